@@ -25,10 +25,18 @@ SOURCES += src/attrmap.cpp \
     src/sync.cpp \
     src/transfer.cpp \
     src/transferslot.cpp \
+    src/chunkcrypto.cpp \
+    src/statesnapshot.cpp \
+    src/statecacheloader.cpp \
+    src/fingerprintpool.cpp \
+    src/syncscanner.cpp \
+    src/db/async.cpp \
     src/treeproc.cpp \
     src/user.cpp \
     src/utils.cpp \
     src/logging.cpp \
+    src/metrics.cpp \
+    src/asynclogger.cpp \
     src/waiterbase.cpp  \
     src/proxy.cpp \
     src/pendingcontactrequest.cpp \
@@ -272,11 +280,19 @@ HEADERS  += include/mega.h \
             include/mega/sync.h \
             include/mega/transfer.h \
             include/mega/transferslot.h \
+            include/mega/chunkcrypto.h \
+            include/mega/statesnapshot.h \
+            include/mega/statecacheloader.h \
+            include/mega/fingerprintpool.h \
+            include/mega/syncscanner.h \
+            include/mega/db/async.h \
             include/mega/treeproc.h \
             include/mega/types.h \
             include/mega/user.h \
             include/mega/utils.h \
             include/mega/logging.h \
+            include/mega/metrics.h \
+            include/mega/asynclogger.h \
             include/mega/waiter.h \
             include/mega/proxy.h \
             include/mega/pendingcontactrequest.h \
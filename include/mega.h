@@ -57,12 +57,20 @@
 #include "mega/pendingcontactrequest.h"
 #include "mega/utils.h"
 #include "mega/logging.h"
+#include "mega/asynclogger.h"
+#include "mega/metrics.h"
 #include "mega/waiter.h"
 
 #include "mega/node.h"
 #include "mega/sync.h"
 #include "mega/transfer.h"
 #include "mega/transferslot.h"
+#include "mega/chunkcrypto.h"
+#include "mega/statesnapshot.h"
+#include "mega/statecacheloader.h"
+#include "mega/db/async.h"
+#include "mega/syncscanner.h"
+#include "mega/fingerprintpool.h"
 #include "mega/megaapp.h"
 #include "mega/megaclient.h"
 
@@ -0,0 +1,113 @@
+/**
+ * @file mega/asynclogger.h
+ * @brief Deferred delivery of log messages on a background thread
+ *
+ * (c) 2013-2018 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifndef MEGA_ASYNCLOGGER_H
+#define MEGA_ASYNCLOGGER_H 1
+
+#include "types.h"
+#include "mega/logging.h"
+#include "mega/thread/qtthread.h"
+#include "mega/thread/posixthread.h"
+#include "mega/thread/win32thread.h"
+#include "mega/thread/cppthread.h"
+
+namespace mega {
+
+// log message waiting for delivery
+struct MEGA_API LogRecord
+{
+    time_t when;
+    int level;
+    int line;
+    string filename;
+    string message;
+};
+
+// deferred delivery of the log messages: while registered as the queue of
+// SimpleLogger, the messages are stored in a bounded ring buffer and a
+// background thread formats their timestamp and source and passes them to
+// the output class and streams, so that the threads that log don't wait
+// for the application's logger
+// - the slots are preallocated and the messages are swapped in and out, so
+//   that the mutex is only held to claim a slot
+// - the thread is woken by the first message after it went to sleep, and
+//   waits BATCHDELAYMS for more messages before delivering them, so that
+//   the other threads rarely pay for a wakeup
+// - when the buffer is full, info, debug and verbose messages are dropped
+//   (and their number logged later), the others are delivered by the caller
+// - fatal messages are delivered by the caller after the queued ones
+// - while suspended, the callers deliver their messages themselves - the
+//   object must outlive all threads that may still have it as the queue
+class MEGA_API AsyncLogger : public LogQueue
+{
+    MUTEX_CLASS mutex;
+    SEMAPHORE_CLASS pending;
+    SEMAPHORE_CLASS idle;
+    SEMAPHORE_CLASS hurry;
+    THREAD_CLASS thread;
+
+    // protected by mutex
+    vector<LogRecord> ring;
+    size_t first;
+    size_t count;
+    unsigned waiting;
+    bool sleeping;
+    bool busy;
+    bool exiting;
+    bool suspended;
+    unsigned long long dropped;
+
+    unsigned long long threadid;
+
+    static void* threadEntryPoint(void*);
+    void deliverloop();
+
+public:
+    static const size_t DEFAULT_CAPACITY = 8192;
+
+    // time the messages are collected before being delivered (ms)
+    static const int BATCHDELAYMS = 10;
+
+    bool push(time_t, int, const char*, int, string*);
+
+    // wait until the messages queued so far have been delivered
+    void flush();
+
+    // messages dropped since the start
+    unsigned long long numdropped();
+
+    // unregister from SimpleLogger and deliver the queued messages (other
+    // threads may still be pushing)...
+    void suspend();
+
+    // ...and register again
+    void resume();
+
+    // registers itself as SimpleLogger's queue
+    AsyncLogger(size_t capacity = DEFAULT_CAPACITY);
+
+    // unregisters itself and delivers the queued messages - no other
+    // thread may be logging
+    ~AsyncLogger();
+};
+} // namespace
+
+#endif
@@ -0,0 +1,116 @@
+/**
+ * @file mega/chunkcrypto.h
+ * @brief Worker threads for transfer chunk encryption/decryption
+ *
+ * (c) 2013-2018 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifndef MEGA_CHUNKCRYPTO_H
+#define MEGA_CHUNKCRYPTO_H 1
+
+#include "http.h"
+#include "mega/thread/qtthread.h"
+#include "mega/thread/posixthread.h"
+#include "mega/thread/win32thread.h"
+#include "mega/thread/cppthread.h"
+
+namespace mega {
+
+// CTR/MAC work on the buffer of a transfer request
+struct MEGA_API ChunkCryptoJob
+{
+    // slot that owns the request
+    TransferSlot* slot;
+
+    // request whose buffer is processed (GET: HttpReqDL, PUT: HttpReqUL)
+    HttpReqXfer* req;
+
+    // transfer direction
+    direction_t type;
+
+    // private copy of the transfer key (Crypto++ mode objects are stateful
+    // and must not be shared between threads)
+    SymmCipher cipher;
+    uint64_t ctriv;
+
+    // GET: size of the transfer
+    // PUT: chunk range to encrypt
+    m_off_t size, pos, npos;
+
+    // PUT: storage server URL for the prepared chunk
+    string tempurl;
+
+    // set by the worker thread when the buffer has been processed (read
+    // through ChunkCryptoPool::finished())
+    bool finished;
+
+    void run();
+
+    ChunkCryptoJob();
+};
+
+// pool of worker threads that run the chunk CTR/MAC work off the SDK thread
+// - jobs are submitted and collected by TransferSlot::doio()
+// - the client's waiter is notified as soon as a job is finished
+class MEGA_API ChunkCryptoPool
+{
+    MegaClient* client;
+
+    MUTEX_CLASS mutex;
+    SEMAPHORE_CLASS pending;
+    SEMAPHORE_CLASS jobdone;
+    vector<THREAD_CLASS*> threads;
+
+    // queued jobs (protected by mutex)
+    std::deque<ChunkCryptoJob*> jobs;
+
+    // jobs being processed by a worker (protected by mutex)
+    std::set<ChunkCryptoJob*> running;
+
+    // the SDK thread is waiting in cancel()
+    bool waiting;
+
+    bool exiting;
+
+    static void *threadEntryPoint(void *param);
+    void loop();
+    void submit(ChunkCryptoJob*);
+
+public:
+    // queue the decryption/MAC of a completed download request
+    // (the request's chunk MACs must have been loaded already)
+    ChunkCryptoJob* decrypt(TransferSlot*, HttpReqDL*);
+
+    // queue the MAC/encryption of the chunk read into an upload request
+    ChunkCryptoJob* encrypt(TransferSlot*, HttpReqUL*, const string&, m_off_t, m_off_t);
+
+    // drop the queued jobs of a slot and wait for the running ones
+    void cancel(TransferSlot*);
+
+    // the job has been processed and can be collected
+    bool finished(ChunkCryptoJob*);
+
+    int numthreads() const;
+
+    ChunkCryptoPool(MegaClient*, int);
+
+    // remaining queued jobs are processed before returning
+    ~ChunkCryptoPool();
+};
+} // namespace
+
+#endif
@@ -431,9 +431,17 @@ class MEGA_API CommandPutNodes : public Command
     putsource_t source;
     handle targethandle;
 
+    // coalesced uploads: tag of the transfer of each node
+    vector<int> tags;
+
+    void appresult(error);
+
 public:
     void procresult();
 
+    // report the result of each node separately, with the given tags
+    void settags(vector<int>*);
+
     CommandPutNodes(MegaClient*, handle, const char*, NewNode*, int, int, putsource_t = PUTNODES_APP);
 };
 
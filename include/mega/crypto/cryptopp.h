@@ -90,6 +90,13 @@ private:
     CryptoPP::GCM<CryptoPP::AES>::Encryption aesgcm_e;
     CryptoPP::GCM<CryptoPP::AES>::Decryption aesgcm_d;
 
+    // expanded AES-128 encryption round keys for the AES-NI/VAES CTR kernels
+    // (only filled in if the CPU supports them)
+    byte aeskeyschedule[11 * CryptoPP::AES::BLOCKSIZE];
+
+    // CTR-crypt (and optionally CBC-MAC) a run of whole blocks
+    void ctr_crypt_blocks(byte*, unsigned, uint64_t, uint64_t, byte*, bool);
+
 public:
     static byte zeroiv[CryptoPP::AES::BLOCKSIZE];
 
@@ -244,8 +251,27 @@ public:
      */
     void serializekeyforjs(string *);
 
+    /**
+     * @brief Encrypt or decrypt in AES-CTR mode, optionally computing the
+     * CBC-MAC of the plain text at the same time.
+     *
+     * Whole blocks are processed by a multi-block kernel selected at runtime
+     * (VAES/AVX-512, AES-NI or a portable batched fallback).
+     *
+     * @param data Data to be processed (in-place). Must be padded to BLOCKSIZE.
+     * @param len Length of data in bytes.
+     * @param pos Position of the data in the file (multiple of BLOCKSIZE).
+     * @param ctriv Counter nonce.
+     * @param mac CBC-MAC buffer (BLOCKSIZE bytes) or NULL.
+     * @param encrypt true to encrypt, false to decrypt.
+     * @param initmac Initialise the MAC from the counter before starting.
+     * @return Void.
+     */
     void ctr_crypt(byte *, unsigned, m_off_t, ctr_iv, byte *, bool, bool initmac = true);
 
+    // name of the CTR kernel used on this CPU
+    static const char* ctr_kernel_name();
+
     static void setint64(int64_t, byte*);
 
     static void xorblock(const byte*, byte*);
@@ -25,12 +25,26 @@
 #include "filesystem.h"
 
 namespace mega {
+// node record returned by a node paging query
+struct MEGA_API DbNodeRecord
+{
+    uint32_t id;
+    handle h;
+    handle ph;
+    string data;
+};
+
+typedef vector<DbNodeRecord> dbnoderecord_vector;
+
 // generic host transactional database access interface
 class MEGA_API DbTable
 {
     static const int IDSPACING = 16;
 
 public:
+    // records serialized per putmany() batch
+    static const unsigned PUTBATCH = 256;
+
     // for a full sequential get: rewind to first record
     virtual void rewind() = 0;
 
@@ -38,6 +52,9 @@ public:
     virtual bool next(uint32_t*, string*) = 0;
     bool next(uint32_t*, string*, SymmCipher*);
 
+    // account for the id of a record read without next(..., SymmCipher*)
+    void checkid(uint32_t);
+
     // get specific record by key
     virtual bool get(uint32_t, string*) = 0;
 
@@ -46,9 +63,16 @@ public:
     bool put(uint32_t, string*);
     bool put(uint32_t, Cachable *, SymmCipher*);
 
+    // update or add several records (default: one put() per record)
+    virtual bool putmany(const uint32_t*, const string*, unsigned);
+    bool putmany(uint32_t, Cachable**, unsigned, SymmCipher*);
+
     // delete specific record
     virtual bool del(uint32_t) = 0;
 
+    // delete several records (default: one del() per record)
+    virtual bool delmany(const uint32_t*, unsigned);
+
     // delete all records
     virtual void truncate() = 0;
 
@@ -64,6 +88,43 @@ public:
     // permanantly remove all database info
     virtual void remove() = 0;
 
+    // node paging: node records can be stored along with their handle, parent
+    // handle, keyed name and fingerprint hashes and a pinned flag, and looked
+    // up by them (unsupported by default)
+    enum { NODES_BYHANDLE, NODES_CHILDREN, NODES_CHILDRENBYNAME, NODES_BYFINGERPRINT, NODES_TOP, NODES_QUERIES };
+
+    // prepare the table for node paging
+    virtual bool enablenodepaging() { return false; }
+
+    // set the lookup keys of a node record
+    virtual bool putnodekeys(uint32_t, handle, handle, uint64_t, uint64_t, bool) { return false; }
+
+    // all records of the given type have their lookup keys set
+    virtual bool nodekeyscomplete(uint32_t) { return false; }
+
+    // for a full sequential get of the records that are not node records
+    virtual void rewindskipnodes() { rewind(); }
+
+    // node records matching a NODES_* query (handle: node or parent,
+    // hash: name or fingerprint hash, NODES_TOP: records whose parent is not
+    // in the table and pinned records)
+    virtual bool getnodes(int, handle, uint64_t, dbnoderecord_vector*) { return false; }
+
+    // UTF-8 path of the StateSnapshot file that accompanies the table
+    // (unsupported by default)
+    virtual bool snapshotpath(string*) { return false; }
+
+    // write-behind tables: commit() only queues the commit, which becomes
+    // durable later (synchronous by default: every commit is durable)
+    // - sequence number of the last commit() call
+    virtual uint64_t commitseq() { return 0; }
+
+    // - sequence number of the last durable commit
+    virtual uint64_t durableseq() { return 0; }
+
+    // - block until all queued mutations and commits are durable
+    virtual void barrier() { }
+
     // autoincrement
     uint32_t nextid;
 
@@ -0,0 +1,140 @@
+/**
+ * @file mega/db/async.h
+ * @brief Write-behind wrapper for database tables
+ *
+ * (c) 2013-2018 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifndef MEGA_DB_ASYNC_H
+#define MEGA_DB_ASYNC_H 1
+
+#include "mega/db.h"
+#include "mega/waiter.h"
+#include "mega/thread/qtthread.h"
+#include "mega/thread/posixthread.h"
+#include "mega/thread/win32thread.h"
+#include "mega/thread/cppthread.h"
+
+namespace mega {
+
+// mutation of the wrapped table, applied by the writer thread
+struct MEGA_API DbJournalOp
+{
+    enum { PUT, DEL, TRUNCATE, NODEKEYS, COMMIT, ABORT, GETNODES } type;
+
+    uint32_t id;
+    string data;
+
+    // NODEKEYS
+    handle h, ph;
+    uint64_t namehash, fphash;
+    bool pinned;
+
+    // COMMIT: sequence number of the commit
+    uint64_t seq;
+
+    // GETNODES: query and the caller's result (filled in by the writer)
+    int query;
+    dbnoderecord_vector* records;
+    bool* result;
+    bool served;
+};
+
+// write-behind table: mutations are appended to an in-memory journal and a
+// writer thread applies them, in order, within a transaction that is kept
+// open between commits
+// - commits queued while the previous one is being flushed are grouped
+// - node paging queries are queued too and answered by the writer thread
+//   once the mutations ahead of them are applied, before it flushes a commit
+//   queued ahead of them (the open transaction already contains its changes)
+// - other reads wait for the journal to be applied (the scsn record read by
+//   MegaClient::updatesc() is served from memory)
+// - a write error is reported by the next mutation
+class MEGA_API AsyncDbTable : public DbTable
+{
+    DbTable* table;
+    Waiter* waiter;
+
+    // journal and writer state
+    MUTEX_CLASS mutex;
+    SEMAPHORE_CLASS pending;
+    SEMAPHORE_CLASS idle;
+    SEMAPHORE_CLASS answered;
+    std::deque<DbJournalOp*> journal;
+    bool busy;
+    unsigned waiting;
+    bool exiting;
+    bool failed;
+    uint64_t durable;
+
+    // held by the writer while it uses the wrapped table
+    MUTEX_CLASS tablemutex;
+
+    THREAD_CLASS writer;
+
+    // SDK thread only
+    uint64_t lastcommit;
+
+    // values of the records read by get(), kept in step with the mutations
+    // (false: no such record)
+    std::map<uint32_t, std::pair<bool, string> > known;
+
+    static void* writerEntryPoint(void*);
+    void writeloop();
+    bool apply(vector<DbJournalOp*>*);
+    void serve(DbJournalOp*);
+    bool enqueue(DbJournalOp*);
+    void stop();
+
+protected:
+    // called with the journal locked once an op has been queued
+    virtual void queued(const DbJournalOp*) { }
+
+public:
+    void rewind();
+    bool next(uint32_t*, string*);
+    bool get(uint32_t, string*);
+    bool put(uint32_t, char*, unsigned);
+    bool putmany(const uint32_t*, const string*, unsigned);
+    bool del(uint32_t);
+    bool delmany(const uint32_t*, unsigned);
+    void truncate();
+    void begin();
+    void commit();
+    void abort();
+    void remove();
+
+    bool enablenodepaging();
+    bool putnodekeys(uint32_t, handle, handle, uint64_t, uint64_t, bool);
+    bool nodekeyscomplete(uint32_t);
+    void rewindskipnodes();
+    bool getnodes(int, handle, uint64_t, dbnoderecord_vector*);
+    bool snapshotpath(string*);
+
+    uint64_t commitseq();
+    uint64_t durableseq();
+    void barrier();
+
+    // takes ownership of the table, the waiter is notified after each commit
+    AsyncDbTable(DbTable*, Waiter*);
+
+    // the queued mutations are applied first
+    ~AsyncDbTable();
+};
+} // namespace
+
+#endif
@@ -39,16 +39,36 @@ public:
 
 class MEGA_API SqliteDbTable : public DbTable
 {
+    // rows written by a single multi-row statement
+    static const unsigned MULTIROW = 32;
+
     sqlite3* db;
     sqlite3_stmt* pStmt;
     string dbfile;
     FileSystemAccess *fsaccess;
 
+    // prepared statements, compiled on first use and kept until the
+    // database is closed
+    sqlite3_stmt* getStmt;
+    sqlite3_stmt* putStmt;
+    sqlite3_stmt* delStmt;
+    sqlite3_stmt* putMultiStmt;
+
+    // node paging
+    sqlite3_stmt* nodeKeysStmt;
+    sqlite3_stmt* nodeStmt[NODES_QUERIES];
+    bool pStmtSkipsNodes;
+
+    bool prepare(sqlite3_stmt**, const char*);
+    bool step(sqlite3_stmt*);
+    void finalize();
+
 public:
     void rewind();
     bool next(uint32_t*, string*);
     bool get(uint32_t, string*);
     bool put(uint32_t, char*, unsigned);
+    bool putmany(const uint32_t*, const string*, unsigned);
     bool del(uint32_t);
     void truncate();
     void begin();
@@ -56,6 +76,14 @@ public:
     void abort();
     void remove();
 
+    bool enablenodepaging();
+    bool putnodekeys(uint32_t, handle, handle, uint64_t, uint64_t, bool);
+    bool nodekeyscomplete(uint32_t);
+    void rewindskipnodes();
+    bool getnodes(int, handle, uint64_t, dbnoderecord_vector*);
+
+    bool snapshotpath(string*);
+
     SqliteDbTable(sqlite3*, FileSystemAccess *fs, string *filepath);
     ~SqliteDbTable();
 };
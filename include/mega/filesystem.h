@@ -111,6 +111,10 @@ struct MEGA_API FileAccess
     // absolute position read to byte buffer
     bool frawread(byte *, unsigned, m_off_t);
 
+    // equally sized reads at several absolute positions to consecutive
+    // byte buffers, with a single open
+    bool frawreadv(byte *, unsigned, const m_off_t *, unsigned);
+
     // non-locking ops: open/close temporary hFile
     bool openf();
     void closef();
@@ -120,6 +124,7 @@ struct MEGA_API FileAccess
 
     // system-specific raw read/open/close
     virtual bool sysread(byte *, unsigned, m_off_t) = 0;
+    virtual bool sysreadv(byte *, unsigned, const m_off_t *, unsigned);
     virtual bool sysstat(m_time_t*, m_off_t*) = 0;
     virtual bool sysopen(bool async = false) = 0;
     virtual void sysclose() = 0;
@@ -159,6 +164,19 @@ struct MEGA_API InputStreamAccess
     virtual ~InputStreamAccess() { }
 };
 
+// directory entry with the attributes that the sync engine compares
+struct MEGA_API DirEntry
+{
+    string localname;
+    nodetype_t type;
+    m_off_t size;
+    m_time_t mtime;
+    handle fsid;
+    bool fsidvalid;
+};
+
+typedef vector<DirEntry> direntry_vector;
+
 // generic host directory enumeration
 struct MEGA_API DirAccess
 {
@@ -168,6 +186,11 @@ struct MEGA_API DirAccess
     // get next record
     virtual bool dnext(string*, string*, bool = true, nodetype_t* = NULL) = 0;
 
+    // read all remaining files and folders of the open directory along with
+    // their attributes, without opening them - called by SyncScanner worker
+    // threads (unsupported by default)
+    virtual bool dread(direntry_vector*, bool = true) { return false; }
+
     virtual ~DirAccess() { }
 };
 
@@ -0,0 +1,100 @@
+/**
+ * @file mega/fingerprintpool.h
+ * @brief Worker threads for sync file fingerprinting
+ *
+ * (c) 2013-2018 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifndef MEGA_FINGERPRINTPOOL_H
+#define MEGA_FINGERPRINTPOOL_H 1
+
+#ifdef ENABLE_SYNC
+#include "filefingerprint.h"
+#include "mega/thread/qtthread.h"
+#include "mega/thread/posixthread.h"
+#include "mega/thread/win32thread.h"
+#include "mega/thread/cppthread.h"
+
+namespace mega {
+
+// fingerprint of a sync file, generated by a worker thread
+struct MEGA_API FingerprintJob
+{
+    // node the fingerprint is for (NULL: cancelled)
+    LocalNode* localnode;
+
+    // full local path at the time the job was queued
+    string localpath;
+
+    // the node was created by the scan that queued the job
+    bool newnode;
+
+    // invalid or negative size if the file couldn't be read
+    FileFingerprint fingerprint;
+};
+
+// pool of worker threads that fingerprint large sync files, so that
+// Sync::checkpath() doesn't wait for their sparse reads
+// - jobs are queued by Sync::checkpath() and collected by MegaClient::exec(),
+//   which applies them through Sync::fingerprintdone()
+// - the client's waiter is notified as soon as a job is finished
+class MEGA_API FingerprintPool
+{
+    FileSystemAccess* fsaccess;
+    Waiter* waiter;
+
+    MUTEX_CLASS mutex;
+    SEMAPHORE_CLASS pending;
+    vector<THREAD_CLASS*> threads;
+
+    // queued, running and finished jobs (protected by mutex)
+    std::deque<FingerprintJob*> jobs;
+    std::set<FingerprintJob*> running;
+    std::deque<FingerprintJob*> done;
+
+    bool exiting;
+
+    static void *threadEntryPoint(void *param);
+    void loop();
+    bool drop(LocalNode*);
+
+public:
+    // queue the fingerprinting of a node's file (replaces a pending job for
+    // the same node)
+    void queue(LocalNode*, string*, bool);
+
+    // drop the pending job of a node, if any
+    void cancel(LocalNode*);
+
+    // finished job (to be deleted by the caller), NULL if none
+    FingerprintJob* collect();
+
+    // process the remaining queued jobs and stop the threads (the finished
+    // jobs can still be collected)
+    void stop();
+
+    int numthreads() const;
+
+    FingerprintPool(FileSystemAccess*, Waiter*, int);
+
+    // jobs not collected are discarded
+    ~FingerprintPool();
+};
+} // namespace
+
+#endif
+#endif
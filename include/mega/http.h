@@ -117,6 +117,20 @@ protected:
     int speedCounter;
 };
 
+// connection usage of a channel (GET/PUT/API)
+struct MEGA_API HttpConnectionStats
+{
+    // sockets open and requests in flight
+    int sockets;
+    int requests;
+
+    // connections established and requests finished
+    long long connects;
+    long long completed;
+
+    HttpConnectionStats();
+};
+
 // generic host HTTP I/O interface
 struct MEGA_API HttpIO : public EventTrigger
 {
@@ -193,6 +207,14 @@ struct MEGA_API HttpIO : public EventTrigger
     // get max upload speed
     virtual m_off_t getmaxuploadspeed();
 
+    // multiplex the transfer requests to the same storage server over
+    // shared HTTP/2 connections, with at most the given number of requests
+    // per connection (0: library default) - false if not supported
+    virtual bool setmultiplexing(bool enable, int maxstreams);
+
+    // connection usage of a channel (GET/PUT/API)
+    virtual void getconnectionstats(direction_t, HttpConnectionStats*);
+
     HttpIO();
     virtual ~HttpIO() { }
 };
@@ -213,6 +235,9 @@ struct MEGA_API HttpReq
 
     bool protect;
 
+    // the response is consumed while it arrives - don't preallocate it
+    bool streamed;
+
     bool sslcheckfailed;
     string sslfakeissuer;
 
@@ -226,6 +251,11 @@ struct MEGA_API HttpReq
     byte* buf;
     m_off_t buflen, bufpos, notifiedbufpos;
 
+    // fixed buffer: buf holds the response from position bufstart, in
+    // bufalloc bytes that are compacted and grown as data arrives (up to
+    // buflen) - the data before bufreleased is not needed anymore
+    m_off_t bufstart, bufalloc, bufreleased;
+
     // we assume that API responses are smaller than 4 GB
     m_off_t contentlength;
 
@@ -270,6 +300,13 @@ struct MEGA_API HttpReq
     // reserve space for incoming data
     byte* reserveput(unsigned* len);
 
+    // fixed buffer: address of the data at a response position
+    byte* bufat(m_off_t pos) { return buf + (pos - bufstart); }
+
+    // fixed buffer: the data up to a response position has been consumed,
+    // its space can be reused for incoming data
+    void releasebuf(m_off_t);
+
     // disconnect open HTTP connection
     void disconnect();
 
@@ -285,6 +322,10 @@ struct MEGA_API HttpReq
     HttpReq(bool = false);
     virtual ~HttpReq();
     void init();
+
+private:
+    // make room in the fixed buffer for the given number of incoming bytes
+    void reservebuf(m_off_t);
 };
 
 struct MEGA_API GenericHttpReq : public HttpReq
@@ -316,10 +357,13 @@ struct MEGA_API HttpReqXfer : public HttpReq
 {
     unsigned size;
 
+    // time the request was posted (Waiter::us(), 0: completion recorded)
+    int64_t posttime;
+
     virtual void prepare(const char*, SymmCipher*, chunkmac_map*, uint64_t, m_off_t, m_off_t) = 0;
     virtual void finalize(Transfer*) { }
 
-    HttpReqXfer() : HttpReq(true), size(0) { }
+    HttpReqXfer() : HttpReq(true), size(0), posttime(0) { }
 };
 
 // file chunk upload
@@ -330,9 +374,21 @@ struct MEGA_API HttpReqUL : public HttpReqXfer
 
     void prepare(const char*, SymmCipher*, chunkmac_map*, uint64_t, m_off_t, m_off_t);
 
+    // prepare() in two steps, so that the CTR/MAC work can run on a worker thread:
+    // MAC, encrypt and checksum the chunk (thread-safe)...
+    void encrypt(SymmCipher*, uint64_t, m_off_t, m_off_t);
+
+    // ...then record the chunk MACs and set the target URL (SDK thread)
+    void commit(const char*, chunkmac_map*, m_off_t);
+
     m_off_t transferred(MegaClient*);
 
     ~HttpReqUL() { }
+
+private:
+    // results of encrypt(): MAC of each chunk in the request
+    chunkmac_map chunkmacs;
+    string crc;
 };
 
 // file chunk download
@@ -341,10 +397,49 @@ struct MEGA_API HttpReqDL : public HttpReqXfer
     m_off_t dlpos;
     chunkmac_map chunkmacs;
 
+    // the received data has been decrypted and MACed
+    bool finalized;
+
+    // initial buffer allocation: larger requests are not buffered whole,
+    // the data that has been written is released while they are in flight
+    static const unsigned INITIALBUFSIZE = 2097152;
+
+    // bytes at the start of the response that have already been decrypted
+    // and MACed / written to the file while the request was in flight
+    m_off_t decryptedpos;
+    m_off_t writtenpos;
+
     void prepare(const char*, SymmCipher*, chunkmac_map*, uint64_t, m_off_t, m_off_t);
     void finalize(Transfer *transfer);
 
+    // decrypt and MAC the chunks that have been received completely, while
+    // they are still in the CPU cache (SDK thread, request in flight)
+    void decryptreceived(Transfer*);
+
+    // same, after loadchunkmacs() (thread-safe)
+    void decryptreceived(SymmCipher*, uint64_t, m_off_t);
+
+    // the decrypted data up to a response position has been written to the
+    // file: its buffer space is released
+    void setwritten(m_off_t);
+
+    // discard the decryption state before the request is sent again
+    void rewind();
+
+    // finalize() in two steps, so that the CTR/MAC work can run on a worker thread:
+    // pick up the state of partially MACed chunks from the transfer (SDK thread)...
+    void loadchunkmacs(Transfer*);
+    void loadchunkmacs(const chunkmac_map*, m_off_t);
+
+    // ...then decrypt and MAC the received data (thread-safe)
+    void decrypt(SymmCipher*, uint64_t, m_off_t);
+
+    HttpReqDL() : dlpos(0), finalized(false), decryptedpos(0), writtenpos(0) { }
     ~HttpReqDL() { }
+
+private:
+    // decrypt and MAC the data from decryptedpos up to a transfer position
+    void decryptupto(SymmCipher*, uint64_t, m_off_t, m_off_t);
 };
 
 // file attribute get
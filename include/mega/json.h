@@ -60,6 +60,8 @@ struct MEGA_API JSON
     bool storestring(string*);
     bool storeobject(string* = NULL);
 
+    static const char* valueend(const char*);
+
     static void unescape(string*);
 
     /**
@@ -88,6 +88,7 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <ctime>
 
 // define MEGA_QT_LOGGING to support QString
 #ifdef MEGA_QT_LOGGING
@@ -112,6 +113,14 @@ public:
     virtual void log(const char *time, int loglevel, const char *source, const char *message) = 0;
 };
 
+// deferred delivery of the log messages (see AsyncLogger)
+class LogQueue {
+public:
+    // takes the message (swapped) - false if it must be delivered by the caller
+    virtual bool push(time_t when, int loglevel, const char *filename, int line, std::string *message) = 0;
+    virtual ~LogQueue() { }
+};
+
 typedef std::vector<std::ostream *> OutputStreams;
 
 class OutputMap : public std::map<enum LogLevel, OutputStreams>
@@ -129,25 +138,42 @@ public:
 class SimpleLogger {
     enum LogLevel level;
     std::ostringstream ostr;
-    std::string t;
-    std::string fname;
+    char const* filename;
+    int line;
+    time_t when;
 
-    OutputStreams getOutput(enum LogLevel ll)
-    {
-        return outputs[ll];
-    }
+    static std::string getTime(time_t);
 
-    std::string getTime();
+    // levels of the modules with their own level (file name without path
+    // and extension) - copy-on-write: the table is replaced, never changed,
+    // so that readers can look it up without the lock (NULL: none)
+    typedef std::map<std::string, enum LogLevel> ModuleLevels;
+    static const ModuleLevels* moduleLevels;
+    static bool moduleEnabled(enum LogLevel ll, char const* filename);
 
 public:
     static OutputMap outputs;
     static Logger *logger;
+    static LogQueue *queue;
 
     static enum LogLevel logCurrentLevel;
 
+    // set if any module has its own level - read without the lock, like
+    // logCurrentLevel
+    static bool hasModuleLevels;
+
     SimpleLogger(enum LogLevel ll, char const* filename, int line);
     ~SimpleLogger();
 
+    // deliver a message to the output class and the output streams
+    static void output(time_t when, enum LogLevel ll, char const* filename, int line, const std::string& message);
+
+    // checked by the LOG_ macros if any module has its own level
+    static bool isEnabled(enum LogLevel ll, char const* filename)
+    {
+        return hasModuleLevels ? moduleEnabled(ll, filename) : logCurrentLevel >= ll;
+    }
+
     static const char *toStr(enum LogLevel ll)
     {
         switch (ll) {
@@ -213,58 +239,83 @@ public:
         SimpleLogger::logCurrentLevel = ll;
     }
 
+    // set the log level of a module (e.g. "transferslot"), which replaces
+    // the current log level for its messages
+    static void setModuleLevel(const char *module, enum LogLevel ll);
+
+    // all modules back to the current log level
+    static void clearModuleLevels();
+
+    // messages queued instead of being delivered by the logging thread
+    // (NULL: synchronous delivery) - a queue that is replaced must stay
+    // valid for the threads that read it before (see AsyncLogger::suspend)
+    static void setQueue(LogQueue *q)
+    {
+        queue = q;
+    }
+
     // Synchronizes all registered stream buffers with their controlled output sequence
     static void flush();
 };
 
 // output VERBOSE log with line break
 #define LOG_verbose \
-    if (SimpleLogger::logCurrentLevel < logMax) ;\
+    if (SimpleLogger::logCurrentLevel < logMax && !SimpleLogger::hasModuleLevels) ;\
+    else if (!SimpleLogger::isEnabled(logMax, __FILE__)) ;\
     else \
         SimpleLogger(logMax, __FILE__, __LINE__)
 
 // output VERBOSE log without line break
 #define LOGn_verbose \
-    if (SimpleLogger::logCurrentLevel < logMax) ;\
+    if (SimpleLogger::logCurrentLevel < logMax && !SimpleLogger::hasModuleLevels) ;\
+    else if (!SimpleLogger::isEnabled(logMax, __FILE__)) ;\
     else \
         SimpleLogger(logMax, __FILE__, __LINE__, false)
 
 // output DEBUG log with line break
 #define LOG_debug \
-    if (SimpleLogger::logCurrentLevel < logDebug) ;\
+    if (SimpleLogger::logCurrentLevel < logDebug && !SimpleLogger::hasModuleLevels) ;\
+    else if (!SimpleLogger::isEnabled(logDebug, __FILE__)) ;\
     else \
         SimpleLogger(logDebug, __FILE__, __LINE__)
 
 // output DEBUG log without line break
 #define LOGn_debug \
-    if (SimpleLogger::logCurrentLevel < logDebug) ;\
+    if (SimpleLogger::logCurrentLevel < logDebug && !SimpleLogger::hasModuleLevels) ;\
+    else if (!SimpleLogger::isEnabled(logDebug, __FILE__)) ;\
     else \
         SimpleLogger(logDebug, __FILE__, __LINE__, false)
 
 #define LOG_info \
-    if (SimpleLogger::logCurrentLevel < logInfo) ;\
+    if (SimpleLogger::logCurrentLevel < logInfo && !SimpleLogger::hasModuleLevels) ;\
+    else if (!SimpleLogger::isEnabled(logInfo, __FILE__)) ;\
     else \
         SimpleLogger(logInfo, __FILE__, __LINE__)
 #define LOGn_info \
-    if (SimpleLogger::logCurrentLevel < logInfo) ;\
+    if (SimpleLogger::logCurrentLevel < logInfo && !SimpleLogger::hasModuleLevels) ;\
+    else if (!SimpleLogger::isEnabled(logInfo, __FILE__)) ;\
     else \
         SimpleLogger(logInfo, __FILE__, __LINE__, false)
 
 #define LOG_warn \
-    if (SimpleLogger::logCurrentLevel < logWarning) ;\
+    if (SimpleLogger::logCurrentLevel < logWarning && !SimpleLogger::hasModuleLevels) ;\
+    else if (!SimpleLogger::isEnabled(logWarning, __FILE__)) ;\
     else \
         SimpleLogger(logWarning, __FILE__, __LINE__)
 #define LOGn_warn \
-    if (SimpleLogger::logCurrentLevel < logWarning) ;\
+    if (SimpleLogger::logCurrentLevel < logWarning && !SimpleLogger::hasModuleLevels) ;\
+    else if (!SimpleLogger::isEnabled(logWarning, __FILE__)) ;\
     else \
         SimpleLogger(logWarning, __FILE__, __LINE__, false)
 
 #define LOG_err \
-    if (SimpleLogger::logCurrentLevel < logError) ;\
+    if (SimpleLogger::logCurrentLevel < logError && !SimpleLogger::hasModuleLevels) ;\
+    else if (!SimpleLogger::isEnabled(logError, __FILE__)) ;\
     else \
         SimpleLogger(logError, __FILE__, __LINE__)
 #define LOGn_err \
-    if (SimpleLogger::logCurrentLevel < logError) ;\
+    if (SimpleLogger::logCurrentLevel < logError && !SimpleLogger::hasModuleLevels) ;\
+    else if (!SimpleLogger::isEnabled(logError, __FILE__)) ;\
     else \
         SimpleLogger(logError, __FILE__, __LINE__, false)
 
@@ -25,6 +25,8 @@
 #include "json.h"
 #include "db.h"
 #include "gfx.h"
+#include "chunkcrypto.h"
+#include "fingerprintpool.h"
 #include "filefingerprint.h"
 #include "request.h"
 #include "transfer.h"
@@ -134,6 +136,15 @@ public:
      */
     dstime timeToLastByte;
 
+    /**
+     * @brief Time until the last record has been decrypted and decoded
+     *
+     * From DB: records are read, decrypted and decoded by worker threads if
+     * MegaClient::nodekeythreads is set - otherwise this is the same as timeToLastByte
+     * From API: not used
+     */
+    dstime timeToDecrypted;
+
     /**
      * @brief Time until the cached filesystem is ready
      *
@@ -341,6 +352,32 @@ public:
     // set max connections per transfer
     void setmaxconnections(direction_t, int);
 
+    // maximum number of transfer crypto worker threads
+    static const unsigned MAX_CRYPTO_THREADS = 16;
+
+    // minimum number of node keys per applykeys() worker thread
+    static const unsigned NODEKEYS_PER_THREAD = 4096;
+
+    // run chunk encryption/decryption on worker threads (0 = on the SDK thread)
+    void setcryptothreads(int);
+
+    // copy the connection and sync counters to the Metrics gauges
+    void updatemetrics();
+
+    // unwrap node keys and decrypt node attributes in applykeys(), and read
+    // and decrypt the local cache in fetchsc(), on worker threads
+    // (0 = on the SDK thread)
+    void setnodekeythreads(int);
+
+    // keep at most this many nodes in memory and fault the others in from
+    // the state cache on demand (0 = disabled) - only before login
+    bool setnodepaging(unsigned);
+
+    // apply and commit the state cache changes on a writer thread, so that
+    // the SDK thread doesn't wait for the database (see AsyncDbTable) - only
+    // before login
+    bool setasyncsccommit(bool);
+
     // enqueue/abort direct read
     void pread(Node*, m_off_t, m_off_t, void*);
     void pread(handle, SymmCipher* key, int64_t, m_off_t, m_off_t, void*, bool = false);
@@ -356,6 +393,21 @@ public:
 
     // indicates whether all startup syncs have been fully scanned
     bool syncsup;
+
+    // number of threads enumerating the local folders during full scans
+    // (0 = on the SDK thread, see SyncScanner)
+    int syncscanthreads;
+    void setsyncscanthreads(int);
+
+    // fingerprint large sync files on worker threads (0 = on the SDK thread,
+    // see FingerprintPool)
+    void setfingerprintthreads(int);
+
+    // sync file fingerprinting worker threads (NULL if disabled)
+    FingerprintPool* fingerprintpool;
+
+    // apply the fingerprints generated by a FingerprintPool
+    void checkfingerprints(FingerprintPool*);
 #endif
 
     // if set, symlinks will be followed except in recursive deletions
@@ -365,6 +417,10 @@ public:
     // number of parallel connections per transfer (PUT/GET)
     unsigned char connections[2];
 
+    // adapt the number of connections of each transfer to its measured
+    // speed (connections[] is the starting point)
+    bool adaptiveconnections;
+
     // generate & return next upload handle
     handle uploadhandle(int);
 
@@ -375,6 +431,19 @@ public:
     // send files/folders to user
     void putnodes(const char*, NewNode*, int);
 
+    // complete an upload with the coalesced putnodes of the uploads to the
+    // same folder (node, target folder, transfer tag)
+    void queueputnodes(NewNode*, handle, int);
+
+    // small-file upload mode: more concurrent uploads of small files, and
+    // their putnodes coalesced into multi-node commands
+    bool batchsmalluploads;
+
+    // maximum number of concurrent uploads in small-file upload mode, and
+    // the size up to which a file counts as small (a single chunk)
+    static const unsigned MAXSMALLUPLOADS;
+    static const m_off_t SMALLUPLOADSIZE;
+
     // attach file attribute to upload or node handle
     void putfa(handle, fatype, SymmCipher*, string*, bool checkAccess = true);
 
@@ -714,6 +783,13 @@ private:
     
     // fetch state serialize from local cache
     bool fetchsc(DbTable*);
+    bool fetchscrecord(uint32_t, string*, NodeRecord*, node_vector*);
+
+    // local logout: save the committed state cache as a StateSnapshot,
+    // which the next fetchsc() loads instead of the database records
+    // (API_ENOENT: no usable snapshot, API_EREAD: invalid records)
+    void writesnapshot();
+    error fetchsnapshot(DbTable*, node_vector*);
 
     // close the local transfer cache
     void closetc(bool remove = false);
@@ -802,6 +878,32 @@ public:
 
     // enable / disable the gfx layer
     bool gfxdisabled;
+
+    // transfer chunk crypto worker threads (NULL if disabled)
+    ChunkCryptoPool* chunkcrypto;
+
+    // number of threads for batched node key/attribute decryption and for
+    // loading the local cache
+    int nodekeythreads;
+
+    // last value assigned to a Node::childrenstamp
+    uint64_t lastchildrenstamp;
+
+    // node paging: maximum number of resident nodes (0 = disabled)
+    unsigned nodepaging;
+
+    // node paging: the state cache holds every node with its lookup keys, so
+    // that nodes can be evicted and faulted in again
+    bool nodepagingready;
+
+    // node paging: resident nodes, most recently used first
+    node_list nodelru;
+
+    // node paging: number of resident nodes that triggers the next eviction
+    size_t nodepagingmark;
+
+    // node paging: some nodes are only available from the state cache
+    bool nodesevicted;
     
     // DB access
     DbAccess* dbaccess;
@@ -812,6 +914,35 @@ public:
     // there is data to commit to the database when possible
     bool pendingsccommit;
 
+    // the state cache has been written since the last commit
+    bool scdirty;
+
+    // the state cache is an AsyncDbTable
+    bool asyncsccommit;
+
+    // commits of the state cache to be reported through notify_dbcommit()
+    // once durable (commit sequence number and scsn)
+    std::deque<std::pair<uint64_t, string> > pendingdbcommits;
+
+    // scsn of the commit being reported through notify_dbcommit()
+    string dbcommitscsn;
+
+    void commitsc();
+    void notifydbcommit();
+    void checkdbcommits();
+
+    // completed uploads waiting for their coalesced putnodes, by target
+    // folder - sent while no API request is in flight, or once MAX_NEWNODES
+    // are queued for a folder
+    std::map<handle, vector<pair<NewNode*, int> > > batchedputnodes;
+    void sendbatchedputnodes(handle);
+    void execbatchedputnodes();
+
+    // upload throughput of the coalesced putnodes (files since
+    // batcheduploadsstart, reset after 10 s without uploads)
+    unsigned batcheduploads;
+    dstime batcheduploadsstart, lastbatcheduploads;
+
     // transfer cache table
     DbTable* tctable;
     // scsn as read from sctable
@@ -845,6 +976,23 @@ public:
     void updatesc();
     void finalizesc(bool);
 
+    // node paging: write the lookup keys of a cached node
+    bool putnodekeys(Node*);
+    uint64_t fingerprinthash(FileFingerprint*);
+
+    // node paging: load node records from the state cache
+    void loadnodes(dbnoderecord_vector*);
+    Node* loadnode(handle);
+
+    // node paging: whether a node can be evicted
+    bool pageable(Node*);
+
+    // node paging: evict least recently used nodes beyond the limit
+    void pagenodes();
+
+    // node paging: the state cache can't be used anymore
+    void disablenodepaging(const char*);
+
     // flag to pause / resume the processing of action packets
     bool scpaused;
 
@@ -945,6 +1093,19 @@ public:
     bool fetchingnodes;
     int fetchnodestag;
 
+    // the node arrays of the fetchnodes response are processed while it
+    // arrives: complete node objects are added and purged from the request
+    // buffer, the rest of the consumed input is kept in fnstreamhead
+    enum { FNSTREAM_START, FNSTREAM_RESULTS, FNSTREAM_NODES, FNSTREAM_KEYS, FNSTREAM_DONE };
+    int fnstream;
+    string fnstreamhead;
+    node_vector fnstreamdp;
+    size_t fnstreamsize;
+    bool fnstreampurged;
+
+    void procfnstream(HttpReq*, bool);
+    void resetfnstream();
+
     // total number of Node objects
     long long totalNodes;
 
@@ -994,10 +1155,18 @@ public:
     // remove node subtree
     void deltree(handle);
 
+    // with node paging, nodes that are not pinned (shares, public links,
+    // syncs, pending changes, resident children...) are evicted when exec()
+    // completes an iteration: Node pointers must not be kept across exec()
+    // calls or outside sdkMutex - keep handles instead
     Node* nodebyhandle(handle);
     Node* nodebyfingerprint(FileFingerprint*);
     node_vector *nodesbyfingerprint(FileFingerprint* fingerprint);
 
+    // node paging: make all children of a node resident (Node::children of a
+    // faulted-in node is incomplete until then)
+    void loadchildren(Node*);
+
     // generate & return upload handle
     handle getuploadhandle();
 
@@ -1064,6 +1233,11 @@ public:
     // total number of LocalNode objects
     long long totalLocalNodes;
 
+    // folders reconciled / skipped as clean by syncdown() and syncup()
+    // (cumulative)
+    long long syncdownvisited, syncdownskipped;
+    long long syncupvisited, syncupskipped;
+
     // sync id dispatch
     handle nextsyncid();
     handle currsyncid;
@@ -1137,6 +1311,7 @@ public:
 
     // process object arrays by the API server
     int readnodes(JSON*, int, putsource_t = PUTNODES_APP, NewNode* = NULL, int = 0, int = 0);
+    bool readnode(JSON*, int, putsource_t, NewNode*, int, int, node_vector*);
 
     void readok(JSON*);
     void readokelement(JSON*);
@@ -1170,6 +1345,10 @@ public:
 
     Node* childnodebyname(Node*, const char*, bool = false);
 
+    // minimum number of children of a folder for childnodebyname() to
+    // build its name index
+    static const unsigned CHILDNAMEINDEX_THRESHOLD = 256;
+
     // purge account state and abort server-client connection
     void purgenodesusersabortsc();
 
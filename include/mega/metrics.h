@@ -0,0 +1,123 @@
+/**
+ * @file mega/metrics.h
+ * @brief Performance counters and latency histograms
+ *
+ * (c) 2013-2018 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifndef MEGA_METRICS_H
+#define MEGA_METRICS_H 1
+
+#include "types.h"
+#include "mega/thread/qtthread.h"
+#include "mega/thread/posixthread.h"
+#include "mega/thread/win32thread.h"
+#include "mega/thread/cppthread.h"
+
+namespace mega {
+
+// log-bucketed histogram: bucket i counts the values in (2^(i-1), 2^i]
+// (bucket 0: up to 1), larger values are only included in count and sum
+struct MEGA_API MetricHistogram
+{
+    static const int NUMBUCKETS = 36;
+
+    uint64_t buckets[NUMBUCKETS];
+    uint64_t count;
+    int64_t sum;
+
+    void add(int64_t);
+
+    MetricHistogram();
+};
+
+// process-wide performance metrics, updated from any thread
+// - metrics are identified by enum values, so that an update is an array
+//   access under a short lock
+// - durations are in microseconds (Waiter::us())
+// - gauges are values owned by a MegaClient, copied with set() before the
+//   metrics are read
+class MEGA_API Metrics
+{
+public:
+    enum counter_t {
+        TRANSFER_BYTES_GET = 0,
+        TRANSFER_BYTES_PUT,
+        TRANSFER_CHUNK_FAILURES_GET,
+        TRANSFER_CHUNK_FAILURES_PUT,
+        UPLOADS_BATCHED,
+        NUMCOUNTERS
+    };
+
+    enum gauge_t {
+        HTTP_SOCKETS_GET = 0,
+        HTTP_SOCKETS_PUT,
+        HTTP_SOCKETS_API,
+        HTTP_REQUESTS_INFLIGHT_GET,
+        HTTP_REQUESTS_INFLIGHT_PUT,
+        HTTP_REQUESTS_INFLIGHT_API,
+        HTTP_CONNECTS_GET,
+        HTTP_CONNECTS_PUT,
+        HTTP_CONNECTS_API,
+        HTTP_REQUESTS_DONE_GET,
+        HTTP_REQUESTS_DONE_PUT,
+        HTTP_REQUESTS_DONE_API,
+        SYNC_FOLDERS_VISITED_SYNCDOWN,
+        SYNC_FOLDERS_VISITED_SYNCUP,
+        SYNC_FOLDERS_SKIPPED_SYNCDOWN,
+        SYNC_FOLDERS_SKIPPED_SYNCUP,
+        NUMGAUGES
+    };
+
+    enum histogram_t {
+        CHUNK_DURATION_GET = 0,
+        CHUNK_DURATION_PUT,
+        CHUNK_DECRYPT_DURATION,
+        CHUNK_ENCRYPT_DURATION,
+        API_REQUEST_DURATION,
+        API_REQUEST_COMMANDS,
+        DB_COMMIT_DURATION,
+        SYNC_SCAN_DURATION,
+        SYNC_SYNCDOWN_DURATION,
+        SYNC_SYNCUP_DURATION,
+        NUMHISTOGRAMS
+    };
+
+    static void add(counter_t, int64_t = 1);
+    static void set(gauge_t, int64_t);
+    static void observe(histogram_t, int64_t);
+
+    // JSON object with the current values
+    static void tojson(string*);
+
+    // Prometheus text exposition format
+    static void toprometheus(string*);
+
+    static void reset();
+
+private:
+    static MUTEX_CLASS mutex;
+
+    static int64_t counters[NUMCOUNTERS];
+    static int64_t gauges[NUMGAUGES];
+    static MetricHistogram histograms[NUMHISTOGRAMS];
+
+    static void snapshot(int64_t*, int64_t*, MetricHistogram*);
+};
+} // namespace
+
+#endif
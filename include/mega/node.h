@@ -67,10 +67,14 @@ struct MEGA_API NewNode : public NodeCore
 
     bool added;
 
+    // handle of the created node (if added)
+    handle addedhandle;
+
     NewNode()
     {
         syncid = UNDEF;
         added = false;
+        addedhandle = UNDEF;
         source = NEW_NODE;
         ovhandle = UNDEF;
         uploadhandle = UNDEF;
@@ -95,6 +99,37 @@ struct MEGA_API PublicLink
     bool isExpired();
 };
 
+// serialized node record split into decoding, which doesn't touch the client
+// and can be done by worker threads, and instantiation
+// (Node::unserialize() = decode() + create())
+struct MEGA_API NodeRecord
+{
+    handle h, ph, owner;
+    nodetype_t type;
+    m_off_t size;
+    m_time_t ctime;
+
+    // pointers into the serialized record
+    const byte* key;
+    const char* fileattrstring;
+    const byte* sharekey;
+    const char* shares;
+    const char* sharesend;
+    short numshares;
+
+    AttrMap attrs;
+
+    bool plink;
+    handle plinkhandle;
+    m_time_t plinkets;
+    bool plinktakendown;
+
+    bool decode(const char*, size_t, FileSystemAccess*);
+    Node* create(MegaClient*, node_vector*);
+
+    NodeRecord();
+};
+
 // filesystem node
 struct MEGA_API Node : public NodeCore, FileFingerprint
 {
@@ -109,12 +144,20 @@ struct MEGA_API Node : public NodeCore, FileFingerprint
     // try to resolve node key string
     bool applykey();
 
+    // locate the encrypted node key and the key that unwraps it
+    // (false if already applied or no suitable key available yet)
+    bool findkey(const char**, SymmCipher**);
+
     // set up nodekey in a static SymmCipher
     SymmCipher* nodecipher();
 
     // decrypt attribute string and set fileattrs
     void setattr();
 
+    // decrypt attribute string into attrs using the supplied node cipher
+    // (thread-safe, does not update the client's fingerprints)
+    bool decryptattrs(SymmCipher*);
+
     // display name (UTF-8)
     const char* displayname() const;
 
@@ -183,6 +226,30 @@ struct MEGA_API Node : public NodeCore, FileFingerprint
     // own position in parent's children
     node_list::iterator child_it;
 
+    // children by display name, only built for large folders (NULL otherwise)
+    nodename_map* childnames;
+
+    // own position in parent's childnames (only valid if the parent has one)
+    nodename_map::iterator childname_it;
+
+    // build the name index of the children
+    void indexchildnames();
+
+    // update own entry in the parent's name index after a name change
+    void reindexname();
+
+    // changes whenever a child is added, removed, renamed or updated - unique
+    // within the client, so that cached sorted listings can be validated
+    uint64_t childrenstamp;
+
+    void childrenchanged();
+
+    // node paging: all children are resident
+    bool childrenloaded;
+
+    // node paging: own position in the client's LRU list
+    node_list::iterator lru_it;
+
     // own position in fingerprint set (only valid for file nodes)
     fingerprint_set::iterator fingerprint_it;
 
@@ -217,6 +284,7 @@ struct MEGA_API Node : public NodeCore, FileFingerprint
 
     bool serialize(string*);
     static Node* unserialize(MegaClient*, string*, node_vector*);
+    static Node* unserialize(MegaClient*, const char*, size_t, node_vector*);
 
     Node(MegaClient*, vector<Node*>*, handle, handle, nodetype_t, m_off_t, handle, const char*, m_time_t);
     ~Node();
@@ -275,6 +343,15 @@ struct MEGA_API LocalNode : public File
 
         // checked for missing attributes
         bool checked : 1;
+
+        // change detected, fingerprint being generated by the
+        // FingerprintPool (the attributes are those of the previous version)
+        bool fingerprinting : 1;
+
+        // the subtree has to be reconciled by the next syncdown() / syncup()
+        // (clean subtrees are skipped)
+        bool syncdowndirty : 1;
+        bool syncupdirty : 1;
     };
 
     // current subtree sync state: current and displayed
@@ -312,6 +389,11 @@ struct MEGA_API LocalNode : public File
 
     void setnotseen(int);
 
+    // flag the node and its ancestors for the next syncdown() / syncup()
+    void setsyncdowndirty();
+    void setsyncupdirty();
+    void setsyncdirty();
+
     void setfsid(handle);
 
     void setnameparent(LocalNode*, string*);
@@ -38,11 +38,79 @@
 #include <aio.h>
 #endif
 
+#ifdef USE_IOURING
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+#endif
+
 #include "mega.h"
 
 #define DEBRISFOLDER ".debris"
 
 namespace mega {
+class PosixDirNotify;
+
+#ifdef USE_IOURING
+struct PosixAsyncIOContext;
+
+// io_uring instance shared by the files of a PosixFileSystemAccess
+// - completions are signalled through an eventfd that is polled along with
+//   the other filesystem events and reaped on the SDK thread
+// - operations beyond the ring size wait in a backlog
+class MEGA_API PosixAsyncIORing
+{
+    int ringfd;
+
+    // submission ring
+    void* sqring;
+    size_t sqringsize;
+    unsigned* sqhead;
+    unsigned* sqtail;
+    unsigned* sqmask;
+    unsigned* sqarray;
+    struct io_uring_sqe* sqes;
+    size_t sqessize;
+
+    // completion ring
+    void* cqring;
+    size_t cqringsize;
+    unsigned* cqhead;
+    unsigned* cqtail;
+    unsigned* cqmask;
+    struct io_uring_cqe* cqes;
+
+    unsigned entries;
+
+    // operations in the kernel / queued entries not accepted by it yet
+    unsigned inflight;
+    unsigned unsubmitted;
+
+    std::deque<PosixAsyncIOContext*> backlog;
+
+    void enter(unsigned, unsigned);
+    void queue(PosixAsyncIOContext*);
+    void complete(PosixAsyncIOContext*, int);
+
+public:
+    // signalled on completions
+    int eventfd;
+
+    // false if io_uring is not supported by the kernel
+    bool init(unsigned);
+
+    void submit(PosixAsyncIOContext*);
+
+    // process completions (waiting for at least one if requested)
+    // returns the number of finished operations
+    int reap(bool);
+
+    PosixAsyncIORing();
+
+    // waits for the operations in progress
+    ~PosixAsyncIORing();
+};
+#endif
+
 struct MEGA_API PosixDirAccess : public DirAccess
 {
     DIR* dp;
@@ -52,6 +120,7 @@ struct MEGA_API PosixDirAccess : public DirAccess
 
     bool dopen(string*, FileAccess*, bool);
     bool dnext(string*, string*, bool, nodetype_t*);
+    bool dread(direntry_vector*, bool);
 
     PosixDirAccess();
     virtual ~PosixDirAccess();
@@ -72,10 +141,31 @@ public:
     string lastname;
 #endif
 
+#ifdef USE_FANOTIFY
+    // whole-filesystem notifications (-1 if unavailable, e.g. unprivileged)
+    int fanotifyfd;
+
+    // syncs whose filesystem is watched through fanotifyfd
+    vector<PosixDirNotify*> fannotifies;
+
+    // inode numbers of the folders identified by the notified file handles
+    static const size_t MAX_FANHANDLES = 65536;
+    map<string, handle> fanhandles;
+
+    int checkfanotify();
+    int fanotifyevent(LocalNode*, const char*, size_t);
+    LocalNode* fanotifynode(const __kernel_fsid_t*, struct file_handle*);
+#endif
+
 #ifdef USE_IOS
     static char *appbasepath;
 #endif
 
+#ifdef USE_IOURING
+    // asynchronous file I/O (NULL if io_uring is not available)
+    PosixAsyncIORing* aioring;
+#endif
+
     bool notifyerr;
     int defaultfilepermissions;
     int defaultfolderpermissions;
@@ -120,14 +210,23 @@ public:
     ~PosixFileSystemAccess();
 };
 
-#ifdef HAVE_AIO_RT
+#if defined(HAVE_AIO_RT) || defined(USE_IOURING)
 struct MEGA_API PosixAsyncIOContext : public AsyncIOContext
 {
     PosixAsyncIOContext();
     virtual ~PosixAsyncIOContext();
     virtual void finish();
 
+#ifdef HAVE_AIO_RT
     struct aiocb *aiocb;
+#endif
+
+#ifdef USE_IOURING
+    // ring processing the operation (NULL when not in progress)
+    PosixAsyncIORing* aioring;
+    int fd;
+    struct iovec iov;
+#endif
 };
 #endif
 
@@ -141,6 +240,10 @@ public:
     DIR* dp;
 #endif
 
+#ifdef USE_IOURING
+    PosixAsyncIORing* aioring;
+#endif
+
     bool fopen(string*, bool, bool);
     void updatelocalname(string*);
     bool fread(string *, unsigned, unsigned, m_off_t);
@@ -148,6 +251,7 @@ public:
     bool fwrite(const byte *, unsigned, m_off_t);
 
     bool sysread(byte *, unsigned, m_off_t);
+    bool sysreadv(byte *, unsigned, const m_off_t *, unsigned);
     bool sysstat(m_time_t*, m_off_t*);
     bool sysopen(bool async = false);
     void sysclose();
@@ -162,9 +266,11 @@ public:
 
     ~PosixFileAccess();
 
-#ifdef HAVE_AIO_RT
+#if defined(HAVE_AIO_RT) || defined(USE_IOURING)
 protected:
     virtual AsyncIOContext* newasynccontext();
+#endif
+#ifdef HAVE_AIO_RT
     static void asyncopfinished(union sigval sigev_value);
 #endif
 };
@@ -174,12 +280,32 @@ class MEGA_API PosixDirNotify : public DirNotify
 public:
     PosixFileSystemAccess* fsaccess;
 
+#ifdef USE_FANOTIFY
+    // events reported for the whole filesystem (new files are reported on
+    // close)
+    static const uint64_t FANOTIFY_MASK = FAN_CREATE | FAN_DELETE | FAN_MOVED_FROM | FAN_MOVED_TO
+                                        | FAN_CLOSE_WRITE | FAN_ONDIR;
+
+    // the sync's filesystem is watched as a whole through fanotify, instead
+    // of one inotify watch per folder
+    bool fanotify;
+
+    // filesystem id, and root folder (to resolve the file handles) and its
+    // inode number
+    __kernel_fsid_t fanfsid;
+    int fanrootfd;
+    handle fanrootino;
+
+    bool watchfilesystem();
+#endif
+
     void addnotify(LocalNode*, string*);
     void delnotify(LocalNode*);
 
     fsfp_t fsfingerprint();
 
     PosixDirNotify(string*, string*);
+    ~PosixDirNotify();
 };
 } // namespace
 
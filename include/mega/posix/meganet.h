@@ -94,6 +94,9 @@ protected:
     static int api_timer_callback(CURLM *multi, long timeout_ms, void *userp);
     static int download_timer_callback(CURLM *multi, long timeout_ms, void *userp);
     static int upload_timer_callback(CURLM *multi, long timeout_ms, void *userp);
+    static int closesocket_callback(void *clientp, curl_socket_t s);
+    static int ares_close_callback(ares_socket_t s, void *userp);
+    void setaressocketfunctions();
 
 #if defined(USE_OPENSSL) && !defined(OPENSSL_IS_BORINGSSL)
     static MUTEX_CLASS **sslMutexes;
@@ -144,6 +147,16 @@ protected:
     set<CURL *>pausedrequests[3];
     m_off_t partialdata[2];
     m_off_t maxspeed[2];
+
+    // HTTP/2 multiplexing of the transfer requests
+    bool http2available;
+    bool multiplexing;
+    int maxstreams;
+    void setmultiplexoptions(direction_t d);
+
+    // connections established and requests finished (per channel)
+    long long numconnects[3];
+    long long numcompleted[3];
     bool curlsocketsprocessed;
     m_time_t arestimeout;
 
@@ -175,6 +188,9 @@ public:
     // get max upload speed
     virtual m_off_t getmaxuploadspeed();
 
+    virtual bool setmultiplexing(bool enable, int maxstreams);
+    virtual void getconnectionstats(direction_t, HttpConnectionStats*);
+
     CurlHttpIO();
     ~CurlHttpIO();
 };
@@ -109,6 +109,10 @@
     #include <sys/inotify.h>
 #endif
 
+#ifdef USE_FANOTIFY
+    #include <sys/fanotify.h>
+#endif
+
 #include <sys/select.h>
 
 #include <curl/curl.h>
@@ -24,26 +24,61 @@
 
 #include "mega/waiter.h"
 
+// epoll is used where available, select() elsewhere
+#if defined(__linux__) && !defined(USE_SELECT)
+#define USE_EPOLL 1
+#include <sys/epoll.h>
+#endif
+
 namespace mega {
 struct PosixWaiter : public Waiter
 {
     PosixWaiter();
     ~PosixWaiter();
 
-    int maxfd;
-    fd_set rfds, wfds, efds;
-    fd_set ignorefds;
+    enum { FDREAD = 1, FDWRITE = 2 };
 
-    bool fd_filter(int nfds, fd_set* fds, fd_set* ignorefds) const;
+    // wake up on activity of a file descriptor in the next wait()
+    // (activity of ignored fds does not request an exec())
+    void addfd(int fd, int events, bool ignore = false);
+
+    // activity (FDREAD/FDWRITE) reported for a file descriptor by the last wait()
+    int fdevents(int fd) const;
+
+    // a file descriptor is about to be closed - its number may be reused
+    void delfd(int fd);
 
     void init(dstime);
     int wait();
-    void bumpmaxfd(int);
 
     void notify();
 
 protected:
     int m_pipe[2];
+
+#ifdef USE_EPOLL
+    // the epoll set persists across wait() calls and is only updated for
+    // file descriptors whose events changed since the previous round
+    int epollfd;
+
+    enum { FDWANTED = 4 };
+
+    // per file descriptor: events of this round (FDWANTED if not ignored),
+    // registered with epoll, reported by the last wait()
+    vector<unsigned char> wanted, registered, reported;
+    vector<int> wantedfds, registeredfds, reportedfds;
+
+    vector<struct epoll_event> epollevents;
+
+    void epollupdate(int, int);
+#else
+    int maxfd;
+    fd_set rfds, wfds, efds;
+    fd_set ignorefds;
+
+    bool fd_filter(int nfds, fd_set* fds, fd_set* ignorefds) const;
+    void bumpmaxfd(int);
+#endif
 };
 } // namespace
 
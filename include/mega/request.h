@@ -55,6 +55,10 @@ class MEGA_API RequestDispatcher
 
     static const int MAX_COMMANDS = 10000;
 
+    // time the request in flight was first generated (Waiter::us()), retries
+    // included in its round-trip time; 0 while no request set is in flight
+    int64_t senttime;
+
 public:
     RequestDispatcher();
 
@@ -64,7 +68,7 @@ public:
 
     int cmdspending() const;
 
-    void get(string*) const;
+    void get(string*);
 
     void procresult(MegaClient*);
 
@@ -0,0 +1,125 @@
+/**
+ * @file mega/statecacheloader.h
+ * @brief Pipelined loading of the state cache
+ *
+ * (c) 2013-2018 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifndef MEGA_STATECACHELOADER_H
+#define MEGA_STATECACHELOADER_H 1
+
+#include "db.h"
+#include "node.h"
+#include "mega/thread/qtthread.h"
+#include "mega/thread/posixthread.h"
+#include "mega/thread/win32thread.h"
+#include "mega/thread/cppthread.h"
+
+namespace mega {
+
+// consecutive state cache records, recycled between the pipeline stages
+struct MEGA_API StateCacheBatch
+{
+    static const unsigned RECORDS = 256;
+
+    // position in the table (batches are handed out in order)
+    unsigned seq;
+
+    unsigned count;
+    uint32_t ids[RECORDS];
+
+    // decrypted and unpadded by a worker
+    string data[RECORDS];
+
+    // decryption succeeded
+    bool valid[RECORDS];
+
+    // node records decoded by a worker
+    NodeRecord nodes[RECORDS];
+    bool decoded[RECORDS];
+};
+
+// state cache loading for fetchsc() in three stages:
+// - a reader thread streams the raw records out of the table
+// - worker threads decrypt them and decode the node records
+// - the SDK thread gets them in table order through next() and only
+//   instantiates and links the objects
+class MEGA_API StateCacheLoader
+{
+    DbTable* table;
+    FileSystemAccess* fsaccess;
+    byte key[SymmCipher::KEYLENGTH];
+
+    MUTEX_CLASS mutex;
+
+    // a batch can be filled / decoded / returned by next()
+    SEMAPHORE_CLASS freeready;
+    SEMAPHORE_CLASS decodeready;
+    SEMAPHORE_CLASS resultready;
+
+    THREAD_CLASS reader;
+    vector<THREAD_CLASS*> workers;
+
+    vector<StateCacheBatch*> batches;
+
+    // protected by mutex
+    std::deque<StateCacheBatch*> freebatches;
+    std::deque<StateCacheBatch*> decodebatches;
+    std::map<unsigned, StateCacheBatch*> decodedbatches;
+    unsigned numread;
+    unsigned numdecoded;
+    bool readdone;
+    bool exiting;
+
+    // Waiter::us() when the last batch was decoded (0 before)
+    int64_t decodedtime;
+    void checkdecoded();
+
+    // SDK thread only
+    StateCacheBatch* current;
+    unsigned numreturned;
+
+    static void* readerEntryPoint(void*);
+    static void* workerEntryPoint(void*);
+    void readloop();
+    void decodeloop();
+
+public:
+    // batches in flight per worker thread
+    static const int BATCHES_PER_THREAD = 4;
+
+    // start reading from the beginning of the table (already rewound) with
+    // the given number of worker threads
+    StateCacheLoader(DbTable*, FileSystemAccess*, SymmCipher*, int);
+
+    // batch of the next records in table order, NULL after the last record
+    // (the previous batch is recycled)
+    StateCacheBatch* next();
+
+    // the reader thread has read the last record
+    bool allread();
+
+    // Waiter::us() at which the workers decoded the last record, 0 if not
+    // done yet
+    int64_t alldecoded();
+
+    // stops the threads - to be deleted before the table is used again
+    ~StateCacheLoader();
+};
+} // namespace
+
+#endif
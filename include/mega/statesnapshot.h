@@ -0,0 +1,128 @@
+/**
+ * @file mega/statesnapshot.h
+ * @brief Binary snapshot of the state cache for fast session resumption
+ *
+ * (c) 2013-2018 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifndef MEGA_STATESNAPSHOT_H
+#define MEGA_STATESNAPSHOT_H 1
+
+#include "filesystem.h"
+
+namespace mega {
+
+// copy of the committed state cache records, written at clean shutdown and
+// consumed by the next fetchsc() instead of reading, decrypting and copying
+// the SQLite rows one by one
+//
+// file layout (native byte order, every section 8-byte aligned):
+// - Header (plain text)
+// - Record[numrecords]: non-node records first, then the node records in
+//   breadth-first order, so that parents precede their children and every
+//   node is linked to its parent as it is created
+// - string pool: the serialized records (Cachable::serialize() format),
+//   zero-padded to a multiple of the AES block size
+// - HMAC-SHA256 of all the above
+//
+// records and pool are AES-CTR encrypted as a whole with a key derived from
+// the master key. Nothing in the layout is position-dependent, so the
+// decrypted payload is used in place.
+//
+// The node records keep the state cache format and are still decoded by
+// Node::unserialize() (in place, without copies): with 200000 nodes
+// (tests/snapshot_bench), reading and decrypting takes 0.05 s instead of
+// 0.45 s from SQLite, decoding 0.18 s and creating the nodes 0.35 s. A
+// fixed-layout node record could only save part of the decoding, the
+// attribute map and the Node objects have to be built anyway.
+class MEGA_API StateSnapshot
+{
+public:
+    static const uint32_t MAGIC = 0x504e534d;
+    static const uint32_t VERSION = 2;
+
+    // no record
+    static const uint32_t NONE = 0xFFFFFFFF;
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+
+        // DbAccess version and scsn of the state cache it mirrors
+        uint32_t dbversion;
+        uint32_t nextid;
+        handle scsn;
+
+        uint64_t ctriv;
+
+        uint32_t numrecords;
+        uint32_t firstnode;
+        uint32_t poolsize;
+        uint32_t reserved;
+    };
+
+    struct Record
+    {
+        // node handle (UNDEF for other records)
+        handle h;
+
+        uint32_t dbid;
+
+        // serialized record in the string pool
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    Header header;
+
+    // add a record - nodes after all other records and in the order
+    // described above
+    void add(uint32_t dbid, string*, handle = UNDEF);
+
+    // encrypt, authenticate and atomically replace the snapshot file
+    // (UTF-8 path)
+    bool write(FileSystemAccess*, const string& path, SymmCipher* masterkey);
+
+    // read, authenticate and decrypt a snapshot file
+    bool read(FileSystemAccess*, const string& path, SymmCipher* masterkey);
+
+    // delete a snapshot file
+    static void remove(FileSystemAccess*, const string& path);
+
+    // access to the records after read()
+    uint32_t numrecords() const;
+    const Record* record(uint32_t) const;
+    const char* data(const Record*) const;
+
+    StateSnapshot();
+
+private:
+    static const int MACLENGTH = 32;
+
+    // Header, Record[] and pool as laid out in the file (decrypted after
+    // read())
+    string buf;
+
+    vector<Record> records;
+    string pool;
+
+    void derivekeys(SymmCipher* masterkey, SymmCipher* cipher, byte* mackey);
+};
+} // namespace
+
+#endif
@@ -78,6 +78,13 @@ public:
     // scan specific path
     LocalNode* checkpath(LocalNode*, string*, string* = NULL, dstime* = NULL);
 
+    // hand the fingerprinting of a large file over to the client's
+    // FingerprintPool (false: to be done synchronously)
+    bool fingerprintasync(LocalNode*, FileAccess*, string*, bool);
+
+    // apply a fingerprint generated by the FingerprintPool
+    void fingerprintdone(FingerprintJob*);
+
     m_off_t localbytes;
     unsigned localnodes[2];
 
@@ -88,6 +95,23 @@ public:
     // LocalNode
     bool scan(string*, FileAccess*);
 
+    // parallel enumeration of the tree during a full scan (NULL if disabled)
+    SyncScanner* scanner;
+
+    // attributes of the entry being checked by scan(), read by the scanner
+    DirEntry* scanentry;
+
+    // start / end of a full scan (statistics and scanner)
+    void startscan();
+    void endscan();
+
+    // entries enumerated since the start of the full scan and start time
+    m_off_t scanentries;
+    dstime scanstart;
+
+    // throughput of the last completed full scan in entries per second
+    m_off_t scanrate;
+
     // own position in session sync list
     sync_list::iterator sync_it;
 
@@ -0,0 +1,112 @@
+/**
+ * @file mega/syncscanner.h
+ * @brief Parallel enumeration of sync trees
+ *
+ * (c) 2013-2018 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifndef MEGA_SYNCSCANNER_H
+#define MEGA_SYNCSCANNER_H 1
+
+#ifdef ENABLE_SYNC
+#include "filesystem.h"
+#include "mega/thread/qtthread.h"
+#include "mega/thread/posixthread.h"
+#include "mega/thread/win32thread.h"
+#include "mega/thread/cppthread.h"
+
+namespace mega {
+
+// folder enumerated by a SyncScanner worker
+struct MEGA_API ScanBatch
+{
+    string localpath;
+    direntry_vector entries;
+};
+
+// parallel enumeration of a sync's tree during full scans: worker threads
+// read the folders with DirAccess::dread() ahead of Sync::scan(), which
+// takes the results instead of enumerating and opening the entries itself
+// - each worker walks its own queue depth-first, and idle workers steal the
+//   shallowest folders from the others
+// - the workers pause while MAX_BUFFERED entries are waiting to be taken
+// - folders that Sync::scan() asks for before a worker started them, or that
+//   can't be read in batch, are left to Sync::scan()
+// - excluded folders are never taken: Sync::scan() reports them with skip(),
+//   which drops their subtrees so that they don't count towards MAX_BUFFERED
+class MEGA_API SyncScanner
+{
+    FileSystemAccess* fsaccess;
+    string localdebris;
+    bool followsymlinks;
+
+    MUTEX_CLASS mutex;
+
+    // work available (or exiting) / result available
+    SEMAPHORE_CLASS workready;
+    SEMAPHORE_CLASS resultready;
+
+    vector<THREAD_CLASS*> workers;
+
+    // protected by mutex
+    vector<std::deque<string> > queues;
+    std::set<string> queued;
+    std::set<string> claimed;
+    std::set<string> active;
+    std::set<string> skipped;
+    std::map<string, ScanBatch*> done;
+    size_t buffered;
+    unsigned idle;
+    unsigned numstarted;
+    bool waiting;
+    bool exiting;
+
+    static void* workerEntryPoint(void*);
+    void scanloop();
+
+    // queue a folder (mutex held)
+    void enqueue(unsigned, const string&);
+
+    // a batch leaves the buffer (mutex held)
+    void unbuffer(ScanBatch*);
+
+public:
+    // entries read ahead of Sync::scan()
+    static const size_t MAX_BUFFERED = 262144;
+
+    // starts enumerating the tree below the local root path (the debris
+    // folder is skipped)
+    SyncScanner(FileSystemAccess*, string*, string*, bool, int);
+
+    // enumeration of the folder (to be deleted by the caller), waits for a
+    // worker that is reading it - NULL: to be enumerated by the caller
+    ScanBatch* take(string*);
+
+    // the entry won't be scanned (excluded): drop whatever was read or
+    // queued below it
+    void skip(string*);
+
+    // number of entries read ahead and not taken yet
+    size_t numbuffered();
+
+    // stops the threads and discards the results not taken
+    ~SyncScanner();
+};
+} // namespace
+
+#endif
+#endif
@@ -78,9 +78,37 @@ struct MEGA_API TransferSlot
     int connections;
     HttpReqXfer** reqs;
 
+    // capacity of the connection arrays (MAX_NUM_CONNECTIONS with adaptive
+    // connection scaling)
+    int maxconnections;
+
+    // adaptive connection scaling: number of connections the slot is
+    // converging to, time and speed of the last decision, direction of the
+    // last change and end of the pause after an unsuccessful increase
+    int targetconnections;
+    dstime lastadapt;
+    m_off_t adaptspeed;
+    int adaptstep;
+    dstime adaptholduntil;
+
+    // interval between adaptive connection decisions (ds)
+    static const dstime ADAPTINTERVAL;
+
+    // pause after an added connection didn't improve the speed (ds)
+    static const dstime ADAPTHOLD;
+
+    // minimum speed improvement (%) to keep an added connection
+    static const int ADAPTMINGAIN;
+
+    // maximum number of connections of all transfers in the same direction
+    static const int MAXDIRECTIONCONNECTIONS;
+
     // async IO operations
     AsyncIOContext** asyncIO;
 
+    // chunk encryption/decryption running on the crypto worker threads
+    struct ChunkCryptoJob** cryptojobs;
+
     // handle I/O for this slot
     void doio(MegaClient*);
 
@@ -90,9 +118,6 @@ struct MEGA_API TransferSlot
     // indicate progress
     void progress();
 
-    // compute the meta MAC based on the chunk MACs
-    int64_t macsmac(chunkmac_map*);
-
     // tslots list position
     transferslot_list::iterator slots_it;
 
@@ -109,6 +134,13 @@ struct MEGA_API TransferSlot
 protected:
     void toggleport(HttpReqXfer* req);
 
+    // grow or shrink the number of connections from the measured speed
+    // (true if a connection was added)
+    bool adjustconnections(MegaClient*);
+
+    // release the idle connections above targetconnections
+    void trimconnections();
+
 };
 } // namespace
 
@@ -85,6 +85,9 @@ struct HttpReq;
 struct GenericHttpReq;
 struct HttpReqCommandPutFA;
 struct LocalNode;
+class SyncScanner;
+class FingerprintPool;
+struct FingerprintJob;
 class MegaClient;
 struct NewNode;
 struct Node;
@@ -117,7 +120,7 @@ typedef uint32_t dstime;
 #define TOSTRING(x) STRINGIFY(x)
 
 // HttpReq states
-typedef enum { REQ_READY, REQ_PREPARED, REQ_INFLIGHT, REQ_SUCCESS, REQ_FAILURE, REQ_DONE, REQ_ASYNCIO } reqstatus_t;
+typedef enum { REQ_READY, REQ_PREPARED, REQ_INFLIGHT, REQ_SUCCESS, REQ_FAILURE, REQ_DONE, REQ_ASYNCIO, REQ_CRYPTO } reqstatus_t;
 
 typedef enum { USER_HANDLE, NODE_HANDLE } targettype_t;
 
@@ -131,15 +134,94 @@ typedef enum { NEW_NODE, NEW_PUBLIC, NEW_UPLOAD } newnodesource_t;
 // file chunk MAC
 struct ChunkMAC
 {
-    ChunkMAC() : offset(0), finished(false) { }
+    ChunkMAC() : offset(0) { }
 
     byte mac[SymmCipher::BLOCKSIZE];
     unsigned int offset;
-    bool finished;
 };
 
-// file chunk macs
-typedef map<m_off_t, ChunkMAC> chunkmac_map;
+// file chunk macs - dense table indexed by ChunkedHash chunk number, with
+// presence/completion bitmaps
+// (the finished state is kept in the bitmap and must be changed through
+// setfinished())
+class chunkmac_map
+{
+    // first chunk number in the table (multiple of 64)
+    size_t base;
+
+    // chunk MACs, indexed by chunk number - base
+    vector<ChunkMAC> macs;
+
+    // one bit per table entry: chunk present / chunk finished
+    vector<uint64_t> presentbits;
+    vector<uint64_t> finishedbits;
+
+    // number of chunks present
+    size_t count;
+
+    // meta-MAC state of the chunks [0, macsmacchunks), which are folded in
+    // as soon as they extend the contiguous finished prefix
+    byte macsmacprefix[SymmCipher::BLOCKSIZE];
+    size_t macsmacchunks;
+
+    // make room for a chunk number
+    void grow(size_t);
+
+    // drop the folded meta-MAC prefix
+    void resetmacsmac();
+
+    bool present(size_t) const;
+
+    // first present chunk number >= n (NOCHUNK if none)
+    size_t nextpresent(size_t) const;
+
+    // first chunk number >= n that is not finished
+    size_t nextunfinished(size_t) const;
+
+    static const size_t NOCHUNK = ~(size_t)0;
+
+public:
+    // chunk at (or containing) a position - created if missing
+    ChunkMAC& operator[](m_off_t);
+
+    // NULL if the chunk is not present
+    const ChunkMAC* find(m_off_t) const;
+
+    bool finished(m_off_t) const;
+    void setfinished(m_off_t, bool = true);
+
+    // mark all chunks that start in [pos, npos) as finished
+    void finishrange(m_off_t, m_off_t);
+
+    // the chunk is missing or no data has been processed for it yet
+    bool unprocessed(m_off_t) const;
+
+    size_t size() const;
+    bool empty() const;
+    void clear();
+
+    // take over all chunks present in another table (usually the chunks
+    // processed by a request)
+    void merge(const chunkmac_map&);
+
+    // skip finished chunks (and the processed part of an unfinished one)
+    m_off_t nextpos(m_off_t) const;
+
+    // resume position (end of the contiguous finished prefix), completed
+    // bytes and bytes in partially processed chunks
+    void calcprogress(m_off_t size, m_off_t& pos, m_off_t& progresscompleted, m_off_t* partial = NULL) const;
+
+    // coalesce the chunk MACs into the file meta-MAC
+    // (only the chunks past the finished prefix are processed again)
+    int64_t macsmac(SymmCipher*);
+
+    // compact form: bitmaps plus the MAC (and offset, if unfinished) of each
+    // present chunk - unserialize() also accepts the former map layout
+    void serialize(string*) const;
+    bool unserialize(const char*&, const char*);
+
+    chunkmac_map();
+};
 
 /**
  * @brief Declaration of API error codes.
@@ -267,6 +349,9 @@ typedef set<Node*> node_set;
 // FIXME: switch to forward_list once C++11 becomes more widely available
 typedef list<Node*> node_list;
 
+// index of the children of a folder by name
+typedef multimap<string, Node*> nodename_map;
+
 // undefined node handle
 const handle UNDEF = ~(handle)0;
 
@@ -294,8 +379,67 @@ typedef map<int, vector<string> > pendingfiles_map;
 // map an upload handle to the corresponding transer
 typedef map<handle, Transfer*> handletransfer_map;
 
-// maps node handles to Node pointers
-typedef map<handle, Node*> node_map;
+// maps node handles to Node pointers - open-addressing hash table with
+// linear probing
+// (UNDEF is not a valid key, iteration order is unspecified and
+// inserting or erasing a handle invalidates all iterators)
+class MEGA_API node_map
+{
+public:
+    typedef pair<handle, Node*> value_type;
+
+    class iterator
+    {
+        friend class node_map;
+
+        value_type* pos;
+        value_type* last;
+
+        // advance to the next used slot
+        void skip();
+
+    public:
+        value_type& operator*() const { return *pos; }
+        value_type* operator->() const { return pos; }
+
+        iterator& operator++();
+        iterator operator++(int);
+
+        bool operator==(const iterator& it) const { return pos == it.pos; }
+        bool operator!=(const iterator& it) const { return pos != it.pos; }
+
+        iterator();
+    };
+
+    iterator begin();
+    iterator end();
+    iterator find(handle);
+
+    // slot of a handle - created (NULL) if missing
+    Node*& operator[](handle);
+
+    size_t erase(handle);
+
+    size_t size() const;
+    bool empty() const;
+    void clear();
+
+    node_map();
+
+private:
+    // power of two, slots with an UNDEF handle are free
+    vector<value_type> slots;
+    unsigned bits;
+    size_t count;
+
+    // preferred slot of a handle
+    size_t home(handle) const;
+
+    // slot of a handle, or of the free slot where it would be inserted
+    size_t lookup(handle) const;
+
+    void rehash(unsigned);
+};
 
 // maps node handles to Share pointers
 typedef map<handle, struct Share*> share_map;
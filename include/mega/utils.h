@@ -46,6 +46,10 @@ struct MEGA_API ChunkedHash
 
     static m_off_t chunkfloor(m_off_t);
     static m_off_t chunkceil(m_off_t, m_off_t limit = -1);
+
+    // number of the chunk containing a position / start of a chunk
+    static size_t chunkindex(m_off_t);
+    static m_off_t chunkpos(size_t);
 };
 
 /**
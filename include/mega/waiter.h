@@ -48,6 +48,9 @@ struct MEGA_API Waiter
     // set ds to current time
     static void bumpds();
 
+    // monotonic time in microseconds (for measurements)
+    static int64_t us();
+
     // wait ceiling
     dstime maxds;
 
@@ -3721,6 +3721,15 @@ public:
      * @return State of the synchronization
      */
     virtual int getState() const;
+
+    /**
+     * @brief Get the throughput of the initial scan of the synchronization
+     *
+     * The value is available once the initial scan is completed.
+     *
+     * @return Local files and folders scanned per second (0 if not available)
+     */
+    virtual long long getScanRate() const;
 };
 
 #endif
@@ -5262,6 +5271,11 @@ class MegaApi
             TRANSFER_METHOD_AUTO_ALTERNATIVE = 4
         };
 
+        enum {
+            METRICS_FORMAT_JSON = 0,
+            METRICS_FORMAT_PROMETHEUS = 1
+        };
+
         enum {
             PUSH_NOTIFICATION_ANDROID = 1,
             PUSH_NOTIFICATION_IOS_VOIP = 2,
@@ -6662,6 +6676,39 @@ class MegaApi
          */
         static void setLogToConsole(bool enable);
 
+        /**
+         * @brief Deliver the logs on a background thread
+         *
+         * By default, each log message is passed to the registered MegaLogger objects by the
+         * thread that generates it, which waits for them. With this option, the messages are
+         * queued and a dedicated thread formats them and passes them to the loggers, in the
+         * same order. When too many messages are waiting, new messages with the levels
+         * MegaApi::LOG_LEVEL_INFO, MegaApi::LOG_LEVEL_DEBUG and MegaApi::LOG_LEVEL_MAX are
+         * dropped, and a warning with the number of dropped messages is logged afterwards.
+         *
+         * When the option is disabled, the queued messages are delivered before this
+         * function returns. It can be changed while other threads are generating logs, but
+         * it must not be called from several threads at the same time.
+         *
+         * @param enable True to deliver the logs on a background thread
+         */
+        static void setAsyncLogging(bool enable);
+
+        /**
+         * @brief Set the log level of a module of the SDK
+         *
+         * The messages of the module use this log level instead of the one set with
+         * MegaApi::setLogLevel, which makes it possible to get detailed logs of a single
+         * module, or to silence it. Modules are named after their source file, without
+         * path and extension (for example, "transferslot" or "sync").
+         *
+         * The module levels can be changed at any time.
+         *
+         * @param module Name of the module (NULL to remove the levels of all modules)
+         * @param logLevel Log level of the module (see MegaApi::setLogLevel)
+         */
+        static void setModuleLogLevel(const char *module, int logLevel);
+
         /**
          * @brief Add a MegaLogger implementation to receive SDK logs
          *
@@ -8752,6 +8799,150 @@ class MegaApi
          */
         void setMaxConnections(int connections, MegaRequestListener* listener = NULL);
 
+        /**
+         * @brief Set the number of worker threads used to encrypt and decrypt transfer chunks
+         *
+         * By default, chunks are encrypted/decrypted and MACed on the thread of the SDK, which
+         * can become a bottleneck with many concurrent transfers on fast connections. With
+         * worker threads, that work is done in parallel while the SDK keeps processing
+         * network events.
+         *
+         * Chunks already being processed are completed before the change takes effect.
+         *
+         * @param threads Number of threads (0 to disable the worker threads, maximum 16)
+         */
+        void setTransferCryptoThreads(int threads);
+
+        /**
+         * @brief Set the number of threads used to decrypt node keys and attributes
+         *
+         * After loading the filesystem of the account, and whenever new share keys become
+         * available, the keys and attributes of the affected nodes are decrypted. By default,
+         * this is done on the thread of the SDK, which dominates the time to log into very
+         * large accounts. With more than one thread, large batches of nodes are decrypted in
+         * parallel.
+         *
+         * When a session is resumed, any non-zero value also moves the reading and decryption
+         * of the local cache to a pipeline of a reader thread and this number of worker
+         * threads, so that the thread of the SDK only has to link the loaded nodes.
+         *
+         * @param threads Number of threads (0 to decrypt on the thread of the SDK, maximum 16)
+         */
+        void setNodeKeyThreads(int threads);
+
+        /**
+         * @brief Limit the number of nodes kept in memory
+         *
+         * By default, the whole filesystem of the account is kept in memory. With node paging,
+         * only up to maxNodes nodes are kept in memory and the rest are loaded from the local
+         * cache when they are accessed, which reduces the memory usage and the time to resume
+         * the session of very large accounts.
+         *
+         * Nodes that are shared, exported, synced or being transferred are always kept in memory,
+         * and the top-level nodes are loaded at startup. Functions that process whole subtrees
+         * (like MegaApi::search) load the affected nodes.
+         *
+         * This option requires the local cache (SQLite) and is ignored after login.
+         *
+         * @param maxNodes Maximum number of nodes in memory (0 to disable node paging)
+         */
+        void setNodePaging(int maxNodes);
+
+        /**
+         * @brief Commit the local cache asynchronously
+         *
+         * By default, the changes to the local cache are committed on the thread of the SDK,
+         * which has to wait for the database to reach the disk after each batch of updates.
+         * With this option, the changes are queued and a dedicated thread applies them and
+         * commits them, grouping the commits requested while the previous one is in progress.
+         *
+         * MegaEvent::EVENT_COMMIT_DB is only sent once the corresponding commit is on disk.
+         *
+         * This option requires the local cache (SQLite) and is ignored after login.
+         *
+         * @param enable True to commit the local cache on a dedicated thread
+         */
+        void setAsyncDbCommit(bool enable);
+
+        /**
+         * @brief Enable the upload mode for large numbers of small files
+         *
+         * By default, each upload requests its own upload URL and is completed with its own
+         * request to add the new node. Uploading many small files is then limited by the
+         * round trips to the API rather than by the bandwidth. With this option, up to 100
+         * small files (up to 128 KB) are uploaded at the same time, so that their upload URLs
+         * are requested together, and the new nodes of the uploads to the same folder are
+         * added with a single request.
+         *
+         * Each upload is still reported separately through MegaTransferListener::onTransferFinish.
+         * Uploads to synced folders and to the inbox of other users aren't affected.
+         *
+         * @param enable True to enable the small-file upload mode
+         */
+        void setSmallFileUploads(bool enable);
+
+        /**
+         * @brief Adapt the number of connections of each transfer to its speed
+         *
+         * By default, each transfer uses the number of connections set with
+         * MegaApi::setMaxConnections for its whole duration. With this option, that number
+         * is only the starting point: a connection is added while the previous one made
+         * the transfer faster, up to 6 connections, and the connections that don't improve
+         * the speed are released. Connections are also released when the bandwidth limit
+         * of the direction is reached or when other transfers are waiting to start.
+         *
+         * The option applies to the transfers started after the call.
+         *
+         * @param enable True to adapt the number of connections of the transfers
+         */
+        void setAdaptiveConnections(bool enable);
+
+        /**
+         * @brief Share HTTP/2 connections between the transfer requests to the same server
+         *
+         * By default, each chunk request of a transfer uses its own connection to the
+         * storage server, even if HTTP/2 is negotiated. With this option, HTTP/2 is requested
+         * from the storage servers and the chunk requests to the same server are multiplexed
+         * over the same connection, up to the specified number of requests per connection.
+         * Another connection is opened when all of them are busy.
+         *
+         * HTTP/2 is only negotiated for HTTPS transfers (see MegaApi::useHttpsOnly).
+         * The option applies to the connections established after the call.
+         *
+         * @param enable True to multiplex the transfer requests
+         * @param maxStreams Maximum number of requests per connection (0 for the default of 100)
+         * @return False if the network layer doesn't support HTTP/2
+         */
+        bool setTransferMultiplexing(bool enable, int maxStreams = 0);
+
+        /**
+         * @brief Get the performance metrics collected by the SDK
+         *
+         * The metrics are shared by all the MegaApi instances of the process. They include:
+         * - Transferred bytes and failed chunk requests per direction
+         * - HTTP connections and requests per channel (downloads, uploads and API)
+         * - Folders visited and skipped by the sync engine
+         * - Histograms of the duration of transfer chunk requests, chunk decryption and
+         * encryption passes, API requests, local cache commits, full sync scans and sync
+         * reconciliation passes (in microseconds), and of the number of commands per API request
+         *
+         * Valid values for the format are:
+         * - MegaApi::METRICS_FORMAT_JSON = 0
+         * A JSON object with the members "counters", "gauges" and "histograms". Each histogram
+         * has the members "count", "sum" and "buckets", where the element i of "buckets" is the
+         * number of values greater than 2^(i-1) and up to 2^i (the first one, up to 1). Trailing
+         * empty buckets are omitted.
+         *
+         * - MegaApi::METRICS_FORMAT_PROMETHEUS = 1
+         * The Prometheus text exposition format (version 0.0.4)
+         *
+         * You take the ownership of the returned value
+         *
+         * @param format Format of the result
+         * @return Current value of the metrics
+         */
+        char *getMetrics(int format = METRICS_FORMAT_JSON);
+
         /**
          * @brief Set the transfer method for downloads
          *
@@ -9407,6 +9598,34 @@ class MegaApi
          */
         void setExclusionUpperSizeLimit(long long limit);
 
+        /**
+         * @brief Set the number of threads used to enumerate local folders during full scans
+         *
+         * By default, the initial scan of a synced folder (and any full rescan) lists and
+         * checks every local file and folder on the thread of the SDK. With this option,
+         * worker threads read the local folders and the attributes of their contents in
+         * advance, so that the SDK only has to compare them with the cached state.
+         *
+         * The change takes effect with the next full scan. The throughput of the initial
+         * scan of each sync is available in MegaSync::getScanRate.
+         *
+         * @param threads Number of threads (0 to scan on the thread of the SDK, maximum 16)
+         */
+        void setSyncScanThreads(int threads);
+
+        /**
+         * @brief Set the number of threads used to fingerprint new and modified synced files
+         *
+         * By default, the fingerprint of each new or modified local file is generated on the
+         * thread of the SDK when the change is detected. For large files this means reading
+         * scattered blocks of the file, which is slow on network filesystems. With this
+         * option, the fingerprints of large files are generated by worker threads and the
+         * change is processed when the result is available.
+         *
+         * @param threads Number of threads (0 to fingerprint on the thread of the SDK, maximum 16)
+         */
+        void setFingerprintThreads(int threads);
+
         /**
          * @brief Move a local file to the local "Debris" folder
          *
@@ -11407,6 +11626,30 @@ class MegaApi
          */
         bool httpServerIsSubtitlesSupportEnabled();
 
+        /**
+         * @brief Serve the performance metrics of the SDK from the HTTP proxy server
+         *
+         * When this feature is enabled, the HTTP proxy server answers the requests for the
+         * path /metrics with the result of MegaApi::getMetrics in the Prometheus text format,
+         * so that it can be scraped by a Prometheus server.
+         *
+         * This feature is disabled by default.
+         *
+         * @param enable True to serve the metrics, false to disable it
+         */
+        void httpServerEnableMetrics(bool enable);
+
+        /**
+         * @brief Check if the HTTP proxy server serves the performance metrics
+         *
+         * See MegaApi::httpServerEnableMetrics.
+         *
+         * This feature is disabled by default.
+         *
+         * @return true if the metrics are served, otherwise false
+         */
+        bool httpServerIsMetricsEnabled();
+
         /**
          * @brief Add a listener to receive information about the HTTP proxy server
          *
@@ -155,6 +155,7 @@ public:
     void removeMegaLogger(MegaLogger *logger);
     void setLogLevel(int logLevel);
     void setLogToConsole(bool enable);
+    void setAsync(bool enable);
     void postLog(int logLevel, const char *message, const char *filename, int line);
     virtual void log(const char *time, int loglevel, const char *source, const char *message);
 
@@ -162,6 +163,7 @@ private:
     MegaMutex mutex;
     set <MegaLogger *> megaLoggers;
     bool logToConsole;
+    AsyncLogger *asyncLogger;
 };
 
 class MegaTransferPrivate;
@@ -862,6 +864,8 @@ public:
     void setState(int state);
     virtual MegaRegExp* getRegExp() const;
     void setRegExp(MegaRegExp *regExp);
+    virtual long long getScanRate() const;
+    void setScanRate(long long scanRate);
 
 protected:
     MegaHandle megaHandle;
@@ -871,6 +875,7 @@ protected:
     long long fingerprint;
     MegaSyncListener *listener;
     int state; 
+    long long scanRate;
 };
 
 #endif
@@ -1712,6 +1717,8 @@ class MegaApiImpl : public MegaApp
         static void addLoggerClass(MegaLogger *megaLogger);
         static void removeLoggerClass(MegaLogger *megaLogger);
         static void setLogToConsole(bool enable);
+        static void setAsyncLogging(bool enable);
+        static void setModuleLogLevel(const char *module, int logLevel);
         static void log(int logLevel, const char* message, const char *filename = NULL, int line = -1);
 
         void createFolder(const char* name, MegaNode *parent, MegaRequestListener *listener = NULL);
@@ -1827,6 +1834,14 @@ class MegaApiImpl : public MegaApp
         bool areTransfersPaused(int direction);
         void setUploadLimit(int bpslimit);
         void setMaxConnections(int direction, int connections, MegaRequestListener* listener = NULL);
+        void setTransferCryptoThreads(int threads);
+        void setNodeKeyThreads(int threads);
+        void setNodePaging(int maxNodes);
+        void setAsyncDbCommit(bool enable);
+        void setSmallFileUploads(bool enable);
+        void setAdaptiveConnections(bool enable);
+        bool setTransferMultiplexing(bool enable, int maxStreams);
+        char *getMetrics(int format);
         void setDownloadMethod(int method);
         void setUploadMethod(int method);
         bool setMaxDownloadSpeed(m_off_t bpslimit);
@@ -1864,6 +1879,8 @@ class MegaApiImpl : public MegaApp
         void setExcludedPaths(vector<string> *excludedPaths);
         void setExclusionLowerSizeLimit(long long limit);
         void setExclusionUpperSizeLimit(long long limit);
+        void setSyncScanThreads(int threads);
+        void setFingerprintThreads(int threads);
         bool moveToLocalDebris(const char *path);
         string getLocalPath(MegaNode *node);
         long long getNumLocalNodes();
@@ -2021,6 +2038,7 @@ class MegaApiImpl : public MegaApp
         void pauseActionPackets();
         void resumeActionPackets();
 
+        static bool (*nodeComparator(int order))(Node *, Node *);
         static bool nodeComparatorDefaultASC  (Node *i, Node *j);
         static bool nodeComparatorDefaultDESC (Node *i, Node *j);
         static bool nodeComparatorSizeASC  (Node *i, Node *j);
@@ -2069,6 +2087,8 @@ class MegaApiImpl : public MegaApp
         int httpServerGetRestrictedMode();
         void httpServerEnableSubtitlesSupport(bool enable);
         bool httpServerIsSubtitlesSupportEnabled();
+        void httpServerEnableMetrics(bool enable);
+        bool httpServerIsMetricsEnabled();
         bool httpServerIsLocalOnly();
         void httpServerEnableOfflineAttribute(bool enable);
 
@@ -2181,6 +2201,7 @@ protected:
         bool httpServerOfflineAttributeEnabled;
         int httpServerRestrictedMode;
         bool httpServerSubtitlesSupportEnabled;
+        bool httpServerMetricsEnabled;
         set<MegaTransferListener *> httpServerListeners;
 #endif
 		
@@ -2231,6 +2252,24 @@ protected:
         int threadExit;
         void loop();
 
+        // sorted children of large folders, validated with Node::childrenstamp
+        struct SortedChildren
+        {
+            uint64_t stamp;
+            vector<Node *> nodes;
+        };
+        map<pair<handle, int>, SortedChildren> childrenCache;
+
+        // folders with fewer children are sorted on every request
+        static const unsigned CHILDREN_CACHE_MIN_CHILDREN = 1000;
+
+        // the cache is flushed when it would exceed this number of listings
+        static const unsigned CHILDREN_CACHE_MAX_ENTRIES = 64;
+
+        // children of parent sorted by order (list order if order is not sorted)
+        // sdkMutex must be locked
+        void getSortedChildren(Node *parent, int order, vector<Node *> *children);
+
         int maxRetries;
 
         // a request-level error occurred
@@ -2627,6 +2666,7 @@ protected:
     bool folderServerEnabled;
     bool offlineAttribute;
     bool subtitlesSupportEnabled;
+    bool metricsEnabled;
     int restrictedMode;
     bool localOnly;
     bool started;
@@ -2720,6 +2760,8 @@ public:
     char* getLink(MegaNode *node, bool enablewebdav = false);
     bool isSubtitlesSupportEnabled();
     void enableSubtitlesSupport(bool enable);
+    bool isMetricsEnabled();
+    void enableMetrics(bool enable);
 
     static void returnHttpCodeBasedOnRequestError(MegaHTTPContext* httpctx, MegaError *e, bool synchronous = true);
     static void returnHttpCode(MegaHTTPContext* httpctx, int errorCode, std::string errorMessage = string(), bool synchronous = true);
@@ -0,0 +1,265 @@
+/**
+ * @file asynclogger.cpp
+ * @brief Deferred delivery of log messages on a background thread
+ *
+ * (c) 2013-2018 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mega/asynclogger.h"
+
+namespace mega {
+AsyncLogger::AsyncLogger(size_t capacity) : mutex(false)
+{
+    ring.resize(capacity > 0 ? capacity : 1);
+    first = 0;
+    count = 0;
+    waiting = 0;
+    sleeping = false;
+    busy = false;
+    exiting = false;
+    suspended = false;
+    dropped = 0;
+    threadid = 0;
+
+    thread.start(threadEntryPoint, this);
+
+    SimpleLogger::setQueue(this);
+}
+
+AsyncLogger::~AsyncLogger()
+{
+    SimpleLogger::setQueue(NULL);
+
+    mutex.lock();
+    exiting = true;
+    bool wake = sleeping;
+    sleeping = false;
+    mutex.unlock();
+
+    if (wake)
+    {
+        pending.release();
+    }
+
+    hurry.release();
+    thread.join();
+}
+
+void* AsyncLogger::threadEntryPoint(void* param)
+{
+    ((AsyncLogger*)param)->deliverloop();
+    return NULL;
+}
+
+// background thread: takes all queued messages at once and delivers them
+// without holding the mutex
+void AsyncLogger::deliverloop()
+{
+    vector<LogRecord> batch;
+    unsigned long long reported = 0;
+
+    mutex.lock();
+    threadid = THREAD_CLASS::currentThreadId();
+
+    for (;;)
+    {
+        while (!count && !exiting)
+        {
+            sleeping = true;
+            mutex.unlock();
+            pending.wait();
+            mutex.lock();
+        }
+
+        if (!count)
+        {
+            break;
+        }
+
+        if (!exiting && !waiting)
+        {
+            // collect more messages (cut short by flush() and exit)
+            mutex.unlock();
+            hurry.timedwait(BATCHDELAYMS);
+            mutex.lock();
+        }
+
+        if (batch.size() < count)
+        {
+            batch.resize(count);
+        }
+
+        size_t n = count;
+        for (size_t i = 0; i < n; i++)
+        {
+            LogRecord& record = ring[(first + i) % ring.size()];
+
+            batch[i].when = record.when;
+            batch[i].level = record.level;
+            batch[i].line = record.line;
+            batch[i].filename.swap(record.filename);
+            batch[i].message.swap(record.message);
+        }
+
+        first = (first + n) % ring.size();
+        count = 0;
+        busy = true;
+
+        unsigned long long numdropped = dropped;
+        mutex.unlock();
+
+        if (numdropped != reported)
+        {
+            std::ostringstream oss;
+            oss << (numdropped - reported) << " log messages dropped";
+            SimpleLogger::output(time(NULL), logWarning, __FILE__, __LINE__, oss.str());
+            reported = numdropped;
+        }
+
+        for (size_t i = 0; i < n; i++)
+        {
+            SimpleLogger::output(batch[i].when, (LogLevel)batch[i].level,
+                                 batch[i].filename.c_str(), batch[i].line, batch[i].message);
+        }
+
+        mutex.lock();
+        busy = false;
+
+        if (!count)
+        {
+            for (; waiting; waiting--)
+            {
+                idle.release();
+            }
+        }
+    }
+
+    mutex.unlock();
+}
+
+bool AsyncLogger::push(time_t when, int level, const char* filename, int line, string* message)
+{
+    if (level == logFatal)
+    {
+        // delivered by the caller, after the queued messages
+        flush();
+        return false;
+    }
+
+    mutex.lock();
+
+    if (exiting)
+    {
+        mutex.unlock();
+        return false;
+    }
+
+    if (suspended)
+    {
+        // the caller read the queue before suspend() - delivered after the
+        // messages that are still queued
+        mutex.unlock();
+        flush();
+        return false;
+    }
+
+    if (count == ring.size())
+    {
+        if (level >= logInfo)
+        {
+            dropped++;
+            mutex.unlock();
+            return true;
+        }
+
+        mutex.unlock();
+        return false;
+    }
+
+    LogRecord& record = ring[(first + count) % ring.size()];
+    record.when = when;
+    record.level = level;
+    record.line = line;
+    record.filename.assign(filename ? filename : "");
+    record.message.swap(*message);
+
+    bool wake = sleeping;
+    sleeping = false;
+    count++;
+    mutex.unlock();
+
+    if (wake)
+    {
+        pending.release();
+    }
+
+    return true;
+}
+
+void AsyncLogger::flush()
+{
+    mutex.lock();
+
+    // the background thread can't wait for itself (messages logged by the
+    // output class)
+    if (threadid == THREAD_CLASS::currentThreadId())
+    {
+        mutex.unlock();
+        return;
+    }
+
+    while ((count || busy) && !exiting)
+    {
+        waiting++;
+        mutex.unlock();
+        hurry.release();
+        idle.wait();
+        mutex.lock();
+    }
+
+    mutex.unlock();
+}
+
+void AsyncLogger::suspend()
+{
+    SimpleLogger::setQueue(NULL);
+
+    mutex.lock();
+    suspended = true;
+    mutex.unlock();
+
+    flush();
+}
+
+void AsyncLogger::resume()
+{
+    mutex.lock();
+    suspended = false;
+    mutex.unlock();
+
+    SimpleLogger::setQueue(this);
+}
+
+unsigned long long AsyncLogger::numdropped()
+{
+    mutex.lock();
+    unsigned long long n = dropped;
+    mutex.unlock();
+
+    return n;
+}
+} // namespace
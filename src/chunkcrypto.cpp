@@ -0,0 +1,230 @@
+/**
+ * @file chunkcrypto.cpp
+ * @brief Worker threads for transfer chunk encryption/decryption
+ *
+ * (c) 2013-2018 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mega.h"
+#include "mega/chunkcrypto.h"
+
+namespace mega {
+ChunkCryptoJob::ChunkCryptoJob()
+{
+    slot = NULL;
+    req = NULL;
+    type = GET;
+    ctriv = 0;
+    size = 0;
+    pos = 0;
+    npos = 0;
+    finished = false;
+}
+
+// runs on a worker thread: only touches the request buffer and the job
+void ChunkCryptoJob::run()
+{
+    if (type == GET)
+    {
+        ((HttpReqDL*)req)->decrypt(&cipher, ctriv, size);
+    }
+    else
+    {
+        ((HttpReqUL*)req)->encrypt(&cipher, ctriv, pos, npos);
+    }
+}
+
+ChunkCryptoPool::ChunkCryptoPool(MegaClient* c, int n) : mutex(false)
+{
+    client = c;
+    waiting = false;
+    exiting = false;
+
+    LOG_debug << "Starting " << n << " chunk crypto threads (" << SymmCipher::ctr_kernel_name() << ")";
+
+    while (n-- > 0)
+    {
+        THREAD_CLASS* thread = new THREAD_CLASS();
+        threads.push_back(thread);
+        thread->start(threadEntryPoint, this);
+    }
+}
+
+ChunkCryptoPool::~ChunkCryptoPool()
+{
+    mutex.lock();
+    exiting = true;
+    mutex.unlock();
+
+    for (size_t i = threads.size(); i--; )
+    {
+        pending.release();
+    }
+
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+        threads[i]->join();
+        delete threads[i];
+    }
+}
+
+void *ChunkCryptoPool::threadEntryPoint(void *param)
+{
+    ((ChunkCryptoPool*)param)->loop();
+    return NULL;
+}
+
+void ChunkCryptoPool::loop()
+{
+    for (;;)
+    {
+        pending.wait();
+
+        mutex.lock();
+        if (jobs.empty())
+        {
+            // only reached at shutdown, after the queue has been drained
+            bool exit = exiting;
+            mutex.unlock();
+
+            if (exit)
+            {
+                break;
+            }
+
+            continue;
+        }
+
+        ChunkCryptoJob* job = jobs.front();
+        jobs.pop_front();
+        running.insert(job);
+        mutex.unlock();
+
+        job->run();
+
+        mutex.lock();
+        running.erase(job);
+        job->finished = true;
+        if (waiting)
+        {
+            waiting = false;
+            jobdone.release();
+        }
+        mutex.unlock();
+
+        client->waiter->notify();
+    }
+}
+
+void ChunkCryptoPool::submit(ChunkCryptoJob* job)
+{
+    mutex.lock();
+    jobs.push_back(job);
+    mutex.unlock();
+
+    pending.release();
+}
+
+ChunkCryptoJob* ChunkCryptoPool::decrypt(TransferSlot* slot, HttpReqDL* req)
+{
+    ChunkCryptoJob* job = new ChunkCryptoJob();
+
+    job->slot = slot;
+    job->req = req;
+    job->type = GET;
+    job->cipher.setkey(slot->transfer->transferkey);
+    job->ctriv = slot->transfer->ctriv;
+    job->size = slot->transfer->size;
+
+    submit(job);
+    return job;
+}
+
+ChunkCryptoJob* ChunkCryptoPool::encrypt(TransferSlot* slot, HttpReqUL* req, const string& tempurl, m_off_t pos, m_off_t npos)
+{
+    ChunkCryptoJob* job = new ChunkCryptoJob();
+
+    job->slot = slot;
+    job->req = req;
+    job->type = PUT;
+    job->cipher.setkey(slot->transfer->transferkey);
+    job->ctriv = slot->transfer->ctriv;
+    job->pos = pos;
+    job->npos = npos;
+    job->tempurl = tempurl;
+
+    submit(job);
+    return job;
+}
+
+void ChunkCryptoPool::cancel(TransferSlot* slot)
+{
+    mutex.lock();
+
+    for (std::deque<ChunkCryptoJob*>::iterator it = jobs.begin(); it != jobs.end(); )
+    {
+        if ((*it)->slot == slot)
+        {
+            it = jobs.erase(it);
+        }
+        else
+        {
+            it++;
+        }
+    }
+
+    for (;;)
+    {
+        bool busy = false;
+        for (std::set<ChunkCryptoJob*>::iterator it = running.begin(); it != running.end(); it++)
+        {
+            if ((*it)->slot == slot)
+            {
+                busy = true;
+                break;
+            }
+        }
+
+        if (!busy)
+        {
+            break;
+        }
+
+        waiting = true;
+        mutex.unlock();
+        jobdone.wait();
+        mutex.lock();
+    }
+
+    waiting = false;
+    mutex.unlock();
+}
+
+bool ChunkCryptoPool::finished(ChunkCryptoJob* job)
+{
+    mutex.lock();
+    bool result = job->finished;
+    mutex.unlock();
+
+    return result;
+}
+
+int ChunkCryptoPool::numthreads() const
+{
+    return int(threads.size());
+}
+} // namespace
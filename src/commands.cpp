@@ -954,38 +954,92 @@ CommandPutNodes::CommandPutNodes(MegaClient* client, handle th,
     tag = ctag;
 }
 
+void CommandPutNodes::settags(vector<int>* ctags)
+{
+    tags.swap(*ctags);
+}
+
+// the coalesced uploads are reported as separate single-node putnodes - an
+// upload whose node is not among the added ones fails (the last node added
+// belongs to another upload)
+void CommandPutNodes::appresult(error e)
+{
+    if (!tags.size())
+    {
+        return client->app->putnodes_result(e, type, nn);
+    }
+
+    for (int i = 0; i < nnsize; i++)
+    {
+        NewNode* newnode = new NewNode[1];
+
+        *newnode = nn[i];
+        nn[i].attrstring = NULL;
+
+        error ne = e;
+        if (!ne && !newnode->added)
+        {
+            LOG_err << "Node of a coalesced upload not added: " << i;
+            ne = API_EINTERNAL;
+        }
+
+        client->restag = tags[i];
+        client->app->putnodes_result(ne, type, newnode);
+    }
+
+    delete [] nn;
+}
+
 // add new nodes and handle->node handle mapping
 void CommandPutNodes::procresult()
 {
     error e;
 
-    pendingdbid_map::iterator it = client->pendingtcids.find(tag);
-    if (it != client->pendingtcids.end())
+    // transfer cache records and temporary files of the uploads
+    size_t numtags = tags.size() ? tags.size() : 1;
+    bool tcupdated = false;
+
+    for (size_t t = 0; t < numtags; t++)
     {
-        if (client->tctable)
+        int ttag = tags.size() ? tags[t] : tag;
+
+        pendingdbid_map::iterator it = client->pendingtcids.find(ttag);
+        if (it != client->pendingtcids.end())
         {
-            client->tctable->begin();
-            vector<uint32_t> &ids = it->second;
-            for (unsigned int i = 0; i < ids.size(); i++)
+            if (client->tctable)
             {
-                if (ids[i])
+                if (!tcupdated)
+                {
+                    client->tctable->begin();
+                    tcupdated = true;
+                }
+
+                vector<uint32_t> &ids = it->second;
+                for (unsigned int i = 0; i < ids.size(); i++)
                 {
-                    client->tctable->del(ids[i]);
+                    if (ids[i])
+                    {
+                        client->tctable->del(ids[i]);
+                    }
                 }
             }
-            client->tctable->commit();
+            client->pendingtcids.erase(it);
         }
-        client->pendingtcids.erase(it);
-    }
-    pendingfiles_map::iterator pit = client->pendingfiles.find(tag);
-    if (pit != client->pendingfiles.end())
-    {
-        vector<string> &pfs = pit->second;
-        for (unsigned int i = 0; i < pfs.size(); i++)
+        pendingfiles_map::iterator pit = client->pendingfiles.find(ttag);
+        if (pit != client->pendingfiles.end())
         {
-            client->fsaccess->unlinklocal(&pfs[i]);
+            vector<string> &pfs = pit->second;
+            for (unsigned int i = 0; i < pfs.size(); i++)
+            {
+                client->fsaccess->unlinklocal(&pfs[i]);
+            }
+            client->pendingfiles.erase(pit);
         }
-        client->pendingfiles.erase(pit);
+    }
+
+    if (tcupdated)
+    {
+        client->tctable->commit();
     }
 
     if (client->json.isnumeric())
@@ -1021,7 +1075,7 @@ void CommandPutNodes::procresult()
 #endif
             if (source == PUTNODES_APP)
             {
-                return client->app->putnodes_result(e, type, nn);
+                return appresult(e);
             }
 #ifdef ENABLE_SYNC
             else
@@ -1102,7 +1156,7 @@ void CommandPutNodes::procresult()
             }
         }
 #endif
-        client->app->putnodes_result(e, type, nn);
+        appresult(e);
     }
 #ifdef ENABLE_SYNC
     else
@@ -3950,7 +4004,11 @@ void CommandFetchNodes::procresult()
     WAIT_CLASS::bumpds();
     client->fnstats.timeToLastByte = Waiter::ds - client->fnstats.startTime;
 
-    client->purgenodesusersabortsc();
+    // the nodes may have been processed while the response was arriving
+    if (!client->fnstreampurged)
+    {
+        client->purgenodesusersabortsc();
+    }
 
     if (client->json.isnumeric())
     {
@@ -21,6 +21,16 @@
 
 #include "mega.h"
 
+// hardware AES kernels for CTR/CBC-MAC (runtime-dispatched, no global -maes needed)
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define MEGA_AESNI_KERNEL 1
+#include <cpuid.h>
+#include <immintrin.h>
+#if (defined(__clang__) && __clang_major__ >= 6) || (!defined(__clang__) && __GNUC__ >= 8)
+#define MEGA_VAES_KERNEL 1
+#endif
+#endif
+
 namespace mega {
 #ifndef htobe64
 #define htobe64(x) (((uint64_t)htonl((uint32_t)((x) >> 32))) | (((uint64_t)htonl((uint32_t)x)) << 32))
@@ -30,6 +40,308 @@ using namespace CryptoPP;
 
 AutoSeededRandomPool PrnGen::rng;
 
+enum { CTR_KERNEL_PORTABLE, CTR_KERNEL_AESNI, CTR_KERNEL_VAES };
+
+// number of blocks whose keystream is generated per call in the portable path
+#define CTR_BATCH 64
+
+#ifdef MEGA_AESNI_KERNEL
+static int detectctrkernel()
+{
+    unsigned a, b, c, d;
+
+    if (!__get_cpuid(1, &a, &b, &c, &d) || !(c & bit_AES) || !(c & bit_SSE2 || d & bit_SSE2))
+    {
+        return CTR_KERNEL_PORTABLE;
+    }
+
+#ifdef MEGA_VAES_KERNEL
+    // VAES with 512-bit vectors also requires the OS to save the ZMM state
+    if ((c & bit_OSXSAVE) && __get_cpuid_max(0, NULL) >= 7)
+    {
+        unsigned xcr0, xcr0hi;
+        __asm__ __volatile__ ("xgetbv" : "=a"(xcr0), "=d"(xcr0hi) : "c"(0));
+
+        if ((xcr0 & 0xe6) == 0xe6)
+        {
+            __cpuid_count(7, 0, a, b, c, d);
+
+            if ((b & (1 << 16)) && (c & (1 << 9)))  // AVX512F, VAES
+            {
+                return CTR_KERNEL_VAES;
+            }
+        }
+    }
+#endif
+
+    return CTR_KERNEL_AESNI;
+}
+
+static int ctrkernel()
+{
+    // benign race: every thread computes the same value
+    static int kernel = -1;
+
+    if (kernel < 0)
+    {
+        kernel = detectctrkernel();
+    }
+
+    return kernel;
+}
+
+__attribute__((target("aes,sse2")))
+static inline __m128i aesni_keyexpand(__m128i key, __m128i assist)
+{
+    assist = _mm_shuffle_epi32(assist, 0xff);
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    return _mm_xor_si128(key, assist);
+}
+
+#define AESNI_EXPAND_ROUND(i, rcon) \
+    rk[i] = aesni_keyexpand(rk[i - 1], _mm_aeskeygenassist_si128(rk[i - 1], rcon))
+
+// AES-128 encryption key schedule
+__attribute__((target("aes,sse2")))
+static void aesni_setkey(const byte* key, byte* schedule)
+{
+    __m128i rk[11];
+
+    rk[0] = _mm_loadu_si128((const __m128i*)key);
+    AESNI_EXPAND_ROUND(1, 0x01);
+    AESNI_EXPAND_ROUND(2, 0x02);
+    AESNI_EXPAND_ROUND(3, 0x04);
+    AESNI_EXPAND_ROUND(4, 0x08);
+    AESNI_EXPAND_ROUND(5, 0x10);
+    AESNI_EXPAND_ROUND(6, 0x20);
+    AESNI_EXPAND_ROUND(7, 0x40);
+    AESNI_EXPAND_ROUND(8, 0x80);
+    AESNI_EXPAND_ROUND(9, 0x1b);
+    AESNI_EXPAND_ROUND(10, 0x36);
+
+    for (int i = 0; i < 11; i++)
+    {
+        _mm_storeu_si128((__m128i*)(schedule + i * 16), rk[i]);
+    }
+}
+
+#undef AESNI_EXPAND_ROUND
+
+// counter block: 64-bit nonce as stored in memory, followed by the big-endian block index
+__attribute__((target("sse2")))
+static inline __m128i aesni_ctrblock(uint64_t ctriv, uint64_t index)
+{
+    return _mm_set_epi64x((long long)__builtin_bswap64(index), (long long)ctriv);
+}
+
+// plain CTR, eight independent blocks in flight to saturate the AES units
+__attribute__((target("aes,sse2")))
+static void aesni_ctr(const byte* schedule, byte* data, size_t nblocks, uint64_t ctriv, uint64_t index)
+{
+    __m128i rk[11];
+    __m128i b[8];
+
+    for (int r = 0; r < 11; r++)
+    {
+        rk[r] = _mm_loadu_si128((const __m128i*)(schedule + r * 16));
+    }
+
+    while (nblocks >= 8)
+    {
+        for (int k = 0; k < 8; k++)
+        {
+            b[k] = _mm_xor_si128(aesni_ctrblock(ctriv, index + k), rk[0]);
+        }
+
+        for (int r = 1; r < 10; r++)
+        {
+            for (int k = 0; k < 8; k++)
+            {
+                b[k] = _mm_aesenc_si128(b[k], rk[r]);
+            }
+        }
+
+        for (int k = 0; k < 8; k++)
+        {
+            __m128i* p = (__m128i*)(data + k * 16);
+            b[k] = _mm_aesenclast_si128(b[k], rk[10]);
+            _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), b[k]));
+        }
+
+        data += 8 * 16;
+        index += 8;
+        nblocks -= 8;
+    }
+
+    while (nblocks--)
+    {
+        __m128i* p = (__m128i*)data;
+        __m128i t = _mm_xor_si128(aesni_ctrblock(ctriv, index), rk[0]);
+
+        for (int r = 1; r < 10; r++)
+        {
+            t = _mm_aesenc_si128(t, rk[r]);
+        }
+
+        t = _mm_aesenclast_si128(t, rk[10]);
+        _mm_storeu_si128(p, _mm_xor_si128(_mm_loadu_si128(p), t));
+
+        data += 16;
+        index++;
+    }
+}
+
+// CTR with CBC-MAC of the plain text. The MAC chain is inherently serial, so
+// each MAC round is paired with a round of an independent keystream block,
+// which hides the keystream generation in the latency of the chain. When
+// decrypting, the keystream for the next block is computed ahead so that the
+// plain text is ready as soon as the previous MAC step completes.
+__attribute__((target("aes,sse2")))
+static void aesni_ctr_mac(const byte* schedule, byte* data, size_t nblocks, uint64_t ctriv, uint64_t index, byte* mac, bool encrypt)
+{
+    __m128i rk[11];
+
+    for (int r = 0; r < 11; r++)
+    {
+        rk[r] = _mm_loadu_si128((const __m128i*)(schedule + r * 16));
+    }
+
+    __m128i m = _mm_loadu_si128((const __m128i*)mac);
+
+    if (encrypt)
+    {
+        while (nblocks--)
+        {
+            __m128i* p = (__m128i*)data;
+            __m128i plain = _mm_loadu_si128(p);
+            __m128i t = _mm_xor_si128(aesni_ctrblock(ctriv, index), rk[0]);
+
+            m = _mm_xor_si128(_mm_xor_si128(m, plain), rk[0]);
+
+            for (int r = 1; r < 10; r++)
+            {
+                m = _mm_aesenc_si128(m, rk[r]);
+                t = _mm_aesenc_si128(t, rk[r]);
+            }
+
+            m = _mm_aesenclast_si128(m, rk[10]);
+            t = _mm_aesenclast_si128(t, rk[10]);
+            _mm_storeu_si128(p, _mm_xor_si128(plain, t));
+
+            data += 16;
+            index++;
+        }
+    }
+    else
+    {
+        // keystream for the first block
+        __m128i t = _mm_xor_si128(aesni_ctrblock(ctriv, index), rk[0]);
+
+        for (int r = 1; r < 10; r++)
+        {
+            t = _mm_aesenc_si128(t, rk[r]);
+        }
+
+        t = _mm_aesenclast_si128(t, rk[10]);
+
+        while (nblocks--)
+        {
+            __m128i* p = (__m128i*)data;
+            __m128i plain = _mm_xor_si128(_mm_loadu_si128(p), t);
+            _mm_storeu_si128(p, plain);
+
+            // the keystream of the following block is computed speculatively
+            // alongside the MAC step (harmless past the end)
+            index++;
+            t = _mm_xor_si128(aesni_ctrblock(ctriv, index), rk[0]);
+            m = _mm_xor_si128(_mm_xor_si128(m, plain), rk[0]);
+
+            for (int r = 1; r < 10; r++)
+            {
+                m = _mm_aesenc_si128(m, rk[r]);
+                t = _mm_aesenc_si128(t, rk[r]);
+            }
+
+            m = _mm_aesenclast_si128(m, rk[10]);
+            t = _mm_aesenclast_si128(t, rk[10]);
+
+            data += 16;
+        }
+    }
+
+    _mm_storeu_si128((__m128i*)mac, m);
+}
+
+#ifdef MEGA_VAES_KERNEL
+// plain CTR, sixteen blocks per iteration in four 512-bit lanes
+__attribute__((target("avx512f,vaes,aes,sse2")))
+static void vaes_ctr(const byte* schedule, byte* data, size_t nblocks, uint64_t ctriv, uint64_t index)
+{
+    __m512i rk[11];
+    __m512i b[4];
+
+    for (int r = 0; r < 11; r++)
+    {
+        rk[r] = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i*)(schedule + r * 16)));
+    }
+
+    while (nblocks >= 16)
+    {
+        for (int q = 0; q < 4; q++)
+        {
+            uint64_t i = index + q * 4;
+
+            b[q] = _mm512_set_epi64((long long)__builtin_bswap64(i + 3), (long long)ctriv,
+                                    (long long)__builtin_bswap64(i + 2), (long long)ctriv,
+                                    (long long)__builtin_bswap64(i + 1), (long long)ctriv,
+                                    (long long)__builtin_bswap64(i), (long long)ctriv);
+            b[q] = _mm512_xor_si512(b[q], rk[0]);
+        }
+
+        for (int r = 1; r < 10; r++)
+        {
+            for (int q = 0; q < 4; q++)
+            {
+                b[q] = _mm512_aesenc_epi128(b[q], rk[r]);
+            }
+        }
+
+        for (int q = 0; q < 4; q++)
+        {
+            byte* p = data + q * 64;
+            b[q] = _mm512_aesenclast_epi128(b[q], rk[10]);
+            _mm512_storeu_si512(p, _mm512_xor_si512(_mm512_loadu_si512(p), b[q]));
+        }
+
+        data += 16 * 16;
+        index += 16;
+        nblocks -= 16;
+    }
+
+    if (nblocks)
+    {
+        aesni_ctr(schedule, data, nblocks, ctriv, index);
+    }
+}
+#endif
+#endif
+
+const char* SymmCipher::ctr_kernel_name()
+{
+#ifdef MEGA_AESNI_KERNEL
+    switch (ctrkernel())
+    {
+        case CTR_KERNEL_VAES:
+            return "VAES";
+        case CTR_KERNEL_AESNI:
+            return "AES-NI";
+    }
+#endif
+    return "portable";
+}
+
 // cryptographically strong random byte sequence
 void PrnGen::genblock(byte* buf, int len)
 {
@@ -62,6 +374,13 @@ void SymmCipher::setkey(const byte* newkey, int type)
         xorblock(newkey + KEYLENGTH, key);
     }
 
+#ifdef MEGA_AESNI_KERNEL
+    if (ctrkernel() != CTR_KERNEL_PORTABLE)
+    {
+        aesni_setkey(key, aeskeyschedule);
+    }
+#endif
+
     aesecb_e.SetKey(key, KEYLENGTH);
     aesecb_d.SetKey(key, KEYLENGTH);
 
@@ -279,6 +598,19 @@ void SymmCipher::ctr_crypt(byte* data, unsigned len, m_off_t pos, ctr_iv ctriv,
         memcpy(mac + sizeof ctriv, ctr, sizeof ctriv);
     }
 
+    // whole blocks go through the multi-block kernel, a trailing partial
+    // block (if any) is handled below
+    unsigned nblocks = len / BLOCKSIZE;
+
+    if (nblocks)
+    {
+        ctr_crypt_blocks(data, nblocks, pos / BLOCKSIZE, ctriv, mac, encrypt);
+
+        data += nblocks * BLOCKSIZE;
+        len -= nblocks * BLOCKSIZE;
+        setint64(pos / BLOCKSIZE + nblocks, ctr + sizeof ctriv);
+    }
+
     while ((int)len > 0)
     {
         if (encrypt)
@@ -319,6 +651,72 @@ void SymmCipher::ctr_crypt(byte* data, unsigned len, m_off_t pos, ctr_iv ctriv,
     }
 }
 
+void SymmCipher::ctr_crypt_blocks(byte* data, unsigned nblocks, uint64_t index, uint64_t ctriv, byte* mac, bool encrypt)
+{
+#ifdef MEGA_AESNI_KERNEL
+    int kernel = ctrkernel();
+
+    if (kernel != CTR_KERNEL_PORTABLE)
+    {
+        if (mac)
+        {
+            aesni_ctr_mac(aeskeyschedule, data, nblocks, ctriv, index, mac, encrypt);
+        }
+#ifdef MEGA_VAES_KERNEL
+        else if (kernel == CTR_KERNEL_VAES)
+        {
+            vaes_ctr(aeskeyschedule, data, nblocks, ctriv, index);
+        }
+#endif
+        else
+        {
+            aesni_ctr(aeskeyschedule, data, nblocks, ctriv, index);
+        }
+
+        return;
+    }
+#endif
+
+    // portable path: generate the keystream for a batch of counters with a
+    // single ECB call, which lets Crypto++ use its own pipelined implementation
+    byte keystream[CTR_BATCH * BLOCKSIZE];
+
+    while (nblocks)
+    {
+        unsigned batch = nblocks < CTR_BATCH ? nblocks : CTR_BATCH;
+
+        for (unsigned i = 0; i < batch; i++)
+        {
+            MemAccess::set<uint64_t>(keystream + i * BLOCKSIZE, ctriv);
+            setint64(index + i, keystream + i * BLOCKSIZE + sizeof ctriv);
+        }
+
+        aesecb_e.ProcessData(keystream, keystream, batch * BLOCKSIZE);
+
+        for (unsigned i = 0; i < batch; i++)
+        {
+            if (mac && encrypt)
+            {
+                xorblock(data, mac);
+                ecb_encrypt(mac);
+            }
+
+            xorblock(keystream + i * BLOCKSIZE, data);
+
+            if (mac && !encrypt)
+            {
+                xorblock(data, mac);
+                ecb_encrypt(mac);
+            }
+
+            data += BLOCKSIZE;
+        }
+
+        index += batch;
+        nblocks -= batch;
+    }
+}
+
 static void rsaencrypt(Integer* key, Integer* m)
 {
     *m = a_exp_b_mod_c(*m, key[AsymmCipher::PUB_E], key[AsymmCipher::PUB_PQ]);
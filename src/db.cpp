@@ -58,6 +58,75 @@ bool DbTable::put(uint32_t type, Cachable* record, SymmCipher* key)
     return put(record->dbid, &data);
 }
 
+// add or update several records
+bool DbTable::putmany(const uint32_t* ids, const string* data, unsigned count)
+{
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (!put(ids[i], (char*)data[i].data(), data[i].size()))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// add or update records with padding and encryption, PUTBATCH at a time
+bool DbTable::putmany(uint32_t type, Cachable** records, unsigned count, SymmCipher* key)
+{
+    uint32_t ids[PUTBATCH];
+    string data[PUTBATCH];
+
+    while (count)
+    {
+        unsigned n = 0;
+
+        for (; count && n < PUTBATCH; records++, count--)
+        {
+            Cachable* record = *records;
+
+            data[n].clear();
+            if (!record->serialize(&data[n]))
+            {
+                // as in put(): skip the record and save the rest
+                LOG_warn << "Serialization failed: " << type;
+                continue;
+            }
+
+            PaddedCBC::encrypt(&data[n], key);
+
+            if (!record->dbid)
+            {
+                record->dbid = (nextid += IDSPACING) | type;
+            }
+
+            ids[n++] = record->dbid;
+        }
+
+        if (n && !putmany(ids, data, n))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// delete several records
+bool DbTable::delmany(const uint32_t* ids, unsigned count)
+{
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (!del(ids[i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 // get next record, decrypt and unpad
 bool DbTable::next(uint32_t* type, string* data, SymmCipher* key)
 {
@@ -68,10 +137,7 @@ bool DbTable::next(uint32_t* type, string* data, SymmCipher* key)
             return true;
         }
 
-        if (*type > nextid)
-        {
-            nextid = *type & - IDSPACING;
-        }
+        checkid(*type);
 
         return PaddedCBC::decrypt(data, key);
     }
@@ -79,6 +145,15 @@ bool DbTable::next(uint32_t* type, string* data, SymmCipher* key)
     return false;
 }
 
+// new records must get higher ids than the existing ones
+void DbTable::checkid(uint32_t id)
+{
+    if (id > nextid)
+    {
+        nextid = id & - IDSPACING;
+    }
+}
+
 DbAccess::DbAccess()
 {
     currentDbVersion = LEGACY_DB_VERSION;
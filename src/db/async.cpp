@@ -0,0 +1,596 @@
+/**
+ * @file async.cpp
+ * @brief Write-behind wrapper for database tables
+ *
+ * (c) 2013-2018 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mega/db/async.h"
+#include "mega/logging.h"
+
+namespace mega {
+AsyncDbTable::AsyncDbTable(DbTable* t, Waiter* w) : mutex(false), tablemutex(false)
+{
+    table = t;
+    waiter = w;
+    nextid = t->nextid;
+
+    busy = false;
+    waiting = 0;
+    exiting = false;
+    failed = false;
+    durable = 0;
+    lastcommit = 0;
+
+    // the writer thread keeps a transaction open between commits
+    table->begin();
+
+    writer.start(writerEntryPoint, this);
+}
+
+AsyncDbTable::~AsyncDbTable()
+{
+    stop();
+
+    // anything not committed yet is discarded by the table, as usual
+    delete table;
+}
+
+// apply the journal and stop the writer thread
+void AsyncDbTable::stop()
+{
+    mutex.lock();
+    if (exiting)
+    {
+        mutex.unlock();
+        return;
+    }
+
+    exiting = true;
+    mutex.unlock();
+
+    pending.release();
+    writer.join();
+}
+
+void* AsyncDbTable::writerEntryPoint(void* param)
+{
+    ((AsyncDbTable*)param)->writeloop();
+    return NULL;
+}
+
+// writer thread: takes all queued mutations at once, so that the commits
+// queued while the previous round was being flushed are grouped
+void AsyncDbTable::writeloop()
+{
+    vector<DbJournalOp*> ops;
+
+    mutex.lock();
+
+    for (;;)
+    {
+        while (journal.empty() && !exiting)
+        {
+            mutex.unlock();
+            pending.wait();
+            mutex.lock();
+        }
+
+        if (journal.empty())
+        {
+            break;
+        }
+
+        ops.assign(journal.begin(), journal.end());
+        journal.clear();
+        busy = true;
+        bool skip = failed;
+        mutex.unlock();
+
+        uint64_t seq = 0;
+        bool ok = true;
+
+        tablemutex.lock();
+
+        if (!skip)
+        {
+            ok = apply(&ops);
+        }
+
+        // queries are answered even if the mutations failed or were skipped
+        for (size_t i = 0; i < ops.size(); i++)
+        {
+            serve(ops[i]);
+        }
+
+        tablemutex.unlock();
+
+        for (size_t i = ops.size(); i--; )
+        {
+            if (ok && !skip && !seq && ops[i]->type == DbJournalOp::COMMIT)
+            {
+                seq = ops[i]->seq;
+            }
+
+            delete ops[i];
+        }
+
+        ops.clear();
+
+        mutex.lock();
+        busy = false;
+
+        if (!ok)
+        {
+            LOG_err << "Write-behind database update failed";
+            failed = true;
+        }
+
+        if (seq)
+        {
+            durable = seq;
+        }
+
+        if (journal.empty())
+        {
+            for (; waiting; waiting--)
+            {
+                idle.release();
+            }
+        }
+
+        if (seq)
+        {
+            mutex.unlock();
+            waiter->notify();
+            mutex.lock();
+        }
+    }
+
+    mutex.unlock();
+}
+
+// apply a round of mutations in order - consecutive puts and deletions are
+// batched and only the last commit before the end of the round or an abort
+// is executed
+bool AsyncDbTable::apply(vector<DbJournalOp*>* ops)
+{
+    uint32_t ids[PUTBATCH];
+    string data[PUTBATCH];
+    bool commitnext = true;
+    vector<bool> docommit(ops->size());
+
+    for (size_t i = ops->size(); i--; )
+    {
+        switch ((*ops)[i]->type)
+        {
+            case DbJournalOp::COMMIT:
+                docommit[i] = commitnext;
+                commitnext = false;
+                break;
+
+            case DbJournalOp::ABORT:
+                commitnext = true;
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    for (size_t i = 0; i < ops->size(); )
+    {
+        DbJournalOp* op = (*ops)[i];
+        unsigned n = 0;
+
+        switch (op->type)
+        {
+            case DbJournalOp::PUT:
+                for (; n < PUTBATCH && i < ops->size() && (*ops)[i]->type == DbJournalOp::PUT; i++, n++)
+                {
+                    ids[n] = (*ops)[i]->id;
+                    data[n].swap((*ops)[i]->data);
+                }
+
+                if (!table->putmany(ids, data, n))
+                {
+                    return false;
+                }
+                continue;
+
+            case DbJournalOp::DEL:
+                for (; n < PUTBATCH && i < ops->size() && (*ops)[i]->type == DbJournalOp::DEL; i++, n++)
+                {
+                    ids[n] = (*ops)[i]->id;
+                }
+
+                if (!table->delmany(ids, n))
+                {
+                    return false;
+                }
+                continue;
+
+            case DbJournalOp::TRUNCATE:
+                table->truncate();
+                break;
+
+            case DbJournalOp::NODEKEYS:
+                if (!table->putnodekeys(op->id, op->h, op->ph, op->namehash, op->fphash, op->pinned))
+                {
+                    return false;
+                }
+                break;
+
+            case DbJournalOp::COMMIT:
+                if (docommit[i])
+                {
+                    // queries right behind the commit see the same records
+                    // before and after it - don't make them wait for the flush
+                    for (size_t j = i + 1; j < ops->size(); j++)
+                    {
+                        int type = (*ops)[j]->type;
+
+                        if (type != DbJournalOp::GETNODES && type != DbJournalOp::COMMIT)
+                        {
+                            break;
+                        }
+
+                        serve((*ops)[j]);
+                    }
+
+                    table->commit();
+                    table->begin();
+                }
+                break;
+
+            case DbJournalOp::GETNODES:
+                serve(op);
+                break;
+
+            case DbJournalOp::ABORT:
+                table->abort();
+                table->begin();
+                break;
+        }
+
+        i++;
+    }
+
+    return true;
+}
+
+// answer a queued query (once) and wake up the SDK thread
+// must be called with tablemutex held
+void AsyncDbTable::serve(DbJournalOp* op)
+{
+    if (op->type != DbJournalOp::GETNODES || op->served)
+    {
+        return;
+    }
+
+    *op->result = table->getnodes(op->query, op->h, op->namehash, op->records);
+    op->served = true;
+    answered.release();
+}
+
+// queue a mutation (false: a previous one failed)
+bool AsyncDbTable::enqueue(DbJournalOp* op)
+{
+    mutex.lock();
+
+    if (failed || exiting)
+    {
+        mutex.unlock();
+        delete op;
+        return false;
+    }
+
+    bool wake = journal.empty() && !busy;
+    journal.push_back(op);
+    queued(op);
+    mutex.unlock();
+
+    if (wake)
+    {
+        pending.release();
+    }
+
+    return true;
+}
+
+// wait until the writer thread has applied everything queued so far
+void AsyncDbTable::barrier()
+{
+    mutex.lock();
+
+    while ((!journal.empty() || busy) && !exiting)
+    {
+        waiting++;
+        mutex.unlock();
+        idle.wait();
+        mutex.lock();
+    }
+
+    mutex.unlock();
+}
+
+uint64_t AsyncDbTable::commitseq()
+{
+    return lastcommit;
+}
+
+uint64_t AsyncDbTable::durableseq()
+{
+    mutex.lock();
+    uint64_t seq = durable;
+    mutex.unlock();
+
+    return seq;
+}
+
+void AsyncDbTable::rewind()
+{
+    barrier();
+
+    tablemutex.lock();
+    table->rewind();
+    tablemutex.unlock();
+}
+
+bool AsyncDbTable::next(uint32_t* id, string* data)
+{
+    barrier();
+
+    tablemutex.lock();
+    bool result = table->next(id, data);
+    tablemutex.unlock();
+
+    return result;
+}
+
+bool AsyncDbTable::get(uint32_t id, string* data)
+{
+    std::map<uint32_t, std::pair<bool, string> >::iterator it = known.find(id);
+
+    if (it == known.end())
+    {
+        barrier();
+
+        std::pair<bool, string>& record = known[id];
+
+        tablemutex.lock();
+        record.first = table->get(id, &record.second);
+        tablemutex.unlock();
+
+        it = known.find(id);
+    }
+
+    if (!it->second.first)
+    {
+        return false;
+    }
+
+    *data = it->second.second;
+    return true;
+}
+
+bool AsyncDbTable::put(uint32_t id, char* data, unsigned len)
+{
+    std::map<uint32_t, std::pair<bool, string> >::iterator it = known.find(id);
+
+    if (it != known.end())
+    {
+        it->second.first = true;
+        it->second.second.assign(data, len);
+    }
+
+    DbJournalOp* op = new DbJournalOp();
+    op->type = DbJournalOp::PUT;
+    op->id = id;
+    op->data.assign(data, len);
+
+    return enqueue(op);
+}
+
+bool AsyncDbTable::putmany(const uint32_t* ids, const string* data, unsigned count)
+{
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (!put(ids[i], (char*)data[i].data(), data[i].size()))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool AsyncDbTable::del(uint32_t id)
+{
+    std::map<uint32_t, std::pair<bool, string> >::iterator it = known.find(id);
+
+    if (it != known.end())
+    {
+        it->second.first = false;
+        it->second.second.clear();
+    }
+
+    DbJournalOp* op = new DbJournalOp();
+    op->type = DbJournalOp::DEL;
+    op->id = id;
+
+    return enqueue(op);
+}
+
+bool AsyncDbTable::delmany(const uint32_t* ids, unsigned count)
+{
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (!del(ids[i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void AsyncDbTable::truncate()
+{
+    known.clear();
+
+    DbJournalOp* op = new DbJournalOp();
+    op->type = DbJournalOp::TRUNCATE;
+    enqueue(op);
+}
+
+// the writer thread's transaction is always open
+void AsyncDbTable::begin()
+{
+}
+
+void AsyncDbTable::commit()
+{
+    DbJournalOp* op = new DbJournalOp();
+    op->type = DbJournalOp::COMMIT;
+    op->seq = ++lastcommit;
+    enqueue(op);
+}
+
+void AsyncDbTable::abort()
+{
+    // the cached values may have been rolled back
+    known.clear();
+
+    DbJournalOp* op = new DbJournalOp();
+    op->type = DbJournalOp::ABORT;
+    enqueue(op);
+}
+
+// the queued mutations are dropped
+void AsyncDbTable::remove()
+{
+    mutex.lock();
+    for (std::deque<DbJournalOp*>::iterator it = journal.begin(); it != journal.end(); it++)
+    {
+        delete *it;
+    }
+    journal.clear();
+    mutex.unlock();
+
+    stop();
+    known.clear();
+
+    table->remove();
+}
+
+bool AsyncDbTable::enablenodepaging()
+{
+    barrier();
+
+    tablemutex.lock();
+    bool result = table->enablenodepaging();
+    tablemutex.unlock();
+
+    return result;
+}
+
+bool AsyncDbTable::putnodekeys(uint32_t id, handle h, handle ph, uint64_t namehash, uint64_t fphash, bool pinned)
+{
+    DbJournalOp* op = new DbJournalOp();
+    op->type = DbJournalOp::NODEKEYS;
+    op->id = id;
+    op->h = h;
+    op->ph = ph;
+    op->namehash = namehash;
+    op->fphash = fphash;
+    op->pinned = pinned;
+
+    return enqueue(op);
+}
+
+bool AsyncDbTable::nodekeyscomplete(uint32_t type)
+{
+    barrier();
+
+    tablemutex.lock();
+    bool result = table->nodekeyscomplete(type);
+    tablemutex.unlock();
+
+    return result;
+}
+
+void AsyncDbTable::rewindskipnodes()
+{
+    barrier();
+
+    tablemutex.lock();
+    table->rewindskipnodes();
+    tablemutex.unlock();
+}
+
+// node lookups are frequent with node paging: they are ordered after the
+// queued mutations without waiting for the queued commits
+bool AsyncDbTable::getnodes(int query, handle h, uint64_t hash, dbnoderecord_vector* records)
+{
+    bool result = false;
+
+    DbJournalOp* op = new DbJournalOp();
+    op->type = DbJournalOp::GETNODES;
+    op->query = query;
+    op->h = h;
+    op->namehash = hash;
+    op->records = records;
+    op->result = &result;
+    op->served = false;
+
+    mutex.lock();
+
+    if (exiting)
+    {
+        mutex.unlock();
+        delete op;
+
+        // nothing left in the journal
+        tablemutex.lock();
+        result = table->getnodes(query, h, hash, records);
+        tablemutex.unlock();
+
+        return result;
+    }
+
+    bool wake = journal.empty() && !busy;
+    journal.push_back(op);
+    queued(op);
+    mutex.unlock();
+
+    if (wake)
+    {
+        pending.release();
+    }
+
+    // the op is deleted by the writer thread
+    answered.wait();
+
+    return result;
+}
+
+bool AsyncDbTable::snapshotpath(string* path)
+{
+    return table->snapshotpath(path);
+}
+} // namespace
@@ -143,6 +143,18 @@ SqliteDbTable::SqliteDbTable(sqlite3* cdb, FileSystemAccess *fs, string *filepat
     pStmt = NULL;
     fsaccess = fs;
     dbfile = *filepath;
+
+    getStmt = NULL;
+    putStmt = NULL;
+    delStmt = NULL;
+    putMultiStmt = NULL;
+
+    nodeKeysStmt = NULL;
+    for (int i = NODES_QUERIES; i--; )
+    {
+        nodeStmt[i] = NULL;
+    }
+    pStmtSkipsNodes = false;
 }
 
 SqliteDbTable::~SqliteDbTable()
@@ -152,15 +164,65 @@ SqliteDbTable::~SqliteDbTable()
         return;
     }
 
-    if (pStmt)
-    {
-        sqlite3_finalize(pStmt);
-    }
+    finalize();
     abort();
     sqlite3_close(db);
     LOG_debug << "Database closed " << dbfile;
 }
 
+// compile a statement unless already done
+bool SqliteDbTable::prepare(sqlite3_stmt** stmt, const char* sql)
+{
+    if (*stmt)
+    {
+        return true;
+    }
+
+    if (sqlite3_prepare_v2(db, sql, -1, stmt, NULL) != SQLITE_OK)
+    {
+        LOG_err << "Unable to prepare statement: " << sqlite3_errmsg(db);
+        sqlite3_finalize(*stmt);
+        *stmt = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+// run a bound write statement and make it ready for reuse
+bool SqliteDbTable::step(sqlite3_stmt* stmt)
+{
+    bool result = sqlite3_step(stmt) == SQLITE_DONE;
+
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    return result;
+}
+
+// release all prepared statements (required before closing the database)
+void SqliteDbTable::finalize()
+{
+    sqlite3_stmt** stmts[] = { &pStmt, &getStmt, &putStmt, &delStmt, &putMultiStmt, &nodeKeysStmt };
+
+    for (unsigned i = 0; i < sizeof stmts / sizeof *stmts; i++)
+    {
+        if (*stmts[i])
+        {
+            sqlite3_finalize(*stmts[i]);
+            *stmts[i] = NULL;
+        }
+    }
+
+    for (int i = NODES_QUERIES; i--; )
+    {
+        if (nodeStmt[i])
+        {
+            sqlite3_finalize(nodeStmt[i]);
+            nodeStmt[i] = NULL;
+        }
+    }
+}
+
 // set cursor to first record
 void SqliteDbTable::rewind()
 {
@@ -169,6 +231,12 @@ void SqliteDbTable::rewind()
         return;
     }
 
+    if (pStmt && pStmtSkipsNodes)
+    {
+        sqlite3_finalize(pStmt);
+        pStmt = NULL;
+    }
+
     if (pStmt)
     {
         sqlite3_reset(pStmt);
@@ -176,9 +244,27 @@ void SqliteDbTable::rewind()
     else
     {
         sqlite3_prepare(db, "SELECT id, content FROM statecache", -1, &pStmt, NULL);
+        pStmtSkipsNodes = false;
     }
 }
 
+// set cursor to the first record without node lookup keys
+void SqliteDbTable::rewindskipnodes()
+{
+    if (!db)
+    {
+        return;
+    }
+
+    if (pStmt)
+    {
+        sqlite3_finalize(pStmt);
+    }
+
+    sqlite3_prepare(db, "SELECT id, content FROM statecache WHERE nodehandle IS NULL", -1, &pStmt, NULL);
+    pStmtSkipsNodes = true;
+}
+
 // retrieve next record through cursor
 bool SqliteDbTable::next(uint32_t* index, string* data)
 {
@@ -216,23 +302,23 @@ bool SqliteDbTable::get(uint32_t index, string* data)
         return false;
     }
 
-    sqlite3_stmt *stmt;
     bool result = false;
 
-    if (sqlite3_prepare(db, "SELECT content FROM statecache WHERE id = ?", -1, &stmt, NULL) == SQLITE_OK)
+    if (prepare(&getStmt, "SELECT content FROM statecache WHERE id = ?"))
     {
-        if (sqlite3_bind_int(stmt, 1, index) == SQLITE_OK)
+        if (sqlite3_bind_int(getStmt, 1, index) == SQLITE_OK)
         {
-            if (sqlite3_step(stmt) == SQLITE_ROW)
+            if (sqlite3_step(getStmt) == SQLITE_ROW)
             {
-                data->assign((char*)sqlite3_column_blob(stmt, 0), sqlite3_column_bytes(stmt, 0));
+                data->assign((char*)sqlite3_column_blob(getStmt, 0), sqlite3_column_bytes(getStmt, 0));
 
                 result = true;
             }
         }
+
+        sqlite3_reset(getStmt);
     }
 
-    sqlite3_finalize(stmt);
     return result;
 }
 
@@ -244,25 +330,71 @@ bool SqliteDbTable::put(uint32_t index, char* data, unsigned len)
         return false;
     }
 
-    sqlite3_stmt *stmt;
-    bool result = false;
+    if (!prepare(&putStmt, "INSERT OR REPLACE INTO statecache (id, content) VALUES (?, ?)"))
+    {
+        return false;
+    }
+
+    if (sqlite3_bind_int(putStmt, 1, index) != SQLITE_OK
+            || sqlite3_bind_blob(putStmt, 2, data, len, SQLITE_STATIC) != SQLITE_OK)
+    {
+        sqlite3_clear_bindings(putStmt);
+        return false;
+    }
+
+    return step(putStmt);
+}
+
+// add/update records by index, MULTIROW per statement
+bool SqliteDbTable::putmany(const uint32_t* ids, const string* data, unsigned count)
+{
+    if (!db)
+    {
+        return false;
+    }
 
-    if (sqlite3_prepare(db, "INSERT OR REPLACE INTO statecache (id, content) VALUES (?, ?)", -1, &stmt, NULL) == SQLITE_OK)
+    if (count >= MULTIROW && !putMultiStmt)
     {
-        if (sqlite3_bind_int(stmt, 1, index) == SQLITE_OK)
+        string sql = "INSERT OR REPLACE INTO statecache (id, content) VALUES (?, ?)";
+
+        for (unsigned i = 1; i < MULTIROW; i++)
         {
-            if (sqlite3_bind_blob(stmt, 2, data, len, SQLITE_STATIC) == SQLITE_OK)
+            sql.append(", (?, ?)");
+        }
+
+        if (!prepare(&putMultiStmt, sql.c_str()))
+        {
+            return false;
+        }
+    }
+
+    for (; count >= MULTIROW; ids += MULTIROW, data += MULTIROW, count -= MULTIROW)
+    {
+        for (unsigned i = 0; i < MULTIROW; i++)
+        {
+            if (sqlite3_bind_int(putMultiStmt, 2 * i + 1, ids[i]) != SQLITE_OK
+                    || sqlite3_bind_blob(putMultiStmt, 2 * i + 2, data[i].data(), data[i].size(), SQLITE_STATIC) != SQLITE_OK)
             {
-                if (sqlite3_step(stmt) == SQLITE_DONE)
-                {
-                    result = true;
-                }
+                sqlite3_clear_bindings(putMultiStmt);
+                return false;
             }
         }
+
+        if (!step(putMultiStmt))
+        {
+            return false;
+        }
     }
 
-    sqlite3_finalize(stmt);
-    return result;
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (!put(ids[i], (char*)data[i].data(), data[i].size()))
+        {
+            return false;
+        }
+    }
+
+    return true;
 }
 
 // delete record by index
@@ -273,11 +405,17 @@ bool SqliteDbTable::del(uint32_t index)
         return false;
     }
 
-    char buf[64];
+    if (!prepare(&delStmt, "DELETE FROM statecache WHERE id = ?"))
+    {
+        return false;
+    }
 
-    sprintf(buf, "DELETE FROM statecache WHERE id = %" PRIu32, index);
+    if (sqlite3_bind_int(delStmt, 1, index) != SQLITE_OK)
+    {
+        return false;
+    }
 
-    return !sqlite3_exec(db, buf, 0, 0, NULL);
+    return step(delStmt);
 }
 
 // truncate table
@@ -312,7 +450,10 @@ void SqliteDbTable::commit()
     }
 
     LOG_debug << "DB transaction COMMIT " << dbfile;
+
+    int64_t starttime = Waiter::us();
     sqlite3_exec(db, "COMMIT", 0, 0, NULL);
+    Metrics::observe(Metrics::DB_COMMIT_DURATION, Waiter::us() - starttime);
 }
 
 // abort transaction
@@ -327,17 +468,155 @@ void SqliteDbTable::abort()
     sqlite3_exec(db, "ROLLBACK", 0, 0, NULL);
 }
 
-void SqliteDbTable::remove()
+// add the node paging columns and their indexes (existing records get NULL keys)
+bool SqliteDbTable::enablenodepaging()
 {
     if (!db)
     {
-        return;
+        return false;
     }
 
-    if (pStmt)
+    const char* columns[] = { "nodehandle", "parenthandle", "namehash", "fphash", "pinned" };
+
+    for (unsigned i = 0; i < sizeof columns / sizeof *columns; i++)
     {
-        sqlite3_finalize(pStmt);
+        // fails harmlessly if the column already exists
+        string sql = "ALTER TABLE statecache ADD COLUMN ";
+        sql.append(columns[i]);
+        sql.append(" INTEGER");
+        sqlite3_exec(db, sql.c_str(), NULL, NULL, NULL);
+    }
+
+    if (sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS statecache_nodehandle ON statecache (nodehandle)", NULL, NULL, NULL)
+            || sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS statecache_parenthandle ON statecache (parenthandle, namehash)", NULL, NULL, NULL)
+            || sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS statecache_fphash ON statecache (fphash)", NULL, NULL, NULL))
+    {
+        LOG_err << "Unable to enable node paging: " << sqlite3_errmsg(db);
+        return false;
+    }
+
+    return true;
+}
+
+// set the lookup keys of a node record
+bool SqliteDbTable::putnodekeys(uint32_t index, handle h, handle ph, uint64_t namehash, uint64_t fphash, bool pinned)
+{
+    if (!db)
+    {
+        return false;
+    }
+
+    if (!prepare(&nodeKeysStmt, "UPDATE statecache SET nodehandle = ?, parenthandle = ?, namehash = ?, fphash = ?, pinned = ? WHERE id = ?"))
+    {
+        return false;
+    }
+
+    if (sqlite3_bind_int64(nodeKeysStmt, 1, h) != SQLITE_OK
+            || sqlite3_bind_int64(nodeKeysStmt, 2, ph) != SQLITE_OK
+            || sqlite3_bind_int64(nodeKeysStmt, 3, namehash) != SQLITE_OK
+            || sqlite3_bind_int64(nodeKeysStmt, 4, fphash) != SQLITE_OK
+            || sqlite3_bind_int(nodeKeysStmt, 5, pinned) != SQLITE_OK
+            || sqlite3_bind_int(nodeKeysStmt, 6, index) != SQLITE_OK)
+    {
+        sqlite3_clear_bindings(nodeKeysStmt);
+        return false;
+    }
+
+    return step(nodeKeysStmt);
+}
+
+// no record of the given type lacks its lookup keys
+bool SqliteDbTable::nodekeyscomplete(uint32_t type)
+{
+    if (!db)
+    {
+        return false;
     }
+
+    sqlite3_stmt *stmt;
+    bool result = false;
+
+    if (sqlite3_prepare_v2(db, "SELECT id FROM statecache WHERE nodehandle IS NULL", -1, &stmt, NULL) == SQLITE_OK)
+    {
+        int rc;
+
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+        {
+            if (((uint32_t)sqlite3_column_int(stmt, 0) & 15) == type)
+            {
+                break;
+            }
+        }
+
+        result = rc == SQLITE_DONE;
+    }
+
+    sqlite3_finalize(stmt);
+    return result;
+}
+
+// node records by handle, parent, name or fingerprint hash
+bool SqliteDbTable::getnodes(int query, handle h, uint64_t hash, dbnoderecord_vector* records)
+{
+    static const char* sql[NODES_QUERIES] = {
+        "SELECT id, nodehandle, parenthandle, content FROM statecache WHERE nodehandle = ?",
+        "SELECT id, nodehandle, parenthandle, content FROM statecache WHERE parenthandle = ?",
+        "SELECT id, nodehandle, parenthandle, content FROM statecache WHERE parenthandle = ? AND namehash = ?",
+        "SELECT id, nodehandle, parenthandle, content FROM statecache WHERE fphash = ?",
+        "SELECT id, nodehandle, parenthandle, content FROM statecache WHERE nodehandle IS NOT NULL AND "
+            "(pinned OR parenthandle NOT IN (SELECT nodehandle FROM statecache WHERE nodehandle IS NOT NULL))"
+    };
+
+    if (!db || query < 0 || query >= NODES_QUERIES || !prepare(&nodeStmt[query], sql[query]))
+    {
+        return false;
+    }
+
+    sqlite3_stmt* stmt = nodeStmt[query];
+
+    switch (query)
+    {
+        case NODES_BYHANDLE:
+        case NODES_CHILDREN:
+            sqlite3_bind_int64(stmt, 1, h);
+            break;
+
+        case NODES_CHILDRENBYNAME:
+            sqlite3_bind_int64(stmt, 1, h);
+            sqlite3_bind_int64(stmt, 2, hash);
+            break;
+
+        case NODES_BYFINGERPRINT:
+            sqlite3_bind_int64(stmt, 1, hash);
+            break;
+    }
+
+    int rc;
+
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW)
+    {
+        records->resize(records->size() + 1);
+
+        DbNodeRecord& record = records->back();
+        record.id = sqlite3_column_int(stmt, 0);
+        record.h = sqlite3_column_int64(stmt, 1);
+        record.ph = sqlite3_column_int64(stmt, 2);
+        record.data.assign((char*)sqlite3_column_blob(stmt, 3), sqlite3_column_bytes(stmt, 3));
+    }
+
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    return rc == SQLITE_DONE;
+}
+
+void SqliteDbTable::remove()
+{
+    if (!db)
+    {
+        return;
+    }
+
+    finalize();
     abort();
     sqlite3_close(db);
 
@@ -346,6 +625,17 @@ void SqliteDbTable::remove()
     string localpath;
     fsaccess->path2local(&dbfile, &localpath);
     fsaccess->unlinklocal(&localpath);
+
+    string snapshot;
+    snapshotpath(&snapshot);
+    StateSnapshot::remove(fsaccess, snapshot);
+}
+
+// next to the database file, like its -wal and -shm files
+bool SqliteDbTable::snapshotpath(string* path)
+{
+    *path = dbfile + "-snapshot";
+    return true;
 }
 } // namespace
 
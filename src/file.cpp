@@ -325,6 +325,13 @@ void File::completed(Transfer* t, LocalNode* l)
                 newnode->ovhandle = t->client->getovhandle(t->client->nodebyhandle(th), &name);
             }
 
+            if (t->client->batchsmalluploads && t->size <= MegaClient::SMALLUPLOADSIZE && !l)
+            {
+                // sent with the other small uploads to the same folder
+                t->client->queueputnodes(newnode, th, tag);
+                return;
+            }
+
             t->client->reqs.add(new CommandPutNodes(t->client,
                                                                   th, NULL,
                                                                   newnode, 1,
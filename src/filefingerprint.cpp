@@ -174,26 +174,28 @@ bool FileFingerprint::genfingerprint(FileAccess* fa, bool ignoremtime)
     else
     {
         // large file: sparse coverage, four sparse CRC32s
+        // (all blocks are read at once, with a single open)
         HashCRC32 crc32;
-        byte block[4 * sizeof crc];
-        const unsigned blocks = MAXFULL / (sizeof block * sizeof crc / sizeof *crc);
+        const unsigned blocksize = 4 * sizeof crc;
+        const unsigned blocks = MAXFULL / (blocksize * sizeof crc / sizeof *crc);
+        const unsigned numblocks = sizeof crc / sizeof *crc * blocks;
+        byte buf[MAXFULL];
+        m_off_t pos[numblocks];
 
-        for (unsigned i = 0; i < sizeof crc / sizeof *crc; i++)
+        for (unsigned i = 0; i < numblocks; i++)
         {
-            for (unsigned j = 0; j < blocks; j++)
-            {
-                if (!fa->frawread(block, sizeof block,
-                                  (size - sizeof block)
-                                  * (i * blocks + j)
-                                  / (sizeof crc / sizeof *crc * blocks - 1)))
-                {
-                    size = -1;
-                    return true;
-                }
+            pos[i] = (size - blocksize) * i / (numblocks - 1);
+        }
 
-                crc32.add(block, sizeof block);
-            }
+        if (!fa->frawreadv(buf, blocksize, pos, numblocks))
+        {
+            size = -1;
+            return true;
+        }
 
+        for (unsigned i = 0; i < sizeof crc / sizeof *crc; i++)
+        {
+            crc32.add(buf + i * blocks * blocksize, blocks * blocksize);
             crc32.get((byte*)&crcval);
             newcrc[i] = htonl(crcval);
         }
@@ -522,6 +522,34 @@ bool FileAccess::frawread(byte* dst, unsigned len, m_off_t pos)
     return r;
 }
 
+bool FileAccess::frawreadv(byte* dst, unsigned len, const m_off_t* pos, unsigned count)
+{
+    if (!openf())
+    {
+        return false;
+    }
+
+    bool r = sysreadv(dst, len, pos, count);
+
+    closef();
+
+    return r;
+}
+
+// default: one read after the other
+bool FileAccess::sysreadv(byte* dst, unsigned len, const m_off_t* pos, unsigned count)
+{
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (!sysread(dst + i * len, len, pos[i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 AsyncIOContext::AsyncIOContext()
 {
     op = NONE;
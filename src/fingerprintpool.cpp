@@ -0,0 +1,227 @@
+/**
+ * @file fingerprintpool.cpp
+ * @brief Worker threads for sync file fingerprinting
+ *
+ * (c) 2013-2018 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mega/fingerprintpool.h"
+#include "mega/waiter.h"
+#include "mega/logging.h"
+
+#ifdef ENABLE_SYNC
+namespace mega {
+FingerprintPool::FingerprintPool(FileSystemAccess* fs, Waiter* w, int n) : mutex(false)
+{
+    fsaccess = fs;
+    waiter = w;
+    exiting = false;
+
+    LOG_debug << "Starting " << n << " fingerprint threads";
+
+    while (n-- > 0)
+    {
+        THREAD_CLASS* thread = new THREAD_CLASS();
+        threads.push_back(thread);
+        thread->start(threadEntryPoint, this);
+    }
+}
+
+FingerprintPool::~FingerprintPool()
+{
+    stop();
+
+    for (std::deque<FingerprintJob*>::iterator it = done.begin(); it != done.end(); it++)
+    {
+        delete *it;
+    }
+}
+
+void FingerprintPool::stop()
+{
+    mutex.lock();
+    if (exiting)
+    {
+        mutex.unlock();
+        return;
+    }
+
+    exiting = true;
+    mutex.unlock();
+
+    for (size_t i = threads.size(); i--; )
+    {
+        pending.release();
+    }
+
+    for (size_t i = 0; i < threads.size(); i++)
+    {
+        threads[i]->join();
+        delete threads[i];
+    }
+
+    threads.clear();
+}
+
+void *FingerprintPool::threadEntryPoint(void *param)
+{
+    ((FingerprintPool*)param)->loop();
+    return NULL;
+}
+
+// worker threads: private FileAccess, no client state
+void FingerprintPool::loop()
+{
+    for (;;)
+    {
+        pending.wait();
+
+        mutex.lock();
+        if (jobs.empty())
+        {
+            // reached at shutdown, after the queue has been drained, and
+            // for cancelled jobs
+            bool exit = exiting;
+            mutex.unlock();
+
+            if (exit)
+            {
+                break;
+            }
+
+            continue;
+        }
+
+        FingerprintJob* job = jobs.front();
+        jobs.pop_front();
+        running.insert(job);
+        mutex.unlock();
+
+        FileAccess* fa = fsaccess->newfileaccess();
+
+        if (!fa->fopen(&job->localpath, true, false) || !job->fingerprint.genfingerprint(fa))
+        {
+            job->fingerprint.size = -1;
+        }
+
+        delete fa;
+
+        mutex.lock();
+        running.erase(job);
+        done.push_back(job);
+        mutex.unlock();
+
+        waiter->notify();
+    }
+}
+
+void FingerprintPool::queue(LocalNode* l, string* localpath, bool newnode)
+{
+    FingerprintJob* job = new FingerprintJob();
+
+    job->localnode = l;
+    job->localpath = *localpath;
+
+    mutex.lock();
+    // the replacement of a job for a new node reports the creation
+    job->newnode = drop(l) || newnode;
+    jobs.push_back(job);
+    mutex.unlock();
+
+    pending.release();
+}
+
+void FingerprintPool::cancel(LocalNode* l)
+{
+    mutex.lock();
+    drop(l);
+    mutex.unlock();
+}
+
+// drop the jobs of a node (mutex held) - returns true if one of them was
+// for a new node
+bool FingerprintPool::drop(LocalNode* l)
+{
+    bool newnode = false;
+
+    for (std::deque<FingerprintJob*>::iterator it = jobs.begin(); it != jobs.end(); )
+    {
+        if ((*it)->localnode == l)
+        {
+            newnode |= (*it)->newnode;
+            delete *it;
+            it = jobs.erase(it);
+        }
+        else
+        {
+            it++;
+        }
+    }
+
+    // running and finished jobs are skipped by collect()
+    for (std::set<FingerprintJob*>::iterator it = running.begin(); it != running.end(); it++)
+    {
+        if ((*it)->localnode == l)
+        {
+            newnode |= (*it)->newnode;
+            (*it)->localnode = NULL;
+        }
+    }
+
+    for (std::deque<FingerprintJob*>::iterator it = done.begin(); it != done.end(); it++)
+    {
+        if ((*it)->localnode == l)
+        {
+            newnode |= (*it)->newnode;
+            (*it)->localnode = NULL;
+        }
+    }
+
+    return newnode;
+}
+
+FingerprintJob* FingerprintPool::collect()
+{
+    FingerprintJob* job = NULL;
+
+    mutex.lock();
+
+    while (done.size())
+    {
+        job = done.front();
+        done.pop_front();
+
+        if (job->localnode)
+        {
+            break;
+        }
+
+        delete job;
+        job = NULL;
+    }
+
+    mutex.unlock();
+
+    return job;
+}
+
+int FingerprintPool::numthreads() const
+{
+    return int(threads.size());
+}
+} // namespace
+#endif
@@ -24,6 +24,7 @@
 #include "mega/logging.h"
 #include "mega/proxy.h"
 #include "mega/base64.h"
+#include "mega/metrics.h"
 
 #if defined(__APPLE__) && !(TARGET_OS_IPHONE)
 #include "mega/osx/osxutils.h"
@@ -334,6 +335,24 @@ m_off_t HttpIO::getmaxuploadspeed()
     return 0;
 }
 
+bool HttpIO::setmultiplexing(bool, int)
+{
+    return false;
+}
+
+void HttpIO::getconnectionstats(direction_t, HttpConnectionStats* stats)
+{
+    *stats = HttpConnectionStats();
+}
+
+HttpConnectionStats::HttpConnectionStats()
+{
+    sockets = 0;
+    requests = 0;
+    connects = 0;
+    completed = 0;
+}
+
 void HttpReq::post(MegaClient* client, const char* data, unsigned len)
 {
     if (httpio)
@@ -345,6 +364,8 @@ void HttpReq::post(MegaClient* client, const char* data, unsigned len)
 
     httpio = client->httpio;
     bufpos = 0;
+    bufstart = 0;
+    bufreleased = 0;
     outpos = 0;
     notifiedbufpos = 0;
     inpurge = 0;
@@ -366,6 +387,8 @@ void HttpReq::get(MegaClient *client)
 
     httpio = client->httpio;
     bufpos = 0;
+    bufstart = 0;
+    bufreleased = 0;
     outpos = 0;
     notifiedbufpos = 0;
     inpurge = 0;
@@ -387,6 +410,8 @@ void HttpReq::dns(MegaClient *client)
     
     httpio = client->httpio;
     bufpos = 0;
+    bufstart = 0;
+    bufreleased = 0;
     outpos = 0;
     notifiedbufpos = 0;
     inpurge = 0;
@@ -419,7 +444,9 @@ HttpReq::HttpReq(bool b)
     timeoutms = 0;
     type = REQ_JSON;
     buflen = 0;
+    bufalloc = 0;
     protect = false;
+    streamed = false;
 
     init();
 }
@@ -440,6 +467,8 @@ void HttpReq::init()
     inpurge = 0;
     sslcheckfailed = false;
     bufpos = 0;
+    bufstart = 0;
+    bufreleased = 0;
     notifiedbufpos = 0;
     contentlength = 0;
     timeleft = -1;
@@ -469,7 +498,8 @@ void HttpReq::put(void* data, unsigned len, bool purge)
             len = buflen - bufpos;
         }
 
-        memcpy(buf + bufpos, data, len);
+        reservebuf(len);
+        memcpy(bufat(bufpos), data, len);
     }
     else
     {
@@ -504,7 +534,7 @@ void HttpReq::purge(size_t numbytes)
 // set total response size
 void HttpReq::setcontentlength(m_off_t len)
 {
-    if (!buf && type != REQ_BINARY)
+    if (!buf && type != REQ_BINARY && !streamed)
     {
         in.reserve(len);
     }
@@ -522,7 +552,8 @@ byte* HttpReq::reserveput(unsigned* len)
             *len = buflen - bufpos;
         }
 
-        return buf + bufpos;
+        reservebuf(*len);
+        return bufat(bufpos);
     }
     else
     {
@@ -545,6 +576,53 @@ byte* HttpReq::reserveput(unsigned* len)
     }
 }
 
+void HttpReq::releasebuf(m_off_t pos)
+{
+    if (pos > bufreleased)
+    {
+        bufreleased = pos;
+    }
+}
+
+// the data is moved when more room is needed, by the thread that receives it
+// (the buffer of a pending read is never moved): the released data is
+// dropped first, then the allocation grows
+void HttpReq::reservebuf(m_off_t len)
+{
+    if (bufpos - bufstart + len <= bufalloc)
+    {
+        return;
+    }
+
+    if (bufreleased > bufstart)
+    {
+        memmove(buf, bufat(bufreleased), size_t(bufpos - bufreleased));
+        bufstart = bufreleased;
+
+        if (bufpos - bufstart + len <= bufalloc)
+        {
+            return;
+        }
+    }
+
+    m_off_t size = bufalloc * 2;
+    if (size < bufpos - bufstart + len)
+    {
+        size = bufpos - bufstart + len;
+    }
+    if (size > buflen - bufstart)
+    {
+        size = buflen - bufstart;
+    }
+    size = (size + SymmCipher::BLOCKSIZE - 1) & -SymmCipher::BLOCKSIZE;
+
+    byte* newbuf = new byte[size];
+    memcpy(newbuf, buf, size_t(bufpos - bufstart));
+    delete[] buf;
+    buf = newbuf;
+    bufalloc = size;
+}
+
 // number of bytes transferred in this request
 m_off_t HttpReq::transferred(MegaClient*)
 {
@@ -570,8 +648,14 @@ void HttpReqDL::prepare(const char* tempurl, SymmCipher* /*key*/,
 
     dlpos = pos;
     size = (unsigned)(npos - pos);
+    rewind();
+
+    // the buffer grows while the request is received if the data is not
+    // written soon enough
+    m_off_t alloc = size < INITIALBUFSIZE ? size : INITIALBUFSIZE;
+    alloc = (alloc + SymmCipher::BLOCKSIZE - 1) & -SymmCipher::BLOCKSIZE;
 
-    if (!buf || buflen != size)
+    if (!buf || bufalloc != alloc)
     {
         // (re)allocate buffer
         if (buf)
@@ -582,47 +666,120 @@ void HttpReqDL::prepare(const char* tempurl, SymmCipher* /*key*/,
 
         if (size)
         {
-            buf = new byte[(size + SymmCipher::BLOCKSIZE - 1) & - SymmCipher::BLOCKSIZE];
+            buf = new byte[alloc];
         }
-        buflen = size;
+        bufalloc = size ? alloc : 0;
     }
+
+    buflen = size;
+    bufpos = 0;
+    bufstart = 0;
+    bufreleased = 0;
 }
 
 // decrypt, mac and write downloaded chunk
 void HttpReqDL::finalize(Transfer *transfer)
 {
-    byte *chunkstart = buf;
-    m_off_t startpos = dlpos;
-    m_off_t finalpos = startpos + bufpos;
-    assert(finalpos <= transfer->size);
-    if (finalpos != transfer->size)
+    if (finalized)
+    {
+        return;
+    }
+
+    loadchunkmacs(transfer);
+    decrypt(transfer->transfercipher(), transfer->ctriv, transfer->size);
+}
+
+// take over the MAC state of unfinished chunks from the transfer
+void HttpReqDL::loadchunkmacs(Transfer *transfer)
+{
+    loadchunkmacs(&transfer->chunkmacs, transfer->size);
+}
+
+void HttpReqDL::loadchunkmacs(const chunkmac_map* macs, m_off_t transfersize)
+{
+    m_off_t startpos = dlpos + decryptedpos;
+    m_off_t finalpos = dlpos + bufpos;
+    if (finalpos != transfersize)
+    {
+        finalpos &= -SymmCipher::BLOCKSIZE;
+    }
+
+    while (startpos < finalpos)
+    {
+        m_off_t chunkid = ChunkedHash::chunkfloor(startpos);
+        if (!chunkmacs.finished(chunkid))
+        {
+            const ChunkMAC* chunkmac = macs->find(chunkid);
+            chunkmacs[chunkid] = chunkmac ? *chunkmac : ChunkMAC();
+            chunkmacs.setfinished(chunkid, macs->finished(chunkid));
+        }
+        startpos = ChunkedHash::chunkceil(startpos, finalpos);
+    }
+}
+
+// decrypt and mac the received data chunk by chunk - only uses the request's
+// own chunkmacs, which loadchunkmacs() must have initialised
+void HttpReqDL::decrypt(SymmCipher* cipher, uint64_t ctriv, m_off_t transfersize)
+{
+    m_off_t finalpos = dlpos + bufpos;
+    assert(finalpos <= transfersize);
+    if (finalpos != transfersize)
     {
         finalpos &= -SymmCipher::BLOCKSIZE;
         bufpos &= -SymmCipher::BLOCKSIZE;
     }
 
+    decryptupto(cipher, ctriv, transfersize, finalpos);
+
+    finalized = true;
+}
+
+void HttpReqDL::decryptreceived(Transfer* transfer)
+{
+    if (!finalized && buf && ChunkedHash::chunkfloor(dlpos + bufpos) > dlpos + decryptedpos)
+    {
+        loadchunkmacs(transfer);
+        decryptreceived(transfer->transfercipher(), transfer->ctriv, transfer->size);
+    }
+}
+
+void HttpReqDL::decryptreceived(SymmCipher* cipher, uint64_t ctriv, m_off_t transfersize)
+{
+    // the chunk that is being received is left for finalize()
+    m_off_t finalpos = ChunkedHash::chunkfloor(dlpos + bufpos);
+
+    if (!finalized && buf && finalpos > dlpos + decryptedpos)
+    {
+        decryptupto(cipher, ctriv, transfersize, finalpos);
+    }
+}
+
+void HttpReqDL::decryptupto(SymmCipher* cipher, uint64_t ctriv, m_off_t transfersize, m_off_t finalpos)
+{
+    byte *chunkstart = bufat(decryptedpos);
+    m_off_t startpos = dlpos + decryptedpos;
+
     m_off_t endpos = ChunkedHash::chunkceil(startpos, finalpos);
     m_off_t chunksize = endpos - startpos;
-    SymmCipher *cipher = transfer->transfercipher();
+    int64_t starttime = chunksize ? Waiter::us() : 0;
+
     while (chunksize)
     {
         m_off_t chunkid = ChunkedHash::chunkfloor(startpos);
         ChunkMAC &chunkmac = chunkmacs[chunkid];
-        if (!chunkmac.finished)
+        if (!chunkmacs.finished(chunkid))
         {
-            chunkmac = transfer->chunkmacs[chunkid];
-            cipher->ctr_crypt(chunkstart, chunksize, startpos, transfer->ctriv,
-                                    chunkmac.mac, false, !chunkmac.finished && !chunkmac.offset);
-            if (endpos == ChunkedHash::chunkceil(chunkid, transfer->size))
+            cipher->ctr_crypt(chunkstart, chunksize, startpos, ctriv,
+                                    chunkmac.mac, false, !chunkmac.offset);
+            if (endpos == ChunkedHash::chunkceil(chunkid, transfersize))
             {
                 LOG_debug << "Finished chunk: " << startpos << " - " << endpos << "   Size: " << chunksize;
-                chunkmac.finished = true;
+                chunkmacs.setfinished(chunkid);
                 chunkmac.offset = 0;
             }
             else
             {
                 LOG_debug << "Decrypted partial chunk: " << startpos << " - " << endpos << "   Size: " << chunksize;
-                chunkmac.finished = false;
                 chunkmac.offset += chunksize;
             }
         }
@@ -631,21 +788,59 @@ void HttpReqDL::finalize(Transfer *transfer)
         endpos = ChunkedHash::chunkceil(startpos, finalpos);
         chunksize = endpos - startpos;
     }
+
+    if (startpos > dlpos + decryptedpos)
+    {
+        decryptedpos = startpos - dlpos;
+    }
+
+    if (starttime)
+    {
+        Metrics::observe(Metrics::CHUNK_DECRYPT_DURATION, Waiter::us() - starttime);
+    }
+}
+
+void HttpReqDL::setwritten(m_off_t pos)
+{
+    writtenpos = pos;
+    releasebuf(pos);
+}
+
+void HttpReqDL::rewind()
+{
+    finalized = false;
+    decryptedpos = 0;
+    writtenpos = 0;
+    chunkmacs.clear();
 }
 
 // prepare chunk for uploading: mac and encrypt
 void HttpReqUL::prepare(const char* tempurl, SymmCipher* key,
                         chunkmac_map* macs, uint64_t ctriv, m_off_t pos,
                         m_off_t npos)
+{
+    encrypt(key, ctriv, pos, npos);
+    commit(tempurl, macs, pos);
+}
+
+void HttpReqUL::encrypt(SymmCipher* key, uint64_t ctriv, m_off_t pos, m_off_t npos)
 {
     size = (unsigned)(npos - pos);
 
-    byte mac[SymmCipher::BLOCKSIZE] = { 0 };
+    int64_t starttime = Waiter::us();
+
+    chunkmacs.clear();
+
+    // one MAC per chunk, as expected by the meta-MAC
+    for (m_off_t chunkpos = pos; chunkpos < npos; )
+    {
+        m_off_t chunkend = ChunkedHash::chunkceil(chunkpos, npos);
 
-    key->ctr_crypt((byte*)out->data(), size, pos, ctriv, mac, 1);
+        key->ctr_crypt((byte*)out->data() + (chunkpos - pos), unsigned(chunkend - chunkpos),
+                       chunkpos, ctriv, chunkmacs[chunkpos].mac, 1);
 
-    memcpy((*macs)[pos].mac, mac, sizeof mac);
-    (*macs)[pos].finished = false;
+        chunkpos = chunkend;
+    }
 
     // unpad for POSTing
     out->resize(size);
@@ -678,10 +873,21 @@ void HttpReqUL::prepare(const char* tempurl, SymmCipher* key,
         }
     }
 
-    char crc[32];
+    char b64[32];
+    Base64::btoa(c, CRCSIZE, b64);
+    crc = b64;
+
+    Metrics::observe(Metrics::CHUNK_ENCRYPT_DURATION, Waiter::us() - starttime);
+}
+
+void HttpReqUL::commit(const char* tempurl, chunkmac_map* macs, m_off_t pos)
+{
+    // the chunks are marked finished once the server accepted them
+    macs->merge(chunkmacs);
+    chunkmacs.clear();
+
     char buf[512];
-    Base64::btoa(c, CRCSIZE, crc);
-    snprintf(buf, sizeof buf, "%s/%" PRIu64 "?c=%s", tempurl, pos, crc);
+    snprintf(buf, sizeof buf, "%s/%" PRIu64 "?c=%s", tempurl, pos, crc.c_str());
     setreq(buf, REQ_BINARY);
 }
 
@@ -119,6 +119,65 @@ bool JSON::storeobject(string* s)
     }
 }
 
+// end of the JSON value starting at ptr, or NULL if it is truncated
+// (used to process a response while it is still arriving - a scalar is
+// only complete once it is followed by a delimiter)
+const char* JSON::valueend(const char* ptr)
+{
+    int depth = 0;
+
+    do
+    {
+        switch (*ptr)
+        {
+            case '\0':
+                return NULL;
+
+            case '"':
+                while (*++ptr != '"')
+                {
+                    if (!*ptr || (*ptr == '\\' && !*++ptr))
+                    {
+                        return NULL;
+                    }
+                }
+                ptr++;
+                break;
+
+            case '[':
+            case '{':
+                depth++;
+                ptr++;
+                break;
+
+            case ']':
+            case '}':
+                if (!depth)
+                {
+                    return NULL;
+                }
+                depth--;
+                ptr++;
+                break;
+
+            default:
+                ptr++;
+
+                if (!depth)
+                {
+                    while (*ptr && *ptr != ',' && *ptr != ']' && *ptr != '}')
+                    {
+                        ptr++;
+                    }
+
+                    return *ptr ? ptr : NULL;
+                }
+        }
+    } while (depth);
+
+    return ptr;
+}
+
 bool JSON::isnumeric()
 {
     if (*pos == ',')
@@ -23,65 +23,187 @@
  */
 
 #include "mega/logging.h"
+#include "mega/thread/qtthread.h"
+#include "mega/thread/posixthread.h"
+#include "mega/thread/win32thread.h"
+#include "mega/thread/cppthread.h"
 #include <time.h>
+#include <string.h>
+#include <stdio.h>
 
 namespace mega {
 
+// serializes the changes of the module levels, which are read while they
+// change
+static MUTEX_CLASS moduleLevelsMutex(false);
+
+typedef std::map<std::string, enum LogLevel> LevelTable;
+
+// replaced module level tables - kept, as a thread that is logging may still
+// be using them (module levels change rarely)
+static std::vector<const LevelTable*> retiredModuleLevels;
+
+// the table is filled in before its pointer is published
+static void publishModuleLevels(const LevelTable** ptr, const LevelTable* table)
+{
+#if defined(__GNUC__)
+    __atomic_store_n(ptr, table, __ATOMIC_RELEASE);
+#else
+    // volatile accesses have release/acquire semantics with MSVC
+    *(const LevelTable* volatile*)ptr = table;
+#endif
+}
+
+static const LevelTable* loadModuleLevels(const LevelTable** ptr)
+{
+#if defined(__GNUC__)
+    return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+#else
+    return *(const LevelTable* volatile*)ptr;
+#endif
+}
+
 // static member initialization
 OutputMap SimpleLogger::outputs;
 Logger *SimpleLogger::logger = NULL;
+LogQueue *SimpleLogger::queue = NULL;
 
 // by the default, display logs with level equal or less than logInfo
 enum LogLevel SimpleLogger::logCurrentLevel = logInfo;
 
+const SimpleLogger::ModuleLevels* SimpleLogger::moduleLevels = NULL;
+bool SimpleLogger::hasModuleLevels = false;
+
+// the timestamp and the source are formatted on delivery
 SimpleLogger::SimpleLogger(enum LogLevel ll, char const* filename, int line)
 {
     this->level = ll;
+    this->filename = filename;
+    this->line = line;
+    this->when = (logger || queue) ? time(NULL) : 0;
 
     //ostr << "[" << getTime() << "] ";
     //ostr << "[" << toStr(ll) << "] ";
     //ostr << filename << ":" << line << " ";
+}
 
+SimpleLogger::~SimpleLogger()
+{
+    std::string message = ostr.str();
+
+    if (queue && queue->push(when, level, filename, line, &message))
+    {
+        return;
+    }
+
+    output(when, level, filename, line, message);
+}
+
+void SimpleLogger::output(time_t when, enum LogLevel ll, char const* filename, int line, const std::string& message)
+{
     if (logger)
     {
-        t = getTime();
-        std::ostringstream oss;
-        oss << filename;
+        std::string source(filename);
         if(line >= 0)
         {
-            oss << ":" << line;
+            char buf[16];
+            snprintf(buf, sizeof buf, ":%d", line);
+            source.append(buf);
         }
-        fname = oss.str();
+
+        logger->log(getTime(when).c_str(), ll, source.c_str(), message.c_str());
+    }
+
+    OutputStreams::iterator iter;
+    OutputStreams& vec = outputs[ll];
+
+    for (iter = vec.begin(); iter != vec.end(); iter++)
+    {
+        **iter << message << "\n";
     }
 }
 
-SimpleLogger::~SimpleLogger()
+// called by the delivery thread and by the logging threads at once
+std::string SimpleLogger::getTime(time_t t)
 {
-    OutputStreams::iterator iter;
-    OutputStreams vec;
+    char ts[50];
+    struct tm tmbuf;
+    struct tm* tm;
+
+#ifdef __MINGW32__
+    // per-thread buffer in msvcrt
+    tm = gmtime(&t);
+#elif defined(_WIN32)
+    tm = gmtime_s(&tmbuf, &t) ? NULL : &tmbuf;
+#else
+    tm = gmtime_r(&t, &tmbuf);
+#endif
+
+    if (!tm || !strftime(ts, sizeof(ts), "%H:%M:%S", tm)) {
+        ts[0] = '\0';
+    }
+    return ts;
+}
 
-    if (logger)
-        logger->log(t.c_str(), level, fname.c_str(), ostr.str().c_str());
+void SimpleLogger::setModuleLevel(const char *module, enum LogLevel ll)
+{
+    moduleLevelsMutex.lock();
+    ModuleLevels* table = moduleLevels ? new ModuleLevels(*moduleLevels) : new ModuleLevels();
+    (*table)[module] = ll;
 
-    ostr << std::endl;
+    if (moduleLevels)
+    {
+        retiredModuleLevels.push_back(moduleLevels);
+    }
 
-    vec = getOutput(level);
+    publishModuleLevels(&moduleLevels, table);
+    hasModuleLevels = true;
+    moduleLevelsMutex.unlock();
+}
 
-    for (iter = vec.begin(); iter != vec.end(); iter++)
+void SimpleLogger::clearModuleLevels()
+{
+    moduleLevelsMutex.lock();
+    hasModuleLevels = false;
+
+    if (moduleLevels)
     {
-        **iter << ostr.str();
+        retiredModuleLevels.push_back(moduleLevels);
+        publishModuleLevels(&moduleLevels, NULL);
     }
+
+    moduleLevelsMutex.unlock();
 }
 
-std::string SimpleLogger::getTime()
+bool SimpleLogger::moduleEnabled(enum LogLevel ll, char const* filename)
 {
-    char ts[50];
-    time_t t = time(NULL);
+    const char* name = filename;
 
-    if (!strftime(ts, sizeof(ts), "%H:%M:%S", gmtime(&t))) {
-        ts[0] = '\0';
+    for (const char* ptr = filename; *ptr; ptr++)
+    {
+        if (*ptr == '/' || *ptr == '\\')
+        {
+            name = ptr + 1;
+        }
     }
-    return ts;
+
+    const char* dot = strrchr(name, '.');
+    std::string module = dot ? std::string(name, dot - name) : std::string(name);
+
+    const ModuleLevels* table = loadModuleLevels(&moduleLevels);
+    enum LogLevel level = logCurrentLevel;
+
+    if (table)
+    {
+        ModuleLevels::const_iterator it = table->find(module);
+
+        if (it != table->end())
+        {
+            level = it->second;
+        }
+    }
+
+    return level >= ll;
 }
 
 void SimpleLogger::flush()
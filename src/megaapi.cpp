@@ -1420,6 +1420,16 @@ void MegaApi::setLogToConsole(bool enable)
     MegaApiImpl::setLogToConsole(enable);
 }
 
+void MegaApi::setAsyncLogging(bool enable)
+{
+    MegaApiImpl::setAsyncLogging(enable);
+}
+
+void MegaApi::setModuleLogLevel(const char *module, int logLevel)
+{
+    MegaApiImpl::setModuleLogLevel(module, logLevel);
+}
+
 void MegaApi::addLoggerObject(MegaLogger *megaLogger)
 {
     MegaApiImpl::addLoggerClass(megaLogger);
@@ -2163,6 +2173,46 @@ void MegaApi::setMaxConnections(int connections, MegaRequestListener *listener)
     pImpl->setMaxConnections(-1,  connections, listener);
 }
 
+void MegaApi::setTransferCryptoThreads(int threads)
+{
+    pImpl->setTransferCryptoThreads(threads);
+}
+
+void MegaApi::setNodeKeyThreads(int threads)
+{
+    pImpl->setNodeKeyThreads(threads);
+}
+
+void MegaApi::setNodePaging(int maxNodes)
+{
+    pImpl->setNodePaging(maxNodes);
+}
+
+void MegaApi::setAsyncDbCommit(bool enable)
+{
+    pImpl->setAsyncDbCommit(enable);
+}
+
+void MegaApi::setSmallFileUploads(bool enable)
+{
+    pImpl->setSmallFileUploads(enable);
+}
+
+void MegaApi::setAdaptiveConnections(bool enable)
+{
+    pImpl->setAdaptiveConnections(enable);
+}
+
+bool MegaApi::setTransferMultiplexing(bool enable, int maxStreams)
+{
+    return pImpl->setTransferMultiplexing(enable, maxStreams);
+}
+
+char *MegaApi::getMetrics(int format)
+{
+    return pImpl->getMetrics(format);
+}
+
 void MegaApi::setDownloadMethod(int method)
 {
     pImpl->setDownloadMethod(method);
@@ -2549,6 +2599,16 @@ void MegaApi::setExclusionUpperSizeLimit(long long limit)
     pImpl->setExclusionUpperSizeLimit(limit);
 }
 
+void MegaApi::setSyncScanThreads(int threads)
+{
+    pImpl->setSyncScanThreads(threads);
+}
+
+void MegaApi::setFingerprintThreads(int threads)
+{
+    pImpl->setFingerprintThreads(threads);
+}
+
 #ifdef USE_PCRE
 void MegaApi::setExcludedRegularExpressions(MegaSync *sync, MegaRegExp *regExp)
 {
@@ -3339,6 +3399,16 @@ bool MegaApi::httpServerIsSubtitlesSupportEnabled()
     return pImpl->httpServerIsSubtitlesSupportEnabled();
 }
 
+void MegaApi::httpServerEnableMetrics(bool enable)
+{
+    pImpl->httpServerEnableMetrics(enable);
+}
+
+bool MegaApi::httpServerIsMetricsEnabled()
+{
+    return pImpl->httpServerIsMetricsEnabled();
+}
+
 void MegaApi::httpServerAddListener(MegaTransferListener *listener)
 {
     pImpl->httpServerAddListener(listener);
@@ -4466,6 +4536,11 @@ int MegaSync::getState() const
     return MegaSync::SYNC_FAILED;
 }
 
+long long MegaSync::getScanRate() const
+{
+    return 0;
+}
+
 
 void MegaSyncListener::onSyncFileStateChanged(MegaApi *, MegaSync *, string *, int)
 { }
@@ -3973,6 +3973,7 @@ void MegaApiImpl::init(MegaApi *api, const char *appKey, MegaGfxProcessor* proce
     httpServerOfflineAttributeEnabled = false;
     httpServerRestrictedMode = MegaApi::HTTP_SERVER_ALLOW_CREATED_LOCAL_LINKS;
     httpServerSubtitlesSupportEnabled = false;
+    httpServerMetricsEnabled = false;
 #endif
 
     httpio = new MegaHttpIO();
@@ -4217,6 +4218,23 @@ void MegaApiImpl::setLogToConsole(bool enable)
     externalLogger.setLogToConsole(enable);
 }
 
+void MegaApiImpl::setAsyncLogging(bool enable)
+{
+    externalLogger.setAsync(enable);
+}
+
+void MegaApiImpl::setModuleLogLevel(const char *module, int logLevel)
+{
+    if (!module)
+    {
+        SimpleLogger::clearModuleLevels();
+    }
+    else
+    {
+        SimpleLogger::setModuleLevel(module, (LogLevel)logLevel);
+    }
+}
+
 void MegaApiImpl::log(int logLevel, const char *message, const char *filename, int line)
 {
     externalLogger.postLog(logLevel, message, filename, line);
@@ -6029,6 +6047,76 @@ void MegaApiImpl::setMaxConnections(int direction, int connections, MegaRequestL
     waiter->notify();
 }
 
+void MegaApiImpl::setTransferCryptoThreads(int threads)
+{
+    sdkMutex.lock();
+    client->setcryptothreads(threads);
+    sdkMutex.unlock();
+}
+
+void MegaApiImpl::setNodeKeyThreads(int threads)
+{
+    sdkMutex.lock();
+    client->setnodekeythreads(threads);
+    sdkMutex.unlock();
+}
+
+void MegaApiImpl::setNodePaging(int maxNodes)
+{
+    sdkMutex.lock();
+    client->setnodepaging(maxNodes > 0 ? maxNodes : 0);
+    sdkMutex.unlock();
+}
+
+void MegaApiImpl::setAsyncDbCommit(bool enable)
+{
+    sdkMutex.lock();
+    client->setasyncsccommit(enable);
+    sdkMutex.unlock();
+}
+
+void MegaApiImpl::setSmallFileUploads(bool enable)
+{
+    sdkMutex.lock();
+    client->batchsmalluploads = enable;
+    sdkMutex.unlock();
+}
+
+void MegaApiImpl::setAdaptiveConnections(bool enable)
+{
+    sdkMutex.lock();
+    client->adaptiveconnections = enable;
+    sdkMutex.unlock();
+}
+
+bool MegaApiImpl::setTransferMultiplexing(bool enable, int maxStreams)
+{
+    sdkMutex.lock();
+    bool result = client->httpio->setmultiplexing(enable, maxStreams);
+    sdkMutex.unlock();
+    return result;
+}
+
+char *MegaApiImpl::getMetrics(int format)
+{
+    string result;
+
+    sdkMutex.lock();
+    client->updatemetrics();
+    sdkMutex.unlock();
+
+    if (format == MegaApi::METRICS_FORMAT_PROMETHEUS)
+    {
+        Metrics::toprometheus(&result);
+    }
+    else
+    {
+        Metrics::tojson(&result);
+    }
+
+    return MegaApi::strdup(result.c_str());
+}
+
 void MegaApiImpl::setDownloadMethod(int method)
 {
     switch(method)
@@ -7009,6 +7097,20 @@ void MegaApiImpl::setExclusionUpperSizeLimit(long long limit)
     syncUpperSizeLimit = limit;
 }
 
+void MegaApiImpl::setSyncScanThreads(int threads)
+{
+    sdkMutex.lock();
+    client->setsyncscanthreads(threads);
+    sdkMutex.unlock();
+}
+
+void MegaApiImpl::setFingerprintThreads(int threads)
+{
+    sdkMutex.lock();
+    client->setfingerprintthreads(threads);
+    sdkMutex.unlock();
+}
+
 void MegaApiImpl::setExcludedRegularExpressions(MegaSync *sync, MegaRegExp *regExp)
 {
     if (!sync)
@@ -7360,6 +7462,7 @@ bool MegaApiImpl::httpServerStart(bool localOnly, int port, bool useTLS, const c
     httpServer->enableFolderServer(httpServerEnableFolders);
     httpServer->setRestrictedMode(httpServerRestrictedMode);
     httpServer->enableSubtitlesSupport(httpServerRestrictedMode);
+    httpServer->enableMetrics(httpServerMetricsEnabled);
 
     bool result = httpServer->start(port, localOnly);
     if (!result)
@@ -7658,6 +7761,22 @@ bool MegaApiImpl::httpServerIsSubtitlesSupportEnabled()
     return httpServerSubtitlesSupportEnabled;
 }
 
+void MegaApiImpl::httpServerEnableMetrics(bool enable)
+{
+    sdkMutex.lock();
+    httpServerMetricsEnabled = enable;
+    if (httpServer)
+    {
+        httpServer->enableMetrics(httpServerMetricsEnabled);
+    }
+    sdkMutex.unlock();
+}
+
+bool MegaApiImpl::httpServerIsMetricsEnabled()
+{
+    return httpServerMetricsEnabled;
+}
+
 bool MegaApiImpl::httpServerIsLocalOnly()
 {
     bool localOnly = true;
@@ -8380,6 +8499,7 @@ bool MegaApiImpl::processMegaTree(MegaNode* n, MegaTreeProcessor* processor, boo
 
     if (node->type != FILENODE)
     {
+        client->loadchildren(node);
         for (node_list::iterator it = node->children.begin(); it != node->children.end(); )
         {
             MegaNode *megaNode = MegaNodePrivate::fromNode(*it++);
@@ -8882,6 +9002,7 @@ bool MegaApiImpl::processTree(Node* node, TreeProcessor* processor, bool recursi
 
     if (recursive && node->type != FILENODE)
     {
+        client->loadchildren(node);
         for (node_list::iterator it = node->children.begin(); it != node->children.end(); )
         {
             if (!processTree(*it++,processor))
@@ -8913,6 +9034,7 @@ MegaNodeList* MegaApiImpl::search(MegaNode* n, const char* searchString, bool re
     }
 
     SearchTreeProcessor searchProcessor(searchString);
+    client->loadchildren(node);
     for (node_list::iterator it = node->children.begin(); it != node->children.end(); )
     {
         processTree(*it++, &searchProcessor, recursive);
@@ -9230,6 +9352,7 @@ MegaNode *MegaApiImpl::getNodeByCRC(const char *crc, MegaNode *parent)
     byte binarycrc[sizeof(node->crc)];
     Base64::atob(crc, binarycrc, sizeof(binarycrc));
 
+    client->loadchildren(node);
     for (node_list::iterator it = node->children.begin(); it != node->children.end(); it++)
     {
         Node *child = (*it);
@@ -10203,6 +10326,7 @@ void MegaApiImpl::syncupdate_state(Sync *sync, syncstate_t newstate)
     if(syncMap.find(sync->tag) == syncMap.end()) return;
     MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
     megaSync->setState(newstate);
+    megaSync->setScanRate(sync->scanrate);
     LOG_debug << "Sync state change: " << newstate << " Path: " << sync->localroot.name;
     client->abortbackoff(false);
 
@@ -10756,6 +10880,19 @@ void MegaApiImpl::putnodes_result(error e, targettype_t t, NewNode* nn)
             pendingUploads--;
         }
 
+        if (!e && nn && nn->added && nn->addedhandle != h)
+        {
+            // coalesced putnodes: the node of this upload isn't the last one added
+            // (uploads whose node wasn't added are failed by the command)
+            n = client->nodebyhandle(nn->addedhandle);
+            if (n)
+            {
+                n->applykey();
+                n->setattr();
+                h = n->nodehandle;
+            }
+        }
+
         transfer->setNodeHandle(h);
         transfer->setTransferredBytes(transfer->getTotalBytes());
 
@@ -11218,6 +11355,8 @@ void MegaApiImpl::copysession_result(string *session, error e)
 
 void MegaApiImpl::clearing()
 {
+    childrenCache.clear();
+
 #ifdef ENABLE_SYNC
     map<int, MegaSyncPrivate *>::iterator it;
     for (it = syncMap.begin(); it != syncMap.end(); )
@@ -11255,7 +11394,7 @@ void MegaApiImpl::notify_retry(dstime dsdelta, retryreason_t reason)
 void MegaApiImpl::notify_dbcommit()
 {
     MegaEventPrivate *event = new MegaEventPrivate(MegaEvent::EVENT_COMMIT_DB);
-    event->setText(client->scsn);
+    event->setText(client->dbcommitscsn.c_str());
     fireOnEvent(event);
 }
 
@@ -13548,7 +13687,7 @@ bool MegaApiImpl::nodeComparatorDefaultASC(Node *i, Node *j)
     {
         return 1;
     }
-    if (naturalsorting_compare(i->displayname(), j->displayname()) <= 0)
+    if (naturalsorting_compare(i->displayname(), j->displayname()) < 0)
     {
         return 1;
     }
@@ -13565,11 +13704,11 @@ bool MegaApiImpl::nodeComparatorDefaultDESC(Node *i, Node *j)
     {
         return 0;
     }
-    if (naturalsorting_compare(i->displayname(), j->displayname()) <= 0)
+    if (naturalsorting_compare(i->displayname(), j->displayname()) > 0)
     {
-        return 0;
+        return 1;
     }
-    return 1;
+    return 0;
 }
 
 bool MegaApiImpl::nodeComparatorSizeASC(Node *i, Node *j)
@@ -13676,7 +13815,7 @@ bool MegaApiImpl::nodeComparatorAlphabeticalASC(Node *i, Node *j)
     {
         return 1;
     }
-    if (strcasecmp(i->displayname(), j->displayname()) <= 0)
+    if (strcasecmp(i->displayname(), j->displayname()) < 0)
     {
         return 1;
     }
@@ -13693,11 +13832,11 @@ bool MegaApiImpl::nodeComparatorAlphabeticalDESC(Node *i, Node *j)
     {
         return 1;
     }
-    if (strcasecmp(i->displayname(), j->displayname()) <= 0)
+    if (strcasecmp(i->displayname(), j->displayname()) > 0)
     {
-        return 0;
+        return 1;
     }
-    return 1;
+    return 0;
 }
 
 int MegaApiImpl::getNumChildren(MegaNode* p)
@@ -13715,6 +13854,7 @@ int MegaApiImpl::getNumChildren(MegaNode* p)
 		return 0;
 	}
 
+	client->loadchildren(parent);
 	int numChildren = parent->children.size();
 	sdkMutex.unlock();
 
@@ -13737,6 +13877,7 @@ int MegaApiImpl::getNumChildFiles(MegaNode* p)
 	}
 
 	int numFiles = 0;
+	client->loadchildren(parent);
 	for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); it++)
 	{
 		if ((*it)->type == FILENODE)
@@ -13763,6 +13904,7 @@ int MegaApiImpl::getNumChildFolders(MegaNode* p)
 	}
 
 	int numFolders = 0;
+	client->loadchildren(parent);
 	for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); it++)
 	{
 		if ((*it)->type != FILENODE)
@@ -13774,6 +13916,64 @@ int MegaApiImpl::getNumChildFolders(MegaNode* p)
 }
 
 
+bool (*MegaApiImpl::nodeComparator(int order))(Node *, Node *)
+{
+    switch(order)
+    {
+        case MegaApi::ORDER_DEFAULT_ASC: return MegaApiImpl::nodeComparatorDefaultASC;
+        case MegaApi::ORDER_DEFAULT_DESC: return MegaApiImpl::nodeComparatorDefaultDESC;
+        case MegaApi::ORDER_SIZE_ASC: return MegaApiImpl::nodeComparatorSizeASC;
+        case MegaApi::ORDER_SIZE_DESC: return MegaApiImpl::nodeComparatorSizeDESC;
+        case MegaApi::ORDER_CREATION_ASC: return MegaApiImpl::nodeComparatorCreationASC;
+        case MegaApi::ORDER_CREATION_DESC: return MegaApiImpl::nodeComparatorCreationDESC;
+        case MegaApi::ORDER_MODIFICATION_ASC: return MegaApiImpl::nodeComparatorModificationASC;
+        case MegaApi::ORDER_MODIFICATION_DESC: return MegaApiImpl::nodeComparatorModificationDESC;
+        case MegaApi::ORDER_ALPHABETICAL_ASC: return MegaApiImpl::nodeComparatorAlphabeticalASC;
+        case MegaApi::ORDER_ALPHABETICAL_DESC: return MegaApiImpl::nodeComparatorAlphabeticalDESC;
+        default: return MegaApiImpl::nodeComparatorDefaultASC;
+    }
+}
+
+void MegaApiImpl::getSortedChildren(Node *parent, int order, vector<Node *> *children)
+{
+    client->loadchildren(parent);
+
+    if (!order || order > MegaApi::ORDER_ALPHABETICAL_DESC)
+    {
+        children->assign(parent->children.begin(), parent->children.end());
+        return;
+    }
+
+    bool cacheable = parent->children.size() >= CHILDREN_CACHE_MIN_CHILDREN;
+    pair<handle, int> key(parent->nodehandle, order);
+    if (cacheable)
+    {
+        map<pair<handle, int>, SortedChildren>::iterator it = childrenCache.find(key);
+        if (it != childrenCache.end() && it->second.stamp == parent->childrenstamp)
+        {
+            *children = it->second.nodes;
+            return;
+        }
+    }
+
+    // the comparators are strict orderings: children that compare equal
+    // keep their relative order
+    children->assign(parent->children.begin(), parent->children.end());
+    std::stable_sort(children->begin(), children->end(), nodeComparator(order));
+
+    if (cacheable)
+    {
+        if (childrenCache.size() >= CHILDREN_CACHE_MAX_ENTRIES && childrenCache.find(key) == childrenCache.end())
+        {
+            childrenCache.clear();
+        }
+
+        SortedChildren &sorted = childrenCache[key];
+        sorted.stamp = parent->childrenstamp;
+        sorted.nodes = *children;
+    }
+}
+
 MegaNodeList *MegaApiImpl::getChildren(MegaNode* p, int order)
 {
     if (!p || p->getType() == MegaNode::TYPE_FILE)
@@ -13790,38 +13990,7 @@ MegaNodeList *MegaApiImpl::getChildren(MegaNode* p, int order)
 	}
 
     vector<Node *> childrenNodes;
-
-    if(!order || order> MegaApi::ORDER_ALPHABETICAL_DESC)
-	{
-		for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); )
-            childrenNodes.push_back(*it++);
-	}
-	else
-	{
-        bool (*comp)(Node*, Node*);
-		switch(order)
-		{
-        case MegaApi::ORDER_DEFAULT_ASC: comp = MegaApiImpl::nodeComparatorDefaultASC; break;
-        case MegaApi::ORDER_DEFAULT_DESC: comp = MegaApiImpl::nodeComparatorDefaultDESC; break;
-        case MegaApi::ORDER_SIZE_ASC: comp = MegaApiImpl::nodeComparatorSizeASC; break;
-        case MegaApi::ORDER_SIZE_DESC: comp = MegaApiImpl::nodeComparatorSizeDESC; break;
-        case MegaApi::ORDER_CREATION_ASC: comp = MegaApiImpl::nodeComparatorCreationASC; break;
-        case MegaApi::ORDER_CREATION_DESC: comp = MegaApiImpl::nodeComparatorCreationDESC; break;
-        case MegaApi::ORDER_MODIFICATION_ASC: comp = MegaApiImpl::nodeComparatorModificationASC; break;
-        case MegaApi::ORDER_MODIFICATION_DESC: comp = MegaApiImpl::nodeComparatorModificationDESC; break;
-        case MegaApi::ORDER_ALPHABETICAL_ASC: comp = MegaApiImpl::nodeComparatorAlphabeticalASC; break;
-        case MegaApi::ORDER_ALPHABETICAL_DESC: comp = MegaApiImpl::nodeComparatorAlphabeticalDESC; break;
-        default: comp = MegaApiImpl::nodeComparatorDefaultASC; break;
-		}
-
-		for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); )
-		{
-            Node *n = *it++;
-            vector<Node *>::iterator i = std::lower_bound(childrenNodes.begin(),
-					childrenNodes.end(), n, comp);
-            childrenNodes.insert(i, n);
-		}
-	}
+    getSortedChildren(parent, order, &childrenNodes);
 
     MegaNodeListPrivate *result = NULL;
     if (childrenNodes.size())
@@ -13853,10 +14022,12 @@ MegaNodeList *MegaApiImpl::getVersions(MegaNode *node)
 
     vector<Node*> versions;
     versions.push_back(current);
+    client->loadchildren(current);
     while (current->children.size())
     {
         assert(current->children.back()->parent == current);
         current = current->children.back();
+        client->loadchildren(current);
         assert(current->type == FILENODE);
         versions.push_back(current);
     }
@@ -13882,10 +14053,12 @@ int MegaApiImpl::getNumVersions(MegaNode *node)
     }
 
     int numVersions = 1;
+    client->loadchildren(current);
     while (current->children.size())
     {
         assert(current->children.back()->parent == current);
         current = current->children.back();
+        client->loadchildren(current);
         assert(current->type == FILENODE);
         numVersions++;
     }
@@ -13908,6 +14081,7 @@ bool MegaApiImpl::hasVersions(MegaNode *node)
         return false;
     }
 
+    client->loadchildren(current);
     assert(!current->children.size()
            || (current->children.back()->parent == current
                && current->children.back()->type == FILENODE));
@@ -13943,55 +14117,22 @@ MegaChildrenLists *MegaApiImpl::getFileFolderChildren(MegaNode *p, int order)
         return new MegaChildrenListsPrivate();
     }
 
+    vector<Node *> children;
+    getSortedChildren(parent, order, &children);
+
+    // splitting the sorted listing keeps both parts sorted
     vector<Node *> files;
     vector<Node *> folders;
-
-    if(!order || order> MegaApi::ORDER_ALPHABETICAL_DESC)
+    for (vector<Node *>::iterator it = children.begin(); it != children.end(); it++)
     {
-        for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); )
-        {
-            Node *n = *it++;
-            if (n->type == FILENODE)
-            {
-                files.push_back(n);
-            }
-            else // if (n->type == FOLDERNODE)
-            {
-                folders.push_back(n);
-            }
-        }
-    }
-    else
-    {
-        bool (*comp)(Node*, Node*);
-        switch(order)
+        Node *n = *it;
+        if (n->type == FILENODE)
         {
-        case MegaApi::ORDER_DEFAULT_ASC: comp = MegaApiImpl::nodeComparatorDefaultASC; break;
-        case MegaApi::ORDER_DEFAULT_DESC: comp = MegaApiImpl::nodeComparatorDefaultDESC; break;
-        case MegaApi::ORDER_SIZE_ASC: comp = MegaApiImpl::nodeComparatorSizeASC; break;
-        case MegaApi::ORDER_SIZE_DESC: comp = MegaApiImpl::nodeComparatorSizeDESC; break;
-        case MegaApi::ORDER_CREATION_ASC: comp = MegaApiImpl::nodeComparatorCreationASC; break;
-        case MegaApi::ORDER_CREATION_DESC: comp = MegaApiImpl::nodeComparatorCreationDESC; break;
-        case MegaApi::ORDER_MODIFICATION_ASC: comp = MegaApiImpl::nodeComparatorModificationASC; break;
-        case MegaApi::ORDER_MODIFICATION_DESC: comp = MegaApiImpl::nodeComparatorModificationDESC; break;
-        case MegaApi::ORDER_ALPHABETICAL_ASC: comp = MegaApiImpl::nodeComparatorAlphabeticalASC; break;
-        case MegaApi::ORDER_ALPHABETICAL_DESC: comp = MegaApiImpl::nodeComparatorAlphabeticalDESC; break;
-        default: comp = MegaApiImpl::nodeComparatorDefaultASC; break;
+            files.push_back(n);
         }
-
-        for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); )
+        else // if (n->type == FOLDERNODE)
         {
-            Node *n = *it++;
-            if (n->type == FILENODE)
-            {
-                vector<Node *>::iterator i = std::lower_bound(files.begin(), files.end(), n, comp);
-                files.insert(i, n);
-            }
-            else // if (n->type == FOLDERNODE)
-            {
-                vector<Node *>::iterator i = std::lower_bound(folders.begin(), folders.end(), n, comp);
-                folders.insert(i, n);
-            }
+            folders.push_back(n);
         }
     }
 
@@ -14034,6 +14175,7 @@ bool MegaApiImpl::hasChildren(MegaNode *parent)
         return false;
     }
 
+    client->loadchildren(p);
     bool ret = p->children.size();
     sdkMutex.unlock();
 
@@ -14069,30 +14211,10 @@ int MegaApiImpl::getIndex(MegaNode *n, int order)
         return 0;
     }
 
-    bool (*comp)(Node*, Node*);
-    switch(order)
-    {
-        case MegaApi::ORDER_DEFAULT_ASC: comp = MegaApiImpl::nodeComparatorDefaultASC; break;
-        case MegaApi::ORDER_DEFAULT_DESC: comp = MegaApiImpl::nodeComparatorDefaultDESC; break;
-        case MegaApi::ORDER_SIZE_ASC: comp = MegaApiImpl::nodeComparatorSizeASC; break;
-        case MegaApi::ORDER_SIZE_DESC: comp = MegaApiImpl::nodeComparatorSizeDESC; break;
-        case MegaApi::ORDER_CREATION_ASC: comp = MegaApiImpl::nodeComparatorCreationASC; break;
-        case MegaApi::ORDER_CREATION_DESC: comp = MegaApiImpl::nodeComparatorCreationDESC; break;
-        case MegaApi::ORDER_MODIFICATION_ASC: comp = MegaApiImpl::nodeComparatorModificationASC; break;
-        case MegaApi::ORDER_MODIFICATION_DESC: comp = MegaApiImpl::nodeComparatorModificationDESC; break;
-        case MegaApi::ORDER_ALPHABETICAL_ASC: comp = MegaApiImpl::nodeComparatorAlphabeticalASC; break;
-        case MegaApi::ORDER_ALPHABETICAL_DESC: comp = MegaApiImpl::nodeComparatorAlphabeticalDESC; break;
-        default: comp = MegaApiImpl::nodeComparatorDefaultASC; break;
-    }
+    bool (*comp)(Node*, Node*) = nodeComparator(order);
 
     vector<Node *> childrenNodes;
-    for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); )
-    {
-        Node *temp = *it++;
-        vector<Node *>::iterator i = std::lower_bound(childrenNodes.begin(),
-                childrenNodes.end(), temp, comp);
-        childrenNodes.insert(i, temp);
-    }
+    getSortedChildren(parent, order, &childrenNodes);
 
     vector<Node *>::iterator i = std::lower_bound(childrenNodes.begin(),
             childrenNodes.end(), node, comp);
@@ -18454,11 +18576,15 @@ ExternalLogger::ExternalLogger()
 {
     mutex.init(true);
     logToConsole = false;
+    asyncLogger = NULL;
     SimpleLogger::setOutputClass(this);
 }
 
 ExternalLogger::~ExternalLogger()
 {
+    // queued messages are delivered first
+    delete asyncLogger;
+
     mutex.lock();
     SimpleLogger::setOutputClass(NULL);
     mutex.unlock();
@@ -18494,6 +18620,27 @@ void ExternalLogger::setLogToConsole(bool enable)
     this->logToConsole = enable;
 }
 
+// the AsyncLogger is only suspended, not deleted: other threads may be
+// pushing a message to it right now
+void ExternalLogger::setAsync(bool enable)
+{
+    if (enable)
+    {
+        if (!asyncLogger)
+        {
+            asyncLogger = new AsyncLogger();
+        }
+        else
+        {
+            asyncLogger->resume();
+        }
+    }
+    else if (asyncLogger)
+    {
+        asyncLogger->suspend();
+    }
+}
+
 void ExternalLogger::postLog(int logLevel, const char *message, const char *filename, int line)
 {
     if (SimpleLogger::logCurrentLevel < logLevel)
@@ -18511,6 +18658,14 @@ void ExternalLogger::postLog(int logLevel, const char *message, const char *file
         filename = "";
     }
 
+    if (asyncLogger)
+    {
+        // queued (or delivered after the queued messages, which needs the
+        // mutex on the logging thread - also while suspended)
+        SimpleLogger((LogLevel)logLevel, filename, line) << message;
+        return;
+    }
+
     mutex.lock();
     SimpleLogger((LogLevel)logLevel, filename, line) << message;
     mutex.unlock();
@@ -18759,6 +18914,7 @@ MegaSyncPrivate::MegaSyncPrivate(const char *path, handle nodehandle, int tag)
     this->fingerprint = 0;
     this->regExp = NULL;
     this->listener = NULL;
+    this->scanRate = 0;
 }
 
 MegaSyncPrivate::MegaSyncPrivate(MegaSyncPrivate *sync)
@@ -18772,6 +18928,7 @@ MegaSyncPrivate::MegaSyncPrivate(MegaSyncPrivate *sync)
     this->setState(sync->getState());
     this->setListener(sync->getListener());
     this->setRegExp(sync->getRegExp());
+    this->setScanRate(sync->getScanRate());
 }
 
 MegaSyncPrivate::~MegaSyncPrivate()
@@ -18849,6 +19006,16 @@ void MegaSyncPrivate::setState(int state)
     this->state = state;
 }
 
+long long MegaSyncPrivate::getScanRate() const
+{
+    return scanRate;
+}
+
+void MegaSyncPrivate::setScanRate(long long scanRate)
+{
+    this->scanRate = scanRate;
+}
+
 MegaRegExpPrivate::MegaRegExpPrivate()
 {
     patternUpdated = false;
@@ -21118,6 +21285,7 @@ MegaHTTPServer::MegaHTTPServer(MegaApiImpl *megaApi, string basePath, bool useTL
     this->restrictedMode = MegaApi::HTTP_SERVER_ALLOW_CREATED_LOCAL_LINKS;
     this->lastHandle = INVALID_HANDLE;
     this->subtitlesSupportEnabled = false;
+    this->metricsEnabled = false;
 #ifdef ENABLE_EVT_TLS
     this->useTLS = useTLS;
     this->certificatepath = certificatepath;
@@ -21451,6 +21619,16 @@ void MegaHTTPServer::enableSubtitlesSupport(bool enable)
     this->subtitlesSupportEnabled = enable;
 }
 
+bool MegaHTTPServer::isMetricsEnabled()
+{
+    return metricsEnabled;
+}
+
+void MegaHTTPServer::enableMetrics(bool enable)
+{
+    this->metricsEnabled = enable;
+}
+
 void *MegaHTTPServer::threadEntryPoint(void *param)
 {
 #ifndef _WIN32
@@ -22415,6 +22593,26 @@ int MegaHTTPServer::onMessageComplete(http_parser *parser)
         return 0;
     }
 
+    if (httpctx->path == "/metrics" && parser->method == HTTP_GET && httpctx->server->isMetricsEnabled())
+    {
+        LOG_debug << "Metrics requested";
+        char *metrics = httpctx->megaApi->getMetrics(MegaApi::METRICS_FORMAT_PROMETHEUS);
+        string sweb = metrics;
+        delete [] metrics;
+
+        response << "HTTP/1.1 200 OK\r\n"
+                    "Content-Type: text/plain; version=0.0.4\r\n"
+                    "Content-Length: " << sweb.size() << "\r\n"
+                    "Connection: close\r\n"
+                    "\r\n";
+
+        response << sweb;
+        httpctx->resultCode = 200;
+        string resstr = response.str();
+        sendHeaders(httpctx, &resstr);
+        return 0;
+    }
+
     if (httpctx->path == "/")
     {
         node = httpctx->megaApi->getRootNode();
@@ -46,6 +46,10 @@ const unsigned MegaClient::MAXTOTALTRANSFERS = 30;
 // maximum number of concurrent transfers (uploads or downloads)
 const unsigned MegaClient::MAXTRANSFERS = 20;
 
+// maximum number of concurrent uploads of small files (small-file upload mode)
+const unsigned MegaClient::MAXSMALLUPLOADS = 100;
+const m_off_t MegaClient::SMALLUPLOADSIZE = 131072;
+
 // maximum number of queued putfa before halting the upload queue
 const int MegaClient::MAXQUEUEDFA = 30;
 
@@ -758,6 +762,7 @@ bool MegaClient::warnlevel()
 
 // returns a matching child node by UTF-8 name (does not resolve name clashes)
 // folder nodes take precedence over file nodes
+// large folders are looked up through their name index
 Node* MegaClient::childnodebyname(Node* p, const char* name, bool skipfolders)
 {
     string nname = name;
@@ -770,7 +775,42 @@ Node* MegaClient::childnodebyname(Node* p, const char* name, bool skipfolders)
 
     fsaccess->normalize(&nname);
 
-    for (node_list::iterator it = p->children.begin(); it != p->children.end(); it++)
+    if (nodepagingready && !p->childrenloaded)
+    {
+        // fault in the candidates only
+        string lname = nname;
+        dbnoderecord_vector records;
+
+        if (sctable->getnodes(DbTable::NODES_CHILDRENBYNAME, p->nodehandle, stringhash64(&lname, &key), &records))
+        {
+            loadnodes(&records);
+        }
+    }
+
+    if (p->childnames)
+    {
+        pair<nodename_map::iterator, nodename_map::iterator> range = p->childnames->equal_range(nname);
+
+        for (nodename_map::iterator it = range.first; it != range.second; it++)
+        {
+            if (it->second->type != FILENODE && !skipfolders)
+            {
+                return it->second;
+            }
+
+            found = it->second;
+            if (skipfolders)
+            {
+                return found;
+            }
+        }
+
+        return found;
+    }
+
+    unsigned scanned = 0;
+
+    for (node_list::iterator it = p->children.begin(); it != p->children.end(); it++, scanned++)
     {
         if (!strcmp(nname.c_str(), (*it)->displayname()))
         {
@@ -787,6 +827,12 @@ Node* MegaClient::childnodebyname(Node* p, const char* name, bool skipfolders)
         }
     }
 
+    // subsequent lookups in this folder use a name index
+    if (scanned >= CHILDNAMEINDEX_THRESHOLD)
+    {
+        p->indexchildnames();
+    }
+
     return found;
 }
 
@@ -813,6 +859,10 @@ void MegaClient::init()
     syncsup = true;
     syncdownrequired = false;
     syncuprequired = false;
+    syncdownvisited = 0;
+    syncdownskipped = 0;
+    syncupvisited = 0;
+    syncupskipped = 0;
 
     if (syncscanstate)
     {
@@ -846,6 +896,8 @@ MegaClient::MegaClient(MegaApp* a, Waiter* w, HttpIO* h, FileSystemAccess* f, Db
 {
     sctable = NULL;
     pendingsccommit = false;
+    scdirty = false;
+    asyncsccommit = false;
     tctable = NULL;
     me = UNDEF;
     publichandle = UNDEF;
@@ -862,6 +914,13 @@ MegaClient::MegaClient(MegaApp* a, Waiter* w, HttpIO* h, FileSystemAccess* f, Db
     accountsince = 0;
     gmfa_enabled = false;
     gfxdisabled = false;
+    chunkcrypto = NULL;
+    nodekeythreads = 0;
+    lastchildrenstamp = 0;
+    nodepaging = 0;
+    nodepagingready = false;
+    nodepagingmark = 0;
+    nodesevicted = false;
 
 #ifndef EMSCRIPTEN
     autodownport = true;
@@ -877,9 +936,12 @@ MegaClient::MegaClient(MegaApp* a, Waiter* w, HttpIO* h, FileSystemAccess* f, Db
     
     fetchingnodes = false;
     fetchnodestag = 0;
+    resetfnstream();
 
 #ifdef ENABLE_SYNC
     syncscanstate = false;
+    syncscanthreads = 0;
+    fingerprintpool = NULL;
     syncadding = 0;
     currsyncid = 0;
     totalLocalNodes = 0;
@@ -894,6 +956,11 @@ MegaClient::MegaClient(MegaApp* a, Waiter* w, HttpIO* h, FileSystemAccess* f, Db
     overquotauntil = 0;
     looprequested = false;
 
+    batchsmalluploads = false;
+    batcheduploads = 0;
+    batcheduploadsstart = 0;
+    lastbatcheduploads = 0;
+
 #ifdef ENABLE_CHAT
     fetchingkeys = false;
     signkey = NULL;
@@ -927,6 +994,7 @@ MegaClient::MegaClient(MegaApp* a, Waiter* w, HttpIO* h, FileSystemAccess* f, Db
 
     connections[PUT] = 3;
     connections[GET] = 4;
+    adaptiveconnections = false;
 
     int i;
 
@@ -975,6 +1043,10 @@ MegaClient::~MegaClient()
 {
     locallogout();
 
+    delete chunkcrypto;
+#ifdef ENABLE_SYNC
+    delete fingerprintpool;
+#endif
     delete pendingcs;
     delete pendingsc;
     delete badhostcs;
@@ -989,6 +1061,15 @@ void MegaClient::exec()
 {
     WAIT_CLASS::bumpds();
 
+    checkdbcommits();
+
+#ifdef ENABLE_SYNC
+    if (fingerprintpool)
+    {
+        checkfingerprints(fingerprintpool);
+    }
+#endif
+
     if (overquotauntil && overquotauntil < Waiter::ds)
     {
         overquotauntil = 0;
@@ -1380,6 +1461,13 @@ void MegaClient::exec()
                         break;
 
                     case REQ_INFLIGHT:
+                        if (fetchingnodes)
+                        {
+                            httpio->lock();
+                            procfnstream(pendingcs, false);
+                            httpio->unlock();
+                        }
+
                         if (pendingcs->contentlength > 0)
                         {
                             if (fetchingnodes && fnstats.timeToFirstByte == NEVER
@@ -1402,6 +1490,11 @@ void MegaClient::exec()
                         abortlockrequest();
                         app->request_response_progress(pendingcs->bufpos, -1);
 
+                        if (fetchingnodes || fnstreamhead.size())
+                        {
+                            procfnstream(pendingcs, true);
+                        }
+
                         if (pendingcs->in != "-3" && pendingcs->in != "-4")
                         {
                             if (*pendingcs->in.c_str() == '[')
@@ -1430,10 +1523,8 @@ void MegaClient::exec()
                                 if (sctable && pendingsccommit && !reqs.cmdspending())
                                 {
                                     LOG_debug << "Executing postponed DB commit";
-                                    sctable->commit();
-                                    sctable->begin();
-                                    app->notify_dbcommit();
-                                    pendingsccommit = false;
+                                    commitsc();
+                                    notifydbcommit();
                                 }
 
                                 // increment unique request ID
@@ -1553,6 +1644,9 @@ void MegaClient::exec()
 
             if (btcs.armed())
             {
+                // coalesced putnodes wait for the API channel to be idle
+                execbatchedputnodes();
+
                 if (btcs.nextset())
                 {
                     reqs.nextRequest();
@@ -1562,6 +1656,8 @@ void MegaClient::exec()
                 {
                     pendingcs = new HttpReq();
                     pendingcs->protect = true;
+                    pendingcs->streamed = fetchingnodes;
+                    resetfnstream();
 
                     reqs.get(pendingcs->out);
 
@@ -1693,6 +1789,10 @@ void MegaClient::exec()
                         btsc.reset();
                     }
                     break;
+
+                case REQ_CRYPTO:
+                    // only used by transfer requests
+                    break;
                 }
             }
             else
@@ -2259,10 +2359,11 @@ void MegaClient::exec()
                                         << syncfslockretry << synccreate.size();
                             syncops = false;
 
-                            // FIXME: only syncup for subtrees that were actually
-                            // updated to reduce CPU load
+                            // syncup() only descends into subtrees flagged as
+                            // changed since the previous pass
                             bool repeatsyncup = false;
                             bool syncupdone = false;
+                            int64_t syncupstart = Waiter::us();
                             for (it = syncs.begin(); it != syncs.end(); it++)
                             {
                                 if (((*it)->state == SYNC_ACTIVE || (*it)->state == SYNC_INITIALSCAN)
@@ -2276,6 +2377,12 @@ void MegaClient::exec()
                             }
                             syncuprequired = !syncupdone || repeatsyncup;
 
+                            if (syncupdone)
+                            {
+                                Metrics::observe(Metrics::SYNC_SYNCUP_DURATION, Waiter::us() - syncupstart);
+                                LOG_debug << "Syncup folders visited: " << syncupvisited << " skipped: " << syncupskipped;
+                            }
+
                             if (EVER(nds))
                             {
                                 if (!syncnagleretry || (nds - Waiter::ds) < syncnaglebt.backoffdelta())
@@ -2318,6 +2425,8 @@ void MegaClient::exec()
                                     {
                                         if (sync->fullscan)
                                         {
+                                            sync->endscan();
+
                                             // recursively delete all LocalNodes that were deleted (not moved or renamed!)
                                             sync->deletemissing(&sync->localroot);
                                             sync->cachenodes();
@@ -2343,7 +2452,10 @@ void MegaClient::exec()
                                                 }
                                                 scanfailed = true;
 
+                                                sync->startscan();
+                                                int64_t scanstart = Waiter::us();
                                                 sync->scan(&sync->localroot.localname, NULL);
+                                                Metrics::observe(Metrics::SYNC_SCAN_DURATION, Waiter::us() - scanstart);
                                                 sync->dirnotify->error = 0;
                                                 sync->fullscan = true;
                                                 sync->scanseqno++;
@@ -2393,6 +2505,7 @@ void MegaClient::exec()
                 {
                     LOG_verbose << "Running syncdown";
                     bool success = true;
+                    int64_t syncdownstart = Waiter::us();
                     for (it = syncs.begin(); it != syncs.end(); it++)
                     {
                         // make sure that the remote synced folder still exists
@@ -2422,6 +2535,9 @@ void MegaClient::exec()
                         }
                     }
 
+                    Metrics::observe(Metrics::SYNC_SYNCDOWN_DURATION, Waiter::us() - syncdownstart);
+                    LOG_debug << "Syncdown folders visited: " << syncdownvisited << " skipped: " << syncdownskipped;
+
                     // notify the app if a lock is being retried
                     if (success)
                     {
@@ -2501,7 +2617,9 @@ void MegaClient::exec()
 
         httpio->updatedownloadspeed();
         httpio->updateuploadspeed();
-    } while (httpio->doio() || execdirectreads() || (!pendingcs && reqs.cmdspending() && btcs.armed()) || looprequested);
+
+        pagenodes();
+    } while (httpio->doio() || execdirectreads() || (!pendingcs && (reqs.cmdspending() || batchedputnodes.size()) && btcs.armed()) || looprequested);
 }
 
 // get next event time from all subsystems, then invoke the waiter if needed
@@ -3035,27 +3153,8 @@ bool MegaClient::dispatch(direction_t d)
                     m_off_t p = 0;
 
                     // resume at the end of the last contiguous completed block
-                    for (chunkmac_map::iterator it = nexttransfer->chunkmacs.begin();
-                         it != nexttransfer->chunkmacs.end(); it++)
-                    {
-                        m_off_t chunkceil = ChunkedHash::chunkceil(it->first, nexttransfer->size);
-
-                        if (nexttransfer->pos == it->first && it->second.finished)
-                        {
-                            nexttransfer->pos = chunkceil;
-                            nexttransfer->progresscompleted = chunkceil;
-                        }
-                        else if (it->second.finished)
-                        {
-                            m_off_t chunksize = chunkceil - ChunkedHash::chunkfloor(it->first);
-                            nexttransfer->progresscompleted += chunksize;
-                        }
-                        else
-                        {
-                            nexttransfer->progresscompleted += it->second.offset;
-                            p += it->second.offset;
-                        }
-                    }
+                    nexttransfer->chunkmacs.calcprogress(nexttransfer->size, nexttransfer->pos,
+                                                         nexttransfer->progresscompleted, &p);
 
                     if (nexttransfer->progresscompleted > nexttransfer->size)
                     {
@@ -3362,9 +3461,15 @@ void MegaClient::locallogout()
 {
     int i;
 
+    // the local cache is kept for the next session resumption
+    writesnapshot();
+
     delete sctable;
     sctable = NULL;
     pendingsccommit = false;
+    scdirty = false;
+    pendingdbcommits.clear();
+    nodepagingready = false;
 
     me = UNDEF;
     publichandle = UNDEF;
@@ -3416,7 +3521,18 @@ void MegaClient::locallogout()
     xferpaused[GET] = false;
     putmbpscap = 0;
     fetchingnodes = false;
+
+    for (std::map<handle, vector<pair<NewNode*, int> > >::iterator it = batchedputnodes.begin(); it != batchedputnodes.end(); it++)
+    {
+        for (size_t i = 0; i < it->second.size(); i++)
+        {
+            delete [] it->second[i].first;
+        }
+    }
+    batchedputnodes.clear();
+    batcheduploads = 0;
     fetchnodestag = 0;
+    resetfnstream();
     overquotauntil = 0;
     scpaused = false;
 
@@ -3471,6 +3587,8 @@ void MegaClient::removecaches()
 {
     if (sctable)
     {
+        disablenodepaging("Local cache removed");
+
         sctable->remove();
         delete sctable;
         sctable = NULL;
@@ -3613,9 +3731,7 @@ bool MegaClient::procsc()
                             notifypurge();
                             if (sctable)
                             {
-                                sctable->commit();
-                                sctable->begin();
-                                pendingsccommit = false;
+                                commitsc();
                             }
 
                             WAIT_CLASS::bumpds();
@@ -3626,7 +3742,7 @@ bool MegaClient::procsc()
                             restag = fetchnodestag;
                             fetchnodestag = 0;
                             app->fetchnodes_result(API_OK);
-                            app->notify_dbcommit();
+                            notifydbcommit();
 
                             WAIT_CLASS::bumpds();
                             fnstats.timeToSyncsResumed = Waiter::ds - fnstats.startTime;
@@ -3704,10 +3820,8 @@ bool MegaClient::procsc()
                     {
                         if (!pendingcs && !csretrying && !reqs.cmdspending())
                         {
-                            sctable->commit();
-                            sctable->begin();
-                            app->notify_dbcommit();
-                            pendingsccommit = false;
+                            commitsc();
+                            notifydbcommit();
                         }
                         else
                         {
@@ -3958,6 +4072,7 @@ void MegaClient::initsc()
     if (sctable)
     {
         bool complete;
+        bool keyed = false;
 
         sctable->begin();
         sctable->truncate();
@@ -3982,11 +4097,26 @@ void MegaClient::initsc()
         if (complete)
         {
             // 3. write new or modified nodes, purge deleted nodes
+            vector<Cachable*> records;
+            records.reserve(nodes.size());
+
             for (node_map::iterator it = nodes.begin(); it != nodes.end(); it++)
             {
-                if (!(complete = sctable->put(CACHEDNODE, it->second, &key)))
+                records.push_back(it->second);
+            }
+
+            if (records.size())
+            {
+                complete = sctable->putmany(CACHEDNODE, &records[0], records.size(), &key);
+            }
+
+            if (complete && nodepaging)
+            {
+                // lookup keys for node paging (unsupported by some backends)
+                keyed = true;
+                for (node_map::iterator it = nodes.begin(); keyed && it != nodes.end(); it++)
                 {
-                    break;
+                    keyed = putnodekeys(it->second);
                 }
             }
         }
@@ -4021,6 +4151,8 @@ void MegaClient::initsc()
         LOG_debug << "Saving SCSN " << scsn << " with " << nodes.size() << " nodes and " << users.size() << " users and " << pcrindex.size() << " pcrs to local cache (" << complete << ")";
  #endif
         finalizesc(complete);
+
+        nodepagingready = sctable && complete && keyed;
     }
 }
 
@@ -4039,6 +4171,9 @@ void MegaClient::updatesc()
             {
                 LOG_err << "Invalid scsn size";
             }
+
+            // changes are not persisted anymore
+            disablenodepaging("Local cache not current");
             return;
         }
 
@@ -4080,6 +4215,9 @@ void MegaClient::updatesc()
         if (complete)
         {
             // 3. write new or modified nodes, purge deleted nodes
+            vector<uint32_t> deleted;
+            vector<Cachable*> modified;
+
             for (node_vector::iterator it = nodenotify.begin(); it != nodenotify.end(); it++)
             {
                 char base64[12];
@@ -4088,18 +4226,33 @@ void MegaClient::updatesc()
                     if ((*it)->dbid)
                     {
                         LOG_verbose << "Removing node from database: " << (Base64::btoa((byte*)&((*it)->nodehandle),MegaClient::NODEHANDLE,base64) ? base64 : "");
-                        if (!(complete = sctable->del((*it)->dbid)))
-                        {
-                            break;
-                        }
+                        deleted.push_back((*it)->dbid);
                     }
                 }
                 else
                 {
                     LOG_verbose << "Adding node to database: " << (Base64::btoa((byte*)&((*it)->nodehandle),MegaClient::NODEHANDLE,base64) ? base64 : "");
-                    if (!(complete = sctable->put(CACHEDNODE, *it, &key)))
+                    modified.push_back(*it);
+                }
+            }
+
+            if (deleted.size())
+            {
+                complete = sctable->delmany(&deleted[0], deleted.size());
+            }
+
+            if (complete && modified.size())
+            {
+                complete = sctable->putmany(CACHEDNODE, &modified[0], modified.size(), &key);
+            }
+
+            if (nodepagingready)
+            {
+                for (node_vector::iterator it = nodenotify.begin(); complete && it != nodenotify.end(); it++)
+                {
+                    if (!(*it)->changed.removed)
                     {
-                        break;
+                        complete = putnodekeys(*it);
                     }
                 }
             }
@@ -4161,9 +4314,12 @@ void MegaClient::finalizesc(bool complete)
     if (complete)
     {
         Base64::atob(scsn, (byte*)&cachedscsn, sizeof cachedscsn);
+        scdirty = true;
     }
     else
     {
+        disablenodepaging("Local cache write error");
+
         sctable->remove();
 
         LOG_err << "Cache update DB write error - disabling caching";
@@ -4171,6 +4327,48 @@ void MegaClient::finalizesc(bool complete)
         delete sctable;
         sctable = NULL;
         pendingsccommit = false;
+        pendingdbcommits.clear();
+    }
+}
+
+// commit the state cache (with a write-behind table, the commit is only
+// queued and notifydbcommit() defers the notification until it is durable)
+void MegaClient::commitsc()
+{
+    sctable->commit();
+    sctable->begin();
+    pendingsccommit = false;
+    scdirty = false;
+}
+
+// report the last commit of the state cache to the app
+void MegaClient::notifydbcommit()
+{
+    if (sctable && sctable->durableseq() < sctable->commitseq())
+    {
+        pendingdbcommits.push_back(std::pair<uint64_t, string>(sctable->commitseq(), scsn));
+        return;
+    }
+
+    dbcommitscsn = scsn;
+    app->notify_dbcommit();
+}
+
+// report the queued commits that have become durable
+void MegaClient::checkdbcommits()
+{
+    if (!sctable || pendingdbcommits.empty())
+    {
+        return;
+    }
+
+    uint64_t seq = sctable->durableseq();
+
+    while (pendingdbcommits.size() && pendingdbcommits.front().first <= seq)
+    {
+        dbcommitscsn = pendingdbcommits.front().second;
+        pendingdbcommits.pop_front();
+        app->notify_dbcommit();
     }
 }
 
@@ -4318,7 +4516,8 @@ void MegaClient::putfa(handle th, fatype t, SymmCipher* key, string* data, bool
 // has the limit of concurrent transfer tslots been reached?
 bool MegaClient::slotavail() const
 {
-    return tslots.size() < MAXTOTALTRANSFERS;
+    // small-file uploads take additional slots
+    return tslots.size() < (batchsmalluploads ? MAXTOTALTRANSFERS + MAXSMALLUPLOADS - MAXTRANSFERS : MAXTOTALTRANSFERS);
 }
 
 // returns 1 if more transfers of the requested type can be dispatched
@@ -4349,7 +4548,15 @@ bool MegaClient::moretransfers(direction_t d)
 
     if (total >= MAXTRANSFERS)
     {
-        return false;
+        // small-file upload mode: keep going while the uploads in progress
+        // are small, so that the upload URLs are requested in bulk
+        if (d != PUT || !batchsmalluploads || total >= MAXSMALLUPLOADS
+                || r > (m_off_t)total * SMALLUPLOADSIZE)
+        {
+            return false;
+        }
+
+        return true;
     }
 
     m_off_t speed = (d == GET) ? httpio->downloadSpeed : httpio->uploadSpeed;
@@ -5897,9 +6104,19 @@ Node* MegaClient::nodebyhandle(handle h)
 
     if ((it = nodes.find(h)) != nodes.end())
     {
+        if (nodepaging)
+        {
+            nodelru.splice(nodelru.begin(), nodelru, it->second->lru_it);
+        }
+
         return it->second;
     }
 
+    if (nodepagingready && !ISUNDEF(h))
+    {
+        return loadnode(h);
+    }
+
     return NULL;
 }
 
@@ -5990,6 +6207,7 @@ error MegaClient::setattr(Node* n, const char *prevattr)
 
     n->changed.attrs = true;
     n->tag = reqtag;
+    n->reindexname();
     notifynode(n);
 
     reqs.add(new CommandSetAttr(this, n, cipher, prevattr));
@@ -6003,6 +6221,74 @@ void MegaClient::putnodes(handle h, NewNode* newnodes, int numnodes)
     reqs.add(new CommandPutNodes(this, h, NULL, newnodes, numnodes, reqtag));
 }
 
+void MegaClient::queueputnodes(NewNode* newnode, handle h, int tag)
+{
+    vector<pair<NewNode*, int> >& batch = batchedputnodes[h];
+
+    batch.push_back(pair<NewNode*, int>(newnode, tag));
+
+    if (batch.size() >= MAX_NEWNODES)
+    {
+        sendbatchedputnodes(h);
+    }
+}
+
+void MegaClient::execbatchedputnodes()
+{
+    while (batchedputnodes.size())
+    {
+        sendbatchedputnodes(batchedputnodes.begin()->first);
+    }
+}
+
+// one putnodes for the completed uploads to a folder, the results are
+// reported per transfer
+void MegaClient::sendbatchedputnodes(handle h)
+{
+    std::map<handle, vector<pair<NewNode*, int> > >::iterator it = batchedputnodes.find(h);
+
+    if (it == batchedputnodes.end())
+    {
+        return;
+    }
+
+    vector<pair<NewNode*, int> >& batch = it->second;
+    int numnodes = int(batch.size());
+    NewNode* newnodes = new NewNode[numnodes];
+    vector<int> tags(numnodes);
+
+    for (int i = 0; i < numnodes; i++)
+    {
+        newnodes[i] = *batch[i].first;
+        tags[i] = batch[i].second;
+
+        // the attribute string is now owned by the batch
+        batch[i].first->attrstring = NULL;
+        delete [] batch[i].first;
+    }
+
+    batchedputnodes.erase(it);
+
+    if (Waiter::ds - lastbatcheduploads > 100)
+    {
+        batcheduploads = 0;
+        batcheduploadsstart = Waiter::ds;
+    }
+
+    batcheduploads += numnodes;
+    lastbatcheduploads = Waiter::ds;
+    Metrics::add(Metrics::UPLOADS_BATCHED, numnodes);
+
+    dstime elapsed = Waiter::ds - batcheduploadsstart;
+
+    LOG_debug << "Coalesced putnodes of " << numnodes << " uploads. Throughput: "
+              << (elapsed ? batcheduploads * 10 / elapsed : batcheduploads) << " files/s";
+
+    CommandPutNodes* cmd = new CommandPutNodes(this, h, NULL, newnodes, numnodes, 0);
+    cmd->settags(&tags);
+    reqs.add(cmd);
+}
+
 // drop nodes into a user's inbox (must have RSA keypair)
 void MegaClient::putnodes(const char* user, NewNode* newnodes, int numnodes)
 {
@@ -6350,299 +6636,481 @@ int MegaClient::readnodes(JSON* j, int notify, putsource_t source, NewNode* nn,
 
     while (j->enterobject())
     {
-        handle h = UNDEF, ph = UNDEF;
-        handle u = 0, su = UNDEF;
-        nodetype_t t = TYPE_UNKNOWN;
-        const char* a = NULL;
-        const char* k = NULL;
-        const char* fa = NULL;
-        const char *sk = NULL;
-        accesslevel_t rl = ACCESS_UNKNOWN;
-        m_off_t s = NEVER;
-        m_time_t ts = -1, sts = -1;
-        nameid name;
-        int nni = -1;
+        if (!readnode(j, notify, source, nn, nnsize, tag, &dp))
+        {
+            return 0;
+        }
+    }
 
-        while ((name = j->getnameid()) != EOO)
+    // any child nodes that arrived before their parents?
+    for (int i = dp.size(); i--; )
+    {
+        if ((n = nodebyhandle(dp[i]->parenthandle)))
         {
-            switch (name)
-            {
-                case 'h':   // new node: handle
-                    h = j->gethandle();
-                    break;
+            dp[i]->setparent(n);
+        }
+    }
 
-                case 'p':   // parent node
-                    ph = j->gethandle();
-                    break;
+    return j->leavearray();
+}
 
-                case 'u':   // owner user
-                    u = j->gethandle(USERHANDLE);
-                    break;
+// process the (entered) object of a single node
+// nodes whose parent is not known yet are added to dp
+bool MegaClient::readnode(JSON* j, int notify, putsource_t source, NewNode* nn, int nnsize, int tag, node_vector* dp)
+{
+    Node* n;
 
-                case 't':   // type
-                    t = (nodetype_t)j->getint();
-                    break;
+    handle h = UNDEF, ph = UNDEF;
+    handle u = 0, su = UNDEF;
+    nodetype_t t = TYPE_UNKNOWN;
+    const char* a = NULL;
+    const char* k = NULL;
+    const char* fa = NULL;
+    const char *sk = NULL;
+    accesslevel_t rl = ACCESS_UNKNOWN;
+    m_off_t s = NEVER;
+    m_time_t ts = -1, sts = -1;
+    nameid name;
+    int nni = -1;
 
-                case 'a':   // attributes
-                    a = j->getvalue();
-                    break;
+    while ((name = j->getnameid()) != EOO)
+    {
+        switch (name)
+        {
+            case 'h':   // new node: handle
+                h = j->gethandle();
+                break;
 
-                case 'k':   // key(s)
-                    k = j->getvalue();
-                    break;
+            case 'p':   // parent node
+                ph = j->gethandle();
+                break;
 
-                case 's':   // file size
-                    s = j->getint();
-                    break;
+            case 'u':   // owner user
+                u = j->gethandle(USERHANDLE);
+                break;
 
-                case 'i':   // related source NewNode index
-                    nni = int(j->getint());
-                    break;
+            case 't':   // type
+                t = (nodetype_t)j->getint();
+                break;
 
-                case MAKENAMEID2('t', 's'):  // actual creation timestamp
-                    ts = j->getint();
-                    break;
+            case 'a':   // attributes
+                a = j->getvalue();
+                break;
 
-                case MAKENAMEID2('f', 'a'):  // file attributes
-                    fa = j->getvalue();
-                    break;
+            case 'k':   // key(s)
+                k = j->getvalue();
+                break;
 
-                    // inbound share attributes
-                case 'r':   // share access level
-                    rl = (accesslevel_t)j->getint();
-                    break;
+            case 's':   // file size
+                s = j->getint();
+                break;
 
-                case MAKENAMEID2('s', 'k'):  // share key
-                    sk = j->getvalue();
-                    break;
+            case 'i':   // related source NewNode index
+                nni = int(j->getint());
+                break;
 
-                case MAKENAMEID2('s', 'u'):  // sharing user
-                    su = j->gethandle(USERHANDLE);
-                    break;
+            case MAKENAMEID2('t', 's'):  // actual creation timestamp
+                ts = j->getint();
+                break;
 
-                case MAKENAMEID3('s', 't', 's'):  // share timestamp
-                    sts = j->getint();
-                    break;
+            case MAKENAMEID2('f', 'a'):  // file attributes
+                fa = j->getvalue();
+                break;
 
-                default:
-                    if (!j->storeobject())
-                    {
-                        return 0;
-                    }
-            }
+                // inbound share attributes
+            case 'r':   // share access level
+                rl = (accesslevel_t)j->getint();
+                break;
+
+            case MAKENAMEID2('s', 'k'):  // share key
+                sk = j->getvalue();
+                break;
+
+            case MAKENAMEID2('s', 'u'):  // sharing user
+                su = j->gethandle(USERHANDLE);
+                break;
+
+            case MAKENAMEID3('s', 't', 's'):  // share timestamp
+                sts = j->getint();
+                break;
+
+            default:
+                if (!j->storeobject())
+                {
+                    return false;
+                }
         }
+    }
 
-        if (ISUNDEF(h))
+    if (ISUNDEF(h))
+    {
+        warn("Missing node handle");
+    }
+    else
+    {
+        if (t == TYPE_UNKNOWN)
         {
-            warn("Missing node handle");
+            warn("Unknown node type");
         }
-        else
+        else if (t == FILENODE || t == FOLDERNODE)
         {
-            if (t == TYPE_UNKNOWN)
+            if (ISUNDEF(ph))
             {
-                warn("Unknown node type");
+                warn("Missing parent");
             }
-            else if (t == FILENODE || t == FOLDERNODE)
+            else if (!a)
             {
-                if (ISUNDEF(ph))
-                {
-                    warn("Missing parent");
-                }
-                else if (!a)
-                {
-                    warn("Missing node attributes");
-                }
-                else if (!k)
-                {
-                    warn("Missing node key");
-                }
+                warn("Missing node attributes");
+            }
+            else if (!k)
+            {
+                warn("Missing node key");
+            }
 
-                if (t == FILENODE && ISUNDEF(s))
-                {
-                    warn("File node without file size");
-                }
+            if (t == FILENODE && ISUNDEF(s))
+            {
+                warn("File node without file size");
             }
         }
+    }
 
-        if (fa && t != FILENODE)
-        {
-            warn("Spurious file attributes");
-        }
+    if (fa && t != FILENODE)
+    {
+        warn("Spurious file attributes");
+    }
 
-        if (!warnlevel())
+    if (!warnlevel())
+    {
+        if ((n = nodebyhandle(h)))
         {
-            if ((n = nodebyhandle(h)))
+            Node* p = NULL;
+            if (!ISUNDEF(ph))
+            {
+                p = nodebyhandle(ph);
+            }
+
+            if (n->changed.removed)
             {
-                Node* p = NULL;
-                if (!ISUNDEF(ph))
+                // node marked for deletion is being resurrected, possibly
+                // with a new parent (server-client move operation)
+                n->changed.removed = false;
+            }
+            else
+            {
+                // node already present - check for race condition
+                if ((n->parent && ph != n->parent->nodehandle && p &&  p->type != FILENODE) || n->type != t)
                 {
-                    p = nodebyhandle(ph);
+                    app->reload("Node inconsistency");
+
+                    static bool reloadnotified = false;
+                    if (!reloadnotified)
+                    {
+                        int creqtag = reqtag;
+                        reqtag = 0;
+                        sendevent(99437, "Node inconsistency");
+                        reqtag = creqtag;
+                        reloadnotified = true;
+                    }
                 }
+            }
 
-                if (n->changed.removed)
+            if (!ISUNDEF(ph))
+            {
+                if (p)
                 {
-                    // node marked for deletion is being resurrected, possibly
-                    // with a new parent (server-client move operation)
-                    n->changed.removed = false;
+                    n->setparent(p);
+                    n->changed.parent = true;
                 }
                 else
                 {
-                    // node already present - check for race condition
-                    if ((n->parent && ph != n->parent->nodehandle && p &&  p->type != FILENODE) || n->type != t)
-                    {
-                        app->reload("Node inconsistency");
+                    n->setparent(NULL);
+                    n->parenthandle = ph;
+                    dp->push_back(n);
+                }
+            }
 
-                        static bool reloadnotified = false;
-                        if (!reloadnotified)
-                        {
-                            int creqtag = reqtag;
-                            reqtag = 0;
-                            sendevent(99437, "Node inconsistency");
-                            reqtag = creqtag;
-                            reloadnotified = true;
-                        }
-                    }
+            if (a && k && n->attrstring)
+            {
+                LOG_warn << "Updating the key of a NO_KEY node";
+                Node::copystring(n->attrstring, a);
+                Node::copystring(&n->nodekey, k);
+            }
+        }
+        else
+        {
+            byte buf[SymmCipher::KEYLENGTH];
+
+            if (!ISUNDEF(su))
+            {
+                if (t != FOLDERNODE)
+                {
+                    warn("Invalid share node type");
                 }
 
-                if (!ISUNDEF(ph))
+                if (rl == ACCESS_UNKNOWN)
                 {
-                    if (p)
-                    {
-                        n->setparent(p);
-                        n->changed.parent = true;
-                    }
-                    else
-                    {
-                        n->setparent(NULL);
-                        n->parenthandle = ph;
-                        dp.push_back(n);
-                    }
+                    warn("Missing access level");
                 }
 
-                if (a && k && n->attrstring)
+                if (!sk)
                 {
-                    LOG_warn << "Updating the key of a NO_KEY node";
-                    Node::copystring(n->attrstring, a);
-                    Node::copystring(&n->nodekey, k);
+                    LOG_warn << "Missing share key for inbound share";
                 }
-            }
-            else
-            {
-                byte buf[SymmCipher::KEYLENGTH];
 
-                if (!ISUNDEF(su))
+                if (warnlevel())
+                {
+                    su = UNDEF;
+                }
+                else
                 {
-                    if (t != FOLDERNODE)
+                    if (sk)
                     {
-                        warn("Invalid share node type");
+                        decryptkey(sk, buf, sizeof buf, &key, 1, h);
                     }
+                }
+            }
 
-                    if (rl == ACCESS_UNKNOWN)
-                    {
-                        warn("Missing access level");
-                    }
+            string fas;
 
-                    if (!sk)
-                    {
-                        LOG_warn << "Missing share key for inbound share";
-                    }
+            Node::copystring(&fas, fa);
+
+            // fallback timestamps
+            if (!(ts + 1))
+            {
+                ts = m_time();
+            }
+
+            if (!(sts + 1))
+            {
+                sts = ts;
+            }
+
+            n = new Node(this, dp, h, ph, t, s, u, fas.c_str(), ts);
+
+            n->tag = tag;
+
+            n->attrstring = new string;
+            Node::copystring(n->attrstring, a);
+            Node::copystring(&n->nodekey, k);
 
-                    if (warnlevel())
+            if (!ISUNDEF(su))
+            {
+                newshares.push_back(new NewShare(h, 0, su, rl, sts, sk ? buf : NULL));
+            }
+
+            if (nn && nni >= 0 && nni < nnsize)
+            {
+                nn[nni].added = true;
+                nn[nni].addedhandle = h;
+
+#ifdef ENABLE_SYNC
+                if (source == PUTNODES_SYNC)
+                {
+                    if (nn[nni].localnode)
                     {
-                        su = UNDEF;
+                        // overwrites/updates: associate LocalNode with newly created Node
+                        nn[nni].localnode->setnode(n);
+                        nn[nni].localnode->newnode = NULL;
+                        nn[nni].localnode->treestate(TREESTATE_SYNCED);
+
+                        // updates cache with the new node associated
+                        nn[nni].localnode->sync->statecacheadd(nn[nni].localnode);
                     }
-                    else
+                }
+#endif
+
+                if (nn[nni].source == NEW_UPLOAD)
+                {
+                    handle uh = nn[nni].uploadhandle;
+
+                    // do we have pending file attributes for this upload? set them.
+                    for (fa_map::iterator it = pendingfa.lower_bound(pair<handle, fatype>(uh, 0));
+                         it != pendingfa.end() && it->first.first == uh; )
                     {
-                        if (sk)
-                        {
-                            decryptkey(sk, buf, sizeof buf, &key, 1, h);
-                        }
+                        reqs.add(new CommandAttachFA(h, it->first.second, it->second.first, it->second.second));
+                        pendingfa.erase(it++);
                     }
+
+                    // FIXME: only do this for in-flight FA writes
+                    uhnh.insert(pair<handle, handle>(uh, h));
                 }
+            }
+        }
+
+        if (notify)
+        {
+            notifynode(n);
+        }
+    }
+
+    return true;
+}
+
+// true if more data could turn ptr into token
+static bool fnstreamprefix(const char* ptr, const char* token)
+{
+    size_t len = strlen(ptr);
 
-                string fas;
+    return len < strlen(token) && !memcmp(ptr, token, len);
+}
+
+// process the node arrays of the fetchnodes response while it is being received
+// - only if the fetchnodes result is the first one of the response
+// - complete node objects are added and purged from the request buffer
+// upon completion (final), the consumed input minus the nodes is put back,
+// so that the response can be processed normally
+void MegaClient::procfnstream(HttpReq* req, bool final)
+{
+    const char* start = req->in.c_str() + req->inpurge;
+    const char* ptr = start;
+    const char* end;
+    bool wait = false;
+    int numnodes = 0;
 
-                Node::copystring(&fas, fa);
+    if (!final && req->size() == fnstreamsize)
+    {
+        return;
+    }
 
-                // fallback timestamps
-                if (!(ts + 1))
+    while (!wait && fnstream != FNSTREAM_DONE)
+    {
+        switch (fnstream)
+        {
+            case FNSTREAM_START:
+                if (!*ptr)
                 {
-                    ts = m_time();
+                    wait = true;
                 }
-
-                if (!(sts + 1))
+                else if (*ptr == '[')
                 {
-                    sts = ts;
+                    fnstreamhead.append(ptr++, 1);
+                    fnstream = FNSTREAM_RESULTS;
                 }
+                else
+                {
+                    fnstream = FNSTREAM_DONE;
+                }
+                break;
 
-                n = new Node(this, &dp, h, ph, t, s, u, fas.c_str(), ts);
-
-                n->tag = tag;
-
-                n->attrstring = new string;
-                Node::copystring(n->attrstring, a);
-                Node::copystring(&n->nodekey, k);
+            case FNSTREAM_RESULTS:
+                // the fetchnodes result starts with its node array - it is
+                // only streamed if it is the first one: the results of earlier
+                // commands must be processed before the nodes are purged
+                if (!strncmp(ptr, "{\"f\":[", 6))
+                {
+                    LOG_debug << "Processing fetchnodes response while receiving it";
+                    purgenodesusersabortsc();
+                    fnstreampurged = true;
 
-                if (!ISUNDEF(su))
+                    fnstreamhead.append(ptr, 6);
+                    ptr += 6;
+                    fnstream = FNSTREAM_NODES;
+                }
+                else if (!final && fnstreamprefix(ptr, "{\"f\":["))
                 {
-                    newshares.push_back(new NewShare(h, 0, su, rl, sts, sk ? buf : NULL));
+                    wait = true;
                 }
-
-                if (nn && nni >= 0 && nni < nnsize)
+                else
                 {
-                    nn[nni].added = true;
+                    fnstream = FNSTREAM_DONE;
+                }
+                break;
 
-#ifdef ENABLE_SYNC
-                    if (source == PUTNODES_SYNC)
+            case FNSTREAM_NODES:
+                if (*ptr == '{')
+                {
+                    if (!(end = JSON::valueend(ptr)))
                     {
-                        if (nn[nni].localnode)
-                        {
-                            // overwrites/updates: associate LocalNode with newly created Node
-                            nn[nni].localnode->setnode(n);
-                            nn[nni].localnode->newnode = NULL;
-                            nn[nni].localnode->treestate(TREESTATE_SYNCED);
+                        wait = !final;
+                        fnstream = final ? FNSTREAM_DONE : fnstream;
+                        break;
+                    }
 
-                            // updates cache with the new node associated
-                            nn[nni].localnode->sync->statecacheadd(nn[nni].localnode);
-                        }
+                    JSON j;
+                    j.begin(ptr);
+
+                    if (!j.enterobject() || !readnode(&j, 0, PUTNODES_APP, NULL, 0, 0, &fnstreamdp)
+                            || !j.leaveobject() || j.pos != end)
+                    {
+                        // leave the error to the regular processing of the response
+                        fnstream = FNSTREAM_DONE;
+                        break;
                     }
-#endif
 
-                    if (nn[nni].source == NEW_UPLOAD)
+                    numnodes++;
+                    ptr = end;
+                }
+                else if (*ptr == ',')
+                {
+                    ptr++;
+                }
+                else if (*ptr == ']')
+                {
+                    // any child nodes that arrived before their parents?
+                    for (int i = fnstreamdp.size(); i--; )
                     {
-                        handle uh = nn[nni].uploadhandle;
+                        Node* n;
 
-                        // do we have pending file attributes for this upload? set them.
-                        for (fa_map::iterator it = pendingfa.lower_bound(pair<handle, fatype>(uh, 0));
-                             it != pendingfa.end() && it->first.first == uh; )
+                        if ((n = nodebyhandle(fnstreamdp[i]->parenthandle)))
                         {
-                            reqs.add(new CommandAttachFA(h, it->first.second, it->second.first, it->second.second));
-                            pendingfa.erase(it++);
+                            fnstreamdp[i]->setparent(n);
                         }
-
-                        // FIXME: only do this for in-flight FA writes
-                        uhnh.insert(pair<handle, handle>(uh, h));
                     }
+
+                    fnstreamdp.clear();
+                    fnstreamhead.append(ptr++, 1);
+                    fnstream = FNSTREAM_KEYS;
                 }
-            }
+                else
+                {
+                    wait = !*ptr && !final;
+                    fnstream = wait ? fnstream : FNSTREAM_DONE;
+                }
+                break;
 
-            if (notify)
-            {
-                notifynode(n);
-            }
+            case FNSTREAM_KEYS:
+                // old versions follow the nodes, any other element ends the stream
+                if (!strncmp(ptr, ",\"f2\":[", 7))
+                {
+                    fnstreamhead.append(ptr, 7);
+                    ptr += 7;
+                    fnstream = FNSTREAM_NODES;
+                }
+                else if (!final && fnstreamprefix(ptr, ",\"f2\":["))
+                {
+                    wait = true;
+                }
+                else
+                {
+                    fnstream = FNSTREAM_DONE;
+                }
+                break;
         }
     }
 
-    // any child nodes that arrived before their parents?
-    for (int i = dp.size(); i--; )
+    if (numnodes)
     {
-        if ((n = nodebyhandle(dp[i]->parenthandle)))
-        {
-            dp[i]->setparent(n);
-        }
+        LOG_verbose << "Nodes processed from partial fetchnodes response: " << numnodes;
     }
 
-    return j->leavearray();
+    req->purge(ptr - start);
+    fnstreamsize = req->size();
+
+    if (final && fnstreamhead.size())
+    {
+        req->in.replace(0, req->inpurge, fnstreamhead);
+        req->inpurge = 0;
+        fnstreamhead.clear();
+    }
+}
+
+void MegaClient::resetfnstream()
+{
+    fnstream = FNSTREAM_START;
+    fnstreamhead.clear();
+    fnstreamdp.clear();
+    fnstreamsize = 0;
+    fnstreampurged = false;
 }
 
 // decrypt and set encrypted sharekey
@@ -7040,17 +7508,173 @@ void MegaClient::procph(JSON *j)
     }
 }
 
+// symmetric node key to unwrap on a worker thread
+struct NodeKeyJob
+{
+    Node* node;
+    const char* key;
+    SymmCipher* cipher;
+    bool decrypted;
+};
+
+struct NodeKeyBatch
+{
+    NodeKeyJob* jobs;
+    size_t numjobs;
+};
+
+// base64 decoding, key unwrapping and attribute decryption/parsing of a
+// slice of nodes - only the nodes of the slice are modified
+static void* nodekeythread(void* param)
+{
+    NodeKeyBatch* batch = (NodeKeyBatch*)param;
+
+    // private copies of the unwrapping keys (Crypto++ mode objects are
+    // stateful and must not be shared between threads)
+    std::map<SymmCipher*, SymmCipher*> ciphers;
+    SymmCipher nodecipher;
+    byte key[FILENODEKEYLENGTH];
+
+    for (size_t i = 0; i < batch->numjobs; i++)
+    {
+        NodeKeyJob* job = batch->jobs + i;
+        Node* n = job->node;
+        int keylength = (n->type == FILENODE) ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH;
+
+        if (Base64::atob(job->key, key, keylength) != keylength)
+        {
+            LOG_warn << "Corrupt or invalid symmetric node key";
+            continue;
+        }
+
+        SymmCipher*& cipher = ciphers[job->cipher];
+
+        if (!cipher)
+        {
+            cipher = new SymmCipher();
+            cipher->setkey(job->cipher->key);
+        }
+
+        cipher->ecb_decrypt(key, keylength);
+        n->nodekey.assign((const char*)key, keylength);
+
+        if (n->attrstring && nodecipher.setkey(&n->nodekey))
+        {
+            job->decrypted = n->decryptattrs(&nodecipher);
+        }
+    }
+
+    for (std::map<SymmCipher*, SymmCipher*>::iterator it = ciphers.begin(); it != ciphers.end(); it++)
+    {
+        delete it->second;
+    }
+
+    return NULL;
+}
+
 int MegaClient::applykeys()
 {
     int t = 0;
+    vector<NodeKeyJob> jobs;
+
+    // with node paging, findkey() can fault share nodes in, which invalidates
+    // node_map iterators - walk a copy of the resident set
+    node_vector resident;
+    resident.reserve(nodes.size());
 
     // FIXME: rather than iterating through the whole node set, maintain subset
     // with missing keys
     for (node_map::iterator it = nodes.begin(); it != nodes.end(); it++)
     {
-        if (it->second->applykey())
+        resident.push_back(it->second);
+    }
+
+    for (node_vector::iterator it = resident.begin(); it != resident.end(); it++)
+    {
+        Node* n = *it;
+        const char* k;
+        SymmCipher* sc;
+
+        if (!n->findkey(&k, &sc))
+        {
+            continue;
+        }
+
+        t++;
+
+        // RSA-encrypted keys are decrypted and queued for rewriting on this thread
+        if (nodekeythreads && strcspn(k, "\"/") <= 4 * FILENODEKEYLENGTH / 3 + 1)
+        {
+            NodeKeyJob job;
+
+            job.node = n;
+            job.key = k;
+            job.cipher = sc;
+            job.decrypted = false;
+
+            jobs.push_back(job);
+        }
+        else
+        {
+            n->applykey();
+        }
+    }
+
+    if (jobs.size())
+    {
+        // not worth a thread for small batches (e.g. key updates from action packets)
+        size_t numthreads = jobs.size() / NODEKEYS_PER_THREAD;
+
+        if (numthreads > (size_t)nodekeythreads)
+        {
+            numthreads = nodekeythreads;
+        }
+
+        if (numthreads < 2)
         {
-            t++;
+            for (size_t i = 0; i < jobs.size(); i++)
+            {
+                jobs[i].node->applykey();
+            }
+        }
+        else
+        {
+            LOG_debug << "Decrypting " << jobs.size() << " node keys with " << numthreads << " threads";
+
+            vector<NodeKeyBatch> batches(numthreads);
+            vector<THREAD_CLASS*> threads;
+
+            for (size_t i = 0; i < numthreads; i++)
+            {
+                batches[i].jobs = &jobs[i * jobs.size() / numthreads];
+                batches[i].numjobs = (i + 1) * jobs.size() / numthreads - i * jobs.size() / numthreads;
+            }
+
+            // the last slice is processed by this thread
+            for (size_t i = 0; i + 1 < numthreads; i++)
+            {
+                THREAD_CLASS* thread = new THREAD_CLASS();
+                threads.push_back(thread);
+                thread->start(nodekeythread, &batches[i]);
+            }
+
+            nodekeythread(&batches[numthreads - 1]);
+
+            for (size_t i = 0; i < threads.size(); i++)
+            {
+                threads[i]->join();
+                delete threads[i];
+            }
+
+            // the fingerprint index is only updated by the SDK thread
+            for (size_t i = 0; i < jobs.size(); i++)
+            {
+                if (jobs[i].decrypted)
+                {
+                    jobs[i].node->setfingerprint();
+                    jobs[i].node->reindexname();
+                }
+            }
         }
     }
 
@@ -7429,6 +8053,16 @@ void MegaClient::opensctable()
         {
             sctable = dbaccess->open(fsaccess, &dbname);
             pendingsccommit = false;
+
+            if (sctable && asyncsccommit)
+            {
+                sctable = new AsyncDbTable(sctable, waiter);
+            }
+
+            if (sctable && nodepaging && !sctable->enablenodepaging())
+            {
+                LOG_warn << "Node paging is not supported by the local cache";
+            }
         }
     }
 }
@@ -7760,6 +8394,8 @@ void MegaClient::proctree(Node* n, TreeProc* tp, bool skipinshares, bool skipver
 {
     if (!skipversions || n->type != FILENODE)
     {
+        loadchildren(n);
+
         for (node_list::iterator it = n->children.begin(); it != n->children.end(); )
         {
             Node *child = *it++;
@@ -8206,6 +8842,12 @@ void MegaClient::notifynode(Node* n)
 {
     n->applykey();
 
+    if (n->parent)
+    {
+        // sort keys (size, timestamps, attributes) may have changed
+        n->parent->childrenchanged();
+    }
+
     if (!fetchingnodes)
     {
         if (n->tag && !n->changed.removed && n->attrstring)
@@ -8245,6 +8887,18 @@ void MegaClient::notifynode(Node* n)
         }
 
 #ifdef ENABLE_SYNC
+        // remote changes have to be reconciled where the node was and where
+        // it is now
+        if (n->localnode)
+        {
+            n->localnode->setsyncdirty();
+        }
+
+        if (n->parent && n->parent->localnode)
+        {
+            n->parent->localnode->setsyncdirty();
+        }
+
         // is this a synced node that was moved to a non-synced location? queue for
         // deletion from LocalNodes.
         if (n->localnode && n->localnode->parent && n->parent && !n->parent->localnode)
@@ -9481,105 +10135,453 @@ void MegaClient::setkeypair()
                                       pubks.size()));
 }
 
-bool MegaClient::fetchsc(DbTable* sctable)
+// instantiate a decrypted state cache record (node records can be passed
+// already decoded)
+bool MegaClient::fetchscrecord(uint32_t id, string* data, NodeRecord* record, node_vector* dp)
 {
-    uint32_t id;
-    string data;
     Node* n;
     User* u;
     PendingContactRequest* pcr;
-    node_vector dp;
 
-    LOG_info << "Loading session from local cache";
+    switch (id & 15)
+    {
+        case CACHEDSCSN:
+            if (data->size() != sizeof cachedscsn)
+            {
+                return false;
+            }
+            break;
 
-    sctable->rewind();
+        case CACHEDNODE:
+            if ((n = record ? record->create(this, dp) : Node::unserialize(this, data, dp)))
+            {
+                n->dbid = id;
+            }
+            else
+            {
+                LOG_err << "Failed - node record read error";
+                return false;
+            }
+            break;
 
-    bool hasNext = sctable->next(&id, &data, &key);
-    WAIT_CLASS::bumpds();
-    fnstats.timeToFirstByte = Waiter::ds - fnstats.startTime;
+        case CACHEDPCR:
+            if ((pcr = PendingContactRequest::unserialize(this, data)))
+            {
+                pcr->dbid = id;
+            }
+            else
+            {
+                LOG_err << "Failed - pcr record read error";
+                return false;
+            }
+            break;
 
-    while (hasNext)
-    {
-        switch (id & 15)
-        {
-            case CACHEDSCSN:
-                if (data.size() != sizeof cachedscsn)
-                {
-                    return false;
-                }
-                break;
+        case CACHEDUSER:
+            if ((u = User::unserialize(this, data)))
+            {
+                u->dbid = id;
+            }
+            else
+            {
+                LOG_err << "Failed - user record read error";
+                return false;
+            }
+            break;
 
-            case CACHEDNODE:
-                if ((n = Node::unserialize(this, &data, &dp)))
+        case CACHEDCHAT:
+#ifdef ENABLE_CHAT
+            {
+                TextChat *chat;
+                if ((chat = TextChat::unserialize(this, data)))
                 {
-                    n->dbid = id;
+                    chat->dbid = id;
                 }
                 else
                 {
-                    LOG_err << "Failed - node record read error";
+                    LOG_err << "Failed - chat record read error";
                     return false;
                 }
-                break;
+            }
+#endif
+            break;
+    }
 
-            case CACHEDPCR:
-                if ((pcr = PendingContactRequest::unserialize(this, &data)))
+    return true;
+}
+
+bool MegaClient::fetchsc(DbTable* sctable)
+{
+    uint32_t id;
+    string data;
+    Node* n;
+    node_vector dp;
+
+    LOG_info << "Loading session from local cache";
+
+    // node paging: only the non-node records are read here
+    bool paged = nodepaging && sctable->nodekeyscomplete(CACHEDNODE);
+
+    error e = fetchsnapshot(sctable, &dp);
+
+    if (e == API_EREAD)
+    {
+        return false;
+    }
+
+    bool snapshot = (e == API_OK);
+
+    if (snapshot)
+    {
+        LOG_info << "Session loaded from state snapshot";
+    }
+    else if (paged)
+    {
+        sctable->rewindskipnodes();
+    }
+    else
+    {
+        sctable->rewind();
+    }
+
+    if (snapshot)
+    {
+        WAIT_CLASS::bumpds();
+        fnstats.timeToFirstByte = Waiter::ds - fnstats.startTime;
+    }
+    else if (nodekeythreads)
+    {
+        // read, decrypt and decode off the SDK thread
+        StateCacheLoader loader(sctable, fsaccess, &key, nodekeythreads);
+        StateCacheBatch* batch;
+        bool end = false;
+
+        while (!end && (batch = loader.next()))
+        {
+            if (fnstats.timeToFirstByte == NEVER)
+            {
+                WAIT_CLASS::bumpds();
+                fnstats.timeToFirstByte = Waiter::ds - fnstats.startTime;
+            }
+
+            for (unsigned i = 0; i < batch->count; i++)
+            {
+                // as with DbTable::next(): an undecryptable record ends the table
+                if (!batch->valid[i])
                 {
-                    pcr->dbid = id;
+                    end = true;
+                    break;
                 }
-                else
+
+                if (!fetchscrecord(batch->ids[i], &batch->data[i], batch->decoded[i] ? &batch->nodes[i] : NULL, &dp))
                 {
-                    LOG_err << "Failed - pcr record read error";
                     return false;
                 }
-                break;
+            }
+
+            if (fnstats.timeToLastByte == NEVER && loader.allread())
+            {
+                WAIT_CLASS::bumpds();
+                fnstats.timeToLastByte = Waiter::ds - fnstats.startTime;
+            }
+        }
+
+        // the workers finish well before the records are linked here
+        WAIT_CLASS::bumpds();
+        fnstats.timeToDecrypted = Waiter::ds - fnstats.startTime;
+
+        int64_t decoded = loader.alldecoded();
+        if (decoded)
+        {
+            fnstats.timeToDecrypted -= dstime((Waiter::us() - decoded) / 100000);
+        }
+    }
+    else
+    {
+        bool hasNext = sctable->next(&id, &data, &key);
+        WAIT_CLASS::bumpds();
+        fnstats.timeToFirstByte = Waiter::ds - fnstats.startTime;
+
+        while (hasNext)
+        {
+            if (!fetchscrecord(id, &data, NULL, &dp))
+            {
+                return false;
+            }
+
+            hasNext = sctable->next(&id, &data, &key);
+        }
+    }
+
+    if (paged)
+    {
+        // top-level and pinned nodes are resident, along with their
+        // ancestors - the rest is faulted in on demand
+        dbnoderecord_vector records;
+
+        nodepagingready = true;
+        if (!sctable->getnodes(DbTable::NODES_TOP, UNDEF, 0, &records))
+        {
+            LOG_err << "Failed - node paging query error";
+            nodepagingready = false;
+            return false;
+        }
+
+        loadnodes(&records);
+        LOG_info << "Node paging: " << nodes.size() << " resident nodes";
+    }
+
+    WAIT_CLASS::bumpds();
+    if (fnstats.timeToLastByte == NEVER)
+    {
+        fnstats.timeToLastByte = Waiter::ds - fnstats.startTime;
+    }
+
+    if (fnstats.timeToDecrypted == NEVER)
+    {
+        fnstats.timeToDecrypted = fnstats.timeToLastByte;
+    }
+
+    LOG_debug << "Local cache stages (ds): first record " << fnstats.timeToFirstByte
+              << ", last record " << fnstats.timeToLastByte
+              << ", decrypted " << fnstats.timeToDecrypted;
+
+    // any child nodes arrived before their parents?
+    for (int i = dp.size(); i--; )
+    {
+        if ((n = nodebyhandle(dp[i]->parenthandle)))
+        {
+            dp[i]->setparent(n);
+        }
+    }
+
+    mergenewshares(0);
+
+    if (nodepaging && !paged)
+    {
+        // cache written without node paging: add the lookup keys
+        bool keyed = true;
+
+        sctable->begin();
+        for (node_map::iterator it = nodes.begin(); keyed && it != nodes.end(); it++)
+        {
+            keyed = putnodekeys(it->second);
+        }
+        sctable->commit();
+
+        nodepagingready = keyed;
+    }
+
+    return true;
+}
+
+// consume the StateSnapshot of the state cache, if it matches the committed
+// records
+error MegaClient::fetchsnapshot(DbTable* sctable, node_vector* dp)
+{
+    string path;
+    StateSnapshot snapshot;
 
+    if (!sctable->snapshotpath(&path))
+    {
+        return API_ENOENT;
+    }
+
+    bool valid = !nodepaging && snapshot.read(fsaccess, path, &key);
+
+    // single use: it becomes stale with the next state cache commit
+    StateSnapshot::remove(fsaccess, path);
+
+    if (!valid)
+    {
+        return API_ENOENT;
+    }
+
+    if (snapshot.header.scsn != cachedscsn || snapshot.header.dbversion != (uint32_t)dbaccess->currentDbVersion)
+    {
+        LOG_debug << "Discarding outdated state snapshot";
+        return API_ENOENT;
+    }
+
+    uint32_t num = snapshot.numrecords();
+
+    for (uint32_t i = 0; i < num; i++)
+    {
+        const StateSnapshot::Record* r = snapshot.record(i);
+        const char* ptr = snapshot.data(r);
+
+        // nodes are unserialized in place, the few other records are copied
+        if ((r->dbid & 15) == CACHEDNODE)
+        {
+            Node* n = Node::unserialize(this, ptr, r->length, dp);
+            if (!n)
+            {
+                LOG_err << "Failed - snapshot node record read error";
+                return API_EREAD;
+            }
+
+            n->dbid = r->dbid;
+            continue;
+        }
+
+        string data(ptr, r->length);
+
+        switch (r->dbid & 15)
+        {
             case CACHEDUSER:
-                if ((u = User::unserialize(this, &data)))
+            {
+                User* u = User::unserialize(this, &data);
+                if (!u)
                 {
-                    u->dbid = id;
+                    LOG_err << "Failed - snapshot user record read error";
+                    return API_EREAD;
                 }
-                else
+
+                u->dbid = r->dbid;
+                break;
+            }
+
+            case CACHEDPCR:
+            {
+                PendingContactRequest* pcr = PendingContactRequest::unserialize(this, &data);
+                if (!pcr)
                 {
-                    LOG_err << "Failed - user record read error";
-                    return false;
+                    LOG_err << "Failed - snapshot pcr record read error";
+                    return API_EREAD;
                 }
+
+                pcr->dbid = r->dbid;
                 break;
+            }
 
-            case CACHEDCHAT:
 #ifdef ENABLE_CHAT
+            case CACHEDCHAT:
+            {
+                TextChat* chat = TextChat::unserialize(this, &data);
+                if (!chat)
                 {
-                    TextChat *chat;
-                    if ((chat = TextChat::unserialize(this, &data)))
-                    {
-                        chat->dbid = id;
-                    }
-                    else
-                    {
-                        LOG_err << "Failed - chat record read error";
-                        return false;
-                    }
+                    LOG_err << "Failed - snapshot chat record read error";
+                    return API_EREAD;
                 }
-#endif
+
+                chat->dbid = r->dbid;
                 break;
+            }
+#endif
         }
-        hasNext = sctable->next(&id, &data, &key);
     }
 
-    WAIT_CLASS::bumpds();
-    fnstats.timeToLastByte = Waiter::ds - fnstats.startTime;
+    // the ids of new records must not collide with the loaded ones
+    sctable->nextid = snapshot.header.nextid;
 
-    // any child nodes arrived before their parents?
-    for (int i = dp.size(); i--; )
+    LOG_debug << "State snapshot: " << num << " records, " << nodes.size() << " nodes";
+    return API_OK;
+}
+
+// only if the in-memory state is exactly the committed state cache
+void MegaClient::writesnapshot()
+{
+    string path;
+
+    if (!sctable || scdirty || fetchingnodes || nodepaging || loggedin() != FULLACCOUNT
+            || ISUNDEF(cachedscsn) || !nodes.size()
+            || nodenotify.size() || usernotify.size() || pcrnotify.size()
+            || !sctable->snapshotpath(&path))
     {
-        if ((n = nodebyhandle(dp[i]->parenthandle)))
+        return;
+    }
+
+    // the snapshot must not get ahead of the database
+    sctable->barrier();
+
+    StateSnapshot snapshot;
+    string d;
+
+    snapshot.header.dbversion = dbaccess->currentDbVersion;
+    snapshot.header.nextid = sctable->nextid;
+    snapshot.header.scsn = cachedscsn;
+
+    for (user_map::iterator it = users.begin(); it != users.end(); it++)
+    {
+        if (it->second.dbid)
         {
-            dp[i]->setparent(n);
+            d.clear();
+            if (!it->second.serialize(&d))
+            {
+                return;
+            }
+
+            snapshot.add(it->second.dbid, &d);
         }
     }
 
-    mergenewshares(0);
+    for (handlepcr_map::iterator it = pcrindex.begin(); it != pcrindex.end(); it++)
+    {
+        if (it->second->dbid)
+        {
+            d.clear();
+            if (!it->second->serialize(&d))
+            {
+                return;
+            }
 
-    return true;
+            snapshot.add(it->second->dbid, &d);
+        }
+    }
+
+#ifdef ENABLE_CHAT
+    for (textchat_map::iterator it = chats.begin(); it != chats.end(); it++)
+    {
+        if (it->second->dbid)
+        {
+            d.clear();
+            if (!it->second->serialize(&d))
+            {
+                return;
+            }
+
+            snapshot.add(it->second->dbid, &d);
+        }
+    }
+#endif
+
+    // nodes breadth-first from the nodes without parent
+    vector<Node*> queue;
+
+    queue.reserve(nodes.size());
+
+    for (node_map::iterator it = nodes.begin(); it != nodes.end(); it++)
+    {
+        if (!it->second->parent)
+        {
+            queue.push_back(it->second);
+        }
+    }
+
+    for (size_t i = 0; i < queue.size(); i++)
+    {
+        Node* n = queue[i];
+
+        if (n->dbid)
+        {
+            d.clear();
+            if (!n->serialize(&d))
+            {
+                return;
+            }
+
+            snapshot.add(n->dbid, &d, n->nodehandle);
+        }
+
+        for (node_list::iterator it = n->children.begin(); it != n->children.end(); it++)
+        {
+            queue.push_back(*it);
+        }
+    }
+
+    if (snapshot.write(fsaccess, path, &key))
+    {
+        LOG_info << "State snapshot saved (" << queue.size() << " nodes)";
+    }
 }
 
 void MegaClient::closetc(bool remove)
@@ -10170,6 +11172,10 @@ void MegaClient::purgenodesusersabortsc()
 {
     app->clearing();
 
+    nodepagingready = false;
+    nodepagingmark = nodepaging;
+    nodesevicted = false;
+
     while (!hdrns.empty())
     {
         delete hdrns.begin()->second;
@@ -10567,7 +11573,11 @@ error MegaClient::addsync(string* rootpath, const char* debris, string* localdeb
             Sync* sync = new Sync(this, rootpath, debris, localdebris, remotenode, fsfp, inshare, tag, appData);
             sync->isnetwork = isnetwork;
 
-            if (sync->scan(rootpath, fa))
+            int64_t scanstart = Waiter::us();
+            bool scanned = sync->scan(rootpath, fa);
+            Metrics::observe(Metrics::SYNC_SCAN_DURATION, Waiter::us() - scanstart);
+
+            if (scanned)
             {
                 syncsup = false;
                 e = API_OK;
@@ -10672,6 +11682,21 @@ void MegaClient::addchild(remotenode_map* nchildren, string* name, Node* n, list
 // returns false if any local fs op failed transiently
 bool MegaClient::syncdown(LocalNode* l, string* localpath, bool rubbish)
 {
+    // skip subtrees that haven't changed on either side since they were last
+    // reconciled (not tracked for passes that don't delete local items)
+    if (rubbish)
+    {
+        if (!l->syncdowndirty)
+        {
+            syncdownskipped++;
+            return true;
+        }
+
+        l->syncdowndirty = false;
+    }
+
+    syncdownvisited++;
+
     // only use for LocalNodes with a corresponding and properly linked Node
     if (l->type != FOLDERNODE || !l->node || (l->parent && l->node->parent->localnode != l->parent))
     {
@@ -10688,6 +11713,8 @@ bool MegaClient::syncdown(LocalNode* l, string* localpath, bool rubbish)
     // remote children by name
     string localname;
 
+    loadchildren(l->node);
+
     // build child hash - nameclash resolution: use newest/largest version
     for (node_list::iterator it = l->node->children.begin(); it != l->node->children.end(); it++)
     {
@@ -10758,7 +11785,13 @@ bool MegaClient::syncdown(LocalNode* l, string* localpath, bool rubbish)
 
                 ll->setnode(rit->second);
 
-                if (*ll == *(FileFingerprint*)rit->second)
+                if (ll->fingerprinting)
+                {
+                    // local change being fingerprinted - not overwritten
+                    LOG_debug << "LocalNode being fingerprinted: " << ll->name;
+                    nchildren.erase(rit);
+                }
+                else if (*ll == *(FileFingerprint*)rit->second)
                 {
                     // both files are identical
                     nchildren.erase(rit);
@@ -11007,6 +12040,12 @@ bool MegaClient::syncdown(LocalNode* l, string* localpath, bool rubbish)
         localpath->resize(t);
     }
 
+    if (!success || nchildren.size())
+    {
+        // retries and transfers in progress: check again in the next pass
+        l->setsyncdowndirty();
+    }
+
     return success;
 }
 
@@ -11020,8 +12059,22 @@ bool MegaClient::syncdown(LocalNode* l, string* localpath, bool rubbish)
 // for creation
 bool MegaClient::syncup(LocalNode* l, dstime* nds)
 {
+    // skip subtrees that haven't changed on either side since they were last
+    // reconciled
+    if (!l->syncupdirty)
+    {
+        syncupskipped++;
+        return true;
+    }
+
+    l->syncupdirty = false;
+    syncupvisited++;
+
     bool insync = true;
 
+    // local items waiting for their upload: check again in the next pass
+    bool pending = false;
+
     list<string> strings;
     remotenode_map nchildren;
     remotenode_map::iterator rit;
@@ -11034,6 +12087,8 @@ bool MegaClient::syncup(LocalNode* l, dstime* nds)
 
     if (l->node)
     {
+        loadchildren(l->node);
+
         // corresponding remote node present: build child hash - nameclash
         // resolution: use newest version
         for (node_list::iterator it = l->node->children.begin(); it != l->node->children.end(); it++)
@@ -11104,6 +12159,15 @@ bool MegaClient::syncup(LocalNode* l, dstime* nds)
         if (ll->deleted)
         {
             LOG_debug << "LocalNode deleted " << ll->name;
+            pending = true;
+            continue;
+        }
+
+        if (ll->fingerprinting)
+        {
+            // taken into account once its fingerprint is known
+            LOG_debug << "LocalNode being fingerprinted " << ll->name;
+            insync = false;
             continue;
         }
 
@@ -11314,6 +12378,7 @@ bool MegaClient::syncup(LocalNode* l, dstime* nds)
                     // recurse into directories of equal name
                     if (!syncup(ll, nds))
                     {
+                        l->setsyncupdirty();
                         return false;
                     }
                     continue;
@@ -11325,6 +12390,7 @@ bool MegaClient::syncup(LocalNode* l, dstime* nds)
         {
             // do not begin transfer until the file size / mtime has stabilized
             insync = false;
+            pending = true;
 
             if (ll->transfer)
             {
@@ -11521,6 +12587,7 @@ bool MegaClient::syncup(LocalNode* l, dstime* nds)
             if (synccreate.size() >= MAX_NEWNODES)
             {
                 LOG_warn << "Stopping syncup due to MAX_NEWNODES";
+                l->setsyncupdirty();
                 return false;
             }
         }
@@ -11529,11 +12596,17 @@ bool MegaClient::syncup(LocalNode* l, dstime* nds)
         {
             if (!syncup(ll, nds))
             {
+                l->setsyncupdirty();
                 return false;
             }
         }
     }
 
+    if (pending)
+    {
+        l->setsyncupdirty();
+    }
+
     if (insync && l->node)
     {
         l->treestate(TREESTATE_SYNCED);
@@ -12248,10 +13321,323 @@ void MegaClient::setmaxconnections(direction_t d, int num)
     }
 }
 
+void MegaClient::setcryptothreads(int num)
+{
+    if (num < 0)
+    {
+        num = 0;
+    }
+    else if ((unsigned int) num > MegaClient::MAX_CRYPTO_THREADS)
+    {
+        num = MegaClient::MAX_CRYPTO_THREADS;
+    }
+
+    if ((chunkcrypto ? chunkcrypto->numthreads() : 0) == num)
+    {
+        return;
+    }
+
+    // jobs already queued are completed by the old pool and collected
+    // by their slots as usual
+    delete chunkcrypto;
+    chunkcrypto = num ? new ChunkCryptoPool(this, num) : NULL;
+}
+
+void MegaClient::updatemetrics()
+{
+    for (int d = GET; d <= API; d++)
+    {
+        HttpConnectionStats stats;
+        httpio->getconnectionstats((direction_t)d, &stats);
+
+        Metrics::set(Metrics::gauge_t(Metrics::HTTP_SOCKETS_GET + d), stats.sockets);
+        Metrics::set(Metrics::gauge_t(Metrics::HTTP_REQUESTS_INFLIGHT_GET + d), stats.requests);
+        Metrics::set(Metrics::gauge_t(Metrics::HTTP_CONNECTS_GET + d), stats.connects);
+        Metrics::set(Metrics::gauge_t(Metrics::HTTP_REQUESTS_DONE_GET + d), stats.completed);
+    }
+
+#ifdef ENABLE_SYNC
+    Metrics::set(Metrics::SYNC_FOLDERS_VISITED_SYNCDOWN, syncdownvisited);
+    Metrics::set(Metrics::SYNC_FOLDERS_VISITED_SYNCUP, syncupvisited);
+    Metrics::set(Metrics::SYNC_FOLDERS_SKIPPED_SYNCDOWN, syncdownskipped);
+    Metrics::set(Metrics::SYNC_FOLDERS_SKIPPED_SYNCUP, syncupskipped);
+#endif
+}
+
+void MegaClient::setnodekeythreads(int num)
+{
+    if (num < 0)
+    {
+        num = 0;
+    }
+    else if ((unsigned int) num > MegaClient::MAX_CRYPTO_THREADS)
+    {
+        num = MegaClient::MAX_CRYPTO_THREADS;
+    }
+
+    nodekeythreads = num;
+}
+
+// node paging can't continue: reload if evicted nodes can't be faulted in
+void MegaClient::disablenodepaging(const char* reason)
+{
+    if (nodepagingready)
+    {
+        LOG_warn << "Node paging disabled: " << reason;
+        nodepagingready = false;
+
+        if (nodesevicted)
+        {
+            app->reload(reason);
+        }
+    }
+}
+
+bool MegaClient::setnodepaging(unsigned maxnodes)
+{
+    if (nodes.size() || sctable)
+    {
+        LOG_warn << "Node paging can only be configured before login";
+        return false;
+    }
+
+    nodepaging = maxnodes;
+    nodepagingmark = maxnodes;
+    return true;
+}
+
+#ifdef ENABLE_SYNC
+void MegaClient::setsyncscanthreads(int num)
+{
+    if (num < 0)
+    {
+        num = 0;
+    }
+    else if ((unsigned int) num > MegaClient::MAX_CRYPTO_THREADS)
+    {
+        num = MegaClient::MAX_CRYPTO_THREADS;
+    }
+
+    syncscanthreads = num;
+}
+
+void MegaClient::setfingerprintthreads(int num)
+{
+    if (num < 0)
+    {
+        num = 0;
+    }
+    else if ((unsigned int) num > MegaClient::MAX_CRYPTO_THREADS)
+    {
+        num = MegaClient::MAX_CRYPTO_THREADS;
+    }
+
+    if ((fingerprintpool ? fingerprintpool->numthreads() : 0) == num)
+    {
+        return;
+    }
+
+    // jobs already queued are completed by the old pool and applied here,
+    // so that no node is left waiting for its fingerprint
+    FingerprintPool* pool = fingerprintpool;
+    fingerprintpool = num ? new FingerprintPool(fsaccess, waiter, num) : NULL;
+
+    if (pool)
+    {
+        pool->stop();
+        checkfingerprints(pool);
+        delete pool;
+    }
+}
+
+void MegaClient::checkfingerprints(FingerprintPool* pool)
+{
+    FingerprintJob* job;
+
+    while ((job = pool->collect()))
+    {
+        job->localnode->sync->fingerprintdone(job);
+        delete job;
+    }
+}
+#endif
+
+bool MegaClient::setasyncsccommit(bool enable)
+{
+    if (sctable)
+    {
+        LOG_warn << "Asynchronous local cache commits can only be configured before login";
+        return false;
+    }
+
+    asyncsccommit = enable;
+    return true;
+}
+
+// keyed hash of the fields compared by FileFingerprintCmp
+uint64_t MegaClient::fingerprinthash(FileFingerprint* fingerprint)
+{
+    string fp;
+
+    fp.append((const char*)&fingerprint->size, sizeof fingerprint->size);
+    fp.append((const char*)&fingerprint->mtime, sizeof fingerprint->mtime);
+    fp.append((const char*)fingerprint->crc, sizeof fingerprint->crc);
+
+    return stringhash64(&fp, &key);
+}
+
+// node paging: store the lookup keys next to the node record
+bool MegaClient::putnodekeys(Node* n)
+{
+    if (!n->dbid)
+    {
+        // not cached (undecryptable)
+        return true;
+    }
+
+    string name = n->displayname();
+    uint64_t namehash = stringhash64(&name, &key);
+    uint64_t fphash = (n->type == FILENODE && n->isvalid) ? fingerprinthash(n) : 0;
+
+    // shared/exported nodes and root nodes are always resident
+    bool pinned = n->inshare || n->outshares || n->pendingshares || n->plink
+            || (n->type != FILENODE && n->type != FOLDERNODE);
+
+    return sctable->putnodekeys(n->dbid, n->nodehandle, n->parent ? n->parent->nodehandle : n->parenthandle,
+                                namehash, fphash, pinned);
+}
+
+// node paging: unserialize node records (resident nodes are skipped, missing
+// ancestors are faulted in by the Node constructor)
+void MegaClient::loadnodes(dbnoderecord_vector* records)
+{
+    node_vector dp;
+
+    for (dbnoderecord_vector::iterator it = records->begin(); it != records->end(); it++)
+    {
+        if (nodes.find(it->h) != nodes.end())
+        {
+            continue;
+        }
+
+        if (!PaddedCBC::decrypt(&it->data, &key))
+        {
+            LOG_err << "Failed - node record decryption error";
+            continue;
+        }
+
+        Node* n = Node::unserialize(this, &it->data, &dp);
+        if (!n)
+        {
+            LOG_err << "Failed - node record read error";
+            continue;
+        }
+
+        n->dbid = it->id;
+        n->childrenloaded = false;
+    }
+}
+
+// node paging: fault a node in from the state cache
+Node* MegaClient::loadnode(handle h)
+{
+    dbnoderecord_vector records;
+
+    if (!sctable->getnodes(DbTable::NODES_BYHANDLE, h, 0, &records) || records.empty())
+    {
+        return NULL;
+    }
+
+    loadnodes(&records);
+
+    node_map::iterator it = nodes.find(h);
+    return it != nodes.end() ? it->second : NULL;
+}
+
+void MegaClient::loadchildren(Node* n)
+{
+    if (!nodepagingready || n->childrenloaded)
+    {
+        return;
+    }
+
+    dbnoderecord_vector records;
+
+    if (sctable->getnodes(DbTable::NODES_CHILDREN, n->nodehandle, 0, &records))
+    {
+        loadnodes(&records);
+        n->childrenloaded = true;
+    }
+}
+
+// a node can be evicted if it is cached unchanged and nothing refers to it
+bool MegaClient::pageable(Node* n)
+{
+    return n->dbid && !n->notified && n->children.empty() && n->parent
+            && (n->type == FILENODE || n->type == FOLDERNODE)
+            && !n->inshare && !n->outshares && !n->pendingshares && !n->plink
+            && !n->attrstring
+            && hdrns.find(n->nodehandle) == hdrns.end()
+#ifdef ENABLE_SYNC
+            && !n->localnode && !n->syncget
+            && n->todebris_it == todebris.end() && n->tounlink_it == tounlink.end()
+#endif
+            ;
+}
+
+// evict least recently used nodes down to the limit - nodes that can't be
+// evicted are moved to the front, and the next eviction is deferred until
+// the resident set has grown by another eighth of the limit
+void MegaClient::pagenodes()
+{
+    if (!nodepagingready || nodes.size() <= nodepagingmark)
+    {
+        return;
+    }
+
+    size_t scan = nodelru.size();
+    size_t evicted = 0;
+
+    while (nodes.size() > nodepaging && scan--)
+    {
+        Node* n = nodelru.back();
+
+        if (!pageable(n))
+        {
+            nodelru.splice(nodelru.begin(), nodelru, n->lru_it);
+            continue;
+        }
+
+        n->parent->childrenloaded = false;
+        nodes.erase(n->nodehandle);
+        delete n;
+        evicted++;
+    }
+
+    if (evicted)
+    {
+        nodesevicted = true;
+    }
+
+    nodepagingmark = std::max(nodes.size(), (size_t)nodepaging) + nodepaging / 8;
+
+    LOG_debug << "Evicted " << evicted << " nodes, " << nodes.size() << " resident";
+}
+
 Node* MegaClient::nodebyfingerprint(FileFingerprint* fingerprint)
 {
     fingerprint_set::iterator it;
 
+    if (nodepagingready)
+    {
+        dbnoderecord_vector records;
+
+        if (sctable->getnodes(DbTable::NODES_BYFINGERPRINT, UNDEF, fingerprinthash(fingerprint), &records))
+        {
+            loadnodes(&records);
+        }
+    }
+
     if ((it = fingerprints.find(fingerprint)) != fingerprints.end())
     {
         return (Node*)*it;
@@ -12262,6 +13648,16 @@ Node* MegaClient::nodebyfingerprint(FileFingerprint* fingerprint)
 
 node_vector *MegaClient::nodesbyfingerprint(FileFingerprint* fingerprint)
 {
+    if (nodepagingready)
+    {
+        dbnoderecord_vector records;
+
+        if (sctable->getnodes(DbTable::NODES_BYFINGERPRINT, UNDEF, fingerprinthash(fingerprint), &records))
+        {
+            loadnodes(&records);
+        }
+    }
+
     node_vector *nodes = new node_vector();
     pair<fingerprint_set::iterator, fingerprint_set::iterator> p = fingerprints.equal_range(fingerprint);
     for (fingerprint_set::iterator it = p.first; it != p.second; it++)
@@ -12536,6 +13932,7 @@ void FetchNodesStats::init()
     startTime = Waiter::ds;
     timeToFirstByte = NEVER;
     timeToLastByte = NEVER;
+    timeToDecrypted = NEVER;
     timeToCached = NEVER;
     timeToResult = NEVER;
     timeToSyncsResumed = NEVER;
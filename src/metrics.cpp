@@ -0,0 +1,316 @@
+/**
+ * @file metrics.cpp
+ * @brief Performance counters and latency histograms
+ *
+ * (c) 2013-2018 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mega/metrics.h"
+
+namespace mega {
+
+// JSON key, Prometheus metric name, Prometheus labels, help text
+struct MetricInfo
+{
+    const char* key;
+    const char* name;
+    const char* labels;
+    const char* help;
+};
+
+static const MetricInfo counterinfo[Metrics::NUMCOUNTERS] = {
+    { "transfer_bytes_get", "mega_transfer_bytes_total", "direction=\"get\"", "Bytes of completed transfer chunks" },
+    { "transfer_bytes_put", "mega_transfer_bytes_total", "direction=\"put\"", NULL },
+    { "transfer_chunk_failures_get", "mega_transfer_chunk_failures_total", "direction=\"get\"", "Failed transfer chunk requests" },
+    { "transfer_chunk_failures_put", "mega_transfer_chunk_failures_total", "direction=\"put\"", NULL },
+    { "uploads_batched", "mega_uploads_batched_total", "", "Uploads whose nodes were created by a coalesced putnodes command" }
+};
+
+// gauges that are client-side totals are exported as Prometheus counters
+static const MetricInfo gaugeinfo[Metrics::NUMGAUGES] = {
+    { "http_sockets_get", "mega_http_sockets", "channel=\"get\"", "Open HTTP connections" },
+    { "http_sockets_put", "mega_http_sockets", "channel=\"put\"", NULL },
+    { "http_sockets_api", "mega_http_sockets", "channel=\"api\"", NULL },
+    { "http_requests_inflight_get", "mega_http_requests_in_flight", "channel=\"get\"", "HTTP requests in progress" },
+    { "http_requests_inflight_put", "mega_http_requests_in_flight", "channel=\"put\"", NULL },
+    { "http_requests_inflight_api", "mega_http_requests_in_flight", "channel=\"api\"", NULL },
+    { "http_connects_get", "mega_http_connects_total", "channel=\"get\"", "HTTP connections established" },
+    { "http_connects_put", "mega_http_connects_total", "channel=\"put\"", NULL },
+    { "http_connects_api", "mega_http_connects_total", "channel=\"api\"", NULL },
+    { "http_requests_done_get", "mega_http_requests_total", "channel=\"get\"", "HTTP requests completed" },
+    { "http_requests_done_put", "mega_http_requests_total", "channel=\"put\"", NULL },
+    { "http_requests_done_api", "mega_http_requests_total", "channel=\"api\"", NULL },
+    { "sync_folders_visited_syncdown", "mega_sync_folders_visited_total", "pass=\"syncdown\"", "Folders visited by sync reconciliation passes" },
+    { "sync_folders_visited_syncup", "mega_sync_folders_visited_total", "pass=\"syncup\"", NULL },
+    { "sync_folders_skipped_syncdown", "mega_sync_folders_skipped_total", "pass=\"syncdown\"", "Unchanged folders skipped by sync reconciliation passes" },
+    { "sync_folders_skipped_syncup", "mega_sync_folders_skipped_total", "pass=\"syncup\"", NULL }
+};
+
+static const MetricInfo histograminfo[Metrics::NUMHISTOGRAMS] = {
+    { "chunk_duration_get_us", "mega_transfer_chunk_duration_microseconds", "direction=\"get\"", "Time from posting a transfer chunk request to its completion" },
+    { "chunk_duration_put_us", "mega_transfer_chunk_duration_microseconds", "direction=\"put\"", NULL },
+    { "chunk_decrypt_us", "mega_transfer_crypto_duration_microseconds", "operation=\"decrypt\"", "Time spent in a transfer chunk decryption or encryption pass" },
+    { "chunk_encrypt_us", "mega_transfer_crypto_duration_microseconds", "operation=\"encrypt\"", NULL },
+    { "api_request_us", "mega_api_request_duration_microseconds", "", "API request round-trip time" },
+    { "api_request_commands", "mega_api_request_commands", "", "Commands batched in an API request" },
+    { "db_commit_us", "mega_db_commit_duration_microseconds", "", "Local cache transaction commit time" },
+    { "sync_scan_us", "mega_sync_scan_duration_microseconds", "", "Full local sync scan time" },
+    { "sync_syncdown_us", "mega_sync_reconcile_duration_microseconds", "pass=\"syncdown\"", "Sync reconciliation pass time" },
+    { "sync_syncup_us", "mega_sync_reconcile_duration_microseconds", "pass=\"syncup\"", NULL }
+};
+
+MUTEX_CLASS Metrics::mutex(false);
+int64_t Metrics::counters[NUMCOUNTERS];
+int64_t Metrics::gauges[NUMGAUGES];
+MetricHistogram Metrics::histograms[NUMHISTOGRAMS];
+
+MetricHistogram::MetricHistogram()
+{
+    memset(buckets, 0, sizeof buckets);
+    count = 0;
+    sum = 0;
+}
+
+void MetricHistogram::add(int64_t value)
+{
+    if (value < 0)
+    {
+        value = 0;
+    }
+
+    int i = 0;
+
+    while (i < NUMBUCKETS && (uint64_t)value > ((uint64_t)1 << i))
+    {
+        i++;
+    }
+
+    if (i < NUMBUCKETS)
+    {
+        buckets[i]++;
+    }
+
+    count++;
+    sum += value;
+}
+
+void Metrics::add(counter_t c, int64_t value)
+{
+    mutex.lock();
+    counters[c] += value;
+    mutex.unlock();
+}
+
+void Metrics::set(gauge_t g, int64_t value)
+{
+    mutex.lock();
+    gauges[g] = value;
+    mutex.unlock();
+}
+
+void Metrics::observe(histogram_t h, int64_t value)
+{
+    mutex.lock();
+    histograms[h].add(value);
+    mutex.unlock();
+}
+
+void Metrics::reset()
+{
+    mutex.lock();
+    memset(counters, 0, sizeof counters);
+    memset(gauges, 0, sizeof gauges);
+
+    for (int i = 0; i < NUMHISTOGRAMS; i++)
+    {
+        histograms[i] = MetricHistogram();
+    }
+    mutex.unlock();
+}
+
+// consistent copy, formatted without holding the lock
+void Metrics::snapshot(int64_t* c, int64_t* g, MetricHistogram* h)
+{
+    mutex.lock();
+    memcpy(c, counters, sizeof counters);
+    memcpy(g, gauges, sizeof gauges);
+
+    for (int i = 0; i < NUMHISTOGRAMS; i++)
+    {
+        h[i] = histograms[i];
+    }
+    mutex.unlock();
+}
+
+// {"counters":{...},"gauges":{...},"histograms":{"<key>":{"count":N,"sum":N,
+// "buckets":[...]}}} - buckets as in MetricHistogram, trailing empty buckets
+// omitted
+void Metrics::tojson(string* out)
+{
+    int64_t c[NUMCOUNTERS];
+    int64_t g[NUMGAUGES];
+    MetricHistogram h[NUMHISTOGRAMS];
+    char buf[64];
+
+    snapshot(c, g, h);
+
+    // keys are appended separately, buf only ever holds one number
+    out->assign("{\"counters\":{");
+
+    for (int i = 0; i < NUMCOUNTERS; i++)
+    {
+        out->append(i ? ",\"" : "\"");
+        out->append(counterinfo[i].key);
+        snprintf(buf, sizeof buf, "\":%" PRId64, c[i]);
+        out->append(buf);
+    }
+
+    out->append("},\"gauges\":{");
+
+    for (int i = 0; i < NUMGAUGES; i++)
+    {
+        out->append(i ? ",\"" : "\"");
+        out->append(gaugeinfo[i].key);
+        snprintf(buf, sizeof buf, "\":%" PRId64, g[i]);
+        out->append(buf);
+    }
+
+    out->append("},\"histograms\":{");
+
+    for (int i = 0; i < NUMHISTOGRAMS; i++)
+    {
+        out->append(i ? ",\"" : "\"");
+        out->append(histograminfo[i].key);
+        snprintf(buf, sizeof buf, "\":{\"count\":%" PRIu64, h[i].count);
+        out->append(buf);
+        snprintf(buf, sizeof buf, ",\"sum\":%" PRId64, h[i].sum);
+        out->append(buf);
+        out->append(",\"buckets\":[");
+
+        int n = MetricHistogram::NUMBUCKETS;
+
+        while (n && !h[i].buckets[n - 1])
+        {
+            n--;
+        }
+
+        for (int j = 0; j < n; j++)
+        {
+            snprintf(buf, sizeof buf, "%s%" PRIu64, j ? "," : "", h[i].buckets[j]);
+            out->append(buf);
+        }
+
+        out->append("]}");
+    }
+
+    out->append("}}");
+}
+
+// HELP and TYPE are written once per metric name, before its first series
+static void promheader(string* out, const MetricInfo* info, const char* type)
+{
+    if (info->help)
+    {
+        out->append("# HELP ");
+        out->append(info->name);
+        out->append(" ");
+        out->append(info->help);
+        out->append("\n# TYPE ");
+        out->append(info->name);
+        out->append(" ");
+        out->append(type);
+        out->append("\n");
+    }
+}
+
+static void promvalue(string* out, const char* name, const char* suffix, const char* labels, const char* extralabel, const char* value)
+{
+    out->append(name);
+    out->append(suffix);
+
+    if (*labels || *extralabel)
+    {
+        out->append("{");
+        out->append(labels);
+
+        if (*labels && *extralabel)
+        {
+            out->append(",");
+        }
+
+        out->append(extralabel);
+        out->append("}");
+    }
+
+    out->append(" ");
+    out->append(value);
+    out->append("\n");
+}
+
+void Metrics::toprometheus(string* out)
+{
+    int64_t c[NUMCOUNTERS];
+    int64_t g[NUMGAUGES];
+    MetricHistogram h[NUMHISTOGRAMS];
+    char buf[32];
+    char le[32];
+
+    snapshot(c, g, h);
+
+    out->clear();
+
+    for (int i = 0; i < NUMCOUNTERS; i++)
+    {
+        promheader(out, &counterinfo[i], "counter");
+        snprintf(buf, sizeof buf, "%" PRId64, c[i]);
+        promvalue(out, counterinfo[i].name, "", counterinfo[i].labels, "", buf);
+    }
+
+    for (int i = 0; i < NUMGAUGES; i++)
+    {
+        const char* name = gaugeinfo[i].name;
+        size_t len = strlen(name);
+
+        promheader(out, &gaugeinfo[i], (len > 6 && !strcmp(name + len - 6, "_total")) ? "counter" : "gauge");
+        snprintf(buf, sizeof buf, "%" PRId64, g[i]);
+        promvalue(out, name, "", gaugeinfo[i].labels, "", buf);
+    }
+
+    for (int i = 0; i < NUMHISTOGRAMS; i++)
+    {
+        const MetricInfo* info = &histograminfo[i];
+        uint64_t cumulative = 0;
+
+        promheader(out, info, "histogram");
+
+        for (int j = 0; j < MetricHistogram::NUMBUCKETS; j++)
+        {
+            cumulative += h[i].buckets[j];
+            snprintf(le, sizeof le, "le=\"%" PRIu64 "\"", (uint64_t)1 << j);
+            snprintf(buf, sizeof buf, "%" PRIu64, cumulative);
+            promvalue(out, info->name, "_bucket", info->labels, le, buf);
+        }
+
+        snprintf(buf, sizeof buf, "%" PRIu64, h[i].count);
+        promvalue(out, info->name, "_bucket", info->labels, "le=\"+Inf\"", buf);
+        snprintf(buf, sizeof buf, "%" PRId64, h[i].sum);
+        promvalue(out, info->name, "_sum", info->labels, "", buf);
+        snprintf(buf, sizeof buf, "%" PRIu64, h[i].count);
+        promvalue(out, info->name, "_count", info->labels, "", buf);
+    }
+}
+} // namespace
@@ -44,6 +44,9 @@ Node::Node(MegaClient* cclient, node_vector* dp, handle h, handle ph,
     parenthandle = ph;
 
     parent = NULL;
+    childnames = NULL;
+    childrenstamp = 0;
+    childrenloaded = true;
 
 #ifdef ENABLE_SYNC
     localnode = NULL;
@@ -78,6 +81,15 @@ Node::Node(MegaClient* cclient, node_vector* dp, handle h, handle ph,
 
         client->nodes[h] = this;
 
+        if (client->nodepaging)
+        {
+            lru_it = client->nodelru.insert(client->nodelru.begin(), this);
+        }
+        else
+        {
+            lru_it = client->nodelru.end();
+        }
+
         // folder link access: first returned record defines root node and
         // identity
         if (ISUNDEF(*client->rootnodes))
@@ -113,6 +125,11 @@ Node::~Node()
     // abort pending direct reads
     client->preadabort(this);
 
+    if (lru_it != client->nodelru.end())
+    {
+        client->nodelru.erase(lru_it);
+    }
+
     // remove node's fingerprint from hash
     if (type == FILENODE && fingerprint_it != client->fingerprints.end())
     {
@@ -157,9 +174,17 @@ Node::~Node()
     // remove from parent's children
     if (parent)
     {
+        if (parent->childnames)
+        {
+            parent->childnames->erase(childname_it);
+        }
+
         parent->children.erase(child_it);
+        parent->childrenchanged();
     }
 
+    delete childnames;
+
     // delete child-parent associations (normally not used, as nodes are
     // deleted bottom-up)
     for (node_list::iterator it = children.begin(); it != children.end(); it++)
@@ -177,6 +202,7 @@ Node::~Node()
     {
         localnode->deleted = true;
         localnode->node = NULL;
+        localnode->setsyncdirty();
     }
 
     // in case this node is currently being transferred for syncing: abort transfer
@@ -199,36 +225,57 @@ void Node::setkey(const byte* newkey)
 // mismatch vector
 Node* Node::unserialize(MegaClient* client, string* d, node_vector* dp)
 {
-    handle h, ph;
-    nodetype_t t;
-    m_off_t s;
-    handle u;
-    const byte* k = NULL;
-    const char* fa;
-    m_time_t ts;
-    const byte* skey;
-    const char* ptr = d->data();
-    const char* end = ptr + d->size();
+    return unserialize(client, d->data(), d->size(), dp);
+}
+
+Node* Node::unserialize(MegaClient* client, const char* data, size_t size, node_vector* dp)
+{
+    NodeRecord record;
+
+    if (!record.decode(data, size, client->fsaccess))
+    {
+        return NULL;
+    }
+
+    return record.create(client, dp);
+}
+
+NodeRecord::NodeRecord()
+{
+    key = NULL;
+    fileattrstring = NULL;
+    sharekey = NULL;
+    shares = NULL;
+    sharesend = NULL;
+    numshares = 0;
+    plink = false;
+}
+
+// does not touch the client: can run on any thread
+// (the record must remain available until create())
+bool NodeRecord::decode(const char* data, size_t len, FileSystemAccess* fsaccess)
+{
+    const char* ptr = data;
+    const char* end = ptr + len;
     unsigned short ll;
-    Node* n;
     int i;
     char isExported = '\0';
 
-    if (ptr + sizeof s + 2 * MegaClient::NODEHANDLE + MegaClient::USERHANDLE + 2 * sizeof ts + sizeof ll > end)
+    if (ptr + sizeof size + 2 * MegaClient::NODEHANDLE + MegaClient::USERHANDLE + 2 * sizeof ctime + sizeof ll > end)
     {
-        return NULL;
+        return false;
     }
 
-    s = MemAccess::get<m_off_t>(ptr);
-    ptr += sizeof s;
+    size = MemAccess::get<m_off_t>(ptr);
+    ptr += sizeof size;
 
-    if (s < 0 && s >= -RUBBISHNODE)
+    if (size < 0 && size >= -RUBBISHNODE)
     {
-        t = (nodetype_t)-s;
+        type = (nodetype_t)-size;
     }
     else
     {
-        t = FILENODE;
+        type = FILENODE;
     }
 
     h = 0;
@@ -244,44 +291,46 @@ Node* Node::unserialize(MegaClient* client, string* d, node_vector* dp)
         ph = UNDEF;
     }
 
-    memcpy((char*)&u, ptr, MegaClient::USERHANDLE);
+    memcpy((char*)&owner, ptr, MegaClient::USERHANDLE);
     ptr += MegaClient::USERHANDLE;
 
     // FIME: use m_time_t / Serialize64 instead
     ptr += sizeof(time_t);
 
-    ts = (uint32_t)MemAccess::get<time_t>(ptr);
+    ctime = (uint32_t)MemAccess::get<time_t>(ptr);
     ptr += sizeof(time_t);
 
-    if ((t == FILENODE) || (t == FOLDERNODE))
+    key = NULL;
+
+    if ((type == FILENODE) || (type == FOLDERNODE))
     {
-        int keylen = ((t == FILENODE) ? FILENODEKEYLENGTH + 0 : FOLDERNODEKEYLENGTH + 0);
+        int keylen = ((type == FILENODE) ? FILENODEKEYLENGTH + 0 : FOLDERNODEKEYLENGTH + 0);
 
         if (ptr + keylen + 8 + sizeof(short) > end)
         {
-            return NULL;
+            return false;
         }
 
-        k = (const byte*)ptr;
+        key = (const byte*)ptr;
         ptr += keylen;
     }
 
-    if (t == FILENODE)
+    if (type == FILENODE)
     {
         ll = MemAccess::get<unsigned short>(ptr);
         ptr += sizeof ll;
 
         if ((ptr + ll > end) || ptr[ll + 1])
         {
-            return NULL;
+            return false;
         }
 
-        fa = ptr;
+        fileattrstring = ptr;
         ptr += ll;
     }
     else
     {
-        fa = NULL;
+        fileattrstring = NULL;
     }
 
     isExported = MemAccess::get<char>(ptr);
@@ -295,89 +344,99 @@ Node* Node::unserialize(MegaClient* client, string* d, node_vector* dp)
         }
     }
 
-    short numshares = MemAccess::get<short>(ptr);
+    numshares = MemAccess::get<short>(ptr);
     ptr += sizeof(numshares);
 
     if (numshares)
     {
         if (ptr + SymmCipher::KEYLENGTH > end)
         {
-            return NULL;
+            return false;
         }
 
-        skey = (const byte*)ptr;
+        sharekey = (const byte*)ptr;
         ptr += SymmCipher::KEYLENGTH;
-    }
-    else
-    {
-        skey = NULL;
-    }
 
-    n = new Node(client, dp, h, ph, t, s, u, fa, ts);
-
-    if (k)
-    {
-        n->setkey(k);
+        // inshare, outshares, or pending shares: only skipped here
+        shares = ptr;
+        for (short count = numshares; Share::unserialize(NULL, 0, h, sharekey, &ptr, end) && count > 0 && --count; );
+        sharesend = ptr;
     }
-
-    if (numshares)
+    else
     {
-        // read inshare, outshares, or pending shares
-        while (Share::unserialize(client,
-                                  (numshares > 0) ? -1 : 0,
-                                  h, skey, &ptr, end)
-               && numshares > 0
-               && --numshares);
+        sharekey = NULL;
+        shares = NULL;
+        sharesend = NULL;
     }
 
-    ptr = n->attrs.unserialize(ptr, end);
+    attrs.map.clear();
+    ptr = attrs.unserialize(ptr, end);
     if (!ptr)
     {
-        delete n;
-        return NULL;
+        return false;
     }
 
     // It's needed to re-normalize node names because
     // the updated version of utf8proc doesn't provide
     // exactly the same output as the previous one that
     // we were using
-    attr_map::iterator it = n->attrs.map.find('n');
-    if (it != n->attrs.map.end())
+    attr_map::iterator it = attrs.map.find('n');
+    if (it != attrs.map.end())
     {
-        client->fsaccess->normalize(&(it->second));
+        fsaccess->normalize(&(it->second));
     }
 
-    PublicLink *plink = NULL;
+    plink = isExported;
     if (isExported)
     {
         if (ptr + MegaClient::NODEHANDLE + sizeof(m_time_t) + sizeof(bool) > end)
         {
-            delete n;
-            return NULL;
+            return false;
         }
 
-        handle ph = MemAccess::get<handle>(ptr);
+        plinkhandle = MemAccess::get<handle>(ptr);
         ptr += MegaClient::NODEHANDLE;
-        m_time_t ets = MemAccess::get<m_time_t>(ptr);
-        ptr += sizeof(ets);
-        bool takendown = MemAccess::get<bool>(ptr);
-        ptr += sizeof(takendown);
-
-        plink = new PublicLink(ph, ets, takendown);
+        plinkets = MemAccess::get<m_time_t>(ptr);
+        ptr += sizeof(plinkets);
+        plinktakendown = MemAccess::get<bool>(ptr);
+        ptr += sizeof(plinktakendown);
     }
-    n->plink = plink;
 
-    n->setfingerprint();
+    return ptr == end;
+}
+
+// instantiate the decoded node and link it into the client (SDK thread)
+// (the attributes are moved to the node)
+Node* NodeRecord::create(MegaClient* client, node_vector* dp)
+{
+    Node* n = new Node(client, dp, h, ph, type, size, owner, fileattrstring, ctime);
 
-    if (ptr == end)
+    if (key)
     {
-        return n;
+        n->setkey(key);
     }
-    else
+
+    if (numshares)
     {
-        delete n;
-        return NULL;
+        // read inshare, outshares, or pending shares
+        const char* ptr = shares;
+        short count = numshares;
+
+        while (Share::unserialize(client,
+                                  (count > 0) ? -1 : 0,
+                                  h, sharekey, &ptr, sharesend)
+               && count > 0
+               && --count);
     }
+
+    n->attrs.map.swap(attrs.map);
+
+    n->plink = plink ? new PublicLink(plinkhandle, plinkets, plinktakendown) : NULL;
+
+    n->setfingerprint();
+    n->reindexname();
+
+    return n;
 }
 
 // serialize node - nodes with pending or RSA keys are unsupported
@@ -583,34 +642,46 @@ SymmCipher* Node::nodecipher()
 // decrypt attributes and build attribute hash
 void Node::setattr()
 {
-    byte* buf;
     SymmCipher* cipher;
 
-    if (attrstring && (cipher = nodecipher()) && (buf = decryptattr(cipher, attrstring->c_str(), attrstring->size())))
+    if (attrstring && (cipher = nodecipher()) && decryptattrs(cipher))
     {
-        JSON json;
-        nameid name;
-        string* t;
+        setfingerprint();
+        reindexname();
+    }
+}
 
-        json.begin((char*)buf + 5);
+bool Node::decryptattrs(SymmCipher* cipher)
+{
+    byte* buf;
 
-        while ((name = json.getnameid()) != EOO && json.storeobject((t = &attrs.map[name])))
-        {
-            JSON::unescape(t);
+    if (!(buf = decryptattr(cipher, attrstring->c_str(), attrstring->size())))
+    {
+        return false;
+    }
 
-            if (name == 'n')
-            {
-                client->fsaccess->normalize(t);
-            }
-        }
+    JSON json;
+    nameid name;
+    string* t;
 
-        setfingerprint();
+    json.begin((char*)buf + 5);
 
-        delete[] buf;
+    while ((name = json.getnameid()) != EOO && json.storeobject((t = &attrs.map[name])))
+    {
+        JSON::unescape(t);
 
-        delete attrstring;
-        attrstring = NULL;
+        if (name == 'n')
+        {
+            client->fsaccess->normalize(t);
+        }
     }
+
+    delete[] buf;
+
+    delete attrstring;
+    attrstring = NULL;
+
+    return true;
 }
 
 // if present, configure FileFingerprint from attributes
@@ -712,6 +783,31 @@ int Node::hasfileattribute(const string *fileattrstring, fatype t)
 
 // attempt to apply node key - sets nodekey to a raw key if successful
 bool Node::applykey()
+{
+    const char* k;
+    SymmCipher* sc;
+
+    if (!findkey(&k, &sc))
+    {
+        return false;
+    }
+
+    unsigned int keylength = (type == FILENODE)
+                   ? FILENODEKEYLENGTH + 0
+                   : FOLDERNODEKEYLENGTH + 0;
+
+    byte key[FILENODEKEYLENGTH];
+
+    if (client->decryptkey(k, key, keylength, sc, 0, nodehandle))
+    {
+        nodekey.assign((const char*)key, keylength);
+        setattr();
+    }
+
+    return true;
+}
+
+bool Node::findkey(const char** kp, SymmCipher** scp)
 {
     unsigned int keylength = (type == FILENODE)
                    ? FILENODEKEYLENGTH + 0
@@ -791,15 +887,42 @@ bool Node::applykey()
         }
     }
 
-    byte key[FILENODEKEYLENGTH];
+    *kp = k;
+    *scp = sc;
 
-    if (client->decryptkey(k, key, keylength, sc, 0, nodehandle))
+    return true;
+}
+
+void Node::indexchildnames()
+{
+    if (!childnames)
     {
-        nodekey.assign((const char*)key, keylength);
-        setattr();
+        childnames = new nodename_map;
+
+        for (node_list::iterator it = children.begin(); it != children.end(); it++)
+        {
+            (*it)->childname_it = childnames->insert(pair<string, Node*>((*it)->displayname(), *it));
+        }
     }
+}
 
-    return true;
+void Node::reindexname()
+{
+    if (parent)
+    {
+        if (parent->childnames)
+        {
+            parent->childnames->erase(childname_it);
+            childname_it = parent->childnames->insert(pair<string, Node*>(displayname(), this));
+        }
+
+        parent->childrenchanged();
+    }
+}
+
+void Node::childrenchanged()
+{
+    childrenstamp = ++client->lastchildrenstamp;
 }
 
 // returns whether node was moved
@@ -812,7 +935,13 @@ bool Node::setparent(Node* p)
 
     if (parent)
     {
+        if (parent->childnames)
+        {
+            parent->childnames->erase(childname_it);
+        }
+
         parent->children.erase(child_it);
+        parent->childrenchanged();
     }
 
 #ifdef ENABLE_SYNC
@@ -824,6 +953,13 @@ bool Node::setparent(Node* p)
     if (parent)
     {
         child_it = parent->children.insert(parent->children.end(), this);
+
+        if (parent->childnames)
+        {
+            childname_it = parent->childnames->insert(pair<string, Node*>(displayname(), this));
+        }
+
+        parent->childrenchanged();
     }
 
 #ifdef ENABLE_SYNC
@@ -934,6 +1070,9 @@ void LocalNode::setnameparent(LocalNode* newparent, string* newlocalpath)
 
     if (parent)
     {
+        // the old parent has to be reconciled without this node
+        parent->setsyncdirty();
+
         // remove existing child linkage
         parent->children.erase(&localname);
 
@@ -1063,6 +1202,9 @@ void LocalNode::setnameparent(LocalNode* newparent, string* newlocalpath)
             slocalname = NULL;
         }
 
+        // ...and the new one with it
+        setsyncdirty();
+
         treestate(TREESTATE_NONE);
 
         if (todelete)
@@ -1113,6 +1255,9 @@ void LocalNode::init(Sync* csync, nodetype_t ctype, LocalNode* cparent, string*
     created = false;
     reported = false;
     checked = false;
+    fingerprinting = false;
+    syncdowndirty = false;
+    syncupdirty = false;
     syncxfer = true;
     newnode = NULL;
     parent_dbid = 0;
@@ -1136,6 +1281,8 @@ void LocalNode::init(Sync* csync, nodetype_t ctype, LocalNode* cparent, string*
         sync->client->fsaccess->local2path(&localname, &name);
     }
 
+    setsyncdirty();
+
     scanseqno = sync->scanseqno;
 
     // mark fsid as not valid
@@ -1227,6 +1374,35 @@ void LocalNode::setnode(Node* cnode)
     }
 }
 
+// the node is always flagged, its ancestors up to the first one that
+// already is (an ancestor without the flag means that its subtree has been
+// reconciled since it was last flagged)
+void LocalNode::setsyncdowndirty()
+{
+    syncdowndirty = true;
+
+    for (LocalNode* l = parent; l && !l->syncdowndirty; l = l->parent)
+    {
+        l->syncdowndirty = true;
+    }
+}
+
+void LocalNode::setsyncupdirty()
+{
+    syncupdirty = true;
+
+    for (LocalNode* l = parent; l && !l->syncupdirty; l = l->parent)
+    {
+        l->syncupdirty = true;
+    }
+}
+
+void LocalNode::setsyncdirty()
+{
+    setsyncdowndirty();
+    setsyncupdirty();
+}
+
 void LocalNode::setnotseen(int newnotseen)
 {
     if (!newnotseen)
@@ -1295,6 +1471,11 @@ LocalNode::~LocalNode()
 
     setnotseen(0);
 
+    if (fingerprinting && sync->client->fingerprintpool)
+    {
+        sync->client->fingerprintpool->cancel(this);
+    }
+
     if (newnode)
     {
         newnode->localnode = NULL;
@@ -39,16 +39,28 @@ extern JavaVM *MEGAjvm;
 #include <uuid/uuid.h>
 #endif
 
+#ifdef USE_IOURING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#endif
+
 namespace mega {
     
 #ifdef USE_IOS
     char* PosixFileSystemAccess::appbasepath = NULL;
 #endif
 
-#ifdef HAVE_AIO_RT
+#if defined(HAVE_AIO_RT) || defined(USE_IOURING)
 PosixAsyncIOContext::PosixAsyncIOContext() : AsyncIOContext()
 {
+#ifdef HAVE_AIO_RT
     aiocb = NULL;
+#endif
+#ifdef USE_IOURING
+    aioring = NULL;
+    fd = -1;
+#endif
 }
 
 PosixAsyncIOContext::~PosixAsyncIOContext()
@@ -59,6 +71,20 @@ PosixAsyncIOContext::~PosixAsyncIOContext()
 
 void PosixAsyncIOContext::finish()
 {
+#ifdef USE_IOURING
+    if (aioring)
+    {
+        // completions are reaped on this thread, so wait on the ring itself
+        LOG_debug << "Synchronously waiting for async operation";
+        PosixAsyncIORing* ring = aioring;
+        while (!finished)
+        {
+            ring->reap(true);
+        }
+    }
+#endif
+
+#ifdef HAVE_AIO_RT
     if (aiocb)
     {
         if (!finished)
@@ -69,10 +95,236 @@ void PosixAsyncIOContext::finish()
         delete aiocb;
         aiocb = NULL;
     }
+#endif
     assert(finished);
 }
 #endif
 
+#ifdef USE_IOURING
+PosixAsyncIORing::PosixAsyncIORing()
+{
+    ringfd = -1;
+    eventfd = -1;
+    sqring = MAP_FAILED;
+    cqring = MAP_FAILED;
+    sqes = (struct io_uring_sqe*)MAP_FAILED;
+    sqringsize = cqringsize = sqessize = 0;
+    entries = 0;
+    inflight = 0;
+    unsubmitted = 0;
+}
+
+PosixAsyncIORing::~PosixAsyncIORing()
+{
+    if (inflight || backlog.size())
+    {
+        LOG_debug << "Waiting for " << (inflight + backlog.size()) << " async operations";
+        while (inflight || backlog.size())
+        {
+            reap(true);
+        }
+    }
+
+    if (sqes != MAP_FAILED)
+    {
+        munmap(sqes, sqessize);
+    }
+
+    if (cqring != MAP_FAILED)
+    {
+        munmap(cqring, cqringsize);
+    }
+
+    if (sqring != MAP_FAILED)
+    {
+        munmap(sqring, sqringsize);
+    }
+
+    if (eventfd >= 0)
+    {
+        close(eventfd);
+    }
+
+    if (ringfd >= 0)
+    {
+        close(ringfd);
+    }
+}
+
+bool PosixAsyncIORing::init(unsigned n)
+{
+    struct io_uring_params params;
+    memset(&params, 0, sizeof params);
+
+    ringfd = syscall(__NR_io_uring_setup, n, &params);
+    if (ringfd < 0)
+    {
+        LOG_debug << "io_uring not available: " << errno;
+        return false;
+    }
+
+    sqringsize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqringsize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    sqessize = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    sqring = mmap(NULL, sqringsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQ_RING);
+    cqring = mmap(NULL, cqringsize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_CQ_RING);
+    sqes = (struct io_uring_sqe*)mmap(NULL, sqessize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQES);
+    if (sqring == MAP_FAILED || cqring == MAP_FAILED || sqes == MAP_FAILED)
+    {
+        LOG_err << "Unable to map io_uring: " << errno;
+        return false;
+    }
+
+    sqhead = (unsigned*)((char*)sqring + params.sq_off.head);
+    sqtail = (unsigned*)((char*)sqring + params.sq_off.tail);
+    sqmask = (unsigned*)((char*)sqring + params.sq_off.ring_mask);
+    sqarray = (unsigned*)((char*)sqring + params.sq_off.array);
+
+    cqhead = (unsigned*)((char*)cqring + params.cq_off.head);
+    cqtail = (unsigned*)((char*)cqring + params.cq_off.tail);
+    cqmask = (unsigned*)((char*)cqring + params.cq_off.ring_mask);
+    cqes = (struct io_uring_cqe*)((char*)cqring + params.cq_off.cqes);
+
+    // the completion ring is at least as large as the submission ring,
+    // so it can't overflow as long as no more than this are in flight
+    entries = params.sq_entries;
+
+    eventfd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (eventfd < 0
+            || syscall(__NR_io_uring_register, ringfd, IORING_REGISTER_EVENTFD, &eventfd, 1) < 0)
+    {
+        LOG_err << "Unable to register io_uring eventfd: " << errno;
+        return false;
+    }
+
+    LOG_debug << "Using io_uring for async file I/O (" << entries << " entries)";
+    return true;
+}
+
+void PosixAsyncIORing::enter(unsigned submit, unsigned wait)
+{
+    int r = syscall(__NR_io_uring_enter, ringfd, submit, wait, wait ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    if (r >= 0)
+    {
+        unsubmitted -= (unsigned)r < unsubmitted ? (unsigned)r : unsubmitted;
+    }
+    else if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+    {
+        LOG_err << "io_uring_enter failed: " << errno;
+    }
+}
+
+void PosixAsyncIORing::queue(PosixAsyncIOContext* context)
+{
+    unsigned tail = *sqtail;
+    unsigned index = tail & *sqmask;
+    struct io_uring_sqe* sqe = &sqes[index];
+
+    memset(sqe, 0, sizeof *sqe);
+    sqe->opcode = context->op == AsyncIOContext::READ ? IORING_OP_READV : IORING_OP_WRITEV;
+    sqe->fd = context->fd;
+    sqe->off = context->pos;
+    sqe->addr = (uint64_t)(uintptr_t)&context->iov;
+    sqe->len = 1;
+    sqe->user_data = (uint64_t)(uintptr_t)context;
+
+    sqarray[index] = index;
+    __atomic_store_n(sqtail, tail + 1, __ATOMIC_RELEASE);
+
+    inflight++;
+    unsubmitted++;
+}
+
+void PosixAsyncIORing::submit(PosixAsyncIOContext* context)
+{
+    context->iov.iov_base = context->buffer;
+    context->iov.iov_len = context->len;
+    context->aioring = this;
+
+    if (inflight >= entries)
+    {
+        backlog.push_back(context);
+        return;
+    }
+
+    queue(context);
+    enter(unsubmitted, 0);
+}
+
+void PosixAsyncIORing::complete(PosixAsyncIOContext* context, int res)
+{
+    context->aioring = NULL;
+    context->retry = (res == -EAGAIN || res == -EINTR);
+    context->failed = (res < 0);
+
+    if (!context->failed)
+    {
+        if (context->op == AsyncIOContext::READ && context->pad)
+        {
+            memset(context->buffer + context->len, 0, context->pad);
+            LOG_verbose << "Async read finished OK";
+        }
+        else
+        {
+            LOG_verbose << "Async write finished OK";
+        }
+    }
+    else
+    {
+        LOG_warn << "Async operation finished with error: " << -res;
+    }
+
+    context->finished = true;
+    if (context->userCallback)
+    {
+        context->userCallback(context->userData);
+    }
+}
+
+int PosixAsyncIORing::reap(bool wait)
+{
+    uint64_t count;
+    while (read(eventfd, &count, sizeof count) > 0);
+
+    if (unsubmitted || (wait && inflight))
+    {
+        enter(unsubmitted, (wait && inflight) ? 1 : 0);
+    }
+
+    int n = 0;
+    unsigned head = *cqhead;
+    unsigned tail = __atomic_load_n(cqtail, __ATOMIC_ACQUIRE);
+
+    while (head != tail)
+    {
+        struct io_uring_cqe* cqe = &cqes[head & *cqmask];
+        PosixAsyncIOContext* context = (PosixAsyncIOContext*)(uintptr_t)cqe->user_data;
+        int res = cqe->res;
+
+        head++;
+        __atomic_store_n(cqhead, head, __ATOMIC_RELEASE);
+        inflight--;
+        n++;
+
+        complete(context, res);
+    }
+
+    if (backlog.size() && inflight < entries)
+    {
+        while (backlog.size() && inflight < entries)
+        {
+            queue(backlog.front());
+            backlog.pop_front();
+        }
+
+        enter(unsubmitted, 0);
+    }
+
+    return n;
+}
+#endif
+
 PosixFileAccess::PosixFileAccess(Waiter *w, int defaultfilepermissions) : FileAccess(w)
 {
     fd = -1;
@@ -82,6 +334,10 @@ PosixFileAccess::PosixFileAccess(Waiter *w, int defaultfilepermissions) : FileAc
     dp = NULL;
 #endif
 
+#ifdef USE_IOURING
+    aioring = NULL;
+#endif
+
     fsidvalid = false;
 }
 
@@ -168,6 +424,13 @@ void PosixFileAccess::sysclose()
 
 bool PosixFileAccess::asyncavailable()
 {
+#ifdef USE_IOURING
+    if (aioring)
+    {
+        return true;
+    }
+#endif
+
 #ifdef HAVE_AIO_RT
     #ifdef __APPLE__
         return false;
@@ -179,12 +442,14 @@ bool PosixFileAccess::asyncavailable()
 #endif
 }
 
-#ifdef HAVE_AIO_RT
+#if defined(HAVE_AIO_RT) || defined(USE_IOURING)
 AsyncIOContext *PosixFileAccess::newasynccontext()
 {
     return new PosixAsyncIOContext();
 }
+#endif
 
+#ifdef HAVE_AIO_RT
 void PosixFileAccess::asyncopfinished(sigval sigev_value)
 {
     PosixAsyncIOContext *context = (PosixAsyncIOContext *)(sigev_value.sival_ptr);
@@ -222,7 +487,7 @@ void PosixFileAccess::asyncopfinished(sigval sigev_value)
 
 void PosixFileAccess::asyncsysopen(AsyncIOContext *context)
 {
-#ifdef HAVE_AIO_RT
+#if defined(HAVE_AIO_RT) || defined(USE_IOURING)
     string path;
     path.assign((char *)context->buffer, context->len);
     context->failed = !fopen(&path, context->access & AsyncIOContext::ACCESS_READ,
@@ -238,7 +503,7 @@ void PosixFileAccess::asyncsysopen(AsyncIOContext *context)
 
 void PosixFileAccess::asyncsysread(AsyncIOContext *context)
 {
-#ifdef HAVE_AIO_RT
+#if defined(HAVE_AIO_RT) || defined(USE_IOURING)
     if (!context)
     {
         return;
@@ -256,6 +521,18 @@ void PosixFileAccess::asyncsysread(AsyncIOContext *context)
         }
         return;
     }
+#endif
+
+#ifdef USE_IOURING
+    if (aioring)
+    {
+        posixContext->fd = fd;
+        aioring->submit(posixContext);
+        return;
+    }
+#endif
+
+#ifdef HAVE_AIO_RT
 
     struct aiocb *aiocbp = new struct aiocb;
     memset(aiocbp, 0, sizeof (struct aiocb));
@@ -287,7 +564,7 @@ void PosixFileAccess::asyncsysread(AsyncIOContext *context)
 
 void PosixFileAccess::asyncsyswrite(AsyncIOContext *context)
 {
-#ifdef HAVE_AIO_RT
+#if defined(HAVE_AIO_RT) || defined(USE_IOURING)
     if (!context)
     {
         return;
@@ -305,6 +582,18 @@ void PosixFileAccess::asyncsyswrite(AsyncIOContext *context)
         }
         return;
     }
+#endif
+
+#ifdef USE_IOURING
+    if (aioring)
+    {
+        posixContext->fd = fd;
+        aioring->submit(posixContext);
+        return;
+    }
+#endif
+
+#ifdef HAVE_AIO_RT
 
     struct aiocb *aiocbp = new struct aiocb;
     memset(aiocbp, 0, sizeof (struct aiocb));
@@ -355,6 +644,31 @@ bool PosixFileAccess::sysread(byte* dst, unsigned len, m_off_t pos)
 #endif
 }
 
+// announce all blocks before reading the first one, so that the kernel (or
+// the network filesystem client) can fetch them concurrently
+bool PosixFileAccess::sysreadv(byte* dst, unsigned len, const m_off_t* pos, unsigned count)
+{
+#if defined(POSIX_FADV_WILLNEED) && !defined(__ANDROID__)
+    if (count > 1)
+    {
+        for (unsigned i = 0; i < count; i++)
+        {
+            posix_fadvise(fd, pos[i], len, POSIX_FADV_WILLNEED);
+        }
+    }
+#endif
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (!sysread(dst + i * len, len, pos[i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 bool PosixFileAccess::fwrite(const byte* data, unsigned len, m_off_t pos)
 {
     retry = false;
@@ -514,6 +828,15 @@ PosixFileSystemAccess::PosixFileSystemAccess(int fseventsfd)
 
     localseparator = "/";
 
+#ifdef USE_IOURING
+    aioring = new PosixAsyncIORing();
+    if (!aioring->init(64))
+    {
+        delete aioring;
+        aioring = NULL;
+    }
+#endif
+
 #ifdef USE_IOS
     if (!appbasepath)
     {
@@ -536,6 +859,20 @@ PosixFileSystemAccess::PosixFileSystemAccess(int fseventsfd)
     }
 #endif
 
+#ifdef USE_FANOTIFY
+    // requires CAP_SYS_ADMIN and Linux 5.9 - syncs are watched through
+    // inotify otherwise (newdirnotify() marks the syncs that can use neither)
+    if ((fanotifyfd = fanotify_init(FAN_CLASS_NOTIF | FAN_REPORT_DFID_NAME
+                                    | FAN_NONBLOCK | FAN_CLOEXEC, O_RDONLY)) >= 0)
+    {
+        notifyfailed = false;
+    }
+    else
+    {
+        LOG_debug << "fanotify not available. Error code: " << errno;
+    }
+#endif
+
 #ifdef __MACH__
 #if __LP64__
     typedef struct fsevent_clone_args {
@@ -612,26 +949,67 @@ PosixFileSystemAccess::~PosixFileSystemAccess()
     {
         close(notifyfd);
     }
+
+#ifdef USE_FANOTIFY
+    if (fanotifyfd >= 0)
+    {
+        close(fanotifyfd);
+    }
+#endif
+
+#ifdef USE_IOURING
+    delete aioring;
+#endif
 }
 
 // wake up from filesystem updates
 void PosixFileSystemAccess::addevents(Waiter* w, int flags)
 {
+#ifdef USE_IOURING
+    if (aioring)
+    {
+        PosixWaiter* pw = (PosixWaiter*)w;
+
+        pw->addfd(aioring->eventfd, PosixWaiter::FDREAD);
+    }
+#endif
+
     if (notifyfd >= 0)
     {
         PosixWaiter* pw = (PosixWaiter*)w;
 
-        FD_SET(notifyfd, &pw->rfds);
-        FD_SET(notifyfd, &pw->ignorefds);
+        pw->addfd(notifyfd, PosixWaiter::FDREAD, true);
+    }
 
-        pw->bumpmaxfd(notifyfd);
+#ifdef USE_FANOTIFY
+    if (fanotifyfd >= 0)
+    {
+        PosixWaiter* pw = (PosixWaiter*)w;
+
+        pw->addfd(fanotifyfd, PosixWaiter::FDREAD, true);
     }
+#endif
 }
 
 // read all pending inotify events and queue them for processing
 int PosixFileSystemAccess::checkevents(Waiter* w)
 {
     int r = 0;
+
+#ifdef USE_IOURING
+    if (aioring && aioring->reap(false))
+    {
+        r |= Waiter::NEEDEXEC;
+    }
+#endif
+
+#if defined(ENABLE_SYNC) && defined(USE_FANOTIFY)
+    if (fanotifyfd >= 0 && (((PosixWaiter*)w)->fdevents(fanotifyfd) & PosixWaiter::FDREAD))
+    {
+        r |= checkfanotify();
+    }
+#endif
+
     if (notifyfd < 0)
     {
         return r;
@@ -641,7 +1019,7 @@ int PosixFileSystemAccess::checkevents(Waiter* w)
     PosixWaiter* pw = (PosixWaiter*)w;
     string *ignore;
 
-    if (FD_ISSET(notifyfd, &pw->rfds))
+    if (pw->fdevents(notifyfd) & PosixWaiter::FDREAD)
     {
         char buf[sizeof(struct inotify_event) + NAME_MAX + 1];
         int p, l;
@@ -907,6 +1285,222 @@ int PosixFileSystemAccess::checkevents(Waiter* w)
 #endif
     return r;
 }
+#if defined(ENABLE_SYNC) && defined(USE_FANOTIFY)
+// read all pending fanotify events and queue them for processing - each event
+// names the affected entry relative to its folder, which is identified by a
+// file handle
+// - as with inotify, the source of a move is retained until the next event,
+//   so that the target of a rename is notified first (fanotify provides no
+//   cookie to pair them, so the source is still notified, after the target)
+int PosixFileSystemAccess::checkfanotify()
+{
+    int r = 0;
+    union
+    {
+        fanotify_event_metadata metadata;
+        char data[16384];
+    } buf;
+    ssize_t len;
+    LocalNode* fromnode = NULL;
+    string fromname;
+
+    while ((len = read(fanotifyfd, &buf, sizeof buf)) > 0)
+    {
+        for (fanotify_event_metadata* md = &buf.metadata; FAN_EVENT_OK(md, len); md = FAN_EVENT_NEXT(md, len))
+        {
+            if (md->vers != FANOTIFY_METADATA_VERSION)
+            {
+                LOG_err << "Unexpected fanotify version: " << (int)md->vers;
+                notifyerr = true;
+
+                if (fromnode)
+                {
+                    r |= fanotifyevent(fromnode, fromname.data(), fromname.size());
+                }
+
+                return r;
+            }
+
+            // (no file descriptors are reported along with file handles)
+            if (md->fd >= 0)
+            {
+                close(md->fd);
+            }
+
+            if (md->mask & FAN_Q_OVERFLOW)
+            {
+                notifyerr = true;
+                continue;
+            }
+
+            // new files are reported when they are closed (the events of
+            // an entry can be merged)
+            if ((md->mask & PosixDirNotify::FANOTIFY_MASK) == FAN_CREATE)
+            {
+                continue;
+            }
+
+            fanotify_event_info_fid* fid = (fanotify_event_info_fid*)((char*)md + md->metadata_len);
+
+            if ((char*)fid + sizeof *fid + sizeof(file_handle) > (char*)md + md->event_len
+             || fid->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID_NAME)
+            {
+                continue;
+            }
+
+            file_handle* fh = (file_handle*)fid->handle;
+            const char* name = (const char*)(fh->f_handle + fh->handle_bytes);
+            size_t namesize = strlen(name);
+
+            if (!namesize || (namesize == 1 && *name == '.'))
+            {
+                continue;
+            }
+
+            LocalNode* l = fanotifynode(&fid->fsid, fh);
+
+            if (!l)
+            {
+                continue;
+            }
+
+            uint64_t moved = md->mask & (FAN_MOVED_FROM | FAN_MOVED_TO);
+
+            if (fromnode && moved != FAN_MOVED_TO)
+            {
+                // not followed by a move target: actually a deletion
+                r |= fanotifyevent(fromnode, fromname.data(), fromname.size());
+                fromnode = NULL;
+            }
+
+            if (moved == FAN_MOVED_FROM)
+            {
+                fromnode = l;
+                fromname.assign(name, namesize);
+                continue;
+            }
+
+            r |= fanotifyevent(l, name, namesize);
+
+            if (fromnode)
+            {
+                r |= fanotifyevent(fromnode, fromname.data(), fromname.size());
+                fromnode = NULL;
+            }
+        }
+    }
+
+    if (fromnode)
+    {
+        r |= fanotifyevent(fromnode, fromname.data(), fromname.size());
+    }
+
+    return r;
+}
+
+// queue a notified entry of a synced folder, unless it is ignored
+int PosixFileSystemAccess::fanotifyevent(LocalNode* l, const char* name, size_t namesize)
+{
+    string* ignore = &l->sync->dirnotify->ignore;
+
+    if (namesize < ignore->size()
+     || memcmp(name, ignore->data(), ignore->size())
+     || (namesize > ignore->size()
+      && memcmp(name + ignore->size(), localseparator.c_str(), localseparator.size())))
+    {
+        LOG_debug << "Filesystem notification. Root: " << l->name << "   Path: " << name;
+        l->sync->dirnotify->notify(DirNotify::DIREVENTS, l, name, namesize);
+
+        return Waiter::NEEDEXEC;
+    }
+
+    return 0;
+}
+
+// folder identified by a notified file handle - the handle is resolved to
+// the inode number, which is looked up in fsidnode (NULL: not synced)
+LocalNode* PosixFileSystemAccess::fanotifynode(const __kernel_fsid_t* fsid, struct file_handle* fh)
+{
+    PosixDirNotify* dirnotify = NULL;
+
+    for (size_t i = 0; i < fannotifies.size(); i++)
+    {
+        if (!memcmp(&fannotifies[i]->fanfsid, fsid, sizeof *fsid))
+        {
+            dirnotify = fannotifies[i];
+            break;
+        }
+    }
+
+    if (!dirnotify)
+    {
+        // unrelated filesystem
+        return NULL;
+    }
+
+    string key((const char*)fsid, sizeof *fsid);
+    key.append((const char*)fh, sizeof(struct file_handle) + fh->handle_bytes);
+
+    map<string, handle>::iterator it = fanhandles.find(key);
+    handle ino;
+
+    if (it != fanhandles.end())
+    {
+        ino = it->second;
+    }
+    else
+    {
+        // the folder may have been deleted in the meantime
+        int fd = open_by_handle_at(dirnotify->fanrootfd, fh, O_PATH);
+        struct stat statbuf;
+
+        if (fd < 0)
+        {
+            return NULL;
+        }
+
+        bool ok = !fstat(fd, &statbuf);
+        close(fd);
+
+        if (!ok)
+        {
+            return NULL;
+        }
+
+        if (fanhandles.size() >= MAX_FANHANDLES)
+        {
+            fanhandles.clear();
+        }
+
+        ino = fanhandles[key] = (handle)statbuf.st_ino;
+    }
+
+    handlelocalnode_map* fsidnode = &dirnotify->sync->client->fsidnode;
+    handlelocalnode_map::iterator nit = fsidnode->find(ino);
+
+    for (size_t i = 0; i < fannotifies.size(); i++)
+    {
+        if (memcmp(&fannotifies[i]->fanfsid, fsid, sizeof *fsid))
+        {
+            continue;
+        }
+
+        // the sync roots aren't in fsidnode
+        if (fannotifies[i]->fanrootino == ino)
+        {
+            return &fannotifies[i]->sync->localroot;
+        }
+
+        if (nit != fsidnode->end() && nit->second->type == FOLDERNODE
+         && nit->second->sync->dirnotify.get() == fannotifies[i])
+        {
+            return nit->second;
+        }
+    }
+
+    return NULL;
+}
+#endif
 
 // generate unique local filename in the same fs as relatedpath
 void PosixFileSystemAccess::tmpnamelocal(string* localname) const
@@ -1691,12 +2285,98 @@ PosixDirNotify::PosixDirNotify(string* localbasepath, string* ignore) : DirNotif
     failed = 0;
 #endif
 
+#ifdef USE_FANOTIFY
+    fanotify = false;
+    fanrootfd = -1;
+    fanrootino = UNDEF;
+#endif
+
     fsaccess = NULL;
 }
 
+PosixDirNotify::~PosixDirNotify()
+{
+#ifdef USE_FANOTIFY
+    if (fanotify)
+    {
+        bool shared = false;
+
+        for (vector<PosixDirNotify*>::iterator it = fsaccess->fannotifies.begin(); it != fsaccess->fannotifies.end(); )
+        {
+            if (*it == this)
+            {
+                it = fsaccess->fannotifies.erase(it);
+            }
+            else
+            {
+                shared |= !memcmp(&(*it)->fanfsid, &fanfsid, sizeof fanfsid);
+                it++;
+            }
+        }
+
+        // stop watching the filesystem when its last sync goes away
+        if (!shared)
+        {
+            fanotify_mark(fsaccess->fanotifyfd, FAN_MARK_REMOVE | FAN_MARK_FILESYSTEM,
+                          FANOTIFY_MASK, fanrootfd, NULL);
+        }
+    }
+
+    if (fanrootfd >= 0)
+    {
+        close(fanrootfd);
+    }
+#endif
+}
+
+#ifdef USE_FANOTIFY
+// watch the whole filesystem of the sync with a single fanotify mark (false:
+// fanotify not available or not permitted, inotify watches are used)
+bool PosixDirNotify::watchfilesystem()
+{
+    struct statfs statfsbuf;
+    struct stat statbuf;
+
+    if (fsaccess->fanotifyfd < 0)
+    {
+        return false;
+    }
+
+    if ((fanrootfd = open(localbasepath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0)
+    {
+        return false;
+    }
+
+    if (fstatfs(fanrootfd, &statfsbuf) || fstat(fanrootfd, &statbuf)
+     || fanotify_mark(fsaccess->fanotifyfd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM,
+                      FANOTIFY_MASK, fanrootfd, NULL))
+    {
+        LOG_debug << "Unable to watch the filesystem of " << localbasepath << " with fanotify. Error code: " << errno;
+        close(fanrootfd);
+        fanrootfd = -1;
+        return false;
+    }
+
+    memcpy(&fanfsid, &statfsbuf.f_fsid, sizeof fanfsid);
+    fanrootino = (handle)statbuf.st_ino;
+    fanotify = true;
+    fsaccess->fannotifies.push_back(this);
+
+    LOG_debug << "Watching the filesystem of " << localbasepath << " with fanotify";
+    return true;
+}
+#endif
+
 void PosixDirNotify::addnotify(LocalNode* l, string* path)
 {
 #ifdef ENABLE_SYNC
+#ifdef USE_FANOTIFY
+    if (fanotify)
+    {
+        return;
+    }
+#endif
+
 #ifdef USE_INOTIFY
     int wd;
 
@@ -1720,6 +2400,13 @@ void PosixDirNotify::addnotify(LocalNode* l, string* path)
 void PosixDirNotify::delnotify(LocalNode* l)
 {
 #ifdef ENABLE_SYNC
+#ifdef USE_FANOTIFY
+    if (fanotify)
+    {
+        return;
+    }
+#endif
+
 #ifdef USE_INOTIFY
     if (fsaccess->wdnodes.erase((int)(long)l->dirnotifytag))
     {
@@ -1741,7 +2428,13 @@ fsfp_t PosixDirNotify::fsfingerprint()
 
 FileAccess* PosixFileSystemAccess::newfileaccess()
 {
-    return new PosixFileAccess(waiter, defaultfilepermissions);
+    PosixFileAccess* fa = new PosixFileAccess(waiter, defaultfilepermissions);
+
+#ifdef USE_IOURING
+    fa->aioring = aioring;
+#endif
+
+    return fa;
 }
 
 DirAccess* PosixFileSystemAccess::newdiraccess()
@@ -1755,6 +2448,20 @@ DirNotify* PosixFileSystemAccess::newdirnotify(string* localpath, string* ignore
 
     dirnotify->fsaccess = this;
 
+#if defined(ENABLE_SYNC) && defined(USE_FANOTIFY)
+    if (!dirnotify->watchfilesystem())
+#endif
+    {
+#ifdef USE_INOTIFY
+        // notifyfailed may only reflect the availability of fanotify
+        if (notifyfd < 0)
+        {
+            dirnotify->failed = 1;
+            dirnotify->failreason = "inotify not available";
+        }
+#endif
+    }
+
     return dirnotify;
 }
 
@@ -1877,6 +2584,49 @@ bool PosixDirAccess::dnext(string* path, string* name, bool followsymlinks, node
     return false;
 }
 
+// stat the entries relative to the directory, which saves the path lookups
+// (readdir() fetches the entries in batches through getdents64())
+bool PosixDirAccess::dread(direntry_vector* entries, bool followsymlinks)
+{
+    if (globbing || !dp)
+    {
+        return false;
+    }
+
+    int dfd = dirfd(dp);
+    dirent* d;
+    struct stat statbuf;
+
+    if (dfd < 0)
+    {
+        return false;
+    }
+
+    while ((d = readdir(dp)))
+    {
+        if (*d->d_name != '.' || (d->d_name[1] && (d->d_name[1] != '.' || d->d_name[2])))
+        {
+            if (!fstatat(dfd, d->d_name, &statbuf, followsymlinks ? 0 : AT_SYMLINK_NOFOLLOW)
+                    && (S_ISREG(statbuf.st_mode) || S_ISDIR(statbuf.st_mode)))
+            {
+                entries->resize(entries->size() + 1);
+
+                DirEntry* entry = &entries->back();
+                entry->localname = d->d_name;
+                entry->type = S_ISDIR(statbuf.st_mode) ? FOLDERNODE : FILENODE;
+                entry->size = entry->type == FILENODE ? statbuf.st_size : 0;
+                entry->mtime = statbuf.st_mtime;
+                entry->fsid = (handle)statbuf.st_ino;
+                entry->fsidvalid = true;
+
+                FileSystemAccess::captimestamp(&entry->mtime);
+            }
+        }
+    }
+
+    return true;
+}
+
 PosixDirAccess::PosixDirAccess()
 {
     dp = NULL;
@@ -27,6 +27,11 @@
 #define DNS_CACHE_TIMEOUT_DS 18000
 #define MAX_SPEED_CONTROL_TIMEOUT_MS 500
 
+#if !defined(_WIN32) && ARES_VERSION >= 0x010d00 // At least c-ares 1.13.0
+#define ARES_CLOSE_HOOK
+#include <sys/uio.h>
+#endif
+
 namespace mega {
 
 MUTEX_CLASS CurlHttpIO::curlMutex(false);
@@ -122,6 +127,15 @@ CurlHttpIO::CurlHttpIO()
     curlipv6 = data->features & CURL_VERSION_IPV6;
     LOG_debug << "IPv6 enabled: " << curlipv6;
 
+#if LIBCURL_VERSION_NUM >= 0x072f00 // At least cURL 7.47.0
+    http2available = (data->features & CURL_VERSION_HTTP2) != 0;
+#else
+    http2available = false;
+#endif
+    LOG_debug << "HTTP/2 available: " << http2available;
+    multiplexing = false;
+    maxstreams = 0;
+
     dnsok = false;
     reset = false;
     statechange = false;
@@ -169,9 +183,16 @@ CurlHttpIO::CurlHttpIO()
     numconnections[PUT] = 0;
     curlsocketsprocessed = true;
 
+    for (int i = 3; i--; )
+    {
+        numconnects[i] = 0;
+        numcompleted[i] = 0;
+    }
+
     struct ares_options options;
     options.tries = 2;
     ares_init_options(&ares, &options, ARES_OPT_TRIES);
+    setaressocketfunctions();
     arestimeout = -1;
     filterDNSservers();
 
@@ -203,6 +224,9 @@ CurlHttpIO::CurlHttpIO()
     curltimeoutreset[PUT] = -1;
     arerequestspaused[PUT] = false;
 
+    setmultiplexoptions(GET);
+    setmultiplexoptions(PUT);
+
     curlsh = curl_share_init();
     curl_share_setopt(curlsh, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
     curl_share_setopt(curlsh, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
@@ -396,16 +420,8 @@ void CurlHttpIO::addaresevents(Waiter *waiter)
             ((WinWaiter *)waiter)->addhandle(info.handle, Waiter::NEEDEXEC);
         }
 #else
-        if (info.mode & SockInfo::READ)
-        {
-            FD_SET(info.fd, &((PosixWaiter *)waiter)->rfds);
-            ((PosixWaiter *)waiter)->bumpmaxfd(info.fd);
-        }
-        if (info.mode & SockInfo::WRITE)
-        {
-            FD_SET(info.fd, &((PosixWaiter *)waiter)->wfds);
-            ((PosixWaiter *)waiter)->bumpmaxfd(info.fd);
-        }
+        ((PosixWaiter *)waiter)->addfd(info.fd, ((info.mode & SockInfo::READ) ? PosixWaiter::FDREAD : 0)
+                                              | ((info.mode & SockInfo::WRITE) ? PosixWaiter::FDWRITE : 0));
 #endif
         aressockets.push_back(info);
     }
@@ -440,8 +456,7 @@ void CurlHttpIO::addcurlevents(Waiter *waiter, direction_t d)
 #if defined(_WIN32)
             events |= FD_READ;
 #else
-            FD_SET(info.fd, &((PosixWaiter *)waiter)->rfds);
-            ((PosixWaiter *)waiter)->bumpmaxfd(info.fd);
+            ((PosixWaiter *)waiter)->addfd(info.fd, PosixWaiter::FDREAD);
 #endif
         }
 
@@ -450,8 +465,7 @@ void CurlHttpIO::addcurlevents(Waiter *waiter, direction_t d)
 #if defined(_WIN32)
             events |= FD_WRITE;
 #else
-            FD_SET(info.fd, &((PosixWaiter *)waiter)->wfds);
-            ((PosixWaiter *)waiter)->bumpmaxfd(info.fd);
+            ((PosixWaiter *)waiter)->addfd(info.fd, PosixWaiter::FDWRITE);
 #endif
         }
 
@@ -479,6 +493,17 @@ void CurlHttpIO::closearesevents()
             WSACloseEvent(aressockets[i].handle);
         }
     }
+#else
+#ifndef ARES_CLOSE_HOOK
+    // c-ares closes its sockets without notice, the set is rebuilt every round
+    if (waiter)
+    {
+        for (unsigned int i = 0; i < aressockets.size(); i++)
+        {
+            ((PosixWaiter *)waiter)->delfd(aressockets[i].fd);
+        }
+    }
+#endif
 #endif
     aressockets.clear();
 }
@@ -502,8 +527,7 @@ void CurlHttpIO::closecurlevents(direction_t d)
 void CurlHttpIO::processaresevents()
 {
 #ifndef _WIN32
-    fd_set *rfds = &((PosixWaiter *)waiter)->rfds;
-    fd_set *wfds = &((PosixWaiter *)waiter)->wfds;
+    PosixWaiter *pw = (PosixWaiter *)waiter;
 #endif
 
     for (unsigned int i = 0; i < aressockets.size(); i++)
@@ -528,11 +552,12 @@ void CurlHttpIO::processaresevents()
                             (info.mode & SockInfo::WRITE) ? info.fd : ARES_SOCKET_BAD);
         }
 #else
-        if (((info.mode & SockInfo::READ) && FD_ISSET(info.fd, rfds)) || ((info.mode & SockInfo::WRITE) && FD_ISSET(info.fd, wfds)))
+        int events = pw->fdevents(info.fd);
+        if (((info.mode & SockInfo::READ) && (events & PosixWaiter::FDREAD)) || ((info.mode & SockInfo::WRITE) && (events & PosixWaiter::FDWRITE)))
         {
             ares_process_fd(ares,
-                            ((info.mode & SockInfo::READ) && FD_ISSET(info.fd, rfds)) ? info.fd : ARES_SOCKET_BAD,
-                            ((info.mode & SockInfo::WRITE) && FD_ISSET(info.fd, wfds)) ? info.fd : ARES_SOCKET_BAD);
+                            ((info.mode & SockInfo::READ) && (events & PosixWaiter::FDREAD)) ? info.fd : ARES_SOCKET_BAD,
+                            ((info.mode & SockInfo::WRITE) && (events & PosixWaiter::FDWRITE)) ? info.fd : ARES_SOCKET_BAD);
         }
 #endif
     }
@@ -547,8 +572,7 @@ void CurlHttpIO::processaresevents()
 void CurlHttpIO::processcurlevents(direction_t d)
 {
 #ifndef _WIN32
-    fd_set *rfds = &((PosixWaiter *)waiter)->rfds;
-    fd_set *wfds = &((PosixWaiter *)waiter)->wfds;
+    PosixWaiter *pw = (PosixWaiter *)waiter;
 #endif
 
     int dummy = 0;
@@ -579,11 +603,12 @@ void CurlHttpIO::processcurlevents(direction_t d)
                                      &dummy);
         }
 #else
-        if (((info.mode & SockInfo::READ) && FD_ISSET(info.fd, rfds)) || ((info.mode & SockInfo::WRITE) && FD_ISSET(info.fd, wfds)))
+        int events = pw->fdevents(info.fd);
+        if (((info.mode & SockInfo::READ) && (events & PosixWaiter::FDREAD)) || ((info.mode & SockInfo::WRITE) && (events & PosixWaiter::FDWRITE)))
         {
             curl_multi_socket_action(curlm[d], info.fd,
-                                     (((info.mode & SockInfo::READ) && FD_ISSET(info.fd, rfds)) ? CURL_CSELECT_IN : 0)
-                                     | (((info.mode & SockInfo::WRITE) && FD_ISSET(info.fd, wfds)) ? CURL_CSELECT_OUT : 0),
+                                     (((info.mode & SockInfo::READ) && (events & PosixWaiter::FDREAD)) ? CURL_CSELECT_IN : 0)
+                                     | (((info.mode & SockInfo::WRITE) && (events & PosixWaiter::FDWRITE)) ? CURL_CSELECT_OUT : 0),
                                      &dummy);
         }
 #endif
@@ -613,6 +638,10 @@ void CurlHttpIO::processcurlevents(direction_t d)
 
 CurlHttpIO::~CurlHttpIO()
 {
+    // the waiter may already be gone (MegaApiImpl deletes it first) - the
+    // sockets closed below must not be unregistered from it
+    waiter = NULL;
+
     ares_destroy(ares);
     curl_multi_cleanup(curlm[API]);
     curl_multi_cleanup(curlm[GET]);
@@ -684,6 +713,7 @@ void CurlHttpIO::disconnect()
     struct ares_options options;
     options.tries = 2;
     ares_init_options(&ares, &options, ARES_OPT_TRIES);
+    setaressocketfunctions();
     arestimeout = -1;
 
     curl_multi_setopt(curlm[API], CURLMOPT_SOCKETFUNCTION, api_socket_callback);
@@ -714,6 +744,9 @@ void CurlHttpIO::disconnect()
     curltimeoutreset[PUT] = -1;
     arerequestspaused[PUT] = false;
 
+    setmultiplexoptions(GET);
+    setmultiplexoptions(PUT);
+
     if (dnsservers.size())
     {
         LOG_debug << "Using custom DNS servers: " << dnsservers;
@@ -753,6 +786,66 @@ m_off_t CurlHttpIO::getmaxuploadspeed()
     return maxspeed[PUT];
 }
 
+// multiplexing requires HTTP/2, which is only negotiated for HTTPS URLs
+// (ALPN), so that transfers through HTTP URLs keep a connection per request
+bool CurlHttpIO::setmultiplexing(bool enable, int streams)
+{
+    if (enable && !http2available)
+    {
+        LOG_warn << "cURL built without HTTP/2 support";
+        return false;
+    }
+
+    if (multiplexing == enable && maxstreams == streams)
+    {
+        return true;
+    }
+
+    LOG_debug << "HTTP/2 multiplexing of transfers: " << enable << " Max streams: " << streams;
+
+    multiplexing = enable;
+    maxstreams = streams > 0 ? streams : 0;
+
+    // already established connections keep their settings
+    setmultiplexoptions(GET);
+    setmultiplexoptions(PUT);
+    return true;
+}
+
+void CurlHttpIO::setmultiplexoptions(direction_t d)
+{
+#if LIBCURL_VERSION_NUM >= 0x072f00 // At least cURL 7.47.0
+    // no limit of connections per host: the number of requests per storage
+    // server is already bounded by the transfer slots, and a limit would
+    // queue the requests to servers that answer with HTTP/1.1 (one request
+    // per connection) - a full HTTP/2 connection is followed by a new one
+    // once it reaches the maximum number of streams
+    curl_multi_setopt(curlm[d], CURLMOPT_MAX_HOST_CONNECTIONS, 0L);
+
+    if (multiplexing)
+    {
+        curl_multi_setopt(curlm[d], CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+    #if LIBCURL_VERSION_NUM >= 0x074300 // At least cURL 7.67.0
+        curl_multi_setopt(curlm[d], CURLMOPT_MAX_CONCURRENT_STREAMS, long(maxstreams ? maxstreams : 100));
+    #endif
+    }
+    else
+    {
+        // one request per connection, even if HTTP/2 is negotiated (cURL
+        // multiplexes by default since 7.62.0)
+        curl_multi_setopt(curlm[d], CURLMOPT_PIPELINING, CURLPIPE_NOTHING);
+    }
+#endif
+}
+
+void CurlHttpIO::getconnectionstats(direction_t d, HttpConnectionStats* stats)
+{
+    stats->sockets = int(curlsockets[d].size());
+    stats->requests = numconnections[d];
+    stats->connects = numconnects[d];
+    stats->completed = numcompleted[d];
+}
+
 // wake up from cURL I/O
 void CurlHttpIO::addevents(Waiter* w, int)
 {
@@ -1244,6 +1337,16 @@ void CurlHttpIO::send_request(CurlHttpContext* httpctx)
         curl_easy_setopt(curl, CURLOPT_TCP_KEEPIDLE,  90L);
         curl_easy_setopt(curl, CURLOPT_TCP_KEEPINTVL, 60L);
 
+    #if LIBCURL_VERSION_NUM >= 0x072f00 // At least cURL 7.47.0
+        if (httpio->multiplexing && httpctx->d != API)
+        {
+            // wait for a connection being established to the same server
+            // instead of opening another one, in case it is multiplexed
+            curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+            curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+        }
+    #endif
+
         if (httpio->maxspeed[GET] && httpio->maxspeed[GET] <= 102400)
         {
             curl_easy_setopt(curl, CURLOPT_BUFFERSIZE, 4096L);
@@ -1297,6 +1400,11 @@ void CurlHttpIO::send_request(CurlHttpContext* httpctx)
         curl_easy_setopt(curl, CURLOPT_DEBUGDATA, (void*)req);
         curl_easy_setopt(curl, CURLOPT_VERBOSE, 1);
 
+    #ifndef _WIN32
+        curl_easy_setopt(curl, CURLOPT_CLOSESOCKETFUNCTION, closesocket_callback);
+        curl_easy_setopt(curl, CURLOPT_CLOSESOCKETDATA, (void*)httpio);
+    #endif
+
         if (httpio->proxyip.size())
         {
             if(!httpio->proxyscheme.size() || !httpio->proxyscheme.compare(0, 4, "http"))
@@ -1573,6 +1681,7 @@ void CurlHttpIO::post(HttpReq* req, const char* data, unsigned len)
         struct ares_options options;
         options.tries = 2;
         ares_init_options(&ares, &options, ARES_OPT_TRIES);
+        setaressocketfunctions();
 
         if (dnsservers.size())
         {
@@ -1853,6 +1962,15 @@ bool CurlHttpIO::multidoio(CURLM *curlmhandle)
 
             if (msg->msg == CURLMSG_DONE)
             {
+                CurlHttpContext* donectx = (CurlHttpContext*)req->httpiohandle;
+                long connects = 0;
+
+                if (donectx && curl_easy_getinfo(msg->easy_handle, CURLINFO_NUM_CONNECTS, &connects) == CURLE_OK)
+                {
+                    numconnects[donectx->d] += connects;
+                    numcompleted[donectx->d]++;
+                }
+
                 CURLcode errorCode = msg->data.result;
                 if (errorCode != CURLE_OK)
                 {
@@ -2334,6 +2452,12 @@ int CurlHttpIO::socket_callback(CURL *, curl_socket_t s, int what, void *userp,
             WSACloseEvent(handle);
             socketmap[s].handle = WSA_INVALID_EVENT;
         }
+#else
+        // the socket is about to be closed, its number may be reused
+        if (httpio->waiter)
+        {
+            ((PosixWaiter *)httpio->waiter)->delfd(s);
+        }
 #endif
         socketmap[s].mode = 0;
     }
@@ -2409,6 +2533,70 @@ int CurlHttpIO::upload_timer_callback(CURLM *multi, long timeout_ms, void *userp
     return timer_callback(multi, timeout_ms, userp, PUT);
 }
 
+#ifndef _WIN32
+// sockets leave the epoll set only when closed for good; a closed number that is
+// reused with the same events would never be registered again, so the waiter is
+// told about every close
+int CurlHttpIO::closesocket_callback(void *clientp, curl_socket_t s)
+{
+    CurlHttpIO *httpio = (CurlHttpIO *)clientp;
+    if (httpio->waiter)
+    {
+        ((PosixWaiter *)httpio->waiter)->delfd(s);
+    }
+    return close(s);
+}
+#endif
+
+#ifdef ARES_CLOSE_HOOK
+static ares_socket_t ares_socket_callback(int af, int type, int protocol, void *)
+{
+    return socket(af, type, protocol);
+}
+
+static int ares_connect_callback(ares_socket_t s, const struct sockaddr *addr, ares_socklen_t len, void *)
+{
+    return connect(s, addr, len);
+}
+
+static ares_ssize_t ares_recvfrom_callback(ares_socket_t s, void *buf, size_t len, int flags,
+                                           struct sockaddr *from, ares_socklen_t *fromlen, void *)
+{
+    return recvfrom(s, buf, len, flags, from, fromlen);
+}
+
+static ares_ssize_t ares_sendv_callback(ares_socket_t s, const struct iovec *vec, int len, void *)
+{
+    return writev(s, vec, len);
+}
+
+int CurlHttpIO::ares_close_callback(ares_socket_t s, void *userp)
+{
+    CurlHttpIO *httpio = (CurlHttpIO *)userp;
+    if (httpio->waiter)
+    {
+        ((PosixWaiter *)httpio->waiter)->delfd(s);
+    }
+    return close(s);
+}
+#endif
+
+// route the socket calls of the current c-ares channel through the close hook
+void CurlHttpIO::setaressocketfunctions()
+{
+#ifdef ARES_CLOSE_HOOK
+    static const struct ares_socket_functions functions = {
+        ares_socket_callback,
+        ares_close_callback,
+        ares_connect_callback,
+        ares_recvfrom_callback,
+        ares_sendv_callback
+    };
+
+    ares_set_socket_functions(ares, &functions, this);
+#endif
+}
+
 #ifdef USE_OPENSSL
 CURLcode CurlHttpIO::ssl_ctx_function(CURL*, void* sslctx, void*req)
 {
@@ -54,15 +54,235 @@ PosixWaiter::PosixWaiter()
         LOG_err << "fcntl error";
     }
 
+#ifdef USE_EPOLL
+    epollfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollfd < 0)
+    {
+        LOG_fatal << "Error creating epoll instance";
+        throw std::runtime_error("Error creating epoll instance");
+    }
+
+    epollevents.resize(64);
+#else
     maxfd = -1;
+#endif
 }
 
 PosixWaiter::~PosixWaiter()
 {
+#ifdef USE_EPOLL
+    close(epollfd);
+#endif
     close(m_pipe[0]);
     close(m_pipe[1]);
 }
 
+// update monotonously increasing timestamp in deciseconds
+void Waiter::bumpds()
+{
+    timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    ds = ts.tv_sec * 10 + ts.tv_nsec / 100000000;
+}
+
+int64_t Waiter::us()
+{
+    timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return int64_t(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+#ifdef USE_EPOLL
+void PosixWaiter::init(dstime ds)
+{
+    Waiter::init(ds);
+
+    for (size_t i = 0; i < wantedfds.size(); i++)
+    {
+        wanted[wantedfds[i]] = 0;
+    }
+    wantedfds.clear();
+}
+
+void PosixWaiter::addfd(int fd, int events, bool ignore)
+{
+    if (fd < 0)
+    {
+        return;
+    }
+
+    if ((size_t)fd >= wanted.size())
+    {
+        wanted.resize(fd + 1);
+        registered.resize(fd + 1);
+        reported.resize(fd + 1);
+    }
+
+    if (!wanted[fd])
+    {
+        wantedfds.push_back(fd);
+    }
+
+    wanted[fd] |= events | (ignore ? 0 : FDWANTED);
+}
+
+int PosixWaiter::fdevents(int fd) const
+{
+    return (fd >= 0 && (size_t)fd < reported.size()) ? reported[fd] : 0;
+}
+
+void PosixWaiter::delfd(int fd)
+{
+    if (fd >= 0 && (size_t)fd < registered.size() && registered[fd])
+    {
+        epoll_ctl(epollfd, EPOLL_CTL_DEL, fd, NULL);
+        registered[fd] = 0;
+    }
+}
+
+// add, modify or remove (events == 0) the epoll registration of an fd
+void PosixWaiter::epollupdate(int fd, int events)
+{
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof ev);
+    ev.events = ((events & FDREAD) ? (uint32_t)EPOLLIN : 0u) | ((events & FDWRITE) ? (uint32_t)EPOLLOUT : 0u);
+    ev.data.fd = fd;
+
+    int op = !events ? EPOLL_CTL_DEL : (registered[fd] ? EPOLL_CTL_MOD : EPOLL_CTL_ADD);
+    int r = epoll_ctl(epollfd, op, fd, &ev);
+
+    // the fd was closed and reused without delfd(), or registered twice
+    if (r < 0 && op == EPOLL_CTL_MOD && errno == ENOENT)
+    {
+        r = epoll_ctl(epollfd, EPOLL_CTL_ADD, fd, &ev);
+    }
+    else if (r < 0 && op == EPOLL_CTL_ADD && errno == EEXIST)
+    {
+        r = epoll_ctl(epollfd, EPOLL_CTL_MOD, fd, &ev);
+    }
+
+    if (r < 0 && op != EPOLL_CTL_DEL)
+    {
+        LOG_warn << "Unable to watch fd " << fd << ": " << errno;
+        events = 0;
+    }
+
+    if (events && !registered[fd])
+    {
+        registeredfds.push_back(fd);
+    }
+
+    registered[fd] = (unsigned char)events;
+}
+
+// wait for supplied events (sockets, filesystem changes), plus timeout + application events
+// maxds specifies the maximum amount of time to wait in deciseconds (or ~0 if no timeout scheduled)
+// returns application-specific bitmask. bit 0 set indicates that exec() needs to be called.
+int PosixWaiter::wait()
+{
+    //Pipe added to be able to leave epoll_wait() when needed
+    addfd(m_pipe[0], FDREAD);
+
+    // register new fds and changed events
+    for (size_t i = 0; i < wantedfds.size(); i++)
+    {
+        int fd = wantedfds[i];
+        int events = wanted[fd] & (FDREAD | FDWRITE);
+
+        if (registered[fd] != events)
+        {
+            epollupdate(fd, events);
+        }
+    }
+
+    // unregister the fds that are no longer of interest
+    size_t n = 0;
+    for (size_t i = 0; i < registeredfds.size(); i++)
+    {
+        int fd = registeredfds[i];
+
+        if (registered[fd] && !(wanted[fd] & (FDREAD | FDWRITE)))
+        {
+            epollupdate(fd, 0);
+        }
+
+        if (registered[fd])
+        {
+            registeredfds[n++] = fd;
+        }
+    }
+    registeredfds.resize(n);
+
+    for (size_t i = 0; i < reportedfds.size(); i++)
+    {
+        reported[reportedfds[i]] = 0;
+    }
+    reportedfds.clear();
+
+    int timeout = -1;
+    if (maxds + 1)
+    {
+        timeout = (maxds > INT_MAX / 100) ? INT_MAX : (int)(maxds * 100);
+    }
+
+    if (epollevents.size() < registeredfds.size())
+    {
+        epollevents.resize(registeredfds.size());
+    }
+
+    int numfd = epoll_wait(epollfd, &epollevents[0], (int)epollevents.size(), timeout);
+
+    bool exec = false;
+    for (int i = 0; i < numfd; i++)
+    {
+        int fd = epollevents[i].data.fd;
+        uint32_t ev = epollevents[i].events;
+        int events = 0;
+
+        // errors and hangups are reported as activity, as select() does
+        if (ev & (EPOLLIN | EPOLLERR | EPOLLHUP))
+        {
+            events |= wanted[fd] & FDREAD;
+        }
+        if (ev & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+        {
+            events |= wanted[fd] & FDWRITE;
+        }
+
+        if (events)
+        {
+            reported[fd] = (unsigned char)events;
+            reportedfds.push_back(fd);
+
+            if (wanted[fd] & FDWANTED)
+            {
+                exec = true;
+            }
+        }
+    }
+
+    // empty pipe
+    uint8_t buf;
+    bool external = false;
+    while (read(m_pipe[0], &buf, sizeof buf) > 0)
+    {
+        external = true;
+    }
+
+    // timeout or error
+    if (external || numfd <= 0)
+    {
+        return NEEDEXEC;
+    }
+
+    // request exec() to be run only if a non-ignored fd was triggered
+    return exec ? NEEDEXEC : 0;
+}
+#else
 void PosixWaiter::init(dstime ds)
 {
     Waiter::init(ds);
@@ -75,14 +295,43 @@ void PosixWaiter::init(dstime ds)
     FD_ZERO(&ignorefds);
 }
 
-// update monotonously increasing timestamp in deciseconds
-void Waiter::bumpds()
+void PosixWaiter::addfd(int fd, int events, bool ignore)
 {
-    timespec ts;
+    if (fd < 0)
+    {
+        return;
+    }
 
-    clock_gettime(CLOCK_MONOTONIC, &ts);
+    if (events & FDREAD)
+    {
+        FD_SET(fd, &rfds);
+    }
 
-    ds = ts.tv_sec * 10 + ts.tv_nsec / 100000000;
+    if (events & FDWRITE)
+    {
+        FD_SET(fd, &wfds);
+    }
+
+    if (ignore)
+    {
+        FD_SET(fd, &ignorefds);
+    }
+
+    bumpmaxfd(fd);
+}
+
+int PosixWaiter::fdevents(int fd) const
+{
+    if (fd < 0 || fd > maxfd)
+    {
+        return 0;
+    }
+
+    return (FD_ISSET(fd, &rfds) ? FDREAD : 0) | (FD_ISSET(fd, &wfds) ? FDWRITE : 0);
+}
+
+void PosixWaiter::delfd(int)
+{
 }
 
 // update maxfd for select()
@@ -147,6 +396,7 @@ int PosixWaiter::wait()
          || fd_filter(maxfd + 1, &wfds, &ignorefds)
          || fd_filter(maxfd + 1, &efds, &ignorefds)) ? NEEDEXEC : 0;
 }
+#endif
 
 void PosixWaiter::notify()
 {
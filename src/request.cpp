@@ -23,6 +23,7 @@
 #include "mega/command.h"
 #include "mega/logging.h"
 #include "mega/megaclient.h"
+#include "mega/metrics.h"
 
 namespace mega {
 void Request::add(Command* c)
@@ -110,6 +111,7 @@ void Request::clear()
 RequestDispatcher::RequestDispatcher()
 {
     r = 0;
+    senttime = 0;
 }
 
 void RequestDispatcher::nextRequest()
@@ -146,13 +148,26 @@ int RequestDispatcher::cmdspending() const
     return reqs[r].cmdspending();
 }
 
-void RequestDispatcher::get(string *out) const
+void RequestDispatcher::get(string *out)
 {
+    // a retried request set keeps its original send time and is counted once
+    if (!senttime)
+    {
+        Metrics::observe(Metrics::API_REQUEST_COMMANDS, reqs[r].cmdspending());
+        senttime = Waiter::us();
+    }
+
     reqs[r].get(out);
 }
 
 void RequestDispatcher::procresult(MegaClient *client)
 {
+    if (senttime)
+    {
+        Metrics::observe(Metrics::API_REQUEST_DURATION, Waiter::us() - senttime);
+        senttime = 0;
+    }
+
     reqs[r ^ 1].procresult(client);
 }
 
@@ -163,6 +178,8 @@ void RequestDispatcher::clear()
         reqs[i].clear();
     }
 
+    senttime = 0;
+
     while (!reqbuf.empty())
     {
         Command *c = reqbuf.front();
@@ -59,9 +59,14 @@ bool Share::unserialize(MegaClient* client, int direction, handle h,
         // Pending flag exists
         ph = MemAccess::get<handle>(*ptr + sizeof(handle) + sizeof(m_time_t) + 2);       
     }
-    client->newshares.push_back(new NewShare(h, direction, MemAccess::get<handle>(*ptr),
-                                             (accesslevel_t)(*ptr)[sizeof(handle) + sizeof(m_time_t)],
-                                             MemAccess::get<m_time_t>(*ptr + sizeof(handle)), key, NULL, ph));
+
+    // no client: only skip the share
+    if (client)
+    {
+        client->newshares.push_back(new NewShare(h, direction, MemAccess::get<handle>(*ptr),
+                                                 (accesslevel_t)(*ptr)[sizeof(handle) + sizeof(m_time_t)],
+                                                 MemAccess::get<m_time_t>(*ptr + sizeof(handle)), key, NULL, ph));
+    }
 
     *ptr += sizeof(handle) + sizeof(m_time_t) + 2;
     if (version_flag >= 1)
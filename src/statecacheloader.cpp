@@ -0,0 +1,281 @@
+/**
+ * @file statecacheloader.cpp
+ * @brief Pipelined loading of the state cache
+ *
+ * (c) 2013-2018 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mega.h"
+#include "mega/statecacheloader.h"
+
+namespace mega {
+StateCacheLoader::StateCacheLoader(DbTable* t, FileSystemAccess* fs, SymmCipher* k, int numthreads) : mutex(false)
+{
+    table = t;
+    fsaccess = fs;
+    memcpy(key, k->key, sizeof key);
+
+    numread = 0;
+    numdecoded = 0;
+    decodedtime = 0;
+    readdone = false;
+    exiting = false;
+    current = NULL;
+    numreturned = 0;
+
+    // one batch being read and one being linked on top of the ones in the
+    // workers' hands
+    for (int i = numthreads * BATCHES_PER_THREAD + 2; i--; )
+    {
+        StateCacheBatch* batch = new StateCacheBatch();
+        batches.push_back(batch);
+        freebatches.push_back(batch);
+        freeready.release();
+    }
+
+    LOG_debug << "Loading local cache with " << numthreads << " decryption threads";
+
+    while (numthreads-- > 0)
+    {
+        THREAD_CLASS* thread = new THREAD_CLASS();
+        workers.push_back(thread);
+        thread->start(workerEntryPoint, this);
+    }
+
+    reader.start(readerEntryPoint, this);
+}
+
+StateCacheLoader::~StateCacheLoader()
+{
+    mutex.lock();
+    exiting = true;
+    mutex.unlock();
+
+    freeready.release();
+
+    for (size_t i = workers.size(); i--; )
+    {
+        decodeready.release();
+    }
+
+    reader.join();
+
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i]->join();
+        delete workers[i];
+    }
+
+    for (size_t i = 0; i < batches.size(); i++)
+    {
+        delete batches[i];
+    }
+}
+
+void* StateCacheLoader::readerEntryPoint(void* param)
+{
+    ((StateCacheLoader*)param)->readloop();
+    return NULL;
+}
+
+void* StateCacheLoader::workerEntryPoint(void* param)
+{
+    ((StateCacheLoader*)param)->decodeloop();
+    return NULL;
+}
+
+// reader thread: the only user of the table until the loader is deleted
+void StateCacheLoader::readloop()
+{
+    for (;;)
+    {
+        freeready.wait();
+
+        mutex.lock();
+        if (exiting)
+        {
+            mutex.unlock();
+            break;
+        }
+
+        StateCacheBatch* batch = freebatches.front();
+        freebatches.pop_front();
+        mutex.unlock();
+
+        batch->count = 0;
+        while (batch->count < StateCacheBatch::RECORDS
+               && table->next(&batch->ids[batch->count], &batch->data[batch->count]))
+        {
+            table->checkid(batch->ids[batch->count]);
+            batch->count++;
+        }
+
+        bool last = batch->count < StateCacheBatch::RECORDS;
+
+        mutex.lock();
+        if (batch->count)
+        {
+            batch->seq = numread++;
+            decodebatches.push_back(batch);
+        }
+        else
+        {
+            freebatches.push_back(batch);
+        }
+
+        readdone = last;
+        checkdecoded();
+        mutex.unlock();
+
+        if (batch->count)
+        {
+            decodeready.release();
+        }
+        else
+        {
+            freeready.release();
+        }
+
+        if (last)
+        {
+            resultready.release();
+            break;
+        }
+    }
+}
+
+// worker threads: private cipher, no client state
+void StateCacheLoader::decodeloop()
+{
+    SymmCipher cipher;
+    cipher.setkey(key);
+
+    for (;;)
+    {
+        decodeready.wait();
+
+        mutex.lock();
+        if (decodebatches.empty())
+        {
+            bool exit = exiting;
+            mutex.unlock();
+
+            if (exit)
+            {
+                break;
+            }
+
+            continue;
+        }
+
+        StateCacheBatch* batch = decodebatches.front();
+        decodebatches.pop_front();
+        bool exit = exiting;
+        mutex.unlock();
+
+        // the scsn record (id 0) isn't encrypted
+        for (unsigned i = 0; !exit && i < batch->count; i++)
+        {
+            uint32_t id = batch->ids[i];
+            string* data = &batch->data[i];
+
+            batch->valid[i] = !id || PaddedCBC::decrypt(data, &cipher);
+            batch->decoded[i] = batch->valid[i] && (id & 15) == MegaClient::CACHEDNODE
+                    && batch->nodes[i].decode(data->data(), data->size(), fsaccess);
+        }
+
+        mutex.lock();
+        decodedbatches[batch->seq] = batch;
+        numdecoded++;
+        checkdecoded();
+        mutex.unlock();
+
+        resultready.release();
+    }
+}
+
+StateCacheBatch* StateCacheLoader::next()
+{
+    bool recycled = current != NULL;
+
+    mutex.lock();
+
+    if (current)
+    {
+        freebatches.push_back(current);
+        current = NULL;
+    }
+
+    for (;;)
+    {
+        std::map<unsigned, StateCacheBatch*>::iterator it = decodedbatches.begin();
+
+        if (it != decodedbatches.end() && it->first == numreturned)
+        {
+            current = it->second;
+            decodedbatches.erase(it);
+            numreturned++;
+            break;
+        }
+
+        if (readdone && numreturned == numread)
+        {
+            break;
+        }
+
+        mutex.unlock();
+        resultready.wait();
+        mutex.lock();
+    }
+
+    mutex.unlock();
+
+    if (recycled)
+    {
+        freeready.release();
+    }
+
+    return current;
+}
+
+bool StateCacheLoader::allread()
+{
+    mutex.lock();
+    bool done = readdone;
+    mutex.unlock();
+
+    return done;
+}
+
+// must be called with the mutex held
+void StateCacheLoader::checkdecoded()
+{
+    if (readdone && numdecoded == numread && !decodedtime)
+    {
+        decodedtime = Waiter::us();
+    }
+}
+
+int64_t StateCacheLoader::alldecoded()
+{
+    mutex.lock();
+    int64_t t = decodedtime;
+    mutex.unlock();
+
+    return t;
+}
+} // namespace
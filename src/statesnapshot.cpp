@@ -0,0 +1,218 @@
+/**
+ * @file statesnapshot.cpp
+ * @brief Binary snapshot of the state cache for fast session resumption
+ *
+ * (c) 2013-2018 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mega.h"
+#include "mega/statesnapshot.h"
+
+namespace mega {
+StateSnapshot::StateSnapshot()
+{
+    memset(&header, 0, sizeof header);
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.scsn = UNDEF;
+    header.firstnode = NONE;
+}
+
+void StateSnapshot::add(uint32_t dbid, string* d, handle h)
+{
+    Record r;
+
+    // no uninitialized padding in the file
+    memset(&r, 0, sizeof r);
+
+    r.h = h;
+    r.dbid = dbid;
+    r.offset = uint32_t(pool.size());
+    r.length = uint32_t(d->size());
+
+    if (!ISUNDEF(h) && header.firstnode == NONE)
+    {
+        header.firstnode = uint32_t(records.size());
+    }
+
+    records.push_back(r);
+    pool.append(*d);
+}
+
+// independent encryption and MAC keys
+void StateSnapshot::derivekeys(SymmCipher* masterkey, SymmCipher* cipher, byte* mackey)
+{
+    byte buf[SymmCipher::BLOCKSIZE];
+
+    memcpy(buf, "statesnapshotenc", sizeof buf);
+    masterkey->ecb_encrypt(buf);
+    cipher->setkey(buf);
+
+    memcpy(mackey, "statesnapshotmac", SymmCipher::BLOCKSIZE);
+    masterkey->ecb_encrypt(mackey);
+}
+
+bool StateSnapshot::write(FileSystemAccess* fsaccess, const string& path, SymmCipher* masterkey)
+{
+    if (pool.size() + records.size() * sizeof(Record) > 0x7FFFFFFF)
+    {
+        LOG_warn << "State snapshot too large";
+        return false;
+    }
+
+    SymmCipher cipher;
+    byte mackey[SymmCipher::BLOCKSIZE];
+    derivekeys(masterkey, &cipher, mackey);
+
+    header.numrecords = uint32_t(records.size());
+    header.poolsize = uint32_t(pool.size());
+    PrnGen::genblock((byte*)&header.ctriv, sizeof header.ctriv);
+
+    size_t payload = records.size() * sizeof(Record) + pool.size();
+    payload += (SymmCipher::BLOCKSIZE - payload % SymmCipher::BLOCKSIZE) % SymmCipher::BLOCKSIZE;
+
+    buf.assign((char*)&header, sizeof header);
+    if (records.size())
+    {
+        buf.append((char*)&records[0], records.size() * sizeof(Record));
+    }
+    buf.append(pool);
+    buf.resize(sizeof header + payload);
+
+    cipher.ctr_crypt((byte*)buf.data() + sizeof header, unsigned(payload), 0, header.ctriv, NULL, true);
+
+    byte mac[MACLENGTH];
+    HMACSHA256 hmac(mackey, sizeof mackey);
+    hmac.add((const byte*)buf.data(), unsigned(buf.size()));
+    hmac.get(mac);
+    buf.append((char*)mac, sizeof mac);
+
+    // write to a temporary file, then move it over the previous snapshot
+    string tmppath = path + ".tmp";
+    string localpath, localtmppath;
+    fsaccess->path2local((string*)&path, &localpath);
+    fsaccess->path2local(&tmppath, &localtmppath);
+    fsaccess->unlinklocal(&localtmppath);
+
+    FileAccess* fa = fsaccess->newfileaccess();
+    bool written = fa->fopen(&localtmppath, false, true)
+            && fa->fwrite((const byte*)buf.data(), unsigned(buf.size()), 0);
+    delete fa;
+
+    buf.clear();
+
+    if (!written || !fsaccess->renamelocal(&localtmppath, &localpath, true))
+    {
+        LOG_warn << "Unable to write the state snapshot";
+        fsaccess->unlinklocal(&localtmppath);
+        return false;
+    }
+
+    return true;
+}
+
+bool StateSnapshot::read(FileSystemAccess* fsaccess, const string& path, SymmCipher* masterkey)
+{
+    string localpath;
+    fsaccess->path2local((string*)&path, &localpath);
+
+    FileAccess* fa = fsaccess->newfileaccess();
+    bool ok = fa->fopen(&localpath, true, false)
+            && fa->size >= m_off_t(sizeof header + MACLENGTH)
+            && fa->size <= 0x7FFFFFFF
+            && fa->fread(&buf, unsigned(fa->size), 0, 0);
+    delete fa;
+
+    if (!ok)
+    {
+        buf.clear();
+        return false;
+    }
+
+    SymmCipher cipher;
+    byte mackey[SymmCipher::BLOCKSIZE];
+    derivekeys(masterkey, &cipher, mackey);
+
+    size_t size = buf.size() - MACLENGTH;
+    byte mac[MACLENGTH];
+    HMACSHA256 hmac(mackey, sizeof mackey);
+    hmac.add((const byte*)buf.data(), unsigned(size));
+    hmac.get(mac);
+
+    // constant time comparison
+    byte diff = 0;
+    for (int i = MACLENGTH; i--; )
+    {
+        diff |= mac[i] ^ (byte)buf[size + i];
+    }
+
+    memcpy(&header, buf.data(), sizeof header);
+
+    size_t payload = size - sizeof header;
+
+    if (diff
+            || header.magic != MAGIC
+            || header.version != VERSION
+            || payload % SymmCipher::BLOCKSIZE
+            || header.numrecords > payload / sizeof(Record)
+            || header.poolsize > payload - header.numrecords * sizeof(Record))
+    {
+        LOG_warn << "Invalid state snapshot";
+        buf.clear();
+        return false;
+    }
+
+    buf.resize(size);
+    cipher.ctr_crypt((byte*)buf.data() + sizeof header, unsigned(payload), 0, header.ctriv, NULL, false);
+
+    for (uint32_t i = 0; i < header.numrecords; i++)
+    {
+        const Record* r = record(i);
+
+        if (r->offset > header.poolsize || r->length > header.poolsize - r->offset)
+        {
+            LOG_warn << "Invalid state snapshot record";
+            buf.clear();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void StateSnapshot::remove(FileSystemAccess* fsaccess, const string& path)
+{
+    string localpath;
+    fsaccess->path2local((string*)&path, &localpath);
+    fsaccess->unlinklocal(&localpath);
+}
+
+uint32_t StateSnapshot::numrecords() const
+{
+    return buf.size() ? header.numrecords : 0;
+}
+
+const StateSnapshot::Record* StateSnapshot::record(uint32_t i) const
+{
+    return (const Record*)(buf.data() + sizeof header) + i;
+}
+
+const char* StateSnapshot::data(const Record* r) const
+{
+    return buf.data() + sizeof header + header.numrecords * sizeof(Record) + r->offset;
+}
+} // namespace
@@ -57,6 +57,12 @@ Sync::Sync(MegaClient* cclient, string* crootpath, const char* cdebris,
     localnodes[FILENODE] = 0;
     localnodes[FOLDERNODE] = 0;
 
+    scanner = NULL;
+    scanentry = NULL;
+    scanentries = 0;
+    scanstart = NEVER;
+    scanrate = 0;
+
     state = SYNC_INITIALSCAN;
     statecachetable = NULL;
 
@@ -121,6 +127,8 @@ Sync::Sync(MegaClient* cclient, string* crootpath, const char* cdebris,
 
         delete fas;
     }
+
+    startscan();
 }
 
 Sync::~Sync()
@@ -131,6 +139,8 @@ Sync::~Sync()
     // unlock tmp lock
     delete tmpfa;
 
+    delete scanner;
+
     // stop all active and pending downloads
     if (localroot.node)
     {
@@ -249,6 +259,9 @@ void Sync::statecacheadd(LocalNode* l)
     }
 
     insertq.insert(l);
+
+    // changed nodes have to be reconciled as well
+    l->setsyncdirty();
 }
 
 void Sync::cachenodes()
@@ -259,30 +272,36 @@ void Sync::cachenodes()
         statecachetable->begin();
 
         // deletions
-        for (set<int32_t>::iterator it = deleteq.begin(); it != deleteq.end(); it++)
+        if (deleteq.size())
         {
-            statecachetable->del(*it);
+            vector<uint32_t> ids(deleteq.begin(), deleteq.end());
+            statecachetable->delmany(&ids[0], ids.size());
         }
 
         deleteq.clear();
 
-        // additions - we iterate until completion or until we get stuck
-        bool added;
+        // additions - a node can only be written once its parent has a dbid,
+        // so we write in batches until completion or until we get stuck
+        vector<Cachable*> batch;
 
         do {
-            added = false;
+            batch.clear();
 
             for (set<LocalNode*>::iterator it = insertq.begin(); it != insertq.end(); )
             {
                 if ((*it)->parent->dbid || (*it)->parent == &localroot)
                 {
-                    statecachetable->put(MegaClient::CACHEDLOCALNODE, *it, &client->key);
+                    batch.push_back(*it);
                     insertq.erase(it++);
-                    added = true;
                 }
                 else it++;
             }
-        } while (added);
+
+            if (batch.size())
+            {
+                statecachetable->putmany(MegaClient::CACHEDLOCALNODE, &batch[0], batch.size(), &client->key);
+            }
+        } while (batch.size());
 
         statecachetable->commit();
 
@@ -297,6 +316,11 @@ void Sync::changestate(syncstate_t newstate)
 {
     if (newstate != state)
     {
+        if (state == SYNC_INITIALSCAN)
+        {
+            endscan();
+        }
+
         client->app->syncupdate_state(this, newstate);
 
         if (newstate == SYNC_FAILED && statecachetable)
@@ -311,6 +335,40 @@ void Sync::changestate(syncstate_t newstate)
     }
 }
 
+// full scan statistics, and read-ahead by scanner threads if enabled
+void Sync::startscan()
+{
+    delete scanner;
+    scanner = NULL;
+
+    if (client->syncscanthreads)
+    {
+        scanner = new SyncScanner(client->fsaccess, &localroot.localname, &localdebris,
+                                  client->followsymlinks, client->syncscanthreads);
+    }
+
+    scanentries = 0;
+    scanstart = Waiter::ds;
+}
+
+void Sync::endscan()
+{
+    if (scanstart == NEVER)
+    {
+        return;
+    }
+
+    delete scanner;
+    scanner = NULL;
+
+    dstime ds = Waiter::ds - scanstart;
+    scanrate = scanentries * 10 / (ds ? ds : 1);
+    scanstart = NEVER;
+
+    LOG_debug << "Full scan completed: " << scanentries << " entries in " << ds << " ds ("
+              << scanrate << " entries/s)";
+}
+
 // walk path and return corresponding LocalNode and its parent
 // path must be relative to l or start with the root prefix if l == NULL
 // path must be a full sync path, i.e. start with localroot->localname
@@ -435,13 +493,27 @@ bool Sync::scan(string* localpath, FileAccess* fa)
 
         da = client->fsaccess->newdiraccess();
 
+        // use the enumeration of the scanner threads, if available
+        ScanBatch* batch = scanner ? scanner->take(localpath) : NULL;
+        size_t i = 0;
+
         // scan the dir, mark all items with a unique identifier
-        if ((success = da->dopen(localpath, fa, false)))
+        if ((success = batch || da->dopen(localpath, fa, false)))
         {
             size_t t = localpath->size();
 
-            while (da->dnext(localpath, &localname, client->followsymlinks))
+            while (batch ? i < batch->entries.size() : da->dnext(localpath, &localname, client->followsymlinks))
             {
+                DirEntry* entry = NULL;
+
+                if (batch)
+                {
+                    entry = &batch->entries[i++];
+                    localname = entry->localname;
+                }
+
+                scanentries++;
+
                 name = localname;
                 client->fsaccess->local2name(&name);
 
@@ -467,7 +539,9 @@ bool Sync::scan(string* localpath, FileAccess* fa)
                         if (initializing)
                         {
                             // preload all cached LocalNodes
+                            scanentry = entry;
                             l = checkpath(NULL, localpath);
+                            scanentry = NULL;
                         }
 
                         if (!l || l == (LocalNode*)~0)
@@ -480,12 +554,19 @@ bool Sync::scan(string* localpath, FileAccess* fa)
                 else
                 {
                     LOG_debug << "Excluded: " << name;
+
+                    // nothing below it will be taken from the scanner
+                    if (scanner)
+                    {
+                        scanner->skip(localpath);
+                    }
                 }
 
                 localpath->resize(t);
             }
         }
 
+        delete batch;
         delete da;
 
         return success;
@@ -506,6 +587,10 @@ LocalNode* Sync::checkpath(LocalNode* l, string* localpath, string* localname, d
     bool newnode = false, changed = false;
     bool isroot;
 
+    // set by scan() if the entry has already been read by the scanner
+    DirEntry* entry = scanentry;
+    scanentry = NULL;
+
     LocalNode* parent;
     string path;        // UTF-8 representation of tmppath
     string tmppath;     // full path represented by l + localpath
@@ -619,7 +704,16 @@ LocalNode* Sync::checkpath(LocalNode* l, string* localpath, string* localname, d
 
         // match cached LocalNode state during initial/rescan to prevent costly re-fingerprinting
         // (just compare the fsids, sizes and mtimes to detect changes)
-        if (fa->fopen(localname ? localpath : &tmppath, false, false))
+        if (entry)
+        {
+            fa->type = entry->type;
+            fa->size = entry->size;
+            fa->mtime = entry->mtime;
+            fa->fsid = entry->fsid;
+            fa->fsidvalid = entry->fsidvalid;
+        }
+
+        if (entry || fa->fopen(localname ? localpath : &tmppath, false, false))
         {
             if (cl && fa->fsidvalid && fa->fsid == cl->fsid)
             {
@@ -635,7 +729,8 @@ LocalNode* Sync::checkpath(LocalNode* l, string* localpath, string* localname, d
 
                     if (l->type == FOLDERNODE)
                     {
-                        scan(localname ? localpath : &tmppath, fa);
+                        // (the folder hasn't been opened if read by the scanner)
+                        scan(localname ? localpath : &tmppath, entry ? NULL : fa);
                     }
                     else
                     {
@@ -754,22 +849,33 @@ LocalNode* Sync::checkpath(LocalNode* l, string* localpath, string* localname, d
                                 l->setfsid(fa->fsid);
                             }
 
-                            m_off_t dsize = l->size > 0 ? l->size : 0;
-
-                            if (l->genfingerprint(fa) && l->size >= 0)
+                            if (fingerprintasync(l, fa, localname ? localpath : &tmppath, false))
                             {
-                                localbytes -= dsize - l->size;
+                                // the change is reported by fingerprintdone()
+                                client->stopxfer(l);
+                                l->deleted = false;
+
+                                client->syncactivity = true;
                             }
+                            else
+                            {
+                                m_off_t dsize = l->size > 0 ? l->size : 0;
 
-                            client->app->syncupdate_local_file_change(this, l, path.c_str());
+                                if (l->genfingerprint(fa) && l->size >= 0)
+                                {
+                                    localbytes -= dsize - l->size;
+                                }
 
-                            client->stopxfer(l);
-                            l->bumpnagleds();
-                            l->deleted = false;
+                                client->app->syncupdate_local_file_change(this, l, path.c_str());
 
-                            client->syncactivity = true;
+                                client->stopxfer(l);
+                                l->bumpnagleds();
+                                l->deleted = false;
 
-                            statecacheadd(l);
+                                client->syncactivity = true;
+
+                                statecacheadd(l);
+                            }
 
                             delete fa;
 
@@ -1017,36 +1123,43 @@ LocalNode* Sync::checkpath(LocalNode* l, string* localpath, string* localname, d
                         l->setfsid(fa->fsid);
                     }
 
-                    if (l->size > 0)
+                    if ((newnode || l->fingerprinting) && fingerprintasync(l, fa, localname ? localpath : &tmppath, newnode))
                     {
-                        localbytes -= l->size;
+                        // the addition is reported by fingerprintdone()
                     }
-
-                    if (l->genfingerprint(fa))
+                    else
                     {
-                        changed = true;
-                        l->bumpnagleds();
-                        l->deleted = false;
-                    }
+                        if (l->size > 0)
+                        {
+                            localbytes -= l->size;
+                        }
 
-                    if (l->size > 0)
-                    {
-                        localbytes += l->size;
-                    }
+                        if (l->genfingerprint(fa))
+                        {
+                            changed = true;
+                            l->bumpnagleds();
+                            l->deleted = false;
+                        }
 
-                    if (newnode)
-                    {
-                        client->app->syncupdate_local_file_addition(this, l, path.c_str());
-                    }
-                    else if (changed)
-                    {
-                        client->app->syncupdate_local_file_change(this, l, path.c_str());
-                        client->stopxfer(l);
-                    }
+                        if (l->size > 0)
+                        {
+                            localbytes += l->size;
+                        }
 
-                    if (newnode || changed)
-                    {
-                        statecacheadd(l);
+                        if (newnode)
+                        {
+                            client->app->syncupdate_local_file_addition(this, l, path.c_str());
+                        }
+                        else if (changed)
+                        {
+                            client->app->syncupdate_local_file_change(this, l, path.c_str());
+                            client->stopxfer(l);
+                        }
+
+                        if (newnode || changed)
+                        {
+                            statecacheadd(l);
+                        }
                     }
                 }
             }
@@ -1104,6 +1217,82 @@ LocalNode* Sync::checkpath(LocalNode* l, string* localpath, string* localname, d
     return l;
 }
 
+// large files are fingerprinted by the worker threads, small ones are read
+// in one go anyway
+bool Sync::fingerprintasync(LocalNode* l, FileAccess* fa, string* localpath, bool newnode)
+{
+    if (!client->fingerprintpool || fa->size <= FileFingerprint::MAXFULL)
+    {
+        return false;
+    }
+
+    client->fingerprintpool->queue(l, localpath, newnode);
+    l->fingerprinting = true;
+
+    return true;
+}
+
+// same effects as the synchronous fingerprinting in checkpath()
+void Sync::fingerprintdone(FingerprintJob* job)
+{
+    LocalNode* l = job->localnode;
+    FileFingerprint* fp = &job->fingerprint;
+    string localpath, path;
+
+    l->fingerprinting = false;
+
+    // skipped by syncdown() / syncup() in the meantime
+    l->setsyncdirty();
+
+    if (state != SYNC_ACTIVE && state != SYNC_INITIALSCAN)
+    {
+        return;
+    }
+
+    l->getlocalpath(&localpath);
+
+    if (!fp->isvalid || fp->size < 0)
+    {
+        // vanished or unreadable in the meantime: check again
+        LOG_debug << "Unable to fingerprint file, rechecking";
+        dirnotify->notify(DirNotify::DIREVENTS, NULL, localpath.data(), localpath.size());
+        return;
+    }
+
+    bool changed = !l->isvalid
+            || l->size != fp->size
+            || l->mtime != fp->mtime
+            || memcmp(l->crc, fp->crc, sizeof l->crc);
+
+    m_off_t dsize = l->size > 0 ? l->size : 0;
+    *(FileFingerprint*)l = *fp;
+    localbytes += l->size - dsize;
+
+    if (!changed && !job->newnode)
+    {
+        return;
+    }
+
+    client->fsaccess->local2path(&localpath, &path);
+
+    if (job->newnode)
+    {
+        client->app->syncupdate_local_file_addition(this, l, path.c_str());
+    }
+    else
+    {
+        client->app->syncupdate_local_file_change(this, l, path.c_str());
+        client->stopxfer(l);
+    }
+
+    l->bumpnagleds();
+    l->deleted = false;
+
+    client->syncactivity = true;
+
+    statecacheadd(l);
+}
+
 // add or refresh local filesystem item from scan stack, add items to scan stack
 // returns 0 if a parent node is missing, ~0 if control should be yielded, or the time
 // until a retry should be made (500 ms minimum latency).
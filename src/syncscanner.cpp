@@ -0,0 +1,332 @@
+/**
+ * @file syncscanner.cpp
+ * @brief Parallel enumeration of sync trees
+ *
+ * (c) 2013-2018 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mega/syncscanner.h"
+#include "mega/logging.h"
+
+#ifdef ENABLE_SYNC
+namespace mega {
+SyncScanner::SyncScanner(FileSystemAccess* fs, string* rootpath, string* debris, bool symlinks, int numthreads) : mutex(false)
+{
+    fsaccess = fs;
+    localdebris = *debris;
+    followsymlinks = symlinks;
+
+    buffered = 0;
+    idle = 0;
+    numstarted = 0;
+    waiting = false;
+    exiting = false;
+
+    if (numthreads < 1)
+    {
+        numthreads = 1;
+    }
+
+    queues.resize(numthreads);
+    enqueue(0, *rootpath);
+
+    LOG_debug << "Scanning sync with " << numthreads << " threads";
+
+    while (numthreads-- > 0)
+    {
+        THREAD_CLASS* thread = new THREAD_CLASS();
+        workers.push_back(thread);
+        thread->start(workerEntryPoint, this);
+    }
+}
+
+SyncScanner::~SyncScanner()
+{
+    mutex.lock();
+    exiting = true;
+    mutex.unlock();
+
+    for (size_t i = workers.size(); i--; )
+    {
+        workready.release();
+    }
+
+    for (size_t i = 0; i < workers.size(); i++)
+    {
+        workers[i]->join();
+        delete workers[i];
+    }
+
+    for (std::map<string, ScanBatch*>::iterator it = done.begin(); it != done.end(); it++)
+    {
+        delete it->second;
+    }
+}
+
+void* SyncScanner::workerEntryPoint(void* param)
+{
+    ((SyncScanner*)param)->scanloop();
+    return NULL;
+}
+
+void SyncScanner::enqueue(unsigned worker, const string& localpath)
+{
+    queues[worker].push_back(localpath);
+    queued.insert(localpath);
+
+    if (idle)
+    {
+        idle--;
+        workready.release();
+    }
+}
+
+void SyncScanner::scanloop()
+{
+    string localpath;
+
+    mutex.lock();
+
+    unsigned worker = numstarted++;
+
+    for (;;)
+    {
+        if (exiting)
+        {
+            break;
+        }
+
+        // own folders first (most recently queued: depth-first), then the
+        // oldest folder of another worker
+        std::deque<string>* queue = NULL;
+
+        if (buffered < MAX_BUFFERED)
+        {
+            if (queues[worker].size())
+            {
+                queue = &queues[worker];
+                localpath = queue->back();
+                queue->pop_back();
+            }
+            else
+            {
+                for (unsigned i = 1; i < queues.size(); i++)
+                {
+                    if (queues[(worker + i) % queues.size()].size())
+                    {
+                        queue = &queues[(worker + i) % queues.size()];
+                        localpath = queue->front();
+                        queue->pop_front();
+                        break;
+                    }
+                }
+            }
+        }
+
+        if (!queue)
+        {
+            idle++;
+            mutex.unlock();
+            workready.wait();
+            mutex.lock();
+            continue;
+        }
+
+        queued.erase(localpath);
+
+        if (claimed.erase(localpath))
+        {
+            continue;
+        }
+
+        active.insert(localpath);
+        mutex.unlock();
+
+        ScanBatch* batch = new ScanBatch();
+        batch->localpath = localpath;
+
+        DirAccess* da = fsaccess->newdiraccess();
+        bool ok = da->dopen(&localpath, NULL, false) && da->dread(&batch->entries, followsymlinks);
+        delete da;
+
+        mutex.lock();
+        active.erase(localpath);
+
+        // excluded while it was being read: no result, no subfolders
+        bool skip = skipped.erase(localpath) > 0;
+
+        if (ok && !skip)
+        {
+            // subfolders in reverse order, so that the first one is read next
+            for (size_t i = batch->entries.size(); i--; )
+            {
+                if (batch->entries[i].type == FOLDERNODE)
+                {
+                    string childpath = localpath;
+
+                    if (childpath.size())
+                    {
+                        childpath.append(fsaccess->localseparator);
+                    }
+
+                    childpath.append(batch->entries[i].localname);
+
+                    if (childpath != localdebris)
+                    {
+                        enqueue(worker, childpath);
+                    }
+                }
+            }
+
+            buffered += batch->entries.size();
+        }
+        else
+        {
+            // left to Sync::scan()
+            delete batch;
+            batch = NULL;
+        }
+
+        if (!skip)
+        {
+            done[localpath] = batch;
+        }
+
+        if (waiting)
+        {
+            waiting = false;
+            resultready.release();
+        }
+    }
+
+    mutex.unlock();
+}
+
+void SyncScanner::unbuffer(ScanBatch* batch)
+{
+    if (batch)
+    {
+        bool resume = buffered >= MAX_BUFFERED;
+
+        buffered -= batch->entries.size();
+
+        // wake a worker paused by the limit
+        if (resume && buffered < MAX_BUFFERED && idle)
+        {
+            idle--;
+            workready.release();
+        }
+    }
+}
+
+void SyncScanner::skip(string* localpath)
+{
+    string prefix = *localpath + fsaccess->localseparator;
+
+    mutex.lock();
+
+    // the folder itself
+    std::map<string, ScanBatch*>::iterator dit = done.find(*localpath);
+    if (dit != done.end())
+    {
+        unbuffer(dit->second);
+        delete dit->second;
+        done.erase(dit);
+    }
+    else if (active.count(*localpath))
+    {
+        skipped.insert(*localpath);
+    }
+    else if (queued.count(*localpath))
+    {
+        claimed.insert(*localpath);
+    }
+
+    // and everything below it
+    dit = done.lower_bound(prefix);
+    while (dit != done.end() && !dit->first.compare(0, prefix.size(), prefix))
+    {
+        unbuffer(dit->second);
+        delete dit->second;
+        done.erase(dit++);
+    }
+
+    for (std::set<string>::iterator it = active.lower_bound(prefix);
+         it != active.end() && !it->compare(0, prefix.size(), prefix); it++)
+    {
+        skipped.insert(*it);
+    }
+
+    for (std::set<string>::iterator it = queued.lower_bound(prefix);
+         it != queued.end() && !it->compare(0, prefix.size(), prefix); it++)
+    {
+        claimed.insert(*it);
+    }
+
+    mutex.unlock();
+}
+
+size_t SyncScanner::numbuffered()
+{
+    mutex.lock();
+    size_t n = buffered;
+    mutex.unlock();
+
+    return n;
+}
+
+ScanBatch* SyncScanner::take(string* localpath)
+{
+    ScanBatch* batch = NULL;
+
+    mutex.lock();
+
+    for (;;)
+    {
+        std::map<string, ScanBatch*>::iterator it = done.find(*localpath);
+
+        if (it != done.end())
+        {
+            batch = it->second;
+            done.erase(it);
+            unbuffer(batch);
+            break;
+        }
+
+        if (active.count(*localpath))
+        {
+            waiting = true;
+            mutex.unlock();
+            resultready.wait();
+            mutex.lock();
+            continue;
+        }
+
+        if (queued.count(*localpath))
+        {
+            claimed.insert(*localpath);
+        }
+
+        break;
+    }
+
+    mutex.unlock();
+
+    return batch;
+}
+} // namespace
+#endif
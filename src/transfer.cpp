@@ -127,13 +127,7 @@ bool Transfer::serialize(string *d)
     d->append((const char*)&metamac, sizeof(metamac));
     d->append((const char*)transferkey, sizeof (transferkey));
 
-    ll = (unsigned short)chunkmacs.size();
-    d->append((char*)&ll, sizeof(ll));
-    for (chunkmac_map::iterator it = chunkmacs.begin(); it != chunkmacs.end(); it++)
-    {
-        d->append((char*)&it->first, sizeof(it->first));
-        d->append((char*)&it->second, sizeof(it->second));
-    }
+    chunkmacs.serialize(d);
 
     if (!FileFingerprint::serialize(d))
     {
@@ -228,25 +222,13 @@ Transfer *Transfer::unserialize(MegaClient *client, string *d, transfer_map* tra
 
     t->localfilename.assign(filepath, ll);
 
-    ll = MemAccess::get<unsigned short>(ptr);
-    ptr += sizeof(ll);
-
-    if (ptr + ll * (sizeof(m_off_t) + sizeof(ChunkMAC)) + sizeof(ll) > end)
+    if (!t->chunkmacs.unserialize(ptr, end))
     {
         LOG_err << "Transfer unserialization failed - chunkmacs too long";
         delete t;
         return NULL;
     }
 
-    for (int i = 0; i < ll; i++)
-    {
-        m_off_t pos = MemAccess::get<m_off_t>(ptr);
-        ptr += sizeof(m_off_t);
-
-        memcpy(&(t->chunkmacs[pos]), ptr, sizeof(ChunkMAC));
-        ptr += sizeof(ChunkMAC);
-    }
-
     d->erase(0, ptr - d->data());
 
     FileFingerprint *fp = FileFingerprint::unserialize(d);
@@ -329,25 +311,7 @@ Transfer *Transfer::unserialize(MegaClient *client, string *d, transfer_map* tra
     }
     ptr++;
 
-    for (chunkmac_map::iterator it = t->chunkmacs.begin(); it != t->chunkmacs.end(); it++)
-    {
-        m_off_t chunkceil = ChunkedHash::chunkceil(it->first, t->size);
-
-        if (t->pos == it->first && it->second.finished)
-        {
-            t->pos = chunkceil;
-            t->progresscompleted = chunkceil;
-        }
-        else if (it->second.finished)
-        {
-            m_off_t chunksize = chunkceil - ChunkedHash::chunkfloor(it->first);
-            t->progresscompleted += chunksize;
-        }
-        else
-        {
-            t->progresscompleted += it->second.offset;
-        }
-    }
+    t->chunkmacs.calcprogress(t->size, t->pos, t->progresscompleted);
 
     transfers[type].insert(pair<FileFingerprint*, Transfer*>(t, t));
     return t;
@@ -1008,18 +972,7 @@ void Transfer::completefiles()
 
 m_off_t Transfer::nextpos()
 {
-    while (chunkmacs.find(ChunkedHash::chunkfloor(pos)) != chunkmacs.end())
-    {    
-        if (chunkmacs[ChunkedHash::chunkfloor(pos)].finished)
-        {
-            pos = ChunkedHash::chunkceil(pos);
-        }
-        else
-        {
-            pos += chunkmacs[ChunkedHash::chunkfloor(pos)].offset;
-            break;
-        }
-    }
+    pos = chunkmacs.nextpos(pos);
 
     return pos;
 }
@@ -28,6 +28,8 @@
 #include "mega/megaapp.h"
 #include "mega/utils.h"
 #include "mega/logging.h"
+#include "mega/chunkcrypto.h"
+#include "mega/metrics.h"
 
 namespace mega {
 
@@ -38,15 +40,22 @@ const dstime TransferSlot::XFERTIMEOUT = 600;
 // max time without progress callbacks
 const dstime TransferSlot::PROGRESSTIMEOUT = 10;
 
-// max request size for downloads
+// max request size for downloads - the buffer of a request only holds the
+// data that has not been written yet (see HttpReqDL::INITIALBUFSIZE)
 #if defined(__ANDROID__) || defined(USE_IOS) || defined(WINDOWS_PHONE)
-    const m_off_t TransferSlot::MAX_DOWNLOAD_REQ_SIZE = 2097152; // 2 MB
-#elif defined (_WIN32) || defined(HAVE_AIO_RT)
-    const m_off_t TransferSlot::MAX_DOWNLOAD_REQ_SIZE = 16777216; // 16 MB
-#else
     const m_off_t TransferSlot::MAX_DOWNLOAD_REQ_SIZE = 4194304; // 4 MB
+#else
+    const m_off_t TransferSlot::MAX_DOWNLOAD_REQ_SIZE = 16777216; // 16 MB
 #endif
 
+// adaptive connection scaling: decisions are taken once the speed window
+// (SpeedController::SPEED_MEAN_INTERVAL_DS) only covers the current number
+// of connections
+const dstime TransferSlot::ADAPTINTERVAL = 100;
+const dstime TransferSlot::ADAPTHOLD = 600;
+const int TransferSlot::ADAPTMINGAIN = 10;
+const int TransferSlot::MAXDIRECTIONCONNECTIONS = 2 * MegaClient::MAX_NUM_CONNECTIONS;
+
 TransferSlot::TransferSlot(Transfer* ctransfer)
 {
     starttime = 0;
@@ -73,8 +82,17 @@ TransferSlot::TransferSlot(Transfer* ctransfer)
     connections = transfer->size > 131072 ? transfer->client->connections[transfer->type] : 1;
     LOG_debug << "Creating transfer slot with " << connections << " connections";
 
-    reqs = new HttpReqXfer*[connections]();
-    asyncIO = new AsyncIOContext*[connections]();
+    // with adaptive scaling, room for the connections that may be added
+    maxconnections = (connections > 1 && transfer->client->adaptiveconnections) ? int(MegaClient::MAX_NUM_CONNECTIONS) : connections;
+    targetconnections = connections;
+    lastadapt = Waiter::ds;
+    adaptspeed = 0;
+    adaptstep = 0;
+    adaptholduntil = 0;
+
+    reqs = new HttpReqXfer*[maxconnections]();
+    asyncIO = new AsyncIOContext*[maxconnections]();
+    cryptojobs = new ChunkCryptoJob*[maxconnections]();
 
     fa = transfer->client->fsaccess->newfileaccess();
 
@@ -125,6 +143,12 @@ TransferSlot::TransferSlot(Transfer* ctransfer)
 // reused on a new slot)
 TransferSlot::~TransferSlot()
 {
+    if (transfer->client->chunkcrypto)
+    {
+        // the workers must not touch the request buffers anymore
+        transfer->client->chunkcrypto->cancel(this);
+    }
+
     if (transfer->type == GET && !transfer->finished
             && transfer->progresscompleted != transfer->size
             && !transfer->asyncopencontext)
@@ -142,10 +166,7 @@ TransferSlot::~TransferSlot()
                     {
                         LOG_verbose << "Async write succeeded";
                         HttpReqDL *downloadRequest = (HttpReqDL *)reqs[i];
-                        for (chunkmac_map::iterator it = downloadRequest->chunkmacs.begin(); it != downloadRequest->chunkmacs.end(); it++)
-                        {
-                            transfer->chunkmacs[it->first] = it->second;
-                        }
+                        transfer->chunkmacs.merge(downloadRequest->chunkmacs);
                         downloadRequest->chunkmacs.clear();
                         transfer->progresscompleted += downloadRequest->bufpos;
                         LOG_debug << "Cached async data at: " << downloadRequest->dlpos << "   Size: " << downloadRequest->bufpos;
@@ -169,20 +190,18 @@ TransferSlot::~TransferSlot()
         for (int i = 0; i < connections; i++)
         {
             HttpReqDL *downloadRequest = (HttpReqDL *)reqs[i];
-            if (fa && downloadRequest && downloadRequest->status == REQ_INFLIGHT
+            if (fa && downloadRequest && (downloadRequest->status == REQ_INFLIGHT || downloadRequest->status == REQ_CRYPTO)
                     && downloadRequest->contentlength == downloadRequest->size
                     && downloadRequest->bufpos >= SymmCipher::BLOCKSIZE)
             {
                 downloadRequest->finalize(transfer);
                 m_off_t dlpos = downloadRequest->dlpos;
                 m_off_t bufsize = downloadRequest->bufpos;
-                if (fa->fwrite(downloadRequest->buf, bufsize, dlpos))
+                m_off_t written = downloadRequest->writtenpos;
+                if (fa->fwrite(downloadRequest->bufat(written), unsigned(bufsize - written), dlpos + written))
                 {
                     LOG_verbose << "Sync write succeeded";
-                    for (chunkmac_map::iterator it = downloadRequest->chunkmacs.begin(); it != downloadRequest->chunkmacs.end(); it++)
-                    {
-                        transfer->chunkmacs[it->first] = it->second;
-                    }
+                    transfer->chunkmacs.merge(downloadRequest->chunkmacs);
                     downloadRequest->chunkmacs.clear();
                     transfer->progresscompleted += bufsize;
                     LOG_debug << "Cached data at: " << dlpos << "   Size: " << bufsize;
@@ -229,10 +248,12 @@ TransferSlot::~TransferSlot()
 
     while (connections--)
     {
+        delete cryptojobs[connections];
         delete asyncIO[connections];
         delete reqs[connections];
     }
 
+    delete[] cryptojobs;
     delete[] asyncIO;
     delete[] reqs;
 
@@ -277,26 +298,6 @@ void TransferSlot::disconnect()
     }
 }
 
-// coalesce block macs into file mac
-int64_t TransferSlot::macsmac(chunkmac_map* macs)
-{
-    byte mac[SymmCipher::BLOCKSIZE] = { 0 };
-
-    SymmCipher *cipher = transfer->transfercipher();
-    for (chunkmac_map::iterator it = macs->begin(); it != macs->end(); it++)
-    {
-        SymmCipher::xorblock(it->second.mac, mac);
-        cipher->ecb_encrypt(mac);
-    }
-
-    uint32_t* m = (uint32_t*)mac;
-
-    m[0] ^= m[1];
-    m[1] = m[2] ^ m[3];
-
-    return MemAccess::get<int64_t>((const char*)mac);
-}
-
 // file transfer state machine
 void TransferSlot::doio(MegaClient* client)
 {
@@ -308,7 +309,7 @@ void TransferSlot::doio(MegaClient* client)
             if (fa && transfer->type == GET)
             {
                 LOG_debug << "Verifying cached download";
-                transfer->currentmetamac = macsmac(&transfer->chunkmacs);
+                transfer->currentmetamac = transfer->chunkmacs.macsmac(transfer->transfercipher());
                 transfer->hascurrentmetamac = true;
 
                 // verify meta MAC
@@ -369,9 +370,58 @@ void TransferSlot::doio(MegaClient* client)
             {
                 case REQ_INFLIGHT:
                     p += reqs[i]->transferred(client);
+
+                    if (transfer->type == GET && reqs[i]->contentlength == reqs[i]->size)
+                    {
+                        HttpReqDL *downloadRequest = (HttpReqDL *)reqs[i];
+
+                        // decrypt and MAC the chunks received so far while they
+                        // are hot in the cache, and write them out, so that only
+                        // the last one is left for the completion of the request
+                        // and their buffer space is reused
+                        downloadRequest->decryptreceived(transfer);
+
+                        if (downloadRequest->decryptedpos > downloadRequest->writtenpos)
+                        {
+                            m_off_t written = downloadRequest->writtenpos;
+                            byte* data = downloadRequest->bufat(written);
+                            unsigned len = unsigned(downloadRequest->decryptedpos - written);
+                            bool ok;
+
+                            if (fa->asyncavailable())
+                            {
+                                // the write must be finished before more data is
+                                // received, which can move the buffer
+                                AsyncIOContext* context = fa->asyncfwrite(data, len, downloadRequest->dlpos + written);
+                                context->finish();
+                                ok = !context->failed;
+                                delete context;
+                            }
+                            else
+                            {
+                                ok = fa->fwrite(data, len, downloadRequest->dlpos + written);
+                            }
+
+                            // a failed write is repeated with the rest of the request
+                            if (ok)
+                            {
+                                downloadRequest->setwritten(downloadRequest->decryptedpos);
+                            }
+                        }
+                    }
                     break;
 
                 case REQ_SUCCESS:
+                    if (reqs[i]->posttime)
+                    {
+                        // once per request, postponed chunks come back here
+                        Metrics::observe(transfer->type == GET ? Metrics::CHUNK_DURATION_GET : Metrics::CHUNK_DURATION_PUT,
+                                         Waiter::us() - reqs[i]->posttime);
+                        Metrics::add(transfer->type == GET ? Metrics::TRANSFER_BYTES_GET : Metrics::TRANSFER_BYTES_PUT,
+                                     reqs[i]->size);
+                        reqs[i]->posttime = 0;
+                    }
+
                     if (client->orderdownloadedchunks && transfer->type == GET && transfer->progresscompleted != ((HttpReqDL *)reqs[i])->dlpos)
                     {
                         // postponing unsorted chunk
@@ -382,8 +432,13 @@ void TransferSlot::doio(MegaClient* client)
                     lastdata = Waiter::ds;
                     transfer->lastaccesstime = m_time();
 
-                    LOG_debug << "Chunk finished OK (" << transfer->type << ") Pos: " << transfer->pos
-                              << " Completed: " << (transfer->progresscompleted + reqs[i]->size) << " of " << transfer->size;
+                    // downloads come back here once decrypted (REQ_CRYPTO) or
+                    // to retry a failed write, already finalized
+                    if (transfer->type == PUT || !((HttpReqDL *)reqs[i])->finalized)
+                    {
+                        LOG_debug << "Chunk finished OK (" << transfer->type << ") Pos: " << transfer->pos
+                                  << " Completed: " << (transfer->progresscompleted + reqs[i]->size) << " of " << transfer->size;
+                    }
 
                     if (transfer->type == PUT)
                     {
@@ -416,11 +471,11 @@ void TransferSlot::doio(MegaClient* client)
                                 {
                                     errorcount = 0;
                                     transfer->failcount = 0;
-                                    transfer->chunkmacs[reqs[i]->pos].finished = true;
+                                    transfer->chunkmacs.finishrange(reqs[i]->pos, reqs[i]->pos + reqs[i]->size);
                                     transfer->progresscompleted += reqs[i]->size;
                                     memcpy(transfer->filekey, transfer->transferkey, sizeof transfer->transferkey);
                                     ((int64_t*)transfer->filekey)[2] = transfer->ctriv;
-                                    ((int64_t*)transfer->filekey)[3] = macsmac(&transfer->chunkmacs);
+                                    ((int64_t*)transfer->filekey)[3] = transfer->chunkmacs.macsmac(transfer->transfercipher());
                                     SymmCipher::xorblock(transfer->filekey + SymmCipher::KEYLENGTH, transfer->filekey);
 
                                     client->transfercacheadd(transfer);
@@ -476,7 +531,7 @@ void TransferSlot::doio(MegaClient* client)
                             return transfer->failed(e);
                         }
 
-                        transfer->chunkmacs[reqs[i]->pos].finished = true;
+                        transfer->chunkmacs.finishrange(reqs[i]->pos, reqs[i]->pos + reqs[i]->size);
                         transfer->progresscompleted += reqs[i]->size;
 
                         if (transfer->progresscompleted == transfer->size)
@@ -499,6 +554,17 @@ void TransferSlot::doio(MegaClient* client)
                         if (reqs[i]->size == reqs[i]->bufpos)
                         {
                             HttpReqDL *downloadRequest = (HttpReqDL *)reqs[i];
+                            if (client->chunkcrypto && !downloadRequest->finalized)
+                            {
+                                // decrypt and MAC on a worker thread, the data is
+                                // written when the job is collected (REQ_CRYPTO)
+                                downloadRequest->loadchunkmacs(transfer);
+                                cryptojobs[i] = client->chunkcrypto->decrypt(this, downloadRequest);
+                                reqs[i]->status = REQ_CRYPTO;
+                                p += reqs[i]->size;
+                                break;
+                            }
+
                             if (fa->asyncavailable())
                             {
                                 if (!asyncIO[i])
@@ -514,21 +580,23 @@ void TransferSlot::doio(MegaClient* client)
 
                                 p += reqs[i]->size;
 
-                                LOG_debug << "Writting data asynchronously at " << downloadRequest->dlpos;
-                                asyncIO[i] = fa->asyncfwrite(downloadRequest->buf, downloadRequest->bufpos, downloadRequest->dlpos);
+                                // the data written while the request was in flight
+                                // is not in the buffer anymore
+                                m_off_t written = downloadRequest->writtenpos;
+                                LOG_debug << "Writting data asynchronously at " << downloadRequest->dlpos + written;
+                                asyncIO[i] = fa->asyncfwrite(downloadRequest->bufat(written), unsigned(downloadRequest->bufpos - written),
+                                                             downloadRequest->dlpos + written);
                                 reqs[i]->status = REQ_ASYNCIO;
                             }
                             else
                             {
                                 downloadRequest->finalize(transfer);
-                                if (fa->fwrite(downloadRequest->buf, downloadRequest->bufpos, downloadRequest->dlpos))
+                                m_off_t written = downloadRequest->writtenpos;
+                                if (fa->fwrite(downloadRequest->bufat(written), unsigned(downloadRequest->bufpos - written),
+                                               downloadRequest->dlpos + written))
                                 {
                                     LOG_verbose << "Sync write succeeded";
-                                    for (chunkmac_map::iterator it = downloadRequest->chunkmacs.begin(); it != downloadRequest->chunkmacs.end(); it++)
-                                    {
-                                        transfer->chunkmacs[it->first] = it->second;
-                                        assert (transfer->chunkmacs[it->first].finished);
-                                    }
+                                    transfer->chunkmacs.merge(downloadRequest->chunkmacs);
                                     downloadRequest->chunkmacs.clear();
                                     transfer->progresscompleted += downloadRequest->bufpos;
                                     LOG_debug << "Saved data at: " << downloadRequest->dlpos << "   Size: " << downloadRequest->bufpos;
@@ -551,7 +619,7 @@ void TransferSlot::doio(MegaClient* client)
                                 {
                                     if (transfer->progresscompleted)
                                     {
-                                        transfer->currentmetamac = macsmac(&transfer->chunkmacs);
+                                        transfer->currentmetamac = transfer->chunkmacs.macsmac(transfer->transfercipher());
                                         transfer->hascurrentmetamac = true;
                                     }
 
@@ -637,21 +705,27 @@ void TransferSlot::doio(MegaClient* client)
                                     }
                                 }
 
-                                reqs[i]->prepare(finaltempurl.c_str(), transfer->transfercipher(),
-                                         &transfer->chunkmacs, transfer->ctriv,
-                                         asyncIO[i]->pos, npos);
+                                if (client->chunkcrypto)
+                                {
+                                    cryptojobs[i] = client->chunkcrypto->encrypt(this, (HttpReqUL*)reqs[i], finaltempurl,
+                                                                                 asyncIO[i]->pos, npos);
+                                    reqs[i]->status = REQ_CRYPTO;
+                                }
+                                else
+                                {
+                                    reqs[i]->prepare(finaltempurl.c_str(), transfer->transfercipher(),
+                                             &transfer->chunkmacs, transfer->ctriv,
+                                             asyncIO[i]->pos, npos);
+                                    reqs[i]->status = REQ_PREPARED;
+                                }
 
                                 reqs[i]->pos = ChunkedHash::chunkfloor(asyncIO[i]->pos);
-                                reqs[i]->status = REQ_PREPARED;
                             }
                             else
                             {
                                 LOG_verbose << "Async write succeeded";
                                 HttpReqDL *downloadRequest = (HttpReqDL *)reqs[i];
-                                for (chunkmac_map::iterator it = downloadRequest->chunkmacs.begin(); it != downloadRequest->chunkmacs.end(); it++)
-                                {
-                                    transfer->chunkmacs[it->first] = it->second;
-                                }
+                                transfer->chunkmacs.merge(downloadRequest->chunkmacs);
                                 downloadRequest->chunkmacs.clear();
                                 transfer->progresscompleted += downloadRequest->bufpos;
                                 LOG_debug << "Saved data at: " << downloadRequest->dlpos << "   Size: " << downloadRequest->bufpos;
@@ -662,7 +736,7 @@ void TransferSlot::doio(MegaClient* client)
                                 {
                                     if (transfer->progresscompleted)
                                     {
-                                        transfer->currentmetamac = macsmac(&transfer->chunkmacs);
+                                        transfer->currentmetamac = transfer->chunkmacs.macsmac(transfer->transfercipher());
                                         transfer->hascurrentmetamac = true;
                                     }
 
@@ -734,12 +808,42 @@ void TransferSlot::doio(MegaClient* client)
                     }
                     else if (transfer->type == GET)
                     {
-                        p += asyncIO[i]->len;
+                        p += reqs[i]->size;
+                    }
+                    break;
+
+                case REQ_CRYPTO:
+                    // the jobs of a replaced pool were all processed before
+                    // its threads were joined
+                    if (!client->chunkcrypto || client->chunkcrypto->finished(cryptojobs[i]))
+                    {
+                        ChunkCryptoJob* job = cryptojobs[i];
+                        cryptojobs[i] = NULL;
+
+                        if (transfer->type == PUT)
+                        {
+                            ((HttpReqUL*)reqs[i])->commit(job->tempurl.c_str(), &transfer->chunkmacs, job->pos);
+                            reqs[i]->status = REQ_PREPARED;
+                            delete job;
+                        }
+                        else
+                        {
+                            // resume the completed download request, now finalized
+                            delete job;
+                            reqs[i]->status = REQ_SUCCESS;
+                            i++;
+                            continue;
+                        }
+                    }
+                    else if (transfer->type == GET)
+                    {
+                        p += reqs[i]->size;
                     }
                     break;
 
                 case REQ_FAILURE:
                     LOG_warn << "Failed chunk. HTTP status: " << reqs[i]->httpstatus;
+                    Metrics::add(transfer->type == GET ? Metrics::TRANSFER_CHUNK_FAILURES_GET : Metrics::TRANSFER_CHUNK_FAILURES_PUT);
                     if (reqs[i]->httpstatus && reqs[i]->contenttype.find("text/html") != string::npos
                             && !memcmp(reqs[i]->posturl.c_str(), "http:", 5))
                     {
@@ -820,7 +924,8 @@ void TransferSlot::doio(MegaClient* client)
 
         if (!failure)
         {
-            if (!reqs[i] || (reqs[i]->status == REQ_READY))
+            // no new chunks for the connections that are being released
+            if (i < targetconnections && (!reqs[i] || (reqs[i]->status == REQ_READY)))
             {
                 m_off_t npos = ChunkedHash::chunkceil(transfer->nextpos(), transfer->size);
                 if (!transfer->size)
@@ -853,16 +958,13 @@ void TransferSlot::doio(MegaClient* client)
                             maxReqSize = 0;
                         }
 
-                        chunkmac_map::iterator it = transfer->chunkmacs.find(npos);
                         m_off_t reqSize = npos - transfer->pos;
                         while (npos < transfer->size
                                && reqSize <= maxReqSize
-                               && (it == transfer->chunkmacs.end()
-                                   || (!it->second.finished && !it->second.offset)))
+                               && transfer->chunkmacs.unprocessed(npos))
                         {
                             npos = ChunkedHash::chunkceil(npos, transfer->size);
                             reqSize = npos - transfer->pos;
-                            it = transfer->chunkmacs.find(npos);
                         }
                         LOG_debug << "Downloading chunk of size " << reqSize;
                     }
@@ -947,11 +1049,20 @@ void TransferSlot::doio(MegaClient* client)
                             return transfer->failed(API_EINTERNAL);
                         }
 
-                        reqs[i]->prepare(finaltempurl.c_str(), transfer->transfercipher(),
-                                                                 &transfer->chunkmacs, transfer->ctriv,
-                                                                 transfer->pos, npos);
+                        if (transfer->type == PUT && client->chunkcrypto)
+                        {
+                            cryptojobs[i] = client->chunkcrypto->encrypt(this, (HttpReqUL*)reqs[i], finaltempurl,
+                                                                         transfer->pos, npos);
+                            reqs[i]->status = REQ_CRYPTO;
+                        }
+                        else
+                        {
+                            reqs[i]->prepare(finaltempurl.c_str(), transfer->transfercipher(),
+                                                                     &transfer->chunkmacs, transfer->ctriv,
+                                                                     transfer->pos, npos);
+                            reqs[i]->status = REQ_PREPARED;
+                        }
                         reqs[i]->pos = ChunkedHash::chunkfloor(transfer->pos);
-                        reqs[i]->status = REQ_PREPARED;
                     }
 
                     if (transfer->pos < npos)
@@ -967,6 +1078,13 @@ void TransferSlot::doio(MegaClient* client)
 
             if (reqs[i] && (reqs[i]->status == REQ_PREPARED))
             {
+                if (transfer->type == GET)
+                {
+                    // retried requests are decrypted again from their start
+                    ((HttpReqDL *)reqs[i])->rewind();
+                }
+
+                reqs[i]->posttime = Waiter::us();
                 reqs[i]->post(client);
             }
         }
@@ -998,6 +1116,17 @@ void TransferSlot::doio(MegaClient* client)
         progress();
     }
 
+    if (maxconnections > 1 && client->adaptiveconnections && !failure && adjustconnections(client))
+    {
+        // start the added connection right away
+        backoff = 1;
+    }
+
+    if (connections > targetconnections)
+    {
+        trimconnections();
+    }
+
     if (Waiter::ds - lastdata >= XFERTIMEOUT && !failure)
     {
         LOG_warn << "Failed chunk due to a timeout";
@@ -1023,6 +1152,7 @@ void TransferSlot::doio(MegaClient* client)
             if (reqs[i] && reqs[i]->status == REQ_INFLIGHT)
             {
                 chunkfailed = true;
+                Metrics::add(transfer->type == GET ? Metrics::TRANSFER_CHUNK_FAILURES_GET : Metrics::TRANSFER_CHUNK_FAILURES_PUT);
                 client->setchunkfailed(&reqs[i]->posturl);
                 reqs[i]->disconnect();
 
@@ -1059,6 +1189,123 @@ void TransferSlot::doio(MegaClient* client)
     }
 }
 
+// adaptive connection scaling - hill climbing on the speed of the slot:
+// - a connection is added while none of the current ones is idle and the
+//   previous one improved the speed by at least ADAPTMINGAIN%
+// - an added connection that didn't pay off is removed again, and no other
+//   one is tried for ADAPTHOLD
+// - connections are removed while the bandwidth limit of the direction is
+//   reached (down to one) or other transfers of the direction are waiting
+//   for a slot or the direction uses MAXDIRECTIONCONNECTIONS (down to the
+//   configured number)
+bool TransferSlot::adjustconnections(MegaClient* client)
+{
+    if (Waiter::ds - lastadapt < ADAPTINTERVAL || connections != targetconnections)
+    {
+        return false;
+    }
+
+    direction_t d = transfer->type;
+    int base = client->connections[d];
+
+    m_off_t limit = d == GET ? client->httpio->getmaxdownloadspeed() : client->httpio->getmaxuploadspeed();
+    m_off_t total = d == GET ? client->httpio->downloadSpeed : client->httpio->uploadSpeed;
+    bool throttled = limit > 0 && total >= limit - limit / 10;
+
+    size_t numslots = 0;
+    int used = 0;
+    for (transferslot_list::iterator it = client->tslots.begin(); it != client->tslots.end(); it++)
+    {
+        if ((*it)->transfer->type == d)
+        {
+            numslots++;
+            used += (*it)->connections;
+        }
+    }
+
+    bool waiting = client->transfers[d].size() > numslots;
+
+    bool busy = true;
+    for (int i = connections; i--; )
+    {
+        if (!reqs[i] || reqs[i]->status == REQ_READY || reqs[i]->status == REQ_DONE)
+        {
+            busy = false;
+            break;
+        }
+    }
+
+    int target = connections;
+    const char* reason = NULL;
+
+    if (throttled)
+    {
+        if (connections > 1)
+        {
+            target--;
+            reason = "bandwidth limit reached";
+        }
+    }
+    else if (waiting || used > MAXDIRECTIONCONNECTIONS)
+    {
+        if (connections > base)
+        {
+            target--;
+            reason = waiting ? "transfers waiting for a slot" : "too many connections in this direction";
+        }
+    }
+    else if (adaptstep > 0 && speed < adaptspeed + adaptspeed * ADAPTMINGAIN / 100)
+    {
+        target--;
+        reason = "no speed improvement";
+        adaptholduntil = Waiter::ds + ADAPTHOLD;
+    }
+    else if (busy && speed > 0 && connections < maxconnections
+             && used < MAXDIRECTIONCONNECTIONS && Waiter::ds >= adaptholduntil)
+    {
+        target++;
+        reason = adaptstep > 0 ? "speed improved" : "all connections busy";
+    }
+
+    if (reason)
+    {
+        LOG_debug << "Adaptive connections (" << d << "): " << connections << " -> " << target
+                  << " Speed: " << speed << " Previous: " << adaptspeed << " (" << reason << ")";
+    }
+
+    adaptstep = target - connections;
+    adaptspeed = speed;
+    lastadapt = Waiter::ds;
+    targetconnections = target;
+
+    if (target > connections)
+    {
+        // the new request is created and posted by the next doio()
+        connections = target;
+        return true;
+    }
+
+    return false;
+}
+
+// connections are only released once their request is idle
+void TransferSlot::trimconnections()
+{
+    while (connections > targetconnections)
+    {
+        int i = connections - 1;
+
+        if ((reqs[i] && reqs[i]->status != REQ_READY && reqs[i]->status != REQ_DONE) || asyncIO[i] || cryptojobs[i])
+        {
+            break;
+        }
+
+        delete reqs[i];
+        reqs[i] = NULL;
+        connections--;
+    }
+}
+
 // transfer progress notification to app and related files
 void TransferSlot::progress()
 {
@@ -540,6 +540,705 @@ m_off_t ChunkedHash::chunkceil(m_off_t p, m_off_t limit)
     return (limit < 0 || np < limit) ? np : limit;
 }
 
+size_t ChunkedHash::chunkindex(m_off_t p)
+{
+    m_off_t cp, np;
+
+    cp = 0;
+
+    for (unsigned i = 1; i <= 8; i++)
+    {
+        np = cp + i * SEGSIZE;
+
+        if ((p >= cp) && (p < np))
+        {
+            return i - 1;
+        }
+
+        cp = np;
+    }
+
+    return size_t((p - cp) / (8 * SEGSIZE)) + 8;
+}
+
+m_off_t ChunkedHash::chunkpos(size_t i)
+{
+    if (i < 8)
+    {
+        return m_off_t(i * (i + 1) / 2) * SEGSIZE;
+    }
+
+    return m_off_t(i - 8) * 8 * SEGSIZE + 36 * SEGSIZE;
+}
+
+// lowest set bit of a nonzero word
+static unsigned lowestbit(uint64_t w)
+{
+    unsigned b = 0;
+
+    while (!(w & 0xffffffff))
+    {
+        w >>= 32;
+        b += 32;
+    }
+
+    while (!(w & 1))
+    {
+        w >>= 1;
+        b++;
+    }
+
+    return b;
+}
+
+chunkmac_map::chunkmac_map()
+{
+    base = 0;
+    count = 0;
+    resetmacsmac();
+}
+
+void chunkmac_map::resetmacsmac()
+{
+    macsmacchunks = 0;
+    memset(macsmacprefix, 0, sizeof macsmacprefix);
+}
+
+void chunkmac_map::grow(size_t n)
+{
+    if (macs.empty())
+    {
+        base = n & ~(size_t)63;
+    }
+    else if (n < base)
+    {
+        size_t words = (base - (n & ~(size_t)63)) / 64;
+
+        macs.insert(macs.begin(), words * 64, ChunkMAC());
+        presentbits.insert(presentbits.begin(), words, 0);
+        finishedbits.insert(finishedbits.begin(), words, 0);
+        base -= words * 64;
+    }
+
+    if (n - base >= macs.size())
+    {
+        size_t words = (n - base) / 64 + 1;
+
+        macs.resize(words * 64);
+        presentbits.resize(words);
+        finishedbits.resize(words);
+    }
+}
+
+bool chunkmac_map::present(size_t n) const
+{
+    return n >= base && n - base < macs.size()
+            && (presentbits[(n - base) / 64] >> ((n - base) & 63) & 1);
+}
+
+size_t chunkmac_map::nextpresent(size_t n) const
+{
+    if (n < base)
+    {
+        n = base;
+    }
+
+    size_t w = (n - base) / 64;
+    if (w >= presentbits.size())
+    {
+        return NOCHUNK;
+    }
+
+    uint64_t bits = presentbits[w] & (~(uint64_t)0 << ((n - base) & 63));
+    while (!bits)
+    {
+        if (++w >= presentbits.size())
+        {
+            return NOCHUNK;
+        }
+        bits = presentbits[w];
+    }
+
+    return base + w * 64 + lowestbit(bits);
+}
+
+size_t chunkmac_map::nextunfinished(size_t n) const
+{
+    if (n < base)
+    {
+        return n;
+    }
+
+    size_t w = (n - base) / 64;
+    if (w >= finishedbits.size())
+    {
+        return n;
+    }
+
+    // skip 64 finished chunks at a time
+    uint64_t bits = ~finishedbits[w] & (~(uint64_t)0 << ((n - base) & 63));
+    while (!bits)
+    {
+        if (++w >= finishedbits.size())
+        {
+            return base + w * 64;
+        }
+        bits = ~finishedbits[w];
+    }
+
+    return base + w * 64 + lowestbit(bits);
+}
+
+ChunkMAC& chunkmac_map::operator[](m_off_t pos)
+{
+    size_t n = ChunkedHash::chunkindex(pos);
+
+    grow(n);
+
+    uint64_t& bits = presentbits[(n - base) / 64];
+    uint64_t bit = (uint64_t)1 << ((n - base) & 63);
+    if (!(bits & bit))
+    {
+        bits |= bit;
+        count++;
+    }
+
+    // the caller may change a MAC that was already folded in
+    if (n < macsmacchunks)
+    {
+        resetmacsmac();
+    }
+
+    return macs[n - base];
+}
+
+const ChunkMAC* chunkmac_map::find(m_off_t pos) const
+{
+    size_t n = ChunkedHash::chunkindex(pos);
+
+    return present(n) ? &macs[n - base] : NULL;
+}
+
+bool chunkmac_map::finished(m_off_t pos) const
+{
+    size_t n = ChunkedHash::chunkindex(pos);
+
+    return present(n) && (finishedbits[(n - base) / 64] >> ((n - base) & 63) & 1);
+}
+
+void chunkmac_map::setfinished(m_off_t pos, bool f)
+{
+    size_t n = ChunkedHash::chunkindex(pos);
+
+    if (!present(n))
+    {
+        (*this)[pos];
+    }
+
+    uint64_t bit = (uint64_t)1 << ((n - base) & 63);
+    if (f)
+    {
+        finishedbits[(n - base) / 64] |= bit;
+    }
+    else
+    {
+        finishedbits[(n - base) / 64] &= ~bit;
+
+        if (n < macsmacchunks)
+        {
+            resetmacsmac();
+        }
+    }
+}
+
+void chunkmac_map::finishrange(m_off_t pos, m_off_t npos)
+{
+    for (; pos < npos; pos = ChunkedHash::chunkceil(pos))
+    {
+        setfinished(pos);
+    }
+}
+
+bool chunkmac_map::unprocessed(m_off_t pos) const
+{
+    const ChunkMAC* chunkmac = find(pos);
+
+    return !chunkmac || (!finished(pos) && !chunkmac->offset);
+}
+
+size_t chunkmac_map::size() const
+{
+    return count;
+}
+
+bool chunkmac_map::empty() const
+{
+    return !count;
+}
+
+void chunkmac_map::clear()
+{
+    macs.clear();
+    presentbits.clear();
+    finishedbits.clear();
+    base = 0;
+    count = 0;
+    resetmacsmac();
+}
+
+void chunkmac_map::merge(const chunkmac_map& src)
+{
+    if (!src.count)
+    {
+        return;
+    }
+
+    grow(src.base);
+    grow(src.base + src.macs.size() - 1);
+
+    size_t shift = (src.base - base) / 64;
+
+    for (size_t w = 0; w < src.presentbits.size(); w++)
+    {
+        uint64_t bits = src.presentbits[w];
+        if (!bits)
+        {
+            continue;
+        }
+
+        uint64_t added = bits & ~presentbits[w + shift];
+        presentbits[w + shift] |= bits;
+        finishedbits[w + shift] = (finishedbits[w + shift] & ~bits) | (src.finishedbits[w] & bits);
+
+        for (unsigned b = 0; b < 64; b++)
+        {
+            if (bits >> b & 1)
+            {
+                size_t n = src.base + w * 64 + b;
+
+                macs[n - base] = src.macs[n - src.base];
+
+                if (added >> b & 1)
+                {
+                    count++;
+                }
+
+                if (n < macsmacchunks)
+                {
+                    resetmacsmac();
+                }
+            }
+        }
+    }
+}
+
+m_off_t chunkmac_map::nextpos(m_off_t pos) const
+{
+    size_t n = ChunkedHash::chunkindex(pos);
+    size_t u = nextunfinished(n);
+
+    if (u != n)
+    {
+        pos = ChunkedHash::chunkpos(u);
+    }
+
+    if (present(u))
+    {
+        pos += macs[u - base].offset;
+    }
+
+    return pos;
+}
+
+void chunkmac_map::calcprogress(m_off_t size, m_off_t& pos, m_off_t& progresscompleted, m_off_t* partial) const
+{
+    pos = 0;
+    progresscompleted = 0;
+
+    if (partial)
+    {
+        *partial = 0;
+    }
+
+    size_t n = nextunfinished(0);
+    if (n)
+    {
+        pos = ChunkedHash::chunkpos(n);
+        if (pos > size)
+        {
+            pos = size;
+        }
+    }
+
+    for (n = nextpresent(0); n != NOCHUNK; n = nextpresent(n + 1))
+    {
+        if (finishedbits[(n - base) / 64] >> ((n - base) & 63) & 1)
+        {
+            m_off_t chunkpos = ChunkedHash::chunkpos(n);
+            progresscompleted += ChunkedHash::chunkceil(chunkpos, size) - chunkpos;
+        }
+        else
+        {
+            progresscompleted += macs[n - base].offset;
+
+            if (partial)
+            {
+                *partial += macs[n - base].offset;
+            }
+        }
+    }
+}
+
+// coalesce block macs into file mac
+int64_t chunkmac_map::macsmac(SymmCipher* cipher)
+{
+    // fold in the chunks that completed the contiguous finished prefix
+    // since the last call - these never have to be processed again
+    size_t n = nextunfinished(macsmacchunks);
+    for (; macsmacchunks < n; macsmacchunks++)
+    {
+        SymmCipher::xorblock(macs[macsmacchunks - base].mac, macsmacprefix);
+        cipher->ecb_encrypt(macsmacprefix);
+    }
+
+    byte mac[SymmCipher::BLOCKSIZE];
+    memcpy(mac, macsmacprefix, sizeof mac);
+
+    // the rest (usually nothing by the time the transfer is complete)
+    for (n = nextpresent(n); n != NOCHUNK; n = nextpresent(n + 1))
+    {
+        SymmCipher::xorblock(macs[n - base].mac, mac);
+        cipher->ecb_encrypt(mac);
+    }
+
+    uint32_t* m = (uint32_t*)mac;
+
+    m[0] ^= m[1];
+    m[1] = m[2] ^ m[3];
+
+    return MemAccess::get<int64_t>((const char*)mac);
+}
+
+// mark the compact layout - the former layout started with the number of
+// chunks as unsigned short (which can take any value), followed by the
+// position and raw ChunkMAC {mac, offset, finished} of each chunk, and chunk
+// positions are never negative
+static const unsigned short COMPACTCHUNKMACS = 0xffff;
+static const m_off_t COMPACTCHUNKMACSPOS = -1;
+static const unsigned LEGACYCHUNKMACSIZE = 24;
+
+void chunkmac_map::serialize(string* d) const
+{
+    unsigned short ll = COMPACTCHUNKMACS;
+    d->append((const char*)&ll, sizeof(ll));
+    d->append((const char*)&COMPACTCHUNKMACSPOS, sizeof(COMPACTCHUNKMACSPOS));
+
+    uint32_t first = uint32_t(base);
+    uint32_t words = uint32_t(presentbits.size());
+    d->append((const char*)&first, sizeof(first));
+    d->append((const char*)&words, sizeof(words));
+
+    if (words)
+    {
+        d->append((const char*)&presentbits[0], words * sizeof(uint64_t));
+        d->append((const char*)&finishedbits[0], words * sizeof(uint64_t));
+    }
+
+    for (size_t n = nextpresent(0); n != NOCHUNK; n = nextpresent(n + 1))
+    {
+        const ChunkMAC& chunkmac = macs[n - base];
+
+        d->append((const char*)chunkmac.mac, sizeof(chunkmac.mac));
+
+        if (!(finishedbits[(n - base) / 64] >> ((n - base) & 63) & 1))
+        {
+            d->append((const char*)&chunkmac.offset, sizeof(chunkmac.offset));
+        }
+    }
+}
+
+bool chunkmac_map::unserialize(const char*& ptr, const char* end)
+{
+    clear();
+
+    if (ptr + sizeof(unsigned short) > end)
+    {
+        return false;
+    }
+
+    unsigned short ll = MemAccess::get<unsigned short>(ptr);
+    ptr += sizeof(ll);
+
+    if (ll != COMPACTCHUNKMACS || ptr + sizeof(m_off_t) > end
+            || MemAccess::get<m_off_t>(ptr) != COMPACTCHUNKMACSPOS)
+    {
+        if (ptr + ll * (sizeof(m_off_t) + LEGACYCHUNKMACSIZE) > end)
+        {
+            return false;
+        }
+
+        for (int i = 0; i < ll; i++)
+        {
+            m_off_t pos = MemAccess::get<m_off_t>(ptr);
+            ptr += sizeof(m_off_t);
+
+            ChunkMAC& chunkmac = (*this)[pos];
+            memcpy(chunkmac.mac, ptr, sizeof(chunkmac.mac));
+            chunkmac.offset = MemAccess::get<unsigned int>(ptr + sizeof(chunkmac.mac));
+            setfinished(pos, ptr[sizeof(chunkmac.mac) + sizeof(chunkmac.offset)] != 0);
+            ptr += LEGACYCHUNKMACSIZE;
+        }
+
+        return true;
+    }
+
+    ptr += sizeof(m_off_t);
+
+    if (ptr + 2 * sizeof(uint32_t) > end)
+    {
+        return false;
+    }
+
+    uint32_t first = MemAccess::get<uint32_t>(ptr);
+    ptr += sizeof(first);
+    uint32_t words = MemAccess::get<uint32_t>(ptr);
+    ptr += sizeof(words);
+
+    if ((first & 63) || words > (end - ptr) / (2 * sizeof(uint64_t)))
+    {
+        return false;
+    }
+
+    if (!words)
+    {
+        return true;
+    }
+
+    base = first;
+    macs.resize(words * 64);
+    presentbits.resize(words);
+    finishedbits.resize(words);
+
+    memcpy(&presentbits[0], ptr, words * sizeof(uint64_t));
+    ptr += words * sizeof(uint64_t);
+    memcpy(&finishedbits[0], ptr, words * sizeof(uint64_t));
+    ptr += words * sizeof(uint64_t);
+
+    for (size_t n = nextpresent(0); n != NOCHUNK; n = nextpresent(n + 1))
+    {
+        ChunkMAC& chunkmac = macs[n - base];
+        bool finished = finishedbits[(n - base) / 64] >> ((n - base) & 63) & 1;
+
+        if (ptr + sizeof(chunkmac.mac) + (finished ? 0 : sizeof(chunkmac.offset)) > end)
+        {
+            clear();
+            return false;
+        }
+
+        memcpy(chunkmac.mac, ptr, sizeof(chunkmac.mac));
+        ptr += sizeof(chunkmac.mac);
+
+        if (!finished)
+        {
+            chunkmac.offset = MemAccess::get<unsigned int>(ptr);
+            ptr += sizeof(chunkmac.offset);
+        }
+
+        count++;
+    }
+
+    // a finished chunk is always present
+    for (size_t w = 0; w < words; w++)
+    {
+        finishedbits[w] &= presentbits[w];
+    }
+
+    return true;
+}
+
+node_map::iterator::iterator()
+{
+    pos = NULL;
+    last = NULL;
+}
+
+void node_map::iterator::skip()
+{
+    while (pos != last && pos->first == UNDEF)
+    {
+        pos++;
+    }
+}
+
+node_map::iterator& node_map::iterator::operator++()
+{
+    pos++;
+    skip();
+    return *this;
+}
+
+node_map::iterator node_map::iterator::operator++(int)
+{
+    iterator it = *this;
+    ++*this;
+    return it;
+}
+
+node_map::node_map()
+{
+    bits = 0;
+    count = 0;
+}
+
+node_map::iterator node_map::begin()
+{
+    iterator it = end();
+
+    if (slots.size())
+    {
+        it.pos = &slots[0];
+        it.skip();
+    }
+
+    return it;
+}
+
+node_map::iterator node_map::end()
+{
+    iterator it;
+
+    if (slots.size())
+    {
+        it.pos = it.last = &slots[0] + slots.size();
+    }
+
+    return it;
+}
+
+// Fibonacci hashing - the low bits of handles are not evenly distributed
+// for all handle sources
+size_t node_map::home(handle h) const
+{
+    return (size_t)((h * 0x9e3779b97f4a7c15ULL) >> (64 - bits));
+}
+
+size_t node_map::lookup(handle h) const
+{
+    size_t mask = slots.size() - 1;
+    size_t i = home(h);
+
+    while (slots[i].first != h && slots[i].first != UNDEF)
+    {
+        i = (i + 1) & mask;
+    }
+
+    return i;
+}
+
+node_map::iterator node_map::find(handle h)
+{
+    iterator it = end();
+
+    if (count)
+    {
+        size_t i = lookup(h);
+
+        if (slots[i].first != UNDEF)
+        {
+            it.pos = &slots[i];
+        }
+    }
+
+    return it;
+}
+
+Node*& node_map::operator[](handle h)
+{
+    // keep the load factor below 3/4
+    if ((count + 1) * 4 > slots.size() * 3)
+    {
+        rehash(bits ? bits + 1 : 4);
+    }
+
+    size_t i = lookup(h);
+
+    if (slots[i].first == UNDEF)
+    {
+        slots[i].first = h;
+        slots[i].second = NULL;
+        count++;
+    }
+
+    return slots[i].second;
+}
+
+// backward-shift deletion: no tombstones, probe sequences stay short
+size_t node_map::erase(handle h)
+{
+    if (!count)
+    {
+        return 0;
+    }
+
+    size_t mask = slots.size() - 1;
+    size_t i = lookup(h);
+
+    if (slots[i].first == UNDEF)
+    {
+        return 0;
+    }
+
+    for (size_t j = (i + 1) & mask; slots[j].first != UNDEF; j = (j + 1) & mask)
+    {
+        size_t k = home(slots[j].first);
+
+        // move the entry back unless its home lies cyclically in (i, j]
+        if ((i < j) ? (k <= i || k > j) : (k <= i && k > j))
+        {
+            slots[i] = slots[j];
+            i = j;
+        }
+    }
+
+    slots[i].first = UNDEF;
+    slots[i].second = NULL;
+    count--;
+
+    return 1;
+}
+
+size_t node_map::size() const
+{
+    return count;
+}
+
+bool node_map::empty() const
+{
+    return !count;
+}
+
+void node_map::clear()
+{
+    vector<value_type>().swap(slots);
+    bits = 0;
+    count = 0;
+}
+
+void node_map::rehash(unsigned newbits)
+{
+    vector<value_type> old(size_t(1) << newbits, value_type(UNDEF, (Node*)NULL));
+
+    old.swap(slots);
+    bits = newbits;
+
+    for (size_t i = 0; i < old.size(); i++)
+    {
+        if (old[i].first != UNDEF)
+        {
+            slots[lookup(old[i].first)] = old[i];
+        }
+    }
+}
 
 // cryptographic signature generation/verification
 HashSignature::HashSignature(Hash* h)
@@ -84,6 +84,22 @@ void Waiter::bumpds()
 #endif
 }
 
+int64_t Waiter::us()
+{
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+
+    if (!frequency.QuadPart)
+    {
+        QueryPerformanceFrequency(&frequency);
+    }
+
+    QueryPerformanceCounter(&counter);
+
+    return int64_t(counter.QuadPart / frequency.QuadPart) * 1000000
+            + int64_t(counter.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart;
+}
+
 // wait for events (socket, I/O completion, timeout + application events)
 // ds specifies the maximum amount of time to wait in deciseconds (or ~0 if no
 // timeout scheduled)
@@ -163,6 +163,410 @@ TEST(Crypto, AES_CCM)
     ASSERT_STREQ(result.data(), plainText.data()) << "CCM decryption: plain text doesn't match the expected value";
 }
 
+// Test AES-CTR with CBC-MAC against a block-by-block reference
+// (checks the multi-block kernels, including the partial last block)
+TEST(Crypto, AES_CTR_MAC)
+{
+    byte keyBytes[SymmCipher::KEYLENGTH];
+    for (unsigned i = 0; i < sizeof keyBytes; i++) keyBytes[i] = (byte)(i * 7 + 1);
+
+    SymmCipher key;
+    key.setkey(keyBytes);
+
+    SymmCipher::ctr_iv ctriv = 0x0123456789abcdefULL;
+    m_off_t pos = 1048576;
+
+    unsigned lengths[] = { 0, 1, 15, 16, 17, 127, 128, 129, 1000, 4096, 65536 + 5 };
+
+    for (unsigned l = 0; l < sizeof lengths / sizeof lengths[0]; l++)
+    {
+        unsigned len = lengths[l];
+        unsigned padded = (len + SymmCipher::BLOCKSIZE - 1) & -SymmCipher::BLOCKSIZE;
+
+        string plain(padded, '\0');
+        for (unsigned i = 0; i < len; i++) plain[i] = (char)(i * 31 + l);
+
+        // reference: CBC-MAC of the plain text and one ECB call per counter block
+        byte refmac[SymmCipher::BLOCKSIZE];
+        byte ctr[SymmCipher::BLOCKSIZE], ks[SymmCipher::BLOCKSIZE];
+        string refcipher = plain;
+
+        MemAccess::set<int64_t>(ctr, ctriv);
+        SymmCipher::setint64(pos / SymmCipher::BLOCKSIZE, ctr + sizeof ctriv);
+        memcpy(refmac, ctr, sizeof ctriv);
+        memcpy(refmac + sizeof ctriv, ctr, sizeof ctriv);
+
+        for (unsigned i = 0; i < padded; i += SymmCipher::BLOCKSIZE)
+        {
+            SymmCipher::xorblock((byte*)plain.data() + i, refmac);
+            key.ecb_encrypt(refmac);
+            key.ecb_encrypt(ctr, ks);
+            SymmCipher::xorblock(ks, (byte*)refcipher.data() + i);
+            SymmCipher::incblock(ctr);
+        }
+
+        string cipher = plain;
+        byte mac[SymmCipher::BLOCKSIZE];
+        key.ctr_crypt((byte*)cipher.data(), len, pos, ctriv, mac, true);
+
+        ASSERT_EQ(0, memcmp(cipher.data(), refcipher.data(), len)) << "CTR encryption mismatch, length " << len;
+        ASSERT_EQ(0, memcmp(mac, refmac, sizeof mac)) << "CBC-MAC mismatch on encryption, length " << len;
+
+        string decrypted = cipher;
+        byte mac2[SymmCipher::BLOCKSIZE];
+        key.ctr_crypt((byte*)decrypted.data(), len, pos, ctriv, mac2, false);
+
+        ASSERT_EQ(0, memcmp(decrypted.data(), plain.data(), len)) << "CTR decryption mismatch, length " << len;
+        ASSERT_EQ(0, memcmp(mac2, refmac, sizeof mac2)) << "CBC-MAC mismatch on decryption, length " << len;
+
+        string nomac = plain;
+        key.ctr_crypt((byte*)nomac.data(), len, pos, ctriv, NULL, true);
+
+        ASSERT_EQ(0, memcmp(nomac.data(), refcipher.data(), len)) << "CTR (no MAC) mismatch, length " << len;
+    }
+}
+
+// Test the incremental meta-MAC against a full fold of all chunk MACs,
+// with chunks finished out of order and the map cleared midway
+TEST(Crypto, MetaMAC)
+{
+    byte keyBytes[SymmCipher::KEYLENGTH];
+    for (unsigned i = 0; i < sizeof keyBytes; i++) keyBytes[i] = (byte)(i * 13 + 5);
+
+    SymmCipher key;
+    key.setkey(keyBytes);
+
+    m_off_t size = 12 * 1048576 + 12345;
+    unsigned order[] = { 2, 0, 1, 5, 3, 4, 9, 6, 8, 7, 10, 11, 14, 12, 13, 15 };
+
+    chunkmac_map macs;
+
+    for (int round = 0; round < 2; round++)
+    {
+        vector<m_off_t> chunks;
+
+        for (m_off_t pos = 0; pos < size; pos = ChunkedHash::chunkceil(pos, size))
+        {
+            ChunkMAC& chunkmac = macs[pos];
+            for (unsigned i = 0; i < sizeof chunkmac.mac; i++)
+            {
+                chunkmac.mac[i] = (byte)(pos / 4096 + i * 3 + round);
+            }
+            chunks.push_back(pos);
+        }
+
+        ASSERT_EQ(sizeof order / sizeof order[0], chunks.size());
+
+        for (unsigned n = 0; n < chunks.size(); n++)
+        {
+            macs.setfinished(chunks[order[n]]);
+
+            byte mac[SymmCipher::BLOCKSIZE] = { 0 };
+            for (unsigned i = 0; i < chunks.size(); i++)
+            {
+                SymmCipher::xorblock(macs.find(chunks[i])->mac, mac);
+                key.ecb_encrypt(mac);
+            }
+
+            uint32_t* m = (uint32_t*)mac;
+            m[0] ^= m[1];
+            m[1] = m[2] ^ m[3];
+
+            ASSERT_EQ(MemAccess::get<int64_t>((const char*)mac), macs.macsmac(&key)) << "Meta-MAC mismatch, step " << n;
+        }
+
+        macs.clear();
+        ASSERT_EQ(0u, macs.size());
+    }
+}
+
+// Test the chunk table: chunk numbering, merge, resume position/progress
+// and serialization (compact and former layout)
+TEST(Crypto, ChunkMacs)
+{
+    for (m_off_t pos = 0; pos < 40 * 1048576; pos = ChunkedHash::chunkceil(pos))
+    {
+        size_t n = ChunkedHash::chunkindex(pos);
+        ASSERT_EQ(pos, ChunkedHash::chunkpos(n));
+        ASSERT_EQ(n, ChunkedHash::chunkindex(ChunkedHash::chunkceil(pos) - 1));
+        ASSERT_EQ(n + 1, ChunkedHash::chunkindex(ChunkedHash::chunkceil(pos)));
+    }
+
+    m_off_t size = 300 * 1048576 + 777;
+    m_off_t chunk100 = ChunkedHash::chunkpos(100);
+    m_off_t chunk200 = ChunkedHash::chunkpos(200);
+
+    // chunks [0, 100) finished, chunk 100 partially processed, chunk 200 finished
+    chunkmac_map macs;
+    for (size_t n = 0; n < 100; n++)
+    {
+        macs[ChunkedHash::chunkpos(n)].offset = 16;
+    }
+
+    chunkmac_map reqmacs;
+    for (size_t n = 0; n < 100; n++)
+    {
+        ChunkMAC& chunkmac = reqmacs[ChunkedHash::chunkpos(n)];
+        memset(chunkmac.mac, (byte)n, sizeof chunkmac.mac);
+        reqmacs.setfinished(ChunkedHash::chunkpos(n));
+    }
+    reqmacs[chunk100].offset = 4096;
+    memset(reqmacs[chunk200].mac, 200, SymmCipher::BLOCKSIZE);
+    reqmacs.setfinished(chunk200);
+
+    macs.merge(reqmacs);
+
+    ASSERT_EQ(102u, macs.size());
+    ASSERT_EQ(5, macs.find(ChunkedHash::chunkpos(5))->mac[0]);
+    ASSERT_TRUE(macs.finished(ChunkedHash::chunkpos(99)));
+    ASSERT_FALSE(macs.finished(chunk100));
+    ASSERT_FALSE(macs.unprocessed(chunk100));
+    ASSERT_TRUE(macs.unprocessed(ChunkedHash::chunkpos(101)));
+    ASSERT_EQ(chunk100 + 4096, macs.nextpos(0));
+    ASSERT_EQ(ChunkedHash::chunkpos(101), macs.nextpos(ChunkedHash::chunkpos(101)));
+    ASSERT_EQ(ChunkedHash::chunkpos(201), macs.nextpos(chunk200));
+
+    m_off_t pos, progress, partial;
+    macs.calcprogress(size, pos, progress, &partial);
+    ASSERT_EQ(chunk100, pos);
+    ASSERT_EQ(4096, partial);
+    ASSERT_EQ(chunk100 + 4096 + ChunkedHash::chunkpos(201) - chunk200, progress);
+
+    string d;
+    macs.serialize(&d);
+
+    chunkmac_map copy;
+    const char* ptr = d.data();
+    ASSERT_TRUE(copy.unserialize(ptr, d.data() + d.size()));
+    ASSERT_EQ(d.data() + d.size(), ptr);
+    ASSERT_EQ(macs.size(), copy.size());
+    ASSERT_EQ(200, copy.find(chunk200)->mac[0]);
+    ASSERT_EQ(4096u, copy.find(chunk100)->offset);
+    ASSERT_TRUE(copy.finished(chunk200));
+    ASSERT_FALSE(copy.finished(chunk100));
+
+    ptr = d.data();
+    ASSERT_FALSE(copy.unserialize(ptr, d.data() + d.size() - 1));
+
+    // former layout: count, then position and {mac, offset, finished}
+    string legacy;
+    unsigned short ll = 2;
+    legacy.append((const char*)&ll, sizeof ll);
+    for (int i = 0; i < 2; i++)
+    {
+        m_off_t chunkpos = i ? chunk100 : chunk200;
+        char entry[24] = { 0 };
+        unsigned int offset = i ? 4096 : 0;
+        entry[0] = (char)(i + 1);
+        memcpy(entry + 16, &offset, sizeof offset);
+        entry[20] = !i;
+        legacy.append((const char*)&chunkpos, sizeof chunkpos);
+        legacy.append(entry, sizeof entry);
+    }
+
+    ptr = legacy.data();
+    ASSERT_TRUE(copy.unserialize(ptr, legacy.data() + legacy.size()));
+    ASSERT_EQ(2u, copy.size());
+    ASSERT_TRUE(copy.finished(chunk200));
+    ASSERT_EQ(1, copy.find(chunk200)->mac[0]);
+    ASSERT_EQ(4096u, copy.find(chunk100)->offset);
+    ASSERT_EQ(chunk100 + 4096, copy.nextpos(chunk100));
+
+    // a former layout with 0xffff chunks is not taken for the compact one
+    legacy.clear();
+    ll = 0xffff;
+    legacy.append((const char*)&ll, sizeof ll);
+    for (size_t n = 0; n < ll; n++)
+    {
+        m_off_t chunkpos = ChunkedHash::chunkpos(n);
+        char entry[24] = { 0 };
+        entry[20] = 1;
+        legacy.append((const char*)&chunkpos, sizeof chunkpos);
+        legacy.append(entry, sizeof entry);
+    }
+
+    ptr = legacy.data();
+    ASSERT_TRUE(copy.unserialize(ptr, legacy.data() + legacy.size()));
+    ASSERT_EQ(legacy.data() + legacy.size(), ptr);
+    ASSERT_EQ(size_t(ll), copy.size());
+    ASSERT_TRUE(copy.finished(ChunkedHash::chunkpos(ll - 1)));
+
+    // a request spanning several chunks finishes all of them
+    copy.clear();
+    copy[0];
+    copy[ChunkedHash::chunkpos(1)];
+    copy[ChunkedHash::chunkpos(2)];
+    copy.finishrange(0, ChunkedHash::chunkpos(3) - 100);
+    ASSERT_TRUE(copy.finished(ChunkedHash::chunkpos(2)));
+    ASSERT_EQ(ChunkedHash::chunkpos(3), copy.nextpos(0));
+}
+
+// Test the decryption of a download request while it is in flight: a retry
+// must start over, a request resumed in the middle of a chunk must continue
+// its MAC, and both must match a request that is decrypted at once
+TEST(Crypto, DownloadDecryption)
+{
+    byte keyBytes[SymmCipher::KEYLENGTH];
+    for (unsigned i = 0; i < sizeof keyBytes; i++)
+    {
+        keyBytes[i] = (byte)(i * 7 + 1);
+    }
+    SymmCipher cipher;
+    cipher.setkey(keyBytes, SymmCipher::KEYLENGTH);
+    SymmCipher::ctr_iv ctriv = 0x0123456789abcdefULL;
+
+    m_off_t size = ChunkedHash::chunkpos(3) + 12345;
+    string data((size_t)size, 0);
+    for (m_off_t i = 0; i < size; i++)
+    {
+        data[(size_t)i] = (char)(i * 13 + i / 1000);
+    }
+
+    chunkmac_map nomacs;
+    HttpReqDL ref;
+    ref.prepare("http://localhost", NULL, NULL, 0, 0, size);
+    ref.put((void*)data.data(), (unsigned)size);
+    ref.loadchunkmacs(&nomacs, size);
+    ref.decrypt(&cipher, ctriv, size);
+
+    // received in pieces, partially decrypted, then sent again
+    HttpReqDL req;
+    req.prepare("http://localhost", NULL, NULL, 0, 0, size);
+    req.put((void*)data.data(), 300000);
+    req.loadchunkmacs(&nomacs, size);
+    req.decryptreceived(&cipher, ctriv, size);
+    ASSERT_EQ(ChunkedHash::chunkpos(1), req.decryptedpos);
+    ASSERT_TRUE(req.chunkmacs.finished(0));
+
+    req.rewind();
+    ASSERT_EQ(0, req.decryptedpos);
+    ASSERT_TRUE(req.chunkmacs.empty());
+
+    req.init();
+    while (req.bufpos < size)
+    {
+        m_off_t n = std::min<m_off_t>(100000, size - req.bufpos);
+        req.put((void*)(data.data() + req.bufpos), (unsigned)n);
+        req.loadchunkmacs(&nomacs, size);
+        req.decryptreceived(&cipher, ctriv, size);
+    }
+    ASSERT_EQ(ChunkedHash::chunkpos(3), req.decryptedpos);
+    req.loadchunkmacs(&nomacs, size);
+    req.decrypt(&cipher, ctriv, size);
+
+    ASSERT_EQ(0, memcmp(ref.buf, req.buf, (size_t)size));
+    for (size_t n = 0; n < 4; n++)
+    {
+        m_off_t chunkid = ChunkedHash::chunkpos(n);
+        ASSERT_TRUE(req.chunkmacs.finished(chunkid));
+        ASSERT_EQ(0, memcmp(ref.chunkmacs.find(chunkid)->mac, req.chunkmacs.find(chunkid)->mac, SymmCipher::BLOCKSIZE));
+    }
+
+    // a first request ends in the middle of chunk 1, the next one resumes
+    // there and is decrypted while it is received
+    m_off_t mid = 200000;
+    chunkmac_map macs;
+    HttpReqDL first;
+    first.prepare("http://localhost", NULL, NULL, 0, 0, mid);
+    first.put((void*)data.data(), (unsigned)mid);
+    first.loadchunkmacs(&macs, size);
+    first.decrypt(&cipher, ctriv, size);
+    macs.merge(first.chunkmacs);
+    ASSERT_FALSE(macs.finished(ChunkedHash::chunkpos(1)));
+    ASSERT_EQ(mid, macs.nextpos(0));
+
+    HttpReqDL second;
+    second.prepare("http://localhost", NULL, NULL, 0, mid, size);
+    while (second.bufpos < size - mid)
+    {
+        m_off_t n = std::min<m_off_t>(65536, size - mid - second.bufpos);
+        second.put((void*)(data.data() + mid + second.bufpos), (unsigned)n);
+        second.loadchunkmacs(&macs, size);
+        second.decryptreceived(&cipher, ctriv, size);
+    }
+    ASSERT_EQ(ChunkedHash::chunkpos(3) - mid, second.decryptedpos);
+    second.loadchunkmacs(&macs, size);
+    second.decrypt(&cipher, ctriv, size);
+    macs.merge(second.chunkmacs);
+
+    ASSERT_EQ(0, memcmp(ref.buf, first.buf, (size_t)mid));
+    ASSERT_EQ(0, memcmp(ref.buf + mid, second.buf, (size_t)(size - mid)));
+    for (size_t n = 0; n < 4; n++)
+    {
+        m_off_t chunkid = ChunkedHash::chunkpos(n);
+        ASSERT_TRUE(macs.finished(chunkid));
+        ASSERT_EQ(0, memcmp(ref.chunkmacs.find(chunkid)->mac, macs.find(chunkid)->mac, SymmCipher::BLOCKSIZE));
+    }
+}
+
+// Test a download request that is larger than its buffer: the data that has
+// been written is released while the request is received, so the buffer
+// does not grow, and the written data matches a request decrypted at once
+TEST(Crypto, DownloadBufferRelease)
+{
+    byte keyBytes[SymmCipher::KEYLENGTH];
+    for (unsigned i = 0; i < sizeof keyBytes; i++)
+    {
+        keyBytes[i] = (byte)(i * 5 + 3);
+    }
+    SymmCipher cipher;
+    cipher.setkey(keyBytes, SymmCipher::KEYLENGTH);
+    SymmCipher::ctr_iv ctriv = 0x0f1e2d3c4b5a6978ULL;
+
+    m_off_t size = 4 * HttpReqDL::INITIALBUFSIZE + 777;
+    string data((size_t)size, 0);
+    for (m_off_t i = 0; i < size; i++)
+    {
+        data[(size_t)i] = (char)(i * 31 + i / 4096);
+    }
+
+    chunkmac_map nomacs;
+    HttpReqDL ref;
+    ref.prepare("http://localhost", NULL, NULL, 0, 0, size);
+    while (ref.bufpos < size)
+    {
+        // grows up to the whole request while nothing is released
+        m_off_t n = std::min<m_off_t>(1000000, size - ref.bufpos);
+        ref.put((void*)(data.data() + ref.bufpos), (unsigned)n);
+    }
+    ASSERT_GE(ref.bufalloc, size);
+    ref.loadchunkmacs(&nomacs, size);
+    ref.decrypt(&cipher, ctriv, size);
+
+    chunkmac_map macs;
+    HttpReqDL req;
+    req.prepare("http://localhost", NULL, NULL, 0, 0, size);
+    ASSERT_EQ(m_off_t(HttpReqDL::INITIALBUFSIZE), req.bufalloc);
+
+    string file;
+    while (req.bufpos < size)
+    {
+        m_off_t n = std::min<m_off_t>(65536, size - req.bufpos);
+        req.put((void*)(data.data() + req.bufpos), (unsigned)n);
+        req.loadchunkmacs(&macs, size);
+        req.decryptreceived(&cipher, ctriv, size);
+
+        ASSERT_EQ(m_off_t(file.size()), req.writtenpos);
+        file.append((char*)req.bufat(req.writtenpos), size_t(req.decryptedpos - req.writtenpos));
+        req.setwritten(req.decryptedpos);
+    }
+    ASSERT_EQ(m_off_t(HttpReqDL::INITIALBUFSIZE), req.bufalloc);
+    ASSERT_GT(req.bufstart, 0);
+
+    req.loadchunkmacs(&macs, size);
+    req.decrypt(&cipher, ctriv, size);
+    file.append((char*)req.bufat(req.writtenpos), size_t(req.bufpos - req.writtenpos));
+    macs.merge(req.chunkmacs);
+
+    ASSERT_EQ(size_t(size), file.size());
+    ASSERT_EQ(0, memcmp(ref.buf, file.data(), (size_t)size));
+    for (m_off_t chunkid = 0; chunkid < size; chunkid = ChunkedHash::chunkceil(chunkid, size))
+    {
+        ASSERT_TRUE(macs.finished(chunkid));
+        ASSERT_EQ(0, memcmp(ref.chunkmacs.find(chunkid)->mac, macs.find(chunkid)->mac, SymmCipher::BLOCKSIZE));
+    }
+}
+
 #ifdef ENABLE_CHAT
 // Test functions of Ed25519:
 // - Binary & Hex fingerprints of public key
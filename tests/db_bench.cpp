@@ -0,0 +1,168 @@
+/**
+ * @file tests/db_bench.cpp
+ * @brief Write throughput of the SQLite state cache table
+ *
+ * (c) 2013-2018 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+// usage: db_bench [records] [record size]
+//
+// Writes and deletes the same records through:
+// - a statement compiled for every record (the former SqliteDbTable behaviour)
+// - DbTable::put()/del() (persistent prepared statements)
+// - DbTable::putmany()/delmany() (batched writes)
+// and prints the records per second of each, every run in a single transaction
+
+#include "mega.h"
+#include <chrono>
+#include <stdlib.h>
+
+using namespace mega;
+
+#ifdef USE_SQLITE
+static double seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void report(const char* what, unsigned count, double secs)
+{
+    std::cout << what << ": " << count << " records in " << secs << " s ("
+              << (unsigned long)(secs > 0 ? count / secs : 0) << " records/s)" << std::endl;
+}
+
+// one sqlite3_prepare()/sqlite3_finalize() per record
+static void legacy(const string& dbfile, const vector<uint32_t>& ids, const vector<string>& data)
+{
+    sqlite3* db;
+    if (sqlite3_open(dbfile.c_str(), &db))
+    {
+        return;
+    }
+
+    sqlite3_exec(db, "PRAGMA journal_mode=WAL;", NULL, NULL, NULL);
+    sqlite3_exec(db, "CREATE TABLE IF NOT EXISTS statecache (id INTEGER PRIMARY KEY ASC NOT NULL, content BLOB NOT NULL)", NULL, NULL, NULL);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    sqlite3_exec(db, "BEGIN", 0, 0, NULL);
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare(db, "INSERT OR REPLACE INTO statecache (id, content) VALUES (?, ?)", -1, &stmt, NULL) == SQLITE_OK)
+        {
+            sqlite3_bind_int(stmt, 1, ids[i]);
+            sqlite3_bind_blob(stmt, 2, data[i].data(), data[i].size(), SQLITE_STATIC);
+            sqlite3_step(stmt);
+        }
+        sqlite3_finalize(stmt);
+    }
+    sqlite3_exec(db, "COMMIT", 0, 0, NULL);
+    report("put, statement per record", ids.size(), seconds(start));
+
+    start = std::chrono::steady_clock::now();
+    sqlite3_exec(db, "BEGIN", 0, 0, NULL);
+    for (size_t i = 0; i < ids.size(); i++)
+    {
+        char buf[64];
+        sprintf(buf, "DELETE FROM statecache WHERE id = %" PRIu32, ids[i]);
+        sqlite3_exec(db, buf, 0, 0, NULL);
+    }
+    sqlite3_exec(db, "COMMIT", 0, 0, NULL);
+    report("del, statement per record", ids.size(), seconds(start));
+
+    sqlite3_close(db);
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned count = argc > 1 ? atoi(argv[1]) : 200000;
+    unsigned size = argc > 2 ? atoi(argv[2]) : 256;
+
+    vector<uint32_t> ids(count);
+    vector<string> data(count);
+    for (unsigned i = 0; i < count; i++)
+    {
+        ids[i] = (i + 1) * 16;
+        data[i].resize(size);
+        for (unsigned j = 0; j < size; j++)
+        {
+            data[i][j] = (char)rand();
+        }
+    }
+
+    FSACCESS_CLASS fsaccess;
+    string path = "./";
+    string name = "dbbench";
+    SqliteDbAccess dbaccess(&path);
+
+    DbTable* table = dbaccess.open(&fsaccess, &name);
+    if (!table)
+    {
+        std::cout << "Unable to open the database" << std::endl;
+        return 1;
+    }
+
+    table->truncate();
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    table->begin();
+    for (unsigned i = 0; i < count; i++)
+    {
+        table->put(ids[i], (char*)data[i].data(), data[i].size());
+    }
+    table->commit();
+    report("put, prepared statement", count, seconds(start));
+
+    start = std::chrono::steady_clock::now();
+    table->begin();
+    for (unsigned i = 0; i < count; i++)
+    {
+        table->del(ids[i]);
+    }
+    table->commit();
+    report("del, prepared statement", count, seconds(start));
+
+    start = std::chrono::steady_clock::now();
+    table->begin();
+    table->putmany(&ids[0], &data[0], count);
+    table->commit();
+    report("putmany", count, seconds(start));
+
+    start = std::chrono::steady_clock::now();
+    table->begin();
+    table->delmany(&ids[0], count);
+    table->commit();
+    report("delmany", count, seconds(start));
+
+    table->remove();
+    delete table;
+
+    string legacyfile = "./megaclient_statecache_dbbench_legacy.db";
+    legacy(legacyfile, ids, data);
+    ::remove(legacyfile.c_str());
+    ::remove((legacyfile + "-wal").c_str());
+    ::remove((legacyfile + "-shm").c_str());
+
+    return 0;
+}
+#else
+int main()
+{
+    std::cout << "SQLite support is required" << std::endl;
+    return 1;
+}
+#endif
@@ -0,0 +1,257 @@
+/**
+ * @file tests/http2_test.cpp
+ * @brief Mega SDK test for the HTTP/2 multiplexing of transfer requests
+ *
+ * (c) 2013-2018 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+// The requests are sent by CurlHttpIO to a local nghttpd server (TLS with a
+// throwaway self-signed certificate, so that HTTP/2 is negotiated by ALPN).
+// Built with --enable-http2-tests, which locates nghttpd and openssl.
+
+#include "mega.h"
+#include "gtest/gtest.h"
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+using namespace mega;
+
+#ifndef NGHTTPD
+#define NGHTTPD "nghttpd"
+#endif
+
+#ifndef OPENSSL
+#define OPENSSL "openssl"
+#endif
+
+static const int NUMREQUESTS = 32;
+// larger than the initial HTTP/2 flow control window, so that the server
+// interleaves the responses of the streams it multiplexes
+static const int FILESIZE = 1048576;
+
+class Http2Test : public ::testing::Test
+{
+protected:
+    string dir;
+    int port;
+    pid_t server;
+
+    CurlHttpIO httpio;
+    PosixWaiter waiter;
+
+    virtual void SetUp()
+    {
+        char tmpl[] = "/tmp/megahttp2.XXXXXX";
+        ASSERT_TRUE(mkdtemp(tmpl) != NULL);
+        dir = tmpl;
+        server = -1;
+
+        string cmd = OPENSSL " req -x509 -newkey rsa:2048 -nodes -days 1 -subj /CN=localhost -keyout "
+                + dir + "/server.key -out " + dir + "/server.crt >/dev/null 2>&1";
+        ASSERT_EQ(0, system(cmd.c_str())) << "Cannot create the server certificate";
+
+        FILE* fp = fopen((dir + "/data.bin").c_str(), "wb");
+        ASSERT_TRUE(fp != NULL);
+        for (int i = 0; i < FILESIZE; i++)
+        {
+            fputc((i * 7) & 0xff, fp);
+        }
+        fclose(fp);
+
+        port = 20000 + getpid() % 20000;
+
+        char portstr[16];
+        sprintf(portstr, "%d", port);
+
+        server = fork();
+        ASSERT_NE(-1, server);
+        if (!server)
+        {
+            // the frames are logged to check how the streams were multiplexed
+            if (!freopen((dir + "/server.log").c_str(), "w", stdout))
+            {
+                _exit(127);
+            }
+
+            execl(NGHTTPD, NGHTTPD, "-v", "-d", dir.c_str(), portstr,
+                  (dir + "/server.key").c_str(), (dir + "/server.crt").c_str(), (char*)NULL);
+            _exit(127);
+        }
+
+        // wait for the server to listen
+        bool listening = false;
+        for (int i = 0; i < 100 && !listening; i++)
+        {
+            int s = socket(AF_INET, SOCK_STREAM, 0);
+            struct sockaddr_in addr;
+            memset(&addr, 0, sizeof addr);
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(port);
+            addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+            listening = !connect(s, (struct sockaddr*)&addr, sizeof addr);
+            close(s);
+
+            if (!listening)
+            {
+                usleep(100000);
+            }
+        }
+        ASSERT_TRUE(listening) << "nghttpd not listening on port " << port;
+    }
+
+    virtual void TearDown()
+    {
+        if (server > 0)
+        {
+            kill(server, SIGTERM);
+            waitpid(server, NULL, 0);
+        }
+
+        string cmd = "rm -rf " + dir;
+        system(cmd.c_str());
+    }
+
+    // largest number of requests that were in progress at the same time on
+    // one connection: from the request HEADERS to the last DATA frame
+    int maxconcurrentstreams()
+    {
+        kill(server, SIGTERM);
+        waitpid(server, NULL, 0);
+        server = -1;
+
+        FILE* fp = fopen((dir + "/server.log").c_str(), "r");
+        if (!fp)
+        {
+            return -1;
+        }
+
+        map<int, int> streams;
+        int maxstreams = 0;
+        char line[512];
+
+        while (fgets(line, sizeof line, fp))
+        {
+            int session;
+            unsigned flags;
+
+            if (sscanf(line, "[id=%d]", &session) != 1)
+            {
+                continue;
+            }
+
+            if (strstr(line, "recv HEADERS frame"))
+            {
+                maxstreams = std::max(maxstreams, ++streams[session]);
+            }
+            else if (strstr(line, "send DATA frame") && sscanf(strstr(line, "flags="), "flags=%x", &flags) == 1
+                     && (flags & 1))
+            {
+                streams[session]--;
+            }
+        }
+
+        fclose(fp);
+        return maxstreams;
+    }
+
+    // send GET requests for the test file and wait until they are finished
+    void getall(HttpReq* reqs, int n)
+    {
+        string url = "https://127.0.0.1:";
+        char portstr[16];
+        sprintf(portstr, "%d", port);
+        url.append(portstr);
+        url.append("/data.bin");
+
+        for (int i = 0; i < n; i++)
+        {
+            reqs[i].setreq(url.c_str(), REQ_BINARY);
+            reqs[i].httpio = &httpio;
+            reqs[i].method = METHOD_GET;
+            reqs[i].contentlength = -1;
+            httpio.post(&reqs[i]);
+        }
+
+        for (int t = 0; t < 300; t++)
+        {
+            int inflight = 0;
+            for (int i = 0; i < n; i++)
+            {
+                inflight += reqs[i].status == REQ_INFLIGHT;
+            }
+
+            if (!inflight)
+            {
+                break;
+            }
+
+            Waiter::bumpds();
+            waiter.init(1);
+            waiter.wakeupby(&httpio, Waiter::NEEDEXEC);
+            waiter.wait();
+            httpio.doio();
+        }
+    }
+};
+
+// concurrent chunk requests to the same server share one connection
+TEST_F(Http2Test, Multiplexing)
+{
+    ASSERT_TRUE(httpio.setmultiplexing(true, 0)) << "cURL built without HTTP/2";
+
+    HttpReq reqs[NUMREQUESTS];
+    getall(reqs, NUMREQUESTS);
+
+    for (int i = 0; i < NUMREQUESTS; i++)
+    {
+        ASSERT_EQ(REQ_SUCCESS, reqs[i].status) << "Request " << i << " failed";
+        ASSERT_EQ(size_t(FILESIZE), reqs[i].in.size());
+        ASSERT_EQ(char(100 * 7 & 0xff), reqs[i].in[100]);
+    }
+
+    HttpConnectionStats stats;
+    httpio.getconnectionstats(GET, &stats);
+    EXPECT_EQ(NUMREQUESTS, stats.completed);
+    EXPECT_EQ(1, stats.connects) << "Requests not multiplexed";
+    EXPECT_GT(maxconcurrentstreams(), 1);
+}
+
+// without the option, a connection carries one request at a time, even if
+// HTTP/2 has been negotiated for it (idle connections are reused)
+TEST_F(Http2Test, NoMultiplexing)
+{
+    HttpReq first;
+    getall(&first, 1);
+    ASSERT_EQ(REQ_SUCCESS, first.status);
+
+    HttpReq reqs[NUMREQUESTS];
+    getall(reqs, NUMREQUESTS);
+
+    for (int i = 0; i < NUMREQUESTS; i++)
+    {
+        ASSERT_EQ(REQ_SUCCESS, reqs[i].status) << "Request " << i << " failed";
+    }
+
+    HttpConnectionStats stats;
+    httpio.getconnectionstats(GET, &stats);
+    EXPECT_EQ(NUMREQUESTS + 1, stats.completed);
+    EXPECT_EQ(1, maxconcurrentstreams()) << "Requests multiplexed";
+}
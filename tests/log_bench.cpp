@@ -0,0 +1,113 @@
+/**
+ * @file tests/log_bench.cpp
+ * @brief Cost of a log line for the thread that generates it
+ *
+ * (c) 2013-2018 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+// usage: log_bench [lines]
+//
+// Logs the same line:
+// - below the current log level (disabled)
+// - below the current log level, with a level set for another module
+// - delivered synchronously to a Logger
+// - queued to an AsyncLogger (caller side, then until delivered)
+// and prints the nanoseconds per line of each. The Logger holds a mutex
+// and copies the message, like the loggers of the applications.
+
+#include "mega.h"
+#include <chrono>
+#include <stdlib.h>
+
+using namespace mega;
+
+class BenchLogger : public Logger
+{
+public:
+    MUTEX_CLASS mutex;
+    string last;
+    unsigned long long count;
+
+    BenchLogger() : mutex(false), count(0) { }
+
+    void log(const char*, int, const char*, const char* message)
+    {
+        mutex.lock();
+        last = message;
+        count++;
+        mutex.unlock();
+    }
+};
+
+static double seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void report(const char* what, unsigned count, double secs)
+{
+    std::cout << what << ": " << (count ? secs * 1e9 / count : 0) << " ns/line" << std::endl;
+}
+
+static void loglines(unsigned count)
+{
+    for (unsigned i = 0; i < count; i++)
+    {
+        LOG_debug << "Chunk finished OK (" << 0 << ") Pos: " << i << " Completed: " << i * 2 << " of " << count * 2;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned count = argc > 1 ? atoi(argv[1]) : 1000000;
+
+    BenchLogger logger;
+    SimpleLogger::setOutputClass(&logger);
+
+    SimpleLogger::setLogLevel(logInfo);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    loglines(count);
+    report("disabled", count, seconds(start));
+
+    SimpleLogger::setModuleLevel("transferslot", logMax);
+    start = std::chrono::steady_clock::now();
+    loglines(count);
+    report("disabled, other module enabled", count, seconds(start));
+    SimpleLogger::clearModuleLevels();
+
+    SimpleLogger::setLogLevel(logDebug);
+    start = std::chrono::steady_clock::now();
+    loglines(count);
+    report("enabled, synchronous", count, seconds(start));
+
+    {
+        AsyncLogger asynclogger;
+
+        start = std::chrono::steady_clock::now();
+        loglines(count);
+        report("enabled, asynchronous (caller)", count, seconds(start));
+
+        asynclogger.flush();
+        report("enabled, asynchronous (delivered)", count, seconds(start));
+
+        std::cout << "dropped: " << asynclogger.numdropped() << " of " << count << std::endl;
+    }
+
+    SimpleLogger::setOutputClass(NULL);
+
+    return 0;
+}
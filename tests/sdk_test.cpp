@@ -388,6 +388,12 @@ void SdkTest::onTransferFinish(MegaApi* api, MegaTransfer *transfer, MegaError*
 
     if (lastError[apiIndex] == MegaError::API_OK)
         h = transfer->getNodeHandle();
+
+    if (transfer->getType() == MegaTransfer::TYPE_UPLOAD && transfer->getFileName())
+    {
+        uploadedNodes[apiIndex][transfer->getFileName()] =
+                (lastError[apiIndex] == MegaError::API_OK) ? transfer->getNodeHandle() : UNDEF;
+    }
 }
 
 
@@ -1188,6 +1194,95 @@ TEST_F(SdkTest, SdkTestResumeSession)
     delete session;
 }
 
+/**
+ * @brief TEST_F SdkTestNodePaging
+ *
+ * Resumes the session from the local cache with node paging enabled, so that
+ * most nodes are evicted, and reads them back.
+ *
+ * - Create a folder with more children than the paging limit
+ * - Resume the session with node paging enabled
+ * - Get the evicted nodes by handle and as children of their parent
+ * - Create a new folder (its key is applied while nodes are paged)
+ */
+TEST_F(SdkTest, SdkTestNodePaging)
+{
+    megaApi[0]->log(MegaApi::LOG_LEVEL_INFO, "___TEST Node paging___");
+
+    const int maxNodes = 16;
+    const int numChildren = 4 * maxNodes;
+
+    MegaNode *rootnode = megaApi[0]->getRootNode();
+    char name[64] = "Paged folder";
+
+    ASSERT_NO_FATAL_FAILURE( createFolder(0, name, rootnode) );
+    MegaHandle hparent = h;
+    MegaNode *parent = megaApi[0]->getNodeByHandle(hparent);
+    ASSERT_NE((MegaNode*) NULL, parent) << "Cannot get the new folder";
+
+    vector<MegaHandle> handles;
+    for (int i = 0; i < numChildren; i++)
+    {
+        sprintf(name, "Child %d", i);
+        ASSERT_NO_FATAL_FAILURE( createFolder(0, name, parent) );
+        handles.push_back(h);
+    }
+
+    delete parent;
+    delete rootnode;
+
+    // --- Resume with node paging ---
+
+    char *session = dumpSession();
+
+    ASSERT_NO_FATAL_FAILURE( locallogout() );
+    megaApi[0]->setNodePaging(maxNodes);
+    ASSERT_NO_FATAL_FAILURE( resumeSession(session) );
+    ASSERT_NO_FATAL_FAILURE( fetchnodes(0) );
+
+    delete [] session;
+
+    // --- Read evicted nodes back by handle ---
+
+    for (int i = 0; i < numChildren; i++)
+    {
+        MegaNode *n = megaApi[0]->getNodeByHandle(handles[i]);
+        ASSERT_NE((MegaNode*) NULL, n) << "Node " << i << " not read back";
+
+        sprintf(name, "Child %d", i);
+        EXPECT_STREQ(name, n->getName()) << "Wrong name of node read back";
+        EXPECT_EQ(hparent, n->getParentHandle()) << "Wrong parent of node read back";
+        delete n;
+    }
+
+    // --- Read evicted nodes back as children ---
+
+    parent = megaApi[0]->getNodeByHandle(hparent);
+    ASSERT_NE((MegaNode*) NULL, parent) << "Cannot get the parent folder";
+
+    MegaNodeList *children = megaApi[0]->getChildren(parent);
+    EXPECT_EQ(numChildren, children->size()) << "Wrong number of child nodes read back";
+    EXPECT_EQ(numChildren, megaApi[0]->getNumChildren(parent)) << "Wrong number of child nodes";
+    delete children;
+
+    MegaNode *child = megaApi[0]->getChildNode(parent, "Child 0");
+    ASSERT_NE((MegaNode*) NULL, child) << "Cannot get a child node by name";
+    EXPECT_EQ(handles[0], child->getHandle()) << "Wrong child node by name";
+    delete child;
+
+    // --- Create a folder while nodes are paged ---
+
+    strcpy(name, "Child new");
+    ASSERT_NO_FATAL_FAILURE( createFolder(0, name, parent) );
+
+    child = megaApi[0]->getNodeByHandle(h);
+    ASSERT_NE((MegaNode*) NULL, child) << "Cannot get the new folder";
+    EXPECT_STREQ(name, child->getName()) << "Wrong name of the new folder (key not applied?)";
+    delete child;
+
+    delete parent;
+}
+
 /**
  * @brief TEST_F SdkTestNodeOperations
  *
@@ -1481,6 +1576,83 @@ TEST_F(SdkTest, SdkTestTransfers)
     delete n5;
 }
 
+/**
+ * @brief TEST_F SdkTestSmallFileUploads
+ *
+ * Uploads many small files to the same folder in small-file upload mode, so
+ * that their new nodes are added with coalesced putnodes.
+ *
+ * - Upload small files with different content to a new folder
+ * - Check that each upload reports the node of its own file
+ */
+TEST_F(SdkTest, SdkTestSmallFileUploads)
+{
+    megaApi[0]->log(MegaApi::LOG_LEVEL_INFO, "___TEST Small file uploads___");
+
+    const int numFiles = 50;
+
+    MegaNode *rootnode = megaApi[0]->getRootNode();
+    char foldername[64] = "Small files";
+
+    ASSERT_NO_FATAL_FAILURE( createFolder(0, foldername, rootnode) );
+    MegaNode *folder = megaApi[0]->getNodeByHandle(h);
+    ASSERT_NE((MegaNode*) NULL, folder) << "Cannot get the new folder";
+
+    megaApi[0]->setSmallFileUploads(true);
+    uploadedNodes[0].clear();
+
+    vector<string> filenames;
+    for (int i = 0; i < numFiles; i++)
+    {
+        char filename[64];
+        sprintf(filename, "small%d.txt", i);
+        filenames.push_back(filename);
+
+        // different content, so that no upload is completed by copying a node
+        FILE *fp = fopen(filename, "w");
+        ASSERT_NE((FILE*) NULL, fp) << "Cannot create " << filename;
+        for (int j = 0; j <= i; j++)
+        {
+            fprintf(fp, "small file %d\n", i);
+        }
+        fclose(fp);
+
+        megaApi[0]->startUpload(filename, folder);
+    }
+
+    unsigned int tWaited = 0;
+    while (uploadedNodes[0].size() < (size_t)numFiles && tWaited < maxTimeout * 1000000)
+    {
+        WaitMillisec(pollingT / 1000);
+        tWaited += pollingT;
+    }
+    ASSERT_EQ((size_t)numFiles, uploadedNodes[0].size()) << "Uploads not finished after " << maxTimeout << " seconds";
+
+    set<MegaHandle> handles;
+    for (int i = 0; i < numFiles; i++)
+    {
+        MegaHandle hfile = uploadedNodes[0][filenames[i]];
+        ASSERT_NE(UNDEF, hfile) << "Upload of " << filenames[i] << " failed";
+        EXPECT_TRUE(handles.insert(hfile).second) << "Node reported for more than one upload";
+
+        MegaNode *n = megaApi[0]->getNodeByHandle(hfile);
+        ASSERT_NE((MegaNode*) NULL, n) << "Cannot get the node of " << filenames[i];
+        EXPECT_STREQ(filenames[i].c_str(), n->getName()) << "Upload reported the node of another file";
+        EXPECT_EQ(folder->getHandle(), n->getParentHandle()) << "Uploaded file in the wrong folder";
+        EXPECT_EQ((int64_t)getFilesize(filenames[i]), n->getSize()) << "Wrong size of uploaded file";
+        delete n;
+
+        deleteFile(filenames[i]);
+    }
+
+    EXPECT_EQ(numFiles, megaApi[0]->getNumChildren(folder)) << "Wrong number of uploaded files";
+
+    megaApi[0]->setSmallFileUploads(false);
+
+    delete folder;
+    delete rootnode;
+}
+
 /**
  * @brief TEST_F SdkTestContacts
  *
@@ -86,6 +86,9 @@ public:
 
     MegaContactRequest* cr[2];
 
+    // handles of the nodes of finished uploads by file name (UNDEF if failed)
+    map<string, MegaHandle> uploadedNodes[2];
+
     // flags to monitor the updates of nodes/users/PCRs due to actionpackets
     bool nodeUpdated[2];
     bool userUpdated[2];
@@ -0,0 +1,211 @@
+/**
+ * @file tests/snapshot_bench.cpp
+ * @brief Node loading from the state cache and from a state snapshot
+ *
+ * (c) 2013-2018 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+// usage: snapshot_bench [nodes]
+//
+// Loads the same node records (folders of 99 files below a common folder)
+// from:
+// - the SQLite state cache: DbTable::next() with per-record decryption
+// - a state snapshot: StateSnapshot::read()
+// then decodes them and creates the nodes, which both paths share
+// (fetchsc() decodes the snapshot records in place)
+
+#include "mega.h"
+#include <chrono>
+#include <stdlib.h>
+
+using namespace mega;
+
+#ifdef USE_SQLITE
+static double seconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void report(const char* what, unsigned count, double secs)
+{
+    std::cout << what << ": " << count << " nodes in " << secs << " s ("
+              << (unsigned long)(secs > 0 ? count / secs : 0) << " nodes/s)" << std::endl;
+}
+
+// HttpIO of a client that never connects
+struct IdleHttpIO : public HttpIO
+{
+    void post(HttpReq*, const char*, unsigned) { }
+    void cancel(HttpReq*) { }
+    m_off_t postpos(void*) { return 0; }
+    bool doio() { return false; }
+    void setuseragent(string*) { }
+    void addevents(Waiter*, int) { }
+};
+
+int main(int argc, char* argv[])
+{
+    unsigned count = argc > 1 ? atoi(argv[1]) : 200000;
+
+    FSACCESS_CLASS fsaccess;
+    MegaApp app;
+    WAIT_CLASS waiter;
+    IdleHttpIO httpio;
+    MegaClient client(&app, &waiter, &httpio, &fsaccess, NULL, NULL, "bench", "bench");
+
+    byte keybuf[FILENODEKEYLENGTH];
+    for (unsigned i = 0; i < sizeof keybuf; i++)
+    {
+        keybuf[i] = (byte)rand();
+    }
+
+    SymmCipher key;
+    key.setkey(keybuf);
+
+    string path = "./";
+    string name = "snapshotbench";
+    SqliteDbAccess dbaccess(&path);
+
+    DbTable* table = dbaccess.open(&fsaccess, &name);
+    if (!table)
+    {
+        std::cout << "Unable to open the database" << std::endl;
+        return 1;
+    }
+
+    table->truncate();
+    table->begin();
+
+    StateSnapshot snapshot;
+    node_vector dp;
+    Node* root = NULL;
+    Node* folder = NULL;
+    string d;
+    char buf[64];
+
+    for (unsigned i = 0; i < count; i++)
+    {
+        nodetype_t type = (i % 100) ? FILENODE : FOLDERNODE;
+        Node* parent = type == FILENODE ? folder : root;
+        Node* n = new Node(&client, &dp, i + 1, parent ? parent->nodehandle : UNDEF, type,
+                           type == FILENODE ? 1000000 + i : -1, 1, "", 1500000000 + i);
+
+        n->setkey(keybuf);
+        sprintf(buf, type == FILENODE ? "IMG_%06u.jpg" : "Folder %u", i);
+        n->attrs.map['n'] = buf;
+
+        if (type == FILENODE)
+        {
+            n->attrs.map['c'] = "Kq4z5bK1Hm1fPV7ea9Db7w4_LLRNY1";
+        }
+        else
+        {
+            folder = n;
+
+            if (!root)
+            {
+                root = n;
+            }
+        }
+
+        uint32_t dbid = (i + 1) * 16 | MegaClient::CACHEDNODE;
+        table->put(dbid, n, &key);
+
+        d.clear();
+        n->serialize(&d);
+        snapshot.add(dbid, &d, n->nodehandle);
+    }
+
+    table->commit();
+
+    string snapshotpath = "./snapshotbench.snapshot";
+    if (!snapshot.write(&fsaccess, snapshotpath, &key))
+    {
+        std::cout << "Unable to write the snapshot" << std::endl;
+        return 1;
+    }
+
+    // state cache: read and decrypt, then decode and create
+    {
+        MegaClient loaded(&app, &waiter, &httpio, &fsaccess, NULL, NULL, "bench", "bench");
+        vector<string> records;
+        uint32_t id;
+
+        records.reserve(count);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        table->rewind();
+        while (table->next(&id, &d, &key))
+        {
+            records.push_back(d);
+        }
+        report("state cache, read and decrypt", count, seconds(start));
+
+        start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            Node::unserialize(&loaded, &records[i], &dp);
+        }
+        report("state cache, decode and create", count, seconds(start));
+    }
+
+    // snapshot: read, authenticate and decrypt, then decode in place and
+    // create
+    {
+        MegaClient loaded(&app, &waiter, &httpio, &fsaccess, NULL, NULL, "bench", "bench");
+        StateSnapshot read;
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (!read.read(&fsaccess, snapshotpath, &key))
+        {
+            std::cout << "Unable to read the snapshot" << std::endl;
+            return 1;
+        }
+        report("snapshot, read and decrypt", count, seconds(start));
+
+        // the share of the decoding (as a fixed-layout record would avoid)
+        start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < read.numrecords(); i++)
+        {
+            const StateSnapshot::Record* r = read.record(i);
+            NodeRecord record;
+            record.decode(read.data(r), r->length, &fsaccess);
+        }
+        report("snapshot, decode only", count, seconds(start));
+
+        start = std::chrono::steady_clock::now();
+        for (uint32_t i = 0; i < read.numrecords(); i++)
+        {
+            const StateSnapshot::Record* r = read.record(i);
+            Node::unserialize(&loaded, read.data(r), r->length, &dp);
+        }
+        report("snapshot, decode and create", count, seconds(start));
+    }
+
+    StateSnapshot::remove(&fsaccess, snapshotpath);
+    table->remove();
+    delete table;
+
+    return 0;
+}
+#else
+int main()
+{
+    std::cout << "SQLite support is required" << std::endl;
+    return 1;
+}
+#endif
@@ -22,6 +22,8 @@
 #include "mega.h"
 #include "gtest/gtest.h"
 
+#include <limits>
+
 using namespace mega;
 using ::testing::InitGoogleTest;
 using ::testing::Test;
@@ -38,6 +40,69 @@ TEST(JSON, storeobject)
     j.storeobject(&in_str);
 }
 
+// complete values are only detected once fully received
+TEST(JSON, valueend)
+{
+    const char* node = "{\"h\":\"abc\",\"a\":\"x\\\"}\",\"s\":[1,{\"t\":2}]},{";
+    const char* end = JSON::valueend(node);
+    ASSERT_TRUE(end != NULL);
+    ASSERT_EQ(',', *end);
+
+    std::string partial(node, end - node);
+    for (size_t i = partial.size(); i--; )
+    {
+        ASSERT_TRUE(JSON::valueend(std::string(partial, 0, i).c_str()) == NULL);
+    }
+
+    ASSERT_TRUE(JSON::valueend("123") == NULL);
+    ASSERT_EQ(']', *JSON::valueend("123]"));
+    ASSERT_TRUE(JSON::valueend("\"a\\") == NULL);
+}
+
+// node handle hash table against std::map
+TEST(NodeMap, insertfinderase)
+{
+    node_map nodes;
+    std::map<handle, Node*> expected;
+
+    srand(1);
+    for (int i = 0; i < 100000; i++)
+    {
+        handle h = rand() % 4096;
+
+        if (rand() % 3)
+        {
+            Node* n = (Node*)(size_t)(rand() + 1);
+            nodes[h] = n;
+            expected[h] = n;
+        }
+        else
+        {
+            ASSERT_EQ(expected.erase(h), nodes.erase(h));
+        }
+    }
+
+    ASSERT_EQ(expected.size(), nodes.size());
+
+    size_t count = 0;
+    for (node_map::iterator it = nodes.begin(); it != nodes.end(); it++, count++)
+    {
+        ASSERT_EQ(expected[it->first], it->second);
+    }
+    ASSERT_EQ(expected.size(), count);
+
+    for (std::map<handle, Node*>::iterator it = expected.begin(); it != expected.end(); it++)
+    {
+        node_map::iterator nit = nodes.find(it->first);
+        ASSERT_TRUE(nit != nodes.end());
+        ASSERT_EQ(it->second, nit->second);
+    }
+
+    nodes.clear();
+    ASSERT_TRUE(nodes.begin() == nodes.end());
+    ASSERT_TRUE(nodes.find(1) == nodes.end());
+}
+
 // Test 64-bit int serialization/unserialization
 TEST(Serialize64, serialize)
 {
@@ -50,6 +115,676 @@ TEST(Serialize64, serialize)
     ASSERT_EQ(in, out);
 }
 
+// snapshot layout, authentication and child index
+TEST(StateSnapshot, writeread)
+{
+    FSACCESS_CLASS fsaccess;
+    SymmCipher key;
+    byte k[SymmCipher::KEYLENGTH] = { 1, 2, 3 };
+    key.setkey(k);
+
+    string path = "./statesnapshot_test";
+    string user = "user", root = "root", child1 = "child1", child2 = "child2", grandchild = "grandchild";
+
+    StateSnapshot out;
+    out.header.scsn = 42;
+    out.header.nextid = 160;
+    out.add(16 | MegaClient::CACHEDUSER, &user);
+    out.add(32 | MegaClient::CACHEDNODE, &root, 100);
+    out.add(48 | MegaClient::CACHEDNODE, &child1, 101);
+    out.add(64 | MegaClient::CACHEDNODE, &child2, 102);
+    out.add(80 | MegaClient::CACHEDNODE, &grandchild, 103);
+    ASSERT_TRUE(out.write(&fsaccess, path, &key));
+
+    StateSnapshot in;
+    ASSERT_TRUE(in.read(&fsaccess, path, &key));
+    ASSERT_EQ(5u, in.numrecords());
+    ASSERT_EQ(42u, in.header.scsn);
+    ASSERT_EQ(160u, in.header.nextid);
+    ASSERT_EQ(1u, in.header.firstnode);
+
+    const StateSnapshot::Record* rec = in.record(0);
+    ASSERT_EQ(UNDEF, rec->h);
+    ASSERT_EQ(16u | MegaClient::CACHEDUSER, rec->dbid);
+    ASSERT_EQ(user, string(in.data(rec), rec->length));
+
+    rec = in.record(1);
+    ASSERT_EQ(100u, rec->h);
+    ASSERT_EQ(root, string(in.data(rec), rec->length));
+
+    rec = in.record(4);
+    ASSERT_EQ(103u, rec->h);
+    ASSERT_EQ(80u | MegaClient::CACHEDNODE, rec->dbid);
+    ASSERT_EQ(grandchild, string(in.data(rec), rec->length));
+
+    // snapshots of another format version are discarded
+    StateSnapshot old;
+    old.header.version = StateSnapshot::VERSION - 1;
+    old.add(16 | MegaClient::CACHEDUSER, &user);
+    ASSERT_TRUE(old.write(&fsaccess, path, &key));
+    ASSERT_FALSE(in.read(&fsaccess, path, &key));
+    ASSERT_EQ(0u, in.numrecords());
+
+    // wrong key
+    byte otherk[SymmCipher::KEYLENGTH] = { 3, 2, 1 };
+    SymmCipher other;
+    other.setkey(otherk);
+    StateSnapshot bad;
+    ASSERT_FALSE(bad.read(&fsaccess, path, &other));
+    ASSERT_EQ(0u, bad.numrecords());
+
+    StateSnapshot::remove(&fsaccess, path);
+    ASSERT_FALSE(bad.read(&fsaccess, path, &key));
+}
+
+// records the calls made by the writer thread of an AsyncDbTable
+// (put(BLOCKINGID) waits for the gate to be opened)
+struct MockDbLog
+{
+    static const uint32_t BLOCKINGID = 0xFFF0;
+
+    vector<string> ops;
+    unsigned commits;
+    SEMAPHORE_CLASS entered;
+    SEMAPHORE_CLASS gate;
+
+    MockDbLog() : commits(0) { }
+};
+
+class MockDbTable : public DbTable
+{
+    MockDbLog* log;
+
+public:
+    void rewind() { }
+    bool next(uint32_t*, string*) { return false; }
+    bool get(uint32_t, string*) { return false; }
+
+    bool put(uint32_t id, char*, unsigned)
+    {
+        if (id == MockDbLog::BLOCKINGID)
+        {
+            log->entered.release();
+            log->gate.wait();
+        }
+
+        std::ostringstream op;
+        op << "put " << id;
+        log->ops.push_back(op.str());
+        return true;
+    }
+
+    bool del(uint32_t) { return true; }
+    void truncate() { }
+    void begin() { }
+
+    void commit()
+    {
+        log->ops.push_back("commit");
+        log->commits++;
+    }
+
+    void abort() { }
+    void remove() { }
+
+    bool getnodes(int, handle h, uint64_t, dbnoderecord_vector* records)
+    {
+        log->ops.push_back("getnodes");
+
+        DbNodeRecord record;
+        record.id = 32;
+        record.h = h;
+        record.ph = UNDEF;
+        records->push_back(record);
+        return true;
+    }
+
+    MockDbTable(MockDbLog* l) : log(l) { }
+};
+
+TEST(AsyncDbTable, barrier)
+{
+    MockDbLog log;
+    WAIT_CLASS waiter;
+    AsyncDbTable table(new MockDbTable(&log), &waiter);
+
+    char data[] = "x";
+    for (uint32_t id = 1; id <= 3; id++)
+    {
+        ASSERT_TRUE(table.put(id, data, 1));
+    }
+
+    table.barrier();
+
+    ASSERT_EQ(3u, log.ops.size());
+    ASSERT_EQ("put 1", log.ops[0]);
+    ASSERT_EQ("put 3", log.ops[2]);
+    ASSERT_EQ(0u, log.commits);
+    ASSERT_EQ(0u, table.durableseq());
+}
+
+TEST(AsyncDbTable, groupcommit)
+{
+    MockDbLog log;
+    WAIT_CLASS waiter;
+    AsyncDbTable table(new MockDbTable(&log), &waiter);
+
+    // keep the writer busy with a first round
+    char data[] = "x";
+    ASSERT_TRUE(table.put(MockDbLog::BLOCKINGID, data, 1));
+    log.entered.wait();
+
+    // queued meanwhile: applied as one round with a single commit
+    for (uint32_t id = 1; id <= 3; id++)
+    {
+        ASSERT_TRUE(table.put(id, data, 1));
+        table.commit();
+    }
+
+    ASSERT_EQ(3u, table.commitseq());
+
+    log.gate.release();
+    table.barrier();
+
+    ASSERT_EQ(5u, log.ops.size());
+    ASSERT_EQ("put 3", log.ops[3]);
+    ASSERT_EQ("commit", log.ops[4]);
+    ASSERT_EQ(1u, log.commits);
+    ASSERT_EQ(3u, table.durableseq());
+}
+
+// opens the gate of the log once a node query is in the journal
+class GatedAsyncDbTable : public AsyncDbTable
+{
+    MockDbLog* log;
+
+protected:
+    void queued(const DbJournalOp* op)
+    {
+        if (op->type == DbJournalOp::GETNODES)
+        {
+            log->gate.release();
+        }
+    }
+
+public:
+    GatedAsyncDbTable(MockDbLog* l, Waiter* w) : AsyncDbTable(new MockDbTable(l), w), log(l) { }
+};
+
+TEST(AsyncDbTable, getnodesaheadofcommit)
+{
+    MockDbLog log;
+    WAIT_CLASS waiter;
+    GatedAsyncDbTable table(&log, &waiter);
+
+    char data[] = "x";
+    ASSERT_TRUE(table.put(MockDbLog::BLOCKINGID, data, 1));
+    log.entered.wait();
+
+    ASSERT_TRUE(table.put(1, data, 1));
+    table.commit();
+
+    // the first round completes only once the query is queued behind the commit
+    dbnoderecord_vector records;
+    ASSERT_TRUE(table.getnodes(DbTable::NODES_BYHANDLE, 100, 0, &records));
+
+    ASSERT_EQ(1u, records.size());
+    ASSERT_EQ(100u, records[0].h);
+
+    // the query sees the put ahead of it, but doesn't wait for the commit
+    table.barrier();
+    ASSERT_EQ(4u, log.ops.size());
+    ASSERT_EQ("put 1", log.ops[1]);
+    ASSERT_EQ("getnodes", log.ops[2]);
+    ASSERT_EQ("commit", log.ops[3]);
+}
+
+TEST(AsyncDbTable, shutdownflush)
+{
+    MockDbLog log;
+    WAIT_CLASS waiter;
+
+    {
+        AsyncDbTable table(new MockDbTable(&log), &waiter);
+
+        char data[] = "x";
+        ASSERT_TRUE(table.put(MockDbLog::BLOCKINGID, data, 1));
+        log.entered.wait();
+
+        for (uint32_t id = 1; id <= 3; id++)
+        {
+            ASSERT_TRUE(table.put(id, data, 1));
+        }
+        table.commit();
+
+        // the queued mutations are applied before the table is deleted
+        log.gate.release();
+    }
+
+    ASSERT_EQ(5u, log.ops.size());
+    ASSERT_EQ("put 3", log.ops[3]);
+    ASSERT_EQ("commit", log.ops[4]);
+}
+
+#ifdef ENABLE_SYNC
+// wait up to 5 s for the scanner threads to buffer the given number of entries
+static bool waitbuffered(SyncScanner* scanner, size_t entries)
+{
+    SEMAPHORE_CLASS delay;
+
+    for (int i = 500; i--; )
+    {
+        if (scanner->numbuffered() == entries)
+        {
+            return true;
+        }
+
+        delay.timedwait(10);
+    }
+
+    return false;
+}
+
+TEST(SyncScanner, takeskip)
+{
+    FSACCESS_CLASS fsaccess;
+    const char* folders[] = { "", "/a", "/a/a1", "/b", "/b/b1", "/b/b1/b2" };
+    const int numfolders = sizeof folders / sizeof *folders;
+
+    string root = "./syncscanner_test";
+    string debris = root + "/.debris";
+    string path;
+
+    for (int i = 0; i < numfolders; i++)
+    {
+        path = root + folders[i];
+        ASSERT_TRUE(fsaccess.mkdirlocal(&path, false));
+    }
+
+    {
+        SyncScanner scanner(&fsaccess, &root, &debris, false, 2);
+
+        // the whole tree is read ahead: one entry per folder but the root
+        ASSERT_TRUE(waitbuffered(&scanner, numfolders - 1));
+
+        ScanBatch* batch = scanner.take(&root);
+        ASSERT_TRUE(batch != NULL);
+        ASSERT_EQ(2u, batch->entries.size());
+        delete batch;
+
+        path = root + "/a";
+        batch = scanner.take(&path);
+        ASSERT_TRUE(batch != NULL);
+        ASSERT_EQ(1u, batch->entries.size());
+        ASSERT_EQ("a1", batch->entries[0].localname);
+        delete batch;
+
+        // excluded: the batches of the subtree are dropped
+        path = root + "/b";
+        scanner.skip(&path);
+        ASSERT_EQ(0u, scanner.numbuffered());
+
+        path = root + "/b/b1";
+        ASSERT_TRUE(scanner.take(&path) == NULL);
+
+        path = root + "/a/a1";
+        batch = scanner.take(&path);
+        ASSERT_TRUE(batch != NULL);
+        ASSERT_EQ(0u, batch->entries.size());
+        delete batch;
+    }
+
+    for (int i = numfolders; i--; )
+    {
+        path = root + folders[i];
+        fsaccess.rmdirlocal(&path);
+    }
+}
+
+#ifdef USE_FANOTIFY
+// HttpIO of a client that never connects
+struct IdleHttpIO : public HttpIO
+{
+    void post(HttpReq*, const char*, unsigned) { }
+    void cancel(HttpReq*) { }
+    m_off_t postpos(void*) { return 0; }
+    bool doio() { return false; }
+    void setuseragent(string*) { }
+    void addevents(Waiter*, int) { }
+};
+
+// file handle of a folder, as reported by fanotify
+static bool fanotifyhandle(string* path, __kernel_fsid_t* fsid, string* fh)
+{
+    struct statfs statfsbuf;
+    int mountid;
+
+    fh->resize(sizeof(struct file_handle) + MAX_HANDLE_SZ);
+    ((struct file_handle*)fh->data())->handle_bytes = MAX_HANDLE_SZ;
+
+    if (statfs(path->c_str(), &statfsbuf)
+     || name_to_handle_at(AT_FDCWD, path->c_str(), (struct file_handle*)fh->data(), &mountid, 0))
+    {
+        return false;
+    }
+
+    memcpy(fsid, &statfsbuf.f_fsid, sizeof *fsid);
+    fh->resize(sizeof(struct file_handle) + ((struct file_handle*)fh->data())->handle_bytes);
+    return true;
+}
+
+TEST(PosixFileSystemAccess, fanotifynode)
+{
+    PosixFileSystemAccess fsaccess;
+
+    if (fsaccess.fanotifyfd < 0)
+    {
+        // fanotify requires CAP_SYS_ADMIN
+        std::cout << "fanotify not available, skipped" << std::endl;
+        return;
+    }
+
+    string root = "./fanotify_test";
+    string folderpath = root + "/a";
+    string otherpath = "./fanotify_test_other";
+    ASSERT_TRUE(fsaccess.mkdirlocal(&root, false));
+    ASSERT_TRUE(fsaccess.mkdirlocal(&folderpath, false));
+    ASSERT_TRUE(fsaccess.mkdirlocal(&otherpath, false));
+
+    {
+        MegaApp app;
+        WAIT_CLASS waiter;
+        IdleHttpIO httpio;
+        MegaClient client(&app, &waiter, &httpio, &fsaccess, NULL, NULL, "test", "test");
+
+        string debris = ".debris";
+        Sync* sync = new Sync(&client, &root, NULL, &debris, NULL, 0, false, 0, NULL);
+
+        if (((PosixDirNotify*)sync->dirnotify.get())->fanotify)
+        {
+            struct stat statbuf;
+            ASSERT_EQ(0, stat(folderpath.c_str(), &statbuf));
+
+            LocalNode* folder = new LocalNode();
+            folder->init(sync, FOLDERNODE, &sync->localroot, &folderpath);
+            folder->setfsid((handle)statbuf.st_ino);
+
+            __kernel_fsid_t fsid;
+            string fh;
+
+            // the root isn't in fsidnode
+            ASSERT_TRUE(fanotifyhandle(&root, &fsid, &fh));
+            ASSERT_EQ(&sync->localroot, fsaccess.fanotifynode(&fsid, (struct file_handle*)fh.data()));
+
+            // resolved, then found in the cache
+            ASSERT_TRUE(fanotifyhandle(&folderpath, &fsid, &fh));
+            ASSERT_EQ(folder, fsaccess.fanotifynode(&fsid, (struct file_handle*)fh.data()));
+            ASSERT_EQ(2u, fsaccess.fanhandles.size());
+            ASSERT_EQ(folder, fsaccess.fanotifynode(&fsid, (struct file_handle*)fh.data()));
+
+            // not synced
+            ASSERT_TRUE(fanotifyhandle(&otherpath, &fsid, &fh));
+            ASSERT_TRUE(fsaccess.fanotifynode(&fsid, (struct file_handle*)fh.data()) == NULL);
+
+            // a rename: the target is notified ahead of the source
+            string filepath = folderpath + "/f";
+            string movedpath = root + "/g";
+            FILE* fp = fopen(filepath.c_str(), "w");
+            ASSERT_TRUE(fp != NULL);
+            fclose(fp);
+            fsaccess.checkfanotify();
+
+            notify_deque* q = &sync->dirnotify->notifyq[DirNotify::DIREVENTS];
+            q->clear();
+            ASSERT_EQ(0, rename(filepath.c_str(), movedpath.c_str()));
+            fsaccess.checkfanotify();
+
+            ASSERT_EQ(2u, q->size());
+            ASSERT_EQ(&sync->localroot, (*q)[0].localnode);
+            ASSERT_EQ("g", (*q)[0].path);
+            ASSERT_EQ(folder, (*q)[1].localnode);
+            ASSERT_EQ("f", (*q)[1].path);
+            unlink(movedpath.c_str());
+        }
+        else
+        {
+            std::cout << "The test folder can't be watched with fanotify, skipped" << std::endl;
+        }
+
+        sync->changestate(SYNC_CANCELED);
+        delete sync;
+    }
+
+    fsaccess.rmdirlocal(&otherpath);
+    fsaccess.rmdirlocal(&folderpath);
+    fsaccess.rmdirlocal(&root);
+}
+#endif
+#endif
+
+// counts the delivered log messages
+class CountingLogger : public Logger
+{
+    MUTEX_CLASS mutex;
+
+public:
+    unsigned count;
+
+    void log(const char*, int, const char*, const char*)
+    {
+        mutex.lock();
+        count++;
+        mutex.unlock();
+    }
+
+    CountingLogger() : mutex(false), count(0) { }
+};
+
+static void* logmessages(void*)
+{
+    for (int i = 0; i < 20000; i++)
+    {
+        LOG_warn << "Message " << i;
+    }
+
+    return NULL;
+}
+
+// the async delivery and the module levels are switched while other
+// threads are logging: no message is lost or delivered twice
+TEST(AsyncLogger, switchwhilelogging)
+{
+    CountingLogger counter;
+    SimpleLogger::setOutputClass(&counter);
+
+    AsyncLogger* asynclogger = new AsyncLogger();
+
+    THREAD_CLASS threads[4];
+    for (int i = 0; i < 4; i++)
+    {
+        threads[i].start(logmessages, NULL);
+    }
+
+    for (int i = 0; i < 1000; i++)
+    {
+        asynclogger->suspend();
+        SimpleLogger::setModuleLevel("tests", logDebug);
+        SimpleLogger::setModuleLevel("transferslot", logError);
+        asynclogger->resume();
+        SimpleLogger::clearModuleLevels();
+    }
+
+    for (int i = 0; i < 4; i++)
+    {
+        threads[i].join();
+    }
+
+    asynclogger->suspend();
+    ASSERT_EQ(4 * 20000u, counter.count);
+
+    // still usable by threads that read the queue before suspend()
+    string message = "late";
+    ASSERT_FALSE(asynclogger->push(time(NULL), logWarning, __FILE__, __LINE__, &message));
+
+    delete asynclogger;
+    SimpleLogger::setOutputClass(NULL);
+}
+
+// bucket i counts the values in (2^(i-1), 2^i], bucket 0 up to 1
+TEST(Metrics, histogrambuckets)
+{
+    MetricHistogram h;
+
+    h.add(-5);
+    h.add(0);
+    h.add(1);
+    h.add(2);
+    h.add(3);
+    h.add(4);
+    h.add(5);
+    h.add(1024);
+    h.add(1025);
+    h.add((int64_t)1 << (MetricHistogram::NUMBUCKETS - 1));
+    h.add(((int64_t)1 << (MetricHistogram::NUMBUCKETS - 1)) + 1);
+
+    ASSERT_EQ(3u, h.buckets[0]);
+    ASSERT_EQ(1u, h.buckets[1]);
+    ASSERT_EQ(2u, h.buckets[2]);
+    ASSERT_EQ(1u, h.buckets[3]);
+    ASSERT_EQ(1u, h.buckets[10]);
+    ASSERT_EQ(1u, h.buckets[11]);
+    ASSERT_EQ(1u, h.buckets[MetricHistogram::NUMBUCKETS - 1]);
+
+    uint64_t total = 0;
+    for (int i = 0; i < MetricHistogram::NUMBUCKETS; i++)
+    {
+        total += h.buckets[i];
+    }
+
+    // the value beyond the last bucket is only in count and sum
+    ASSERT_EQ(10u, total);
+    ASSERT_EQ(11u, h.count);
+    ASSERT_EQ(2 * ((int64_t)1 << (MetricHistogram::NUMBUCKETS - 1)) + 1 + 1 + 2 + 3 + 4 + 5 + 1024 + 1025, h.sum);
+}
+
+TEST(Metrics, tojson)
+{
+    Metrics::reset();
+    Metrics::add(Metrics::TRANSFER_BYTES_GET, 1000);
+    Metrics::add(Metrics::UPLOADS_BATCHED);
+    Metrics::set(Metrics::HTTP_SOCKETS_API, 2);
+    Metrics::observe(Metrics::API_REQUEST_COMMANDS, 1);
+    Metrics::observe(Metrics::API_REQUEST_COMMANDS, 3);
+    Metrics::observe(Metrics::API_REQUEST_COMMANDS, 4);
+
+    string json;
+    Metrics::tojson(&json);
+
+    ASSERT_EQ(0u, json.find("{\"counters\":{\"transfer_bytes_get\":1000,\"transfer_bytes_put\":0,"));
+    ASSERT_NE(string::npos, json.find(",\"uploads_batched\":1},\"gauges\":{"));
+    ASSERT_NE(string::npos, json.find(",\"http_sockets_api\":2,"));
+
+    // trailing empty buckets are omitted
+    ASSERT_NE(string::npos, json.find("\"api_request_commands\":{\"count\":3,\"sum\":8,\"buckets\":[1,0,2]}"));
+    ASSERT_NE(string::npos, json.find("\"api_request_us\":{\"count\":0,\"sum\":0,\"buckets\":[]}"));
+
+    // a single complete object
+    string terminated = json + ",";
+    const char* end = JSON::valueend(terminated.c_str());
+    ASSERT_TRUE(end != NULL);
+    ASSERT_EQ(terminated.c_str() + json.size(), end);
+
+    Metrics::reset();
+}
+
+// long keys with full-width 64-bit values are not truncated
+TEST(Metrics, tojsonlargevalues)
+{
+    Metrics::reset();
+    Metrics::add(Metrics::TRANSFER_CHUNK_FAILURES_PUT, std::numeric_limits<int64_t>::min());
+    Metrics::set(Metrics::SYNC_FOLDERS_SKIPPED_SYNCDOWN, std::numeric_limits<int64_t>::max());
+
+    for (int i = 0; i < 100000; i++)
+    {
+        Metrics::observe(Metrics::CHUNK_DURATION_GET, 92233720368547);
+    }
+
+    Metrics::observe(Metrics::SYNC_SYNCDOWN_DURATION, std::numeric_limits<int64_t>::max());
+
+    string json;
+    Metrics::tojson(&json);
+
+    ASSERT_NE(string::npos, json.find("\"transfer_chunk_failures_put\":-9223372036854775808,"));
+    ASSERT_NE(string::npos, json.find("\"sync_folders_skipped_syncdown\":9223372036854775807,"));
+    ASSERT_NE(string::npos, json.find("\"chunk_duration_get_us\":{\"count\":100000,\"sum\":9223372036854700000,\"buckets\":["));
+    ASSERT_NE(string::npos, json.find("\"sync_syncdown_us\":{\"count\":1,\"sum\":9223372036854775807,\"buckets\":[]}"));
+
+    string terminated = json + ",";
+    const char* end = JSON::valueend(terminated.c_str());
+    ASSERT_TRUE(end != NULL);
+    ASSERT_EQ(terminated.c_str() + json.size(), end);
+
+    Metrics::reset();
+}
+
+TEST(Metrics, toprometheus)
+{
+    Metrics::reset();
+    Metrics::add(Metrics::TRANSFER_BYTES_GET, 1000);
+    Metrics::add(Metrics::TRANSFER_BYTES_PUT, 500);
+    Metrics::set(Metrics::HTTP_SOCKETS_GET, 3);
+    Metrics::set(Metrics::HTTP_CONNECTS_API, 7);
+    Metrics::observe(Metrics::CHUNK_DURATION_GET, 3);
+    Metrics::observe(Metrics::CHUNK_DURATION_GET, 4);
+    Metrics::observe(Metrics::CHUNK_DURATION_GET, 100);
+
+    string text;
+    Metrics::toprometheus(&text);
+
+    // HELP and TYPE once per metric name, then one series per label set
+    ASSERT_NE(string::npos, text.find(
+        "# HELP mega_transfer_bytes_total Bytes of completed transfer chunks\n"
+        "# TYPE mega_transfer_bytes_total counter\n"
+        "mega_transfer_bytes_total{direction=\"get\"} 1000\n"
+        "mega_transfer_bytes_total{direction=\"put\"} 500\n"));
+
+    // gauges exported by their Prometheus type
+    ASSERT_NE(string::npos, text.find("# TYPE mega_http_sockets gauge\nmega_http_sockets{channel=\"get\"} 3\n"));
+    ASSERT_NE(string::npos, text.find("# TYPE mega_http_connects_total counter\n"));
+    ASSERT_NE(string::npos, text.find("mega_http_connects_total{channel=\"api\"} 7\n"));
+
+    // unlabelled series
+    ASSERT_NE(string::npos, text.find("\nmega_uploads_batched_total 0\n"));
+
+    // cumulative buckets with the power of two upper bounds
+    ASSERT_NE(string::npos, text.find("# TYPE mega_transfer_chunk_duration_microseconds histogram\n"));
+    ASSERT_NE(string::npos, text.find(
+        "mega_transfer_chunk_duration_microseconds_bucket{direction=\"get\",le=\"1\"} 0\n"
+        "mega_transfer_chunk_duration_microseconds_bucket{direction=\"get\",le=\"2\"} 0\n"
+        "mega_transfer_chunk_duration_microseconds_bucket{direction=\"get\",le=\"4\"} 2\n"
+        "mega_transfer_chunk_duration_microseconds_bucket{direction=\"get\",le=\"8\"} 2\n"
+        "mega_transfer_chunk_duration_microseconds_bucket{direction=\"get\",le=\"16\"} 2\n"
+        "mega_transfer_chunk_duration_microseconds_bucket{direction=\"get\",le=\"32\"} 2\n"
+        "mega_transfer_chunk_duration_microseconds_bucket{direction=\"get\",le=\"64\"} 2\n"
+        "mega_transfer_chunk_duration_microseconds_bucket{direction=\"get\",le=\"128\"} 3\n"));
+
+    char last[64];
+    sprintf(last, "le=\"%" PRIu64 "\"} 3\n", (uint64_t)1 << (MetricHistogram::NUMBUCKETS - 1));
+    ASSERT_NE(string::npos, text.find(string("mega_transfer_chunk_duration_microseconds_bucket{direction=\"get\",") + last));
+    ASSERT_NE(string::npos, text.find(
+        "mega_transfer_chunk_duration_microseconds_bucket{direction=\"get\",le=\"+Inf\"} 3\n"
+        "mega_transfer_chunk_duration_microseconds_sum{direction=\"get\"} 107\n"
+        "mega_transfer_chunk_duration_microseconds_count{direction=\"get\"} 3\n"));
+    ASSERT_NE(string::npos, text.find("mega_api_request_duration_microseconds_bucket{le=\"+Inf\"} 0\n"));
+
+    // each metric name described once, every line terminated
+    ASSERT_EQ(text.find("# HELP mega_transfer_chunk_duration_microseconds "),
+              text.rfind("# HELP mega_transfer_chunk_duration_microseconds "));
+    ASSERT_EQ('\n', text[text.size() - 1]);
+
+    Metrics::reset();
+}
+
 int main (int argc, char *argv[])
 {
     InitGoogleTest(&argc, argv);